@@ -1,10 +1,20 @@
+#pragma once
 #include <limits>
 #include <iostream>
 #include <vector>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace pretty_allocator {
-    template<class T>
+    // Alignment is the minimum alignment of every block; alignof(T) still
+    // applies when it is stricter. Anything above what plain operator new
+    // guarantees goes through the aligned operator new (e.g. 64 for cache
+    // lines and AVX-512, 4096 for pages).
+    template<class T, std::size_t Alignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__>
     class allocator {
+        static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
     public:
         typedef T value_type;
         typedef T *pointer;
@@ -14,9 +24,11 @@ namespace pretty_allocator {
         typedef std::size_t size_type;
         typedef std::ptrdiff_t difference_type;
 
+        static constexpr std::size_t alignment = Alignment > alignof(T) ? Alignment : alignof(T);
+
         template<class U>
         struct rebind {
-            typedef allocator<U> other;
+            typedef allocator<U, Alignment> other;
         };
 
         pointer address(reference value) const {
@@ -34,7 +46,7 @@ namespace pretty_allocator {
         }
 
         template<class U>
-        allocator(const allocator<U> &) noexcept {
+        allocator(const allocator<U, Alignment> &) noexcept {
         }
 
         ~allocator() noexcept {
@@ -45,32 +57,146 @@ namespace pretty_allocator {
         }
 
         pointer allocate(size_type num, const void * = 0) {
+            if (over_aligned) {
+                return static_cast<pointer>(::operator new(num * sizeof(T), std::align_val_t(alignment)));
+            }
             pointer p = (pointer) (::operator new(num * sizeof(T)));
             return p;
         }
 
-        void construct(pointer p, const T &value = T()) {
-            new((void *) p)T(value);
+        template<class U, class ...Args>
+        void construct(U *p, Args &&... args) {
+            new((void *) p)U(std::forward<Args>(args)...);
         }
 
-        void destroy(pointer p) {
-            p->~T();
+        template<class U>
+        void destroy(U *p) {
+            p->~U();
         }
 
         void deallocate(pointer p, size_type num) {
+            if (over_aligned) {
+                ::operator delete((void *) p, num * sizeof(T), std::align_val_t(alignment));
+                return;
+            }
+            ::operator delete((void *) p, num * sizeof(T));
+        }
+
+    private:
+        static constexpr bool over_aligned = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    };
+
+    template<class T1, std::size_t A1, class T2, std::size_t A2>
+    bool operator==(const allocator<T1, A1> &,
+                    const allocator<T2, A2> &) throw() {
+        return A1 == A2;
+    }
+
+    template<class T1, std::size_t A1, class T2, std::size_t A2>
+    bool operator!=(const allocator<T1, A1> &,
+                    const allocator<T2, A2> &) throw() {
+        return A1 != A2;
+    }
+
+    // counters shared by every tracking_allocator instantiation
+    struct allocation_stats {
+        std::size_t allocations = 0;
+        std::size_t deallocations = 0;
+        std::size_t bytes_allocated = 0;
+        std::size_t bytes_deallocated = 0;
+        std::size_t bytes_moved = 0; // element copy/move constructions
+
+        std::size_t live_allocations() const {
+            return allocations - deallocations;
+        }
+
+        std::size_t live_bytes() const {
+            return bytes_allocated - bytes_deallocated;
+        }
+
+        void reset() {
+            *this = allocation_stats();
+        }
+    };
+
+    inline allocation_stats &tracked_stats() {
+        static allocation_stats stats;
+        return stats;
+    }
+
+    template<class T>
+    class tracking_allocator {
+    public:
+        typedef T value_type;
+        typedef T *pointer;
+        typedef const T *const_pointer;
+        typedef T &reference;
+        typedef const T &const_reference;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template<class U>
+        struct rebind {
+            typedef tracking_allocator<U> other;
+        };
+
+        tracking_allocator() noexcept {
+        }
+
+        template<class U>
+        tracking_allocator(const tracking_allocator<U> &) noexcept {
+        }
+
+        size_type max_size() const noexcept {
+            return std::numeric_limits<std::size_t>::max() / sizeof(T);
+        }
+
+        pointer allocate(size_type num, const void * = 0) {
+            allocation_stats &stats = tracked_stats();
+            ++stats.allocations;
+            stats.bytes_allocated += num * sizeof(T);
+            return static_cast<pointer>(::operator new(num * sizeof(T)));
+        }
+
+        void deallocate(pointer p, size_type num) {
+            allocation_stats &stats = tracked_stats();
+            ++stats.deallocations;
+            stats.bytes_deallocated += num * sizeof(T);
             ::operator delete((void *) p);
         }
+
+        template<class U, class ...Args>
+        void construct(U *p, Args &&... args) {
+            if (is_relocation<U, Args...>::value) {
+                tracked_stats().bytes_moved += sizeof(U);
+            }
+            new((void *) p)U(std::forward<Args>(args)...);
+        }
+
+        template<class U>
+        void destroy(U *p) {
+            p->~U();
+        }
+
+    private:
+        template<class U, class ...Args>
+        struct is_relocation : std::false_type {
+        };
+
+        template<class U, class Arg>
+        struct is_relocation<U, Arg> : std::is_same<U, typename std::decay<Arg>::type> {
+        };
     };
 
     template<class T1, class T2>
-    bool operator==(const allocator<T1> &,
-                    const allocator<T2> &) throw() {
+    bool operator==(const tracking_allocator<T1> &,
+                    const tracking_allocator<T2> &) noexcept {
         return true;
     }
 
     template<class T1, class T2>
-    bool operator!=(const allocator<T1> &,
-                    const allocator<T2> &) throw() {
+    bool operator!=(const tracking_allocator<T1> &,
+                    const tracking_allocator<T2> &) noexcept {
         return false;
     }
 }
@@ -0,0 +1,1707 @@
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "bench.h"
+#include "vector.h"
+#include "soa_vector.h"
+#include "bit_vector.h"
+#include "segmented_vector.h"
+#include "devector.h"
+#include "circular_vector.h"
+#include "flat_map.h"
+#include "cow_vector.h"
+#include "immutable_vector.h"
+#include "rcu_vector.h"
+#include "concurrent_queue.h"
+#include "vector_pool.h"
+#include "numeric_vector.h"
+#include "simd_kernels.h"
+#include "sort.h"
+#include "permute.h"
+#include "scan.h"
+#include "compressed_int_vector.h"
+#include "vector_file.h"
+
+namespace {
+    using pretty_allocator::tracking_allocator;
+    using pretty_bench::do_not_optimize;
+
+    struct Record {
+        Record() : fields() {}
+
+        explicit Record(std::uint64_t key) : fields() {
+            fields[0] = key;
+        }
+
+        std::uint64_t fields[8];
+
+        friend bool operator==(const Record &lhs, const Record &rhs) { return lhs.fields[0] == rhs.fields[0]; }
+        friend bool operator!=(const Record &lhs, const Record &rhs) { return !(lhs == rhs); }
+        friend bool operator<(const Record &lhs, const Record &rhs) { return lhs.fields[0] < rhs.fields[0]; }
+    };
+
+    // same shape as NotIntegralType from the tests: two heap blocks; the move
+    // constructor is only declared noexcept when Nothrow is set
+    template<bool Nothrow>
+    class Heavy {
+    public:
+        Heavy() : large_field_a(new int[100]()), large_field_b(new int[100]()) {}
+
+        explicit Heavy(std::uint64_t key) : Heavy() {
+            large_field_a[0] = static_cast<int>(key);
+        }
+
+        Heavy(Heavy &&a) noexcept(Nothrow) {
+            large_field_a = a.large_field_a;
+            large_field_b = a.large_field_b;
+            a.large_field_a = nullptr;
+            a.large_field_b = nullptr;
+        }
+
+        Heavy(const Heavy &other) : Heavy() {
+            if (other.large_field_a) {
+                std::memcpy(large_field_a, other.large_field_a, 100 * (sizeof(int)));
+                std::memcpy(large_field_b, other.large_field_b, 100 * (sizeof(int)));
+            }
+        }
+
+        Heavy &operator=(Heavy &&other) noexcept(Nothrow) {
+            std::swap(large_field_a, other.large_field_a);
+            std::swap(large_field_b, other.large_field_b);
+            return *this;
+        }
+
+        Heavy &operator=(const Heavy &other) {
+            Heavy copy(other);
+            return *this = std::move(copy);
+        }
+
+        ~Heavy() {
+            delete[] large_field_a;
+            delete[] large_field_b;
+        }
+
+        int key() const { return large_field_a ? large_field_a[0] : 0; }
+
+        friend bool operator==(const Heavy &lhs, const Heavy &rhs) { return lhs.key() == rhs.key(); }
+        friend bool operator!=(const Heavy &lhs, const Heavy &rhs) { return !(lhs == rhs); }
+        friend bool operator<(const Heavy &lhs, const Heavy &rhs) { return lhs.key() < rhs.key(); }
+
+        int *large_field_a;
+        int *large_field_b;
+    };
+
+    std::uint64_t key_of(int value) { return static_cast<std::uint64_t>(value); }
+
+    std::uint64_t key_of(const Record &value) { return value.fields[0]; }
+
+    template<bool Nothrow>
+    std::uint64_t key_of(const Heavy<Nothrow> &value) { return static_cast<std::uint64_t>(value.key()); }
+
+    template<class C>
+    struct state {
+        typedef typename C::value_type T;
+
+        state(const std::vector<T> &values, std::size_t fill_a, std::size_t fill_b) {
+            for (std::size_t i = 0; i < fill_a; ++i) {
+                a.push_back(values[i]);
+            }
+            for (std::size_t i = 0; i < fill_b; ++i) {
+                b.push_back(values[i]);
+            }
+        }
+
+        C a;
+        C b;
+        std::optional<C> out;
+    };
+
+    template<class C>
+    void run_container(pretty_bench::report &report, const pretty_bench::options &opts,
+                       const char *type, const char *container, std::size_t n,
+                       const std::vector<std::uint64_t> &keys) {
+        typedef typename C::value_type T;
+        typedef state<C> S;
+
+        std::size_t quadratic = std::max<std::size_t>(n / 20, 1);
+        std::vector<T> values;
+        values.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            values.emplace_back(keys[i]);
+        }
+
+        auto add = [&](const char *name, std::size_t ops, std::size_t fill_a, std::size_t fill_b, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(
+                    opts, ops, [&] { return S(values, fill_a, fill_b); }, run);
+            r.name = name;
+            r.type = type;
+            r.container = container;
+            report.add(r);
+        };
+
+        add("push_back", n, 0, 0, [&](S &s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                s.a.push_back(values[i]);
+            }
+            do_not_optimize(s.a.size());
+        });
+
+        add("emplace_back", n, 0, 0, [&](S &s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                s.a.emplace_back(keys[i]);
+            }
+            do_not_optimize(s.a.size());
+        });
+
+        add("reserve_push_back", n, 0, 0, [&](S &s) {
+            s.a.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                s.a.push_back(values[i]);
+            }
+            do_not_optimize(s.a.size());
+        });
+
+        add("insert_front", quadratic, 0, 0, [&](S &s) {
+            for (std::size_t i = 0; i < quadratic; ++i) {
+                s.a.insert(s.a.begin(), values[i]);
+            }
+            do_not_optimize(s.a.size());
+        });
+
+        add("insert_middle", quadratic, 0, 0, [&](S &s) {
+            for (std::size_t i = 0; i < quadratic; ++i) {
+                s.a.insert(s.a.begin() + s.a.size() / 2, values[i]);
+            }
+            do_not_optimize(s.a.size());
+        });
+
+        add("erase_front", quadratic, quadratic, 0, [&](S &s) {
+            for (std::size_t i = 0; i < quadratic; ++i) {
+                s.a.erase(s.a.begin());
+            }
+            do_not_optimize(s.a.size());
+        });
+
+        add("iterate", n, n, 0, [&](S &s) {
+            std::uint64_t sum = 0;
+            for (const auto &value : s.a) {
+                sum += key_of(value);
+            }
+            do_not_optimize(sum);
+        });
+
+        add("copy", n, n, 0, [&](S &s) {
+            s.out.emplace(s.a);
+            do_not_optimize(s.out->size());
+        });
+
+        add("move", n, n, 0, [&](S &s) {
+            s.out.emplace(std::move(s.a));
+            do_not_optimize(s.out->size());
+        });
+
+        add("compare", n, n, n, [&](S &s) {
+            do_not_optimize(s.a == s.b);
+            do_not_optimize(s.a < s.b);
+        });
+
+        add("resize", n, 0, 0, [&](S &s) {
+            s.a.resize(n / 2);
+            s.a.resize(n, values[0]);
+            do_not_optimize(s.a.size());
+        });
+    }
+
+    struct Row {
+        int id;
+        char tag;
+    };
+
+    // field scan over an array of structs against the same data as columns
+    void run_layouts(pretty_bench::report &report, const pretty_bench::options &opts,
+                     const std::vector<std::uint64_t> &keys) {
+        if (!report.selected("scan_field")) {
+            return;
+        }
+        std::size_t n = keys.size();
+        struct layouts {
+            pretty_vector::vector<Row> rows;
+            pretty_vector::soa_vector<int, char> columns;
+        };
+        auto prepare = [&] {
+            layouts l;
+            for (std::size_t i = 0; i < n; ++i) {
+                l.rows.push_back(Row{static_cast<int>(keys[i]), 'r'});
+                l.columns.emplace_back(static_cast<int>(keys[i]), 'r');
+            }
+            return l;
+        };
+
+        pretty_bench::result r = pretty_bench::measure(opts, n, prepare, [&](layouts &l) {
+            const Row *rows = l.rows.data();
+            long sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                sum += rows[i].id;
+            }
+            do_not_optimize(sum);
+        });
+        r.name = "scan_field";
+        r.type = "int+char";
+        r.container = "aos";
+        report.add(r);
+
+        r = pretty_bench::measure(opts, n, prepare, [&](layouts &l) {
+            long sum = 0;
+            for (int id : l.columns.column<0>()) {
+                sum += id;
+            }
+            do_not_optimize(sum);
+        });
+        r.name = "scan_field";
+        r.type = "int+char";
+        r.container = "soa_vector";
+        report.add(r);
+    }
+
+    // filter bitmaps: one bool per byte against the packed bit_vector
+    void run_bitmaps(pretty_bench::report &report, const pretty_bench::options &opts,
+                     const std::vector<std::uint64_t> &keys) {
+        std::size_t n = keys.size() * 8;
+        struct bitmaps {
+            pretty_vector::vector<bool> bytes_a, bytes_b;
+            pretty_vector::bit_vector<> bits_a, bits_b;
+        };
+        auto prepare = [&] {
+            bitmaps m;
+            for (std::size_t i = 0; i < n; ++i) {
+                std::uint64_t key = keys[i % keys.size()] >> (i / keys.size());
+                m.bytes_a.push_back(key & 1);
+                m.bytes_b.push_back(key & 2);
+                m.bits_a.push_back(key & 1);
+                m.bits_b.push_back(key & 2);
+            }
+            return m;
+        };
+        auto add = [&](const char *name, const char *container, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, prepare, run);
+            r.name = name;
+            r.type = "bool";
+            r.container = container;
+            report.add(r);
+        };
+
+        add("bitmap_and", "vector<bool>", [&](bitmaps &m) {
+            bool *a = m.bytes_a.data();
+            const bool *b = m.bytes_b.data();
+            for (std::size_t i = 0; i < n; ++i) {
+                a[i] = a[i] && b[i];
+            }
+            do_not_optimize(a[n / 2]);
+        });
+        add("bitmap_and", "bit_vector", [&](bitmaps &m) {
+            m.bits_a &= m.bits_b;
+            do_not_optimize(m.bits_a.words()[0]);
+        });
+        add("bitmap_count", "vector<bool>", [&](bitmaps &m) {
+            do_not_optimize(std::count(m.bytes_a.data(), m.bytes_a.data() + n, true));
+        });
+        add("bitmap_count", "bit_vector", [&](bitmaps &m) {
+            do_not_optimize(m.bits_a.count());
+        });
+    }
+
+    // appends and scans on the chunked segmented_vector against vector
+    template<class T>
+    void run_segmented(pretty_bench::report &report, const pretty_bench::options &opts,
+                       const char *type, std::size_t n, const std::vector<std::uint64_t> &keys) {
+        typedef pretty_vector::vector<T, tracking_allocator<T>> flat;
+        typedef pretty_vector::segmented_vector<T, 1024, tracking_allocator<T>> segmented;
+        struct containers {
+            flat v;
+            segmented s;
+        };
+        auto add = [&](const char *name, const char *container, bool fill, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, [&] {
+                containers c;
+                for (std::size_t i = 0; fill && i < n; ++i) {
+                    c.v.emplace_back(keys[i]);
+                    c.s.emplace_back(keys[i]);
+                }
+                return c;
+            }, run);
+            r.name = name;
+            r.type = type;
+            r.container = container;
+            report.add(r);
+        };
+
+        add("append", "pretty_vector", false, [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.v.emplace_back(keys[i]);
+            }
+            do_not_optimize(c.v.size());
+        });
+        add("append", "segmented", false, [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.s.emplace_back(keys[i]);
+            }
+            do_not_optimize(c.s.size());
+        });
+        add("chunk_scan", "segmented", true, [&](containers &c) {
+            std::uint64_t sum = 0;
+            c.s.for_each_chunk([&sum](const T *data, unsigned int count) {
+                for (unsigned int i = 0; i < count; ++i) {
+                    sum += key_of(data[i]);
+                }
+            });
+            do_not_optimize(sum);
+        });
+    }
+
+    // front insertion and a fixed-size sliding window; pretty_vector has to shift
+    // every element for each front operation, so n is capped for it
+    template<class T>
+    void run_double_ended(pretty_bench::report &report, const pretty_bench::options &opts,
+                          const char *type, std::size_t n, const std::vector<std::uint64_t> &keys) {
+        const std::size_t window = 64;
+        struct containers {
+            pretty_vector::vector<T, tracking_allocator<T>> v;
+            std::deque<T, tracking_allocator<T>> d;
+            pretty_vector::devector<T, tracking_allocator<T>> dv;
+        };
+        auto add = [&](const char *name, const char *container, std::size_t ops, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, ops, [] { return containers(); }, run);
+            r.name = name;
+            r.type = type;
+            r.container = container;
+            report.add(r);
+        };
+
+        std::size_t shifted = std::min<std::size_t>(n, 20000);
+        add("push_front", "pretty_vector", shifted, [&](containers &c) {
+            for (std::size_t i = 0; i < shifted; ++i) {
+                c.v.emplace(c.v.begin(), keys[i]);
+            }
+            do_not_optimize(c.v.size());
+        });
+        add("push_front", "std::deque", n, [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.d.emplace_front(keys[i]);
+            }
+            do_not_optimize(c.d.size());
+        });
+        add("push_front", "devector", n, [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.dv.emplace_front(keys[i]);
+            }
+            do_not_optimize(c.dv.size());
+        });
+        add("sliding_window", "pretty_vector", n, [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.v.emplace_back(keys[i]);
+                if (c.v.size() > window) {
+                    c.v.erase(c.v.begin());
+                }
+            }
+            do_not_optimize(c.v.size());
+        });
+        add("sliding_window", "std::deque", n, [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.d.emplace_back(keys[i]);
+                if (c.d.size() > window) {
+                    c.d.pop_front();
+                }
+            }
+            do_not_optimize(c.d.size());
+        });
+        add("sliding_window", "devector", n, [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.dv.emplace_back(keys[i]);
+                if (c.dv.size() > window) {
+                    c.dv.pop_front();
+                }
+            }
+            do_not_optimize(c.dv.size());
+        });
+    }
+
+    // streaming stage: append a batch of records, drain the oldest batch
+    template<class T>
+    void run_fifo(pretty_bench::report &report, const pretty_bench::options &opts,
+                  const char *type, std::size_t n, const std::vector<std::uint64_t> &keys) {
+        const std::size_t batch = 64;
+        struct containers {
+            pretty_vector::vector<T, tracking_allocator<T>> v;
+            std::deque<T, tracking_allocator<T>> d;
+            pretty_vector::circular_vector<T, tracking_allocator<T>> ring;
+            std::vector<T> staged, drained;
+        };
+        auto add = [&](const char *name, const char *container, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, [&] {
+                containers c;
+                for (std::size_t i = 0; i < batch; ++i) {
+                    c.staged.emplace_back(keys[i]);
+                }
+                c.drained.resize(batch);
+                return c;
+            }, run);
+            r.name = name;
+            r.type = type;
+            r.container = container;
+            report.add(r);
+        };
+
+        add("fifo", "pretty_vector", [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.v.emplace_back(keys[i]);
+                if (c.v.size() > batch * 4) {
+                    c.v.erase(c.v.begin());
+                }
+            }
+            do_not_optimize(c.v.size());
+        });
+        add("fifo", "std::deque", [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.d.emplace_back(keys[i]);
+                if (c.d.size() > batch * 4) {
+                    c.d.pop_front();
+                }
+            }
+            do_not_optimize(c.d.size());
+        });
+        add("fifo", "circular", [&](containers &c) {
+            for (std::size_t i = 0; i < n; ++i) {
+                c.ring.emplace_back(keys[i]);
+                if (c.ring.size() > batch * 4) {
+                    c.ring.pop_front();
+                }
+            }
+            do_not_optimize(c.ring.size());
+        });
+        add("fifo_batch", "circular", [&](containers &c) {
+            for (std::size_t i = 0; i < n; i += batch) {
+                c.ring.push_back_n(c.staged.data(), batch);
+                if (c.ring.size() > batch * 4) {
+                    c.ring.pop_front_n(c.drained.data(), batch);
+                }
+            }
+            do_not_optimize(c.ring.size());
+        });
+    }
+
+    // read-mostly lookup table: bulk build, then hits and misses in random order
+    void run_lookup(pretty_bench::report &report, const pretty_bench::options &opts,
+                    const std::vector<std::uint64_t> &keys) {
+        typedef std::uint64_t key;
+        typedef std::pair<const key, key> node;
+        struct tables {
+            std::map<key, key, std::less<key>, tracking_allocator<node>> tree;
+            std::unordered_map<key, key, std::hash<key>, std::equal_to<key>, tracking_allocator<node>> hash;
+            pretty_vector::flat_map<key, key, std::less<key>, tracking_allocator<key>, tracking_allocator<key>> flat;
+        };
+        std::vector<std::pair<key, key>> items;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            items.push_back(std::make_pair(keys[i], i));
+        }
+        std::vector<key> probes(keys.begin(), keys.end());
+        std::shuffle(probes.begin(), probes.end(), std::mt19937_64(7));
+        for (std::size_t i = 0; i < probes.size(); i += 2) {
+            probes[i] += 1000000;
+        }
+        std::size_t n = probes.size();
+        auto add = [&](const char *name, const char *container, bool fill, bool index, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, [&] {
+                tables t;
+                if (fill) {
+                    t.tree.insert(items.begin(), items.end());
+                    t.hash.insert(items.begin(), items.end());
+                    t.flat.insert(items.begin(), items.end());
+                    if (index) {
+                        t.flat.build_index();
+                    }
+                }
+                return t;
+            }, run);
+            r.name = name;
+            r.type = "u64";
+            r.container = container;
+            report.add(r);
+        };
+
+        add("table_build", "std::map", false, false, [&](tables &t) {
+            t.tree.insert(items.begin(), items.end());
+            do_not_optimize(t.tree.size());
+        });
+        add("table_build", "std::unordered_map", false, false, [&](tables &t) {
+            t.hash.insert(items.begin(), items.end());
+            do_not_optimize(t.hash.size());
+        });
+        add("table_build", "flat_map", false, false, [&](tables &t) {
+            t.flat.insert(items.begin(), items.end());
+            do_not_optimize(t.flat.size());
+        });
+        add("table_lookup", "std::map", true, false, [&](tables &t) {
+            std::size_t found = 0;
+            for (key probe : probes) {
+                found += t.tree.find(probe) != t.tree.end();
+            }
+            do_not_optimize(found);
+        });
+        add("table_lookup", "std::unordered_map", true, false, [&](tables &t) {
+            std::size_t found = 0;
+            for (key probe : probes) {
+                found += t.hash.find(probe) != t.hash.end();
+            }
+            do_not_optimize(found);
+        });
+        add("table_lookup", "flat_map", true, false, [&](tables &t) {
+            std::size_t found = 0;
+            for (key probe : probes) {
+                found += t.flat.contains(probe);
+            }
+            do_not_optimize(found);
+        });
+        add("table_lookup", "flat_map+eytzinger", true, true, [&](tables &t) {
+            std::size_t found = 0;
+            for (key probe : probes) {
+                found += t.flat.contains(probe);
+            }
+            do_not_optimize(found);
+        });
+    }
+
+    // reader snapshots of a 1024-entry table, one read per snapshot
+    template<class T>
+    void run_snapshots(pretty_bench::report &report, const pretty_bench::options &opts,
+                       const char *type, std::size_t n, const std::vector<std::uint64_t> &keys) {
+        const std::size_t table_size = std::min<std::size_t>(1024, keys.size());
+        struct tables {
+            pretty_vector::vector<T, tracking_allocator<T>> v;
+            pretty_vector::cow_vector<T, tracking_allocator<T>> cow;
+        };
+        auto add = [&](const char *name, const char *container, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, [&] {
+                tables t;
+                for (std::size_t i = 0; i < table_size; ++i) {
+                    t.v.emplace_back(keys[i]);
+                    t.cow.emplace_back(keys[i]);
+                }
+                return t;
+            }, run);
+            r.name = name;
+            r.type = type;
+            r.container = container;
+            report.add(r);
+        };
+
+        add("snapshot", "pretty_vector", [&](tables &t) {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                pretty_vector::vector<T, tracking_allocator<T>> snapshot(t.v);
+                sum += key_of(snapshot[i % table_size]);
+            }
+            do_not_optimize(sum);
+        });
+        add("snapshot", "cow_vector", [&](tables &t) {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                pretty_vector::cow_vector<T, tracking_allocator<T>> snapshot(t.cow);
+                sum += key_of(snapshot[i % table_size]);
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    // versioned state: build, then keep a new version per single-element update
+    template<class T>
+    void run_versions(pretty_bench::report &report, const pretty_bench::options &opts,
+                      const char *type, std::size_t n, const std::vector<std::uint64_t> &keys) {
+        typedef pretty_vector::vector<T, tracking_allocator<T>> flat;
+        typedef pretty_vector::immutable_vector<T, tracking_allocator<T>> persistent;
+        const std::size_t versions = 256;
+        struct states {
+            flat base;
+            persistent tree;
+            std::vector<flat> flat_versions;
+            std::vector<persistent> tree_versions;
+        };
+        auto add = [&](const char *name, const char *container, std::size_t ops, bool fill, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, ops, [&] {
+                states s;
+                if (fill) {
+                    typename persistent::transient builder = s.tree.make_transient();
+                    for (std::size_t i = 0; i < n; ++i) {
+                        s.base.emplace_back(keys[i]);
+                        builder.push_back(T(keys[i]));
+                    }
+                    s.tree = builder.persistent();
+                }
+                s.flat_versions.reserve(versions);
+                s.tree_versions.reserve(versions);
+                return s;
+            }, run);
+            r.name = name;
+            r.type = type;
+            r.container = container;
+            report.add(r);
+        };
+
+        add("versioned_build", "pretty_vector", n, false, [&](states &s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                s.base.emplace_back(keys[i]);
+            }
+            do_not_optimize(s.base.size());
+        });
+        add("versioned_build", "immutable", n, false, [&](states &s) {
+            for (std::size_t i = 0; i < n; ++i) {
+                s.tree = s.tree.push_back(T(keys[i]));
+            }
+            do_not_optimize(s.tree.size());
+        });
+        add("versioned_build", "immutable+transient", n, false, [&](states &s) {
+            typename persistent::transient builder = s.tree.make_transient();
+            for (std::size_t i = 0; i < n; ++i) {
+                builder.push_back(T(keys[i]));
+            }
+            s.tree = builder.persistent();
+            do_not_optimize(s.tree.size());
+        });
+        add("versioned_update", "pretty_vector", versions, true, [&](states &s) {
+            for (std::size_t i = 0; i < versions; ++i) {
+                const flat &previous = i ? s.flat_versions.back() : s.base;
+                s.flat_versions.push_back(previous);
+                s.flat_versions.back()[keys[i] % n] = T(i);
+            }
+            do_not_optimize(s.flat_versions.size());
+        });
+        add("versioned_update", "immutable", versions, true, [&](states &s) {
+            for (std::size_t i = 0; i < versions; ++i) {
+                const persistent &previous = i ? s.tree_versions.back() : s.tree;
+                s.tree_versions.push_back(previous.set(keys[i] % n, T(i)));
+            }
+            do_not_optimize(s.tree_versions.size());
+        });
+        add("versioned_scan", "pretty_vector", n, true, [&](states &s) {
+            std::uint64_t sum = 0;
+            for (const T &value : s.base) {
+                sum += key_of(value);
+            }
+            do_not_optimize(sum);
+        });
+        add("versioned_scan", "immutable", n, true, [&](states &s) {
+            std::uint64_t sum = 0;
+            for (const T &value : s.tree) {
+                sum += key_of(value);
+            }
+            do_not_optimize(sum);
+        });
+        add("versioned_scan", "immutable+chunks", n, true, [&](states &s) {
+            std::uint64_t sum = 0;
+            s.tree.for_each_chunk([&sum](const T *data, unsigned int count) {
+                for (unsigned int i = 0; i < count; ++i) {
+                    sum += key_of(data[i]);
+                }
+            });
+            do_not_optimize(sum);
+        });
+    }
+
+    // Hot read path over a shared table while a writer republishes it every
+    // 100us. Each reader thread does n lookups; ns/op is wall time over n, so it
+    // stays flat as long as readers scale.
+    void run_readers(pretty_bench::report &report, const pretty_bench::options &opts,
+                     const std::vector<std::uint64_t> &keys) {
+        const unsigned int table_size = 4096;
+        std::size_t n = keys.size();
+        unsigned int max_threads = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+        struct tables {
+            pretty_vector::rcu_vector<std::uint64_t> rcu{pretty_vector::vector<std::uint64_t>(table_size, 1)};
+            pretty_vector::vector<std::uint64_t> locked = pretty_vector::vector<std::uint64_t>(table_size, 1);
+            std::shared_mutex lock;
+        };
+
+        // runs `read(thread)` on each reader thread next to one writer thread
+        auto concurrently = [](unsigned int threads, auto read, auto write) {
+            std::atomic<bool> done(false);
+            std::thread writer([&] {
+                while (!done.load(std::memory_order_relaxed)) {
+                    write();
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            });
+            std::vector<std::thread> readers;
+            for (unsigned int t = 0; t < threads; ++t) {
+                readers.emplace_back(read, t);
+            }
+            for (std::thread &reader : readers) {
+                reader.join();
+            }
+            done = true;
+            writer.join();
+        };
+
+        for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+            if (!report.selected("concurrent_read")) {
+                return;
+            }
+            auto add = [&](const char *container, auto run) {
+                pretty_bench::result r = pretty_bench::measure(opts, n, [] { return std::make_unique<tables>(); },
+                                                               [&](std::unique_ptr<tables> &t) { run(*t); });
+                r.name = "concurrent_read";
+                r.type = "u64";
+                r.container = std::string(container) + " x" + std::to_string(threads);
+                report.add(r);
+            };
+
+            add("rwlock", [&](tables &t) {
+                concurrently(threads, [&](unsigned int thread) {
+                    std::uint64_t sum = 0;
+                    for (std::size_t i = 0; i < n; ++i) {
+                        std::shared_lock<std::shared_mutex> guard(t.lock);
+                        sum += t.locked[(keys[i] + thread) % table_size];
+                    }
+                    do_not_optimize(sum);
+                }, [&] {
+                    pretty_vector::vector<std::uint64_t> next(table_size, 2);
+                    std::unique_lock<std::shared_mutex> guard(t.lock);
+                    t.locked.swap(next);
+                });
+            });
+            add("rcu", [&](tables &t) {
+                concurrently(threads, [&](unsigned int thread) {
+                    pretty_vector::rcu_vector<std::uint64_t>::reader reader = t.rcu.make_reader();
+                    std::uint64_t sum = 0;
+                    for (std::size_t i = 0; i < n; ++i) {
+                        sum += reader.read()[(keys[i] + thread) % table_size];
+                    }
+                    do_not_optimize(sum);
+                }, [&] {
+                    t.rcu.publish(pretty_vector::vector<std::uint64_t>(table_size, 2));
+                });
+            });
+        }
+    }
+
+    // Linear searches over distinct odd values: std algorithms through
+    // MyIterator against the member functions at the scalar and the detected
+    // kernel level. ns/op is per search; hit@P% puts the match P% of the way in.
+    template<class T>
+    void run_search(pretty_bench::report &report, const pretty_bench::options &opts, const char *type) {
+        typedef pretty_vector::vector<T> container;
+        const pretty_vector::simd::level levels[] = {pretty_vector::simd::level::scalar,
+                                                     pretty_vector::simd::detected()};
+        for (std::size_t size : {std::size_t(64), std::size_t(4096), std::max<std::size_t>(opts.size, 8192)}) {
+            std::size_t searches = std::max<std::size_t>(1, (std::size_t(1) << 22) / size);
+            struct inputs {
+                container v, w;
+            };
+            auto prepare = [&] {
+                inputs in;
+                for (std::size_t i = 0; i < size; ++i) {
+                    in.v.push_back(static_cast<T>(2 * i + 1));
+                }
+                in.w = in.v;
+                in.w[static_cast<unsigned int>(size / 2)] = T(0);
+                return in;
+            };
+            auto add = [&](const std::string &name, const std::string &impl, auto run) {
+                if (!report.selected(name)) {
+                    return;
+                }
+                pretty_bench::result r = pretty_bench::measure(opts, searches, prepare, [&](inputs &in) {
+                    for (std::size_t s = 0; s < searches; ++s) {
+                        do_not_optimize(run(in));
+                    }
+                });
+                r.n = size;
+                r.name = name;
+                r.type = type;
+                r.container = impl;
+                report.add(r);
+            };
+
+            for (int percent : {10, 50, -1}) {
+                std::string name = percent < 0 ? std::string("find@miss") : "find@" + std::to_string(percent) + "%";
+                T target = percent < 0 ? T(0) : static_cast<T>(2 * (size * percent / 100) + 1);
+                add(name, "std::find", [&](inputs &in) { return std::find(in.v.begin(), in.v.end(), target) - in.v.begin(); });
+                for (pretty_vector::simd::level level : levels) {
+                    pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+                    add(name, std::string("member ") + pretty_vector::simd::name(level), [&](inputs &in) {
+                        return in.v.find(target) - in.v.begin();
+                    });
+                    pretty_vector::simd::set_level(previous);
+                }
+            }
+            T low = static_cast<T>(size), high = static_cast<T>(size + 1);
+            add("find_if@50%", "std::find_if", [&](inputs &in) {
+                return std::find_if(in.v.begin(), in.v.end(), [&](T x) { return low <= x && x <= high; }) - in.v.begin();
+            });
+            add("count", "std::count", [&](inputs &in) { return std::count(in.v.begin(), in.v.end(), T(1)); });
+            add("mismatch@50%", "std::mismatch", [&](inputs &in) {
+                return std::mismatch(in.v.begin(), in.v.end(), in.w.begin()).first - in.v.begin();
+            });
+            for (pretty_vector::simd::level level : levels) {
+                pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+                std::string impl = std::string("member ") + pretty_vector::simd::name(level);
+                add("find_if@50%", impl, [&](inputs &in) {
+                    return in.v.find_if(pretty_vector::in_range(low, high)) - in.v.begin();
+                });
+                add("count", impl, [&](inputs &in) { return in.v.count(T(1)); });
+                add("mismatch@50%", impl, [&](inputs &in) { return in.v.mismatch(in.w).first - in.v.begin(); });
+                pretty_vector::simd::set_level(previous);
+            }
+        }
+    }
+
+    // a = b * c + d and dot(b, c) over n floats: hand-written loops with a
+    // temporary per operator, one fused scalar loop, and numeric_vector at
+    // each dispatch level the CPU supports
+    void run_numeric(pretty_bench::report &report, const pretty_bench::options &opts,
+                     const std::vector<std::uint64_t> &keys) {
+        typedef pretty_vector::vector<float> floats;
+        typedef pretty_vector::numeric_vector<float> numeric;
+        std::size_t n = keys.size();
+        struct inputs {
+            numeric a, b, c, d;
+        };
+        auto prepare = [&] {
+            inputs in{numeric(n), numeric(n), numeric(n), numeric(n)};
+            for (std::size_t i = 0; i < n; ++i) {
+                in.b[i] = static_cast<float>(keys[i] % 1000) / 1000.0f;
+                in.c[i] = static_cast<float>(keys[(i + 1) % n] % 1000) / 1000.0f;
+                in.d[i] = 1.0f;
+            }
+            return in;
+        };
+        auto add = [&](const char *name, const std::string &container, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, prepare, run);
+            r.name = name;
+            r.type = "float";
+            r.container = container;
+            report.add(r);
+        };
+
+        add("axpy", "naive temporaries", [&](inputs &in) {
+            floats product(static_cast<unsigned int>(n), 0.0f), result(static_cast<unsigned int>(n), 0.0f);
+            for (std::size_t i = 0; i < n; ++i) {
+                product[i] = in.b[i] * in.c[i];
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                result[i] = product[i] + in.d[i];
+            }
+            do_not_optimize(result[n / 2]);
+        });
+        add("axpy", "fused loop", [&](inputs &in) {
+            for (std::size_t i = 0; i < n; ++i) {
+                in.a[i] = in.b[i] * in.c[i] + in.d[i];
+            }
+            do_not_optimize(in.a[n / 2]);
+        });
+        add("dot", "fused loop", [&](inputs &in) {
+            float total = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                total += in.b[i] * in.c[i];
+            }
+            do_not_optimize(total);
+        });
+        pretty_vector::simd::level levels[] = {pretty_vector::simd::level::scalar,
+                                                pretty_vector::simd::level::sse2,
+                                                pretty_vector::simd::level::avx2,
+                                                pretty_vector::simd::level::avx512};
+        for (pretty_vector::simd::level level : levels) {
+            if (level > pretty_vector::simd::detected()) {
+                break;
+            }
+            pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+            std::string container = std::string("numeric ") + pretty_vector::simd::name(level);
+            add("axpy", container, [&](inputs &in) {
+                in.a = in.b * in.c + in.d;
+                do_not_optimize(in.a[n / 2]);
+            });
+            add("dot", container, [&](inputs &in) {
+                do_not_optimize(pretty_vector::dot(in.b, in.c));
+            });
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    // Drops about half of n random ints, by a range and by an opaque lambda:
+    // erase/remove_if on std::vector against erase_if at the scalar and the
+    // SIMD levels. ns/op is per input element.
+    void run_filter(pretty_bench::report &report, const pretty_bench::options &opts,
+                    const std::vector<std::uint64_t> &keys) {
+        std::size_t n = keys.size();
+        auto value = [&](std::size_t i) { return static_cast<int>(keys[i] % 100); };
+        auto drop = [](int x) { return 25 <= x && x <= 74; };
+        auto add = [&](const char *name, const std::string &container, auto prepare, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, prepare, run);
+            r.name = name;
+            r.type = "int";
+            r.container = container;
+            report.add(r);
+        };
+        auto prepare_std = [&] {
+            std::vector<int> v(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                v[i] = value(i);
+            }
+            return v;
+        };
+        auto prepare_pretty = [&] {
+            pretty_vector::vector<int> v;
+            v.reserve(static_cast<unsigned int>(n));
+            for (std::size_t i = 0; i < n; ++i) {
+                v.push_back(value(i));
+            }
+            return v;
+        };
+
+        for (const char *name : {"erase_if(range)", "erase_if(lambda)"}) {
+            add(name, "std::remove_if", prepare_std, [&](std::vector<int> &v) {
+                v.erase(std::remove_if(v.begin(), v.end(), drop), v.end());
+                do_not_optimize(v.size());
+            });
+        }
+        pretty_vector::simd::level levels[] = {pretty_vector::simd::level::scalar,
+                                                pretty_vector::simd::level::sse2,
+                                                pretty_vector::simd::level::avx2,
+                                                pretty_vector::simd::level::avx512};
+        for (pretty_vector::simd::level level : levels) {
+            if (level > pretty_vector::simd::detected()) {
+                break;
+            }
+            pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+            std::string container = std::string("member ") + pretty_vector::simd::name(level);
+            add("erase_if(range)", container, prepare_pretty, [&](pretty_vector::vector<int> &v) {
+                do_not_optimize(v.erase_if(pretty_vector::in_range(25, 74)));
+            });
+            add("erase_if(lambda)", container, prepare_pretty, [&](pretty_vector::vector<int> &v) {
+                do_not_optimize(v.erase_if(drop));
+            });
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    // Sorts n random keys: std::sort on std::vector against the radix sort
+    // on one thread and on every core, key-value pairs against sort_by_key,
+    // and a comparator sort against merge_sort. ns/op is per element.
+    template<class K>
+    void run_sort(pretty_bench::report &report, const pretty_bench::options &opts,
+                  const std::vector<std::uint64_t> &keys, const char *type) {
+        std::size_t n = keys.size();
+        auto key = [&](std::size_t i) {
+            if constexpr (std::is_floating_point<K>::value) {
+                return static_cast<K>(static_cast<std::int64_t>(keys[i] % 2000001) - 1000000) / K(3);
+            } else {
+                return static_cast<K>(keys[i]);
+            }
+        };
+        pretty_vector::sort_options serial, parallel;
+        serial.threads = 1;
+        parallel.threads = std::max(1u, std::thread::hardware_concurrency());
+        std::string cores = std::to_string(parallel.threads) + "t";
+        // the parallel cases only run with more than one core
+        std::vector<const pretty_vector::sort_options *> thread_counts = {&serial};
+        if (parallel.threads > 1) {
+            thread_counts.push_back(&parallel);
+        }
+        auto add = [&](const char *name, const std::string &container, auto prepare, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, prepare, run);
+            r.name = name;
+            r.type = type;
+            r.container = container;
+            report.add(r);
+        };
+        auto prepare_std = [&] {
+            std::vector<K> v(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                v[i] = key(i);
+            }
+            return v;
+        };
+        auto prepare_pretty = [&] {
+            pretty_vector::vector<K> v;
+            v.reserve(static_cast<unsigned int>(n));
+            for (std::size_t i = 0; i < n; ++i) {
+                v.push_back(key(i));
+            }
+            return v;
+        };
+
+        add("sort", "std::sort", prepare_std, [&](std::vector<K> &v) {
+            std::sort(v.begin(), v.end());
+            do_not_optimize(v[n / 2]);
+        });
+        add("sort", "radix 1t", prepare_pretty, [&](pretty_vector::vector<K> &v) {
+            pretty_vector::sort(v, serial);
+            do_not_optimize(v[static_cast<unsigned int>(n / 2)]);
+        });
+        if (parallel.threads > 1) {
+            add("sort", "radix " + cores, prepare_pretty, [&](pretty_vector::vector<K> &v) {
+                pretty_vector::sort(v, parallel);
+                do_not_optimize(v[static_cast<unsigned int>(n / 2)]);
+            });
+        }
+
+        struct pairs {
+            pretty_vector::vector<K> keys;
+            pretty_vector::vector<std::uint32_t> values;
+        };
+        add("sort_by_key", "std::sort pairs", [&] {
+            std::vector<std::pair<K, std::uint32_t>> v(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                v[i] = std::make_pair(key(i), static_cast<std::uint32_t>(i));
+            }
+            return v;
+        }, [&](std::vector<std::pair<K, std::uint32_t>> &v) {
+            std::sort(v.begin(), v.end(), [](const std::pair<K, std::uint32_t> &a,
+                                             const std::pair<K, std::uint32_t> &b) { return a.first < b.first; });
+            do_not_optimize(v[n / 2]);
+        });
+        for (const pretty_vector::sort_options *options : thread_counts) {
+            add("sort_by_key", options == &serial ? "radix 1t" : "radix " + cores, [&] {
+                pairs p{prepare_pretty(), pretty_vector::vector<std::uint32_t>()};
+                for (std::size_t i = 0; i < n; ++i) {
+                    p.values.push_back(static_cast<std::uint32_t>(i));
+                }
+                return p;
+            }, [&](pairs &p) {
+                pretty_vector::sort_by_key(p.keys, p.values, *options);
+                do_not_optimize(p.values[static_cast<unsigned int>(n / 2)]);
+            });
+        }
+
+        auto descending = [](const K &a, const K &b) { return b < a; };
+        add("sort(comp)", "std::sort", prepare_std, [&](std::vector<K> &v) {
+            std::sort(v.begin(), v.end(), descending);
+            do_not_optimize(v[n / 2]);
+        });
+        add("sort(comp)", "std::stable_sort", prepare_std, [&](std::vector<K> &v) {
+            std::stable_sort(v.begin(), v.end(), descending);
+            do_not_optimize(v[n / 2]);
+        });
+        for (const pretty_vector::sort_options *options : thread_counts) {
+            add("sort(comp)", options == &serial ? "merge 1t" : "merge " + cores, prepare_pretty,
+                [&](pretty_vector::vector<K> &v) {
+                    pretty_vector::merge_sort(v, descending, *options);
+                    do_not_optimize(v[static_cast<unsigned int>(n / 2)]);
+                });
+        }
+    }
+
+    // Reorders n ints through indices that are sequential, shuffled within
+    // 4096-element windows, or shuffled across the whole input: a plain
+    // indexed loop on std::vector against gather at the scalar and SIMD
+    // levels, with the large-input prefetch forced on and with the blocked
+    // partitioning forced on; the same for scatter, plus apply_permutation.
+    // ns/op is per element.
+    void run_permute(pretty_bench::report &report, const pretty_bench::options &opts) {
+        std::size_t n = opts.size;
+        std::mt19937 rng(7);
+        std::vector<int> std_in(n);
+        pretty_vector::vector<int> in;
+        in.reserve(static_cast<unsigned int>(n));
+        for (std::size_t i = 0; i < n; ++i) {
+            std_in[i] = static_cast<int>(i);
+            in.push_back(static_cast<int>(i));
+        }
+        pretty_vector::permute_options prefetched, blocked;
+        prefetched.gather_prefetch_bytes = 0;
+        prefetched.scatter_prefetch_bytes = 0;
+        blocked.blocked_bytes = 0;
+
+        for (const char *pattern : {"seq", "local", "random"}) {
+            pretty_vector::vector<std::uint32_t> index;
+            index.reserve(static_cast<unsigned int>(n));
+            for (std::size_t i = 0; i < n; ++i) {
+                index.push_back(static_cast<std::uint32_t>(i));
+            }
+            if (pattern[0] == 'l') {
+                for (unsigned int i = 0; i < index.size(); i += 4096) {
+                    std::shuffle(index.begin() + i, index.begin() + std::min(index.size(), i + 4096), rng);
+                }
+            } else if (pattern[0] == 'r') {
+                std::shuffle(index.begin(), index.end(), rng);
+            }
+            std::vector<std::uint32_t> std_index(index.begin(), index.end());
+            auto add = [&](const std::string &name, const std::string &container, auto prepare, auto run) {
+                if (!report.selected(name)) {
+                    return;
+                }
+                pretty_bench::result r = pretty_bench::measure(opts, n, prepare, run);
+                r.name = name;
+                r.type = "int";
+                r.container = container;
+                report.add(r);
+            };
+            auto prepare_std = [&] { return std::vector<int>(n); };
+            auto prepare_pretty = [&] { return pretty_vector::vector<int>(static_cast<unsigned int>(n), 0); };
+            std::string gather_name = std::string("gather(") + pattern + ")";
+            std::string scatter_name = std::string("scatter(") + pattern + ")";
+
+            add(gather_name, "std loop", prepare_std, [&](std::vector<int> &out) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    out[i] = std_in[std_index[i]];
+                }
+                do_not_optimize(out[n / 2]);
+            });
+            pretty_vector::simd::level levels[] = {pretty_vector::simd::level::scalar,
+                                                    pretty_vector::simd::level::avx2,
+                                                    pretty_vector::simd::level::avx512};
+            for (pretty_vector::simd::level level : levels) {
+                if (level > pretty_vector::simd::detected()) {
+                    break;
+                }
+                pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+                add(gather_name, std::string("gather ") + pretty_vector::simd::name(level), prepare_pretty,
+                    [&](pretty_vector::vector<int> &out) {
+                        pretty_vector::gather(in, index, out);
+                        do_not_optimize(out[static_cast<unsigned int>(n / 2)]);
+                    });
+                pretty_vector::simd::set_level(previous);
+            }
+            add(gather_name, "gather prefetch", prepare_pretty, [&](pretty_vector::vector<int> &out) {
+                pretty_vector::gather(in, index, out, prefetched);
+                do_not_optimize(out[static_cast<unsigned int>(n / 2)]);
+            });
+            add(gather_name, "gather blocked", prepare_pretty, [&](pretty_vector::vector<int> &out) {
+                pretty_vector::gather(in, index, out, blocked);
+                do_not_optimize(out[static_cast<unsigned int>(n / 2)]);
+            });
+
+            add(scatter_name, "std loop", prepare_std, [&](std::vector<int> &out) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    out[std_index[i]] = std_in[i];
+                }
+                do_not_optimize(out[n / 2]);
+            });
+            add(scatter_name, "scatter", prepare_pretty, [&](pretty_vector::vector<int> &out) {
+                pretty_vector::scatter(in, index, out);
+                do_not_optimize(out[static_cast<unsigned int>(n / 2)]);
+            });
+            add(scatter_name, "scatter prefetch", prepare_pretty, [&](pretty_vector::vector<int> &out) {
+                pretty_vector::scatter(in, index, out, prefetched);
+                do_not_optimize(out[static_cast<unsigned int>(n / 2)]);
+            });
+            add(scatter_name, "scatter blocked", prepare_pretty, [&](pretty_vector::vector<int> &out) {
+                pretty_vector::scatter(in, index, out, blocked);
+                do_not_optimize(out[static_cast<unsigned int>(n / 2)]);
+            });
+
+            add(std::string("apply_permutation(") + pattern + ")", "apply_permutation", [&] { return in; },
+                [&](pretty_vector::vector<int> &v) {
+                    pretty_vector::apply_permutation(v, index);
+                    do_not_optimize(v[static_cast<unsigned int>(n / 2)]);
+                });
+        }
+    }
+
+    // Turns n random record lengths into offsets: std::exclusive_scan against
+    // exclusive_scan at the scalar and the detected level on one thread and,
+    // on multi-core machines, on 2, 4 ... threads up to the core count; then
+    // the same per segment with a head about every 16 elements. ns/op is per
+    // element.
+    void run_scan(pretty_bench::report &report, const pretty_bench::options &opts,
+                  const std::vector<std::uint64_t> &keys) {
+        std::size_t n = keys.size();
+        std::vector<std::uint32_t> std_lengths(n);
+        pretty_vector::vector<std::uint32_t> lengths;
+        pretty_vector::bit_vector<> heads(static_cast<unsigned int>(n));
+        lengths.reserve(static_cast<unsigned int>(n));
+        for (std::size_t i = 0; i < n; ++i) {
+            std_lengths[i] = static_cast<std::uint32_t>(keys[i] % 256);
+            lengths.push_back(std_lengths[i]);
+            if (keys[i] % 16 == 0) {
+                heads.set(static_cast<unsigned int>(i));
+            }
+        }
+        auto add = [&](const char *name, const std::string &container, auto prepare, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, prepare, run);
+            r.name = name;
+            r.type = "u32";
+            r.container = container;
+            report.add(r);
+        };
+        auto prepare_std = [&] { return std::vector<std::uint32_t>(n); };
+        auto prepare_pretty = [&] { return pretty_vector::vector<std::uint32_t>(static_cast<unsigned int>(n), 0); };
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+
+        add("exclusive_scan", "std::exclusive_scan", prepare_std, [&](std::vector<std::uint32_t> &out) {
+            std::exclusive_scan(std_lengths.begin(), std_lengths.end(), out.begin(), std::uint32_t(0));
+            do_not_optimize(out[n - 1]);
+        });
+        add("segmented_scan", "std loop", prepare_std, [&](std::vector<std::uint32_t> &out) {
+            std::uint32_t running = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (heads.test(static_cast<unsigned int>(i))) {
+                    running = 0;
+                }
+                out[i] = running;
+                running += std_lengths[i];
+            }
+            do_not_optimize(out[n - 1]);
+        });
+        for (pretty_vector::simd::level level : {pretty_vector::simd::level::scalar,
+                                                 pretty_vector::simd::detected()}) {
+            pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+            for (unsigned int threads = 1; threads <= cores; threads *= 2) {
+                if (level == pretty_vector::simd::level::scalar && threads > 1) {
+                    break;
+                }
+                pretty_vector::scan_options options;
+                options.threads = threads;
+                options.parallel_threshold = 0;
+                std::string container = std::string("scan ") + pretty_vector::simd::name(level) + " " +
+                                        std::to_string(threads) + "t";
+                add("exclusive_scan", container, prepare_pretty, [&](pretty_vector::vector<std::uint32_t> &out) {
+                    pretty_vector::exclusive_scan(lengths, out, 0u, options);
+                    do_not_optimize(out[static_cast<unsigned int>(n - 1)]);
+                });
+                add("segmented_scan", container, prepare_pretty, [&](pretty_vector::vector<std::uint32_t> &out) {
+                    pretty_vector::segmented_exclusive_scan(lengths, heads, out, 0u, options);
+                    do_not_optimize(out[static_cast<unsigned int>(n - 1)]);
+                });
+            }
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    // Sorted 64-bit ids with gaps below 32, summed in order (id_scan) or read
+    // at random positions (id_lookup). The compressed containers are labelled
+    // with the bytes they take per id.
+    void run_compressed(pretty_bench::report &report, const pretty_bench::options &opts,
+                        const std::vector<std::uint64_t> &keys) {
+        std::size_t n = keys.size();
+        std::vector<std::uint64_t> ids(n);
+        std::uint64_t id = std::uint64_t(1) << 40;
+        for (std::size_t i = 0; i < n; ++i) {
+            id += keys[i] % 32;
+            ids[i] = id;
+        }
+        pretty_vector::compressed_int_vector<> compressed(ids.begin(), ids.end());
+        compressed.shrink_to_fit();
+        char label[64];
+        std::snprintf(label, sizeof(label), "compressed %.2f B/id", double(compressed.memory_bytes()) / n);
+
+        auto add = [&](const char *name, const std::string &container, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, [] { return 0; }, [&](int &) { run(); });
+            r.name = name;
+            r.type = "u64";
+            r.container = container;
+            report.add(r);
+        };
+
+        add("id_scan", "std::vector", [&] {
+            std::uint64_t sum = 0;
+            for (std::uint64_t value : ids) {
+                sum += value;
+            }
+            do_not_optimize(sum);
+        });
+        add("id_lookup", "std::vector", [&] {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                sum += ids[keys[i] % n];
+            }
+            do_not_optimize(sum);
+        });
+        for (pretty_vector::simd::level level : {pretty_vector::simd::level::scalar,
+                                                 pretty_vector::simd::detected()}) {
+            pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+            std::string container = std::string(label) + " " + pretty_vector::simd::name(level);
+            add("id_scan", container + " for_each_block", [&] {
+                std::uint64_t sum = 0;
+                compressed.for_each_block([&](const std::uint64_t *values, unsigned int count) {
+                    std::uint64_t block = 0;
+                    for (unsigned int i = 0; i < count; ++i) {
+                        block += values[i];
+                    }
+                    sum += block;
+                });
+                do_not_optimize(sum);
+            });
+            add("id_scan", container + " iterator", [&] {
+                std::uint64_t sum = 0;
+                for (std::uint64_t value : compressed) {
+                    sum += value;
+                }
+                do_not_optimize(sum);
+            });
+            pretty_vector::simd::set_level(previous);
+        }
+        add("id_lookup", label, [&] {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                sum += compressed[static_cast<unsigned int>(keys[i] % n)];
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    // Writes `--size` u64 values to a file in the temp directory and reads
+    // them back in chunks of 4096: plain ofstream/ifstream against a vector
+    // file, for random keys below 10^6 and for sorted ids. The vector files
+    // are labelled with their size relative to the raw bytes; the OS cache
+    // keeps both cases off the disk.
+    void run_vector_file(pretty_bench::report &report, const pretty_bench::options &opts,
+                         const std::vector<std::uint64_t> &keys) {
+        if (!report.selected("file_write") && !report.selected("file_read")) {
+            return;
+        }
+        std::size_t n = keys.size();
+        std::string path = (std::filesystem::temp_directory_path() / "pretty_vector_bench.pvf").string();
+        auto add = [&](const char *name, const std::string &type, const std::string &container, auto run) {
+            if (!report.selected(name)) {
+                return;
+            }
+            pretty_bench::result r = pretty_bench::measure(opts, n, [] { return 0; }, [&](int &) { run(); });
+            r.name = name;
+            r.type = type;
+            r.container = container;
+            report.add(r);
+        };
+
+        pretty_vector::vector<std::uint64_t> ids;
+        ids.reserve(static_cast<unsigned int>(n));
+        std::uint64_t id = 0;
+        for (std::uint64_t key : keys) {
+            id += key % 32;
+            ids.push_back(id);
+        }
+        pretty_vector::vector<std::uint64_t> random(keys.begin(), keys.end());
+        std::vector<std::uint64_t> chunk(4096);
+        for (const auto &input : {std::make_pair("keys", &random), std::make_pair("ids", &ids)}) {
+            const pretty_vector::vector<std::uint64_t> &values = *input.second;
+            std::string type = std::string("u64 ") + input.first;
+            auto write_raw = [&] {
+                std::ofstream file(path, std::ios::binary | std::ios::trunc);
+                file.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(std::uint64_t));
+            };
+            add("file_write", type, "ofstream", write_raw);
+            write_raw();
+            add("file_read", type, "ifstream", [&] {
+                std::ifstream file(path, std::ios::binary);
+                std::uint64_t sum = 0;
+                while (file.read(reinterpret_cast<char *>(chunk.data()), chunk.size() * sizeof(std::uint64_t)) ||
+                       file.gcount() > 0) {
+                    sum += chunk[0];
+                }
+                do_not_optimize(sum);
+            });
+            // the container column carries the compressed size over the raw one
+            pretty_vector::save_vector(path, values);
+            char label[32];
+            std::snprintf(label, sizeof(label), "vfile %.2fx", double(std::filesystem::file_size(path)) /
+                                                               double(n * sizeof(std::uint64_t)));
+            add("file_write", type, label, [&] {
+                pretty_vector::save_vector(path, values);
+            });
+            add("file_read", type, label, [&] {
+                pretty_vector::vector_file_reader<std::uint64_t> reader(path);
+                std::uint64_t sum = 0;
+                while (std::size_t count = reader.read(chunk.data(), chunk.size())) {
+                    sum += chunk[count - 1];
+                }
+                do_not_optimize(sum);
+            });
+        }
+        std::filesystem::remove(path);
+    }
+
+    // Each op is one "request" that builds three scratch vectors of up to 256
+    // elements and throws them away, either fresh each time or recycled
+    // through a vector_pool.
+    void run_pooling(pretty_bench::report &report, const pretty_bench::options &opts,
+                     const std::vector<std::uint64_t> &keys) {
+        if (!report.selected("request_scratch")) {
+            return;
+        }
+        typedef pretty_vector::vector<std::uint64_t, tracking_allocator<std::uint64_t>> scratch;
+        typedef pretty_vector::vector_pool<std::uint64_t, tracking_allocator<std::uint64_t>> pool_type;
+        std::size_t requests = std::max<std::size_t>(keys.size() / 64, 1);
+
+        // fills three vectors for request i from `make` and returns a checksum
+        auto serve = [&](std::size_t i, auto &&make, auto &&done) {
+            std::uint64_t sum = 0;
+            for (std::size_t part = 0; part < 3; ++part) {
+                std::size_t count = keys[(i * 3 + part) % keys.size()] % 256 + 1;
+                scratch items = make();
+                for (std::size_t j = 0; j < count; ++j) {
+                    items.push_back(keys[(i + j) % keys.size()]);
+                }
+                sum += items[count - 1];
+                done(std::move(items));
+            }
+            return sum;
+        };
+        auto add = [&](const char *container, auto run) {
+            pretty_bench::result r = pretty_bench::measure(opts, requests, [] {
+                return std::make_unique<pool_type>();
+            }, run);
+            r.name = "request_scratch";
+            r.type = "u64";
+            r.container = container;
+            report.add(r);
+        };
+
+        add("fresh", [&](std::unique_ptr<pool_type> &) {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < requests; ++i) {
+                sum += serve(i, [] { return scratch(); }, [](scratch &&) {});
+            }
+            do_not_optimize(sum);
+        });
+        add("vector_pool", [&](std::unique_ptr<pool_type> &pool) {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < requests; ++i) {
+                sum += serve(i, [&] { return pool->acquire(); }, [&](scratch &&items) {
+                    pool->release(std::move(items));
+                });
+            }
+            do_not_optimize(sum);
+        });
+    }
+
+    // One producer thread hands n small vectors to one consumer thread through
+    // a queue of 1024 slots, one at a time or in batches of 32. The mutex
+    // baseline is a std::deque guarded by std::mutex.
+    void run_handoff(pretty_bench::report &report, const pretty_bench::options &opts, std::size_t n) {
+        if (!report.selected("handoff")) {
+            return;
+        }
+        using buffer = pretty_vector::vector<int>;
+        const unsigned int capacity = 1024, batch = 32;
+
+        auto add = [&](const char *container, auto run) {
+            pretty_bench::result r = pretty_bench::measure(opts, n, [] { return 0; }, [&](int &) { run(); });
+            r.name = "handoff";
+            r.type = "vector<int>";
+            r.container = container;
+            report.add(r);
+        };
+        // runs produce() and consume() on two threads
+        auto pipeline = [](auto produce, auto consume) {
+            std::thread producer(produce);
+            consume();
+            producer.join();
+        };
+
+        add("mutex+deque", [&] {
+            std::mutex lock;
+            std::deque<buffer> q;
+            pipeline([&] {
+                for (std::size_t i = 0; i < n; std::this_thread::yield()) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    for (; i < n && q.size() < capacity; ++i) {
+                        q.push_back(buffer(4, static_cast<int>(i)));
+                    }
+                }
+            }, [&] {
+                std::size_t sum = 0;
+                for (std::size_t received = 0; received < n; std::this_thread::yield()) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    for (; !q.empty(); ++received) {
+                        sum += q.front()[0];
+                        q.pop_front();
+                    }
+                }
+                do_not_optimize(sum);
+            });
+        });
+        add("spsc", [&] {
+            pretty_vector::spsc_queue<buffer> q(capacity);
+            pipeline([&] {
+                for (std::size_t i = 0; i < n;) {
+                    if (q.try_push(buffer(4, static_cast<int>(i)))) {
+                        ++i;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            }, [&] {
+                std::size_t sum = 0;
+                buffer out;
+                for (std::size_t received = 0; received < n;) {
+                    if (q.try_pop(out)) {
+                        sum += out[0];
+                        ++received;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+                do_not_optimize(sum);
+            });
+        });
+        // the batched variants fill batch buffers, then push what fits
+        auto batched = [&](auto &q) {
+            pipeline([&] {
+                std::vector<buffer> pending(batch);
+                for (std::size_t i = 0; i < n;) {
+                    unsigned int count = static_cast<unsigned int>(std::min<std::size_t>(batch, n - i));
+                    for (unsigned int j = 0; j < count; ++j) {
+                        pending[j] = buffer(4, static_cast<int>(i + j));
+                    }
+                    for (unsigned int sent = 0; sent < count;) {
+                        unsigned int pushed = q.push_n(pending.data() + sent, count - sent);
+                        sent += pushed;
+                        if (pushed == 0) {
+                            std::this_thread::yield();
+                        }
+                    }
+                    i += count;
+                }
+            }, [&] {
+                std::size_t sum = 0;
+                std::vector<buffer> out(batch);
+                for (std::size_t received = 0; received < n;) {
+                    unsigned int popped = q.pop_n(out.data(), batch);
+                    for (unsigned int j = 0; j < popped; ++j) {
+                        sum += out[j][0];
+                    }
+                    received += popped;
+                    if (popped == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+                do_not_optimize(sum);
+            });
+        };
+        add("spsc batch", [&] {
+            pretty_vector::spsc_queue<buffer> q(capacity);
+            batched(q);
+        });
+        add("mpmc", [&] {
+            pretty_vector::mpmc_queue<buffer> q(capacity);
+            pipeline([&] {
+                for (std::size_t i = 0; i < n;) {
+                    if (q.try_push(buffer(4, static_cast<int>(i)))) {
+                        ++i;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            }, [&] {
+                std::size_t sum = 0;
+                buffer out;
+                for (std::size_t received = 0; received < n;) {
+                    if (q.try_pop(out)) {
+                        sum += out[0];
+                        ++received;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+                do_not_optimize(sum);
+            });
+        });
+        add("mpmc batch", [&] {
+            pretty_vector::mpmc_queue<buffer> q(capacity);
+            batched(q);
+        });
+    }
+
+    template<class T>
+    void run_type(pretty_bench::report &report, const pretty_bench::options &opts,
+                  const char *type, std::size_t n, const std::vector<std::uint64_t> &keys) {
+        run_container<std::vector<T, tracking_allocator<T>>>(report, opts, type, "std::vector", n, keys);
+        run_container<pretty_vector::vector<T, tracking_allocator<T>>>(report, opts, type, "pretty_vector", n, keys);
+    }
+}
+
+int main(int argc, char **argv) {
+    pretty_bench::options opts;
+    if (!opts.parse(argc, argv)) {
+        return 2;
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<std::uint64_t> keys(opts.size);
+    for (auto &key : keys) {
+        key = rng() % 1000000;
+    }
+
+    std::cerr << pretty_vector::simd::dispatch_report();
+    pretty_bench::report report(opts);
+    report.header();
+    run_type<int>(report, opts, "int", opts.size, keys);
+    run_type<Record>(report, opts, "record64", opts.size, keys);
+    run_type<Heavy<false>>(report, opts, "heavy", std::max<std::size_t>(opts.size / 10, 1), keys);
+    run_type<Heavy<true>>(report, opts, "heavy_nx", std::max<std::size_t>(opts.size / 10, 1), keys);
+    run_layouts(report, opts, keys);
+    run_bitmaps(report, opts, keys);
+    run_segmented<int>(report, opts, "int", opts.size, keys);
+    run_segmented<Heavy<false>>(report, opts, "heavy", std::max<std::size_t>(opts.size / 10, 1), keys);
+    run_double_ended<int>(report, opts, "int", opts.size, keys);
+    run_double_ended<Record>(report, opts, "record64", opts.size, keys);
+    run_fifo<int>(report, opts, "int", opts.size, keys);
+    run_fifo<Record>(report, opts, "record64", opts.size, keys);
+    run_lookup(report, opts, keys);
+    run_snapshots<int>(report, opts, "int", std::max<std::size_t>(opts.size / 10, 1), keys);
+    run_snapshots<Record>(report, opts, "record64", std::max<std::size_t>(opts.size / 10, 1), keys);
+    run_versions<int>(report, opts, "int", opts.size, keys);
+    run_versions<Record>(report, opts, "record64", opts.size, keys);
+    run_readers(report, opts, keys);
+    run_search<int>(report, opts, "int");
+    run_search<std::uint64_t>(report, opts, "u64");
+    run_numeric(report, opts, keys);
+    run_filter(report, opts, keys);
+    run_sort<std::uint32_t>(report, opts, keys, "u32");
+    run_sort<std::uint64_t>(report, opts, keys, "u64");
+    run_sort<float>(report, opts, keys, "float");
+    run_permute(report, opts);
+    run_scan(report, opts, keys);
+    run_compressed(report, opts, keys);
+    run_vector_file(report, opts, keys);
+    run_pooling(report, opts, keys);
+    run_handoff(report, opts, std::max<std::size_t>(opts.size / 10, 1));
+
+    return report.write_json() ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "allocator.h"
+
+namespace pretty_bench {
+
+    template<class T>
+    inline void do_not_optimize(const T &value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    struct options {
+        std::size_t size = 100000;
+        std::size_t repetitions = 5;
+        std::string filter;
+        std::string json_path;
+
+        bool parse(int argc, char **argv) {
+            for (int i = 1; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "--size" && i + 1 < argc) {
+                    size = std::strtoul(argv[++i], nullptr, 10);
+                } else if (arg == "--reps" && i + 1 < argc) {
+                    repetitions = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+                } else if (arg == "--filter" && i + 1 < argc) {
+                    filter = argv[++i];
+                } else if (arg == "--json" && i + 1 < argc) {
+                    json_path = argv[++i];
+                } else {
+                    std::cerr << "usage: " << argv[0]
+                              << " [--size N] [--reps R] [--filter SUBSTR] [--json PATH]\n";
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    struct result {
+        std::string name;
+        std::string type;
+        std::string container;
+        std::size_t n;
+        double ns_per_op;
+        std::size_t allocations;
+        std::size_t bytes_moved;
+    };
+
+    // Runs `run` on a fresh state from `prepare` once per repetition and keeps
+    // the median time. Allocator counters are sampled around `run` only, so
+    // setup and the destruction of the state are not charged to the case.
+    template<class Prepare, class Run>
+    result measure(const options &opts, std::size_t ops, Prepare prepare, Run run) {
+        typedef std::chrono::steady_clock clock;
+        pretty_allocator::allocation_stats &stats = pretty_allocator::tracked_stats();
+        std::vector<double> times;
+        result r = {};
+        r.n = ops;
+
+        for (std::size_t rep = 0; rep < opts.repetitions; ++rep) {
+            auto state = prepare();
+            pretty_allocator::allocation_stats before = stats;
+            auto start = clock::now();
+            run(state);
+            auto stop = clock::now();
+            times.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+            r.allocations = stats.allocations - before.allocations;
+            r.bytes_moved = stats.bytes_moved - before.bytes_moved;
+        }
+
+        std::sort(times.begin(), times.end());
+        r.ns_per_op = times[times.size() / 2] / std::max<std::size_t>(ops, 1);
+        return r;
+    }
+
+    class report {
+    public:
+        explicit report(const options &opts) : opts_(opts) {}
+
+        bool selected(const std::string &name) const {
+            return opts_.filter.empty() || name.find(opts_.filter) != std::string::npos;
+        }
+
+        void add(result r) {
+            std::printf("%-22s %-10s %-14s %9zu %12.2f %10zu %14zu\n",
+                        r.name.c_str(), r.type.c_str(), r.container.c_str(),
+                        r.n, r.ns_per_op, r.allocations, r.bytes_moved);
+            std::fflush(stdout);
+            results_.push_back(std::move(r));
+        }
+
+        void header() const {
+            std::printf("%-22s %-10s %-14s %9s %12s %10s %14s\n",
+                        "case", "type", "container", "n", "ns/op", "allocs", "bytes moved");
+        }
+
+        bool write_json() const {
+            if (opts_.json_path.empty()) {
+                return true;
+            }
+            std::ofstream out(opts_.json_path);
+            if (!out) {
+                std::cerr << "cannot open " << opts_.json_path << '\n';
+                return false;
+            }
+            out << "{\n  \"benchmark\": \"pretty_vector_bench\",\n"
+                << "  \"repetitions\": " << opts_.repetitions << ",\n"
+                << "  \"results\": [\n";
+            for (std::size_t i = 0; i < results_.size(); ++i) {
+                const result &r = results_[i];
+                out << "    {\"case\": \"" << r.name << "\", \"type\": \"" << r.type
+                    << "\", \"container\": \"" << r.container << "\", \"n\": " << r.n
+                    << ", \"ns_per_op\": " << r.ns_per_op
+                    << ", \"allocations\": " << r.allocations
+                    << ", \"bytes_moved\": " << r.bytes_moved << "}"
+                    << (i + 1 < results_.size() ? ",\n" : "\n");
+            }
+            out << "  ]\n}\n";
+            return bool(out);
+        }
+
+    private:
+        const options &opts_;
+        std::vector<result> results_;
+    };
+}
@@ -0,0 +1,484 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include "vector.h"
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PRETTY_VECTOR_TARGET_POPCNT __attribute__((target("popcnt")))
+#else
+#define PRETTY_VECTOR_TARGET_POPCNT
+#endif
+
+namespace pretty_vector {
+
+    namespace bit_detail {
+        // popcount loops built with and without the popcnt instruction; the
+        // first is only called when simd::features() reports popcnt
+        template<bool Popcnt>
+        struct popcount_loop {
+            static std::size_t run(const std::uint64_t *words, std::size_t n) {
+                std::size_t total = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    total += static_cast<std::size_t>(__builtin_popcountll(words[i]));
+                }
+                return total;
+            }
+        };
+
+        template<>
+        struct popcount_loop<true> {
+            static PRETTY_VECTOR_TARGET_POPCNT std::size_t run(const std::uint64_t *words, std::size_t n) {
+                std::size_t total = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    total += static_cast<std::size_t>(__builtin_popcountll(words[i]));
+                }
+                return total;
+            }
+        };
+
+        // set bits in words[0, n)
+        inline std::size_t popcount(const std::uint64_t *words, std::size_t n) {
+            static const bool popcnt = simd::features().popcnt;
+            return popcnt ? popcount_loop<true>::run(words, n) : popcount_loop<false>::run(words, n);
+        }
+    }
+
+    // Packed vector of bits, 64 per word. Bits past size() in the last word are
+    // always zero, so word-at-a-time operations never need to mask them.
+    template<class Allocator = std::allocator<std::uint64_t>>
+    class bit_vector {
+    public:
+        using word_type = std::uint64_t;
+        using value_type = bool;
+        using size_type = unsigned int;
+        static constexpr size_type bits_per_word = 64;
+        static constexpr size_type npos = static_cast<size_type>(-1);
+
+        class reference {
+        public:
+            // writes through the reference drop the owner's rank/select directory
+            reference(word_type *word, size_type bit, bool *index_valid) :
+                    word_(word), mask_(word_type(1) << bit), index_valid_(index_valid) {}
+
+            operator bool() const { return (*word_ & mask_) != 0; }
+
+            reference &operator=(bool value) {
+                *index_valid_ = false;
+                if (value) {
+                    *word_ |= mask_;
+                } else {
+                    *word_ &= ~mask_;
+                }
+                return *this;
+            }
+
+            reference &operator=(const reference &other) {
+                return *this = static_cast<bool>(other);
+            }
+
+            void flip() {
+                *index_valid_ = false;
+                *word_ ^= mask_;
+            }
+
+        private:
+            word_type *word_;
+            word_type mask_;
+            bool *index_valid_;
+        };
+
+        class const_iterator {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = bool;
+            using difference_type = std::ptrdiff_t;
+            using reference = bool;
+            using pointer = void;
+
+            const_iterator(const bit_vector *bits, size_type pos) : bits_(bits), pos_(pos) {}
+
+            bool operator*() const { return bits_->test(pos_); }
+
+            const_iterator &operator++() {
+                ++pos_;
+                return *this;
+            }
+
+            const_iterator operator++(int) { return const_iterator(bits_, pos_++); }
+
+            const_iterator operator+(difference_type n) const { return const_iterator(bits_, pos_ + n); }
+
+            difference_type operator-(const const_iterator &other) const {
+                return difference_type(pos_) - difference_type(other.pos_);
+            }
+
+            bool operator==(const const_iterator &other) const { return pos_ == other.pos_; }
+
+            bool operator!=(const const_iterator &other) const { return pos_ != other.pos_; }
+
+        private:
+            const bit_vector *bits_;
+            size_type pos_;
+        };
+
+        using iterator = const_iterator;
+
+        explicit bit_vector(const Allocator &alloc = Allocator()) : words_(alloc), size_(0) {}
+
+        explicit bit_vector(size_type count, bool value = false, const Allocator &alloc = Allocator()) :
+                words_(word_count(count), value ? ~word_type(0) : word_type(0), alloc), size_(count) {
+            clear_unused_bits();
+        }
+
+        bit_vector(std::initializer_list<bool> init, const Allocator &alloc = Allocator()) : bit_vector(alloc) {
+            reserve(static_cast<size_type>(init.size()));
+            for (bool bit : init) {
+                push_back(bit);
+            }
+        }
+
+        size_type size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        size_type capacity() const { return words_.capacity() * bits_per_word; }
+
+        size_type max_size() const { return npos - 1; }
+
+        void reserve(size_type bits) {
+            words_.reserve(word_count(bits));
+        }
+
+        void shrink_to_fit() {
+            words_.shrink_to_fit();
+        }
+
+        void clear() {
+            words_.clear();
+            size_ = 0;
+            invalidate_index();
+        }
+
+        void resize(size_type count, bool value = false) {
+            if (count > size_ && value) {
+                // fill the tail of the current last word before appending whole words
+                size_type tail = size_ % bits_per_word;
+                if (tail != 0) {
+                    words_.back() |= ~word_type(0) << tail;
+                }
+            }
+            words_.resize(word_count(count), value ? ~word_type(0) : word_type(0));
+            size_ = count;
+            clear_unused_bits();
+            invalidate_index();
+        }
+
+        void push_back(bool value) {
+            if (size_ % bits_per_word == 0) {
+                words_.push_back(0);
+            }
+            if (value) {
+                words_.data()[size_ / bits_per_word] |= word_type(1) << (size_ % bits_per_word);
+            }
+            ++size_;
+            invalidate_index();
+        }
+
+        void pop_back() {
+            if (size_ == 0) {
+                return;
+            }
+            --size_;
+            if (size_ % bits_per_word == 0) {
+                words_.pop_back();
+            } else {
+                clear_unused_bits();
+            }
+            invalidate_index();
+        }
+
+        bool test(size_type pos) const {
+            return (words_.data()[pos / bits_per_word] >> (pos % bits_per_word)) & 1;
+        }
+
+        bool operator[](size_type pos) const { return test(pos); }
+
+        reference operator[](size_type pos) {
+            return reference(words_.data() + pos / bits_per_word, pos % bits_per_word, &index_valid_);
+        }
+
+        bool at(size_type pos) const {
+            check_range(pos);
+            return test(pos);
+        }
+
+        reference at(size_type pos) {
+            check_range(pos);
+            return (*this)[pos];
+        }
+
+        bool back() const { return test(size_ - 1); }
+
+        void set(size_type pos, bool value = true) {
+            (*this)[pos] = value;
+        }
+
+        void reset(size_type pos) {
+            set(pos, false);
+        }
+
+        void flip(size_type pos) {
+            (*this)[pos].flip();
+        }
+
+        void fill(bool value) {
+            word_type pattern = value ? ~word_type(0) : word_type(0);
+            for (size_type i = 0; i < words_.size(); ++i) {
+                words_.data()[i] = pattern;
+            }
+            clear_unused_bits();
+            invalidate_index();
+        }
+
+        void flip() {
+            for (size_type i = 0; i < words_.size(); ++i) {
+                words_.data()[i] = ~words_.data()[i];
+            }
+            clear_unused_bits();
+            invalidate_index();
+        }
+
+        bit_vector &operator&=(const bit_vector &other) {
+            check_same_size(other);
+            word_type *out = words_.data();
+            const word_type *in = other.words_.data();
+            for (size_type i = 0; i < words_.size(); ++i) {
+                out[i] &= in[i];
+            }
+            invalidate_index();
+            return *this;
+        }
+
+        bit_vector &operator|=(const bit_vector &other) {
+            check_same_size(other);
+            word_type *out = words_.data();
+            const word_type *in = other.words_.data();
+            for (size_type i = 0; i < words_.size(); ++i) {
+                out[i] |= in[i];
+            }
+            invalidate_index();
+            return *this;
+        }
+
+        bit_vector &operator^=(const bit_vector &other) {
+            check_same_size(other);
+            word_type *out = words_.data();
+            const word_type *in = other.words_.data();
+            for (size_type i = 0; i < words_.size(); ++i) {
+                out[i] ^= in[i];
+            }
+            invalidate_index();
+            return *this;
+        }
+
+        friend bit_vector operator&(bit_vector lhs, const bit_vector &rhs) { return lhs &= rhs; }
+
+        friend bit_vector operator|(bit_vector lhs, const bit_vector &rhs) { return lhs |= rhs; }
+
+        friend bit_vector operator^(bit_vector lhs, const bit_vector &rhs) { return lhs ^= rhs; }
+
+        friend bool operator==(const bit_vector &lhs, const bit_vector &rhs) {
+            if (lhs.size_ != rhs.size_) {
+                return false;
+            }
+            return std::equal(lhs.words_.data(), lhs.words_.data() + lhs.words_.size(), rhs.words_.data());
+        }
+
+        friend bool operator!=(const bit_vector &lhs, const bit_vector &rhs) { return !(lhs == rhs); }
+
+        // number of set bits
+        size_type count() const {
+            return static_cast<size_type>(bit_detail::popcount(words_.data(), words_.size()));
+        }
+
+        bool any() const {
+            return find_first() != npos;
+        }
+
+        bool none() const {
+            return !any();
+        }
+
+        size_type find_first() const {
+            return find_from_word(0);
+        }
+
+        // first set bit after pos, or npos
+        size_type find_next(size_type pos) const {
+            size_type next = pos + 1;
+            if (next >= size_) {
+                return npos;
+            }
+            size_type word = next / bits_per_word;
+            word_type rest = words_.data()[word] >> (next % bits_per_word);
+            if (rest != 0) {
+                return next + static_cast<size_type>(__builtin_ctzll(rest));
+            }
+            return find_from_word(word + 1);
+        }
+
+        // Builds the rank/select directory: one cumulative 32-bit count per 512-bit
+        // block (8 words), i.e. 6.25% space overhead. Any mutation drops the
+        // directory, after which rank and select fall back to scanning the words.
+        void build_index() {
+            size_type blocks = (words_.size() + words_per_block - 1) / words_per_block;
+            block_ranks_.clear();
+            block_ranks_.reserve(blocks + 1);
+            const word_type *words = words_.data();
+            size_type total = 0;
+            for (size_type i = 0; i < words_.size(); i += words_per_block) {
+                block_ranks_.push_back(total);
+                size_type count = std::min(words_per_block, words_.size() - i);
+                total += static_cast<size_type>(bit_detail::popcount(words + i, count));
+            }
+            block_ranks_.push_back(total);
+            index_valid_ = true;
+        }
+
+        bool has_index() const { return index_valid_; }
+
+        // number of set bits in [0, pos)
+        size_type rank(size_type pos) const {
+            if (pos > size_) {
+                throw std::out_of_range("rank position out of bit_vector range");
+            }
+            const word_type *words = words_.data();
+            size_type word = pos / bits_per_word;
+            size_type result = 0;
+            size_type i = 0;
+            if (index_valid_) {
+                result = block_ranks_.data()[word / words_per_block];
+                i = word / words_per_block * words_per_block;
+            }
+            result += static_cast<size_type>(bit_detail::popcount(words + i, word - i));
+            if (pos % bits_per_word != 0) {
+                word_type masked = words[word] & ((word_type(1) << (pos % bits_per_word)) - 1);
+                result += static_cast<size_type>(bit_detail::popcount(&masked, 1));
+            }
+            return result;
+        }
+
+        // position of the k-th set bit (0-based), or npos if there are not that many
+        size_type select(size_type k) const {
+            const word_type *words = words_.data();
+            size_type word = 0;
+            if (index_valid_) {
+                if (k >= block_ranks_.back()) {
+                    return npos;
+                }
+                // last block whose cumulative count is <= k
+                const size_type *ranks = block_ranks_.data();
+                size_type lo = 0, hi = block_ranks_.size() - 1;
+                while (hi - lo > 1) {
+                    size_type mid = lo + (hi - lo) / 2;
+                    if (ranks[mid] <= k) {
+                        lo = mid;
+                    } else {
+                        hi = mid;
+                    }
+                }
+                k -= ranks[lo];
+                word = lo * words_per_block;
+            }
+            for (; word < words_.size(); ++word) {
+                size_type ones = static_cast<size_type>(bit_detail::popcount(words + word, 1));
+                if (k < ones) {
+                    return word * bits_per_word + select_in_word(words[word], k);
+                }
+                k -= ones;
+            }
+            return npos;
+        }
+
+        const word_type *words() const { return words_.data(); }
+
+        word_type *words() {
+            invalidate_index();
+            return words_.data();
+        }
+
+        size_type word_size() const { return words_.size(); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+
+        const_iterator end() const { return const_iterator(this, size_); }
+
+        void swap(bit_vector &other) noexcept {
+            words_.swap(other.words_);
+            block_ranks_.swap(other.block_ranks_);
+            std::swap(size_, other.size_);
+            std::swap(index_valid_, other.index_valid_);
+        }
+
+    private:
+        static constexpr size_type words_per_block = 8;
+
+        vector<word_type, Allocator> words_;
+        vector<size_type> block_ranks_;
+        size_type size_;
+        bool index_valid_ = false;
+
+        static size_type word_count(size_type bits) {
+            return (bits + bits_per_word - 1) / bits_per_word;
+        }
+
+        static size_type select_in_word(word_type word, size_type k) {
+#if defined(__BMI2__)
+            return static_cast<size_type>(_tzcnt_u64(_pdep_u64(word_type(1) << k, word)));
+#else
+            for (size_type i = 0; i < k; ++i) {
+                word &= word - 1;
+            }
+            return static_cast<size_type>(__builtin_ctzll(word));
+#endif
+        }
+
+        size_type find_from_word(size_type word) const {
+            const word_type *words = words_.data();
+            for (; word < words_.size(); ++word) {
+                if (words[word] != 0) {
+                    return word * bits_per_word + static_cast<size_type>(__builtin_ctzll(words[word]));
+                }
+            }
+            return npos;
+        }
+
+        void clear_unused_bits() {
+            size_type tail = size_ % bits_per_word;
+            if (tail != 0) {
+                words_.data()[size_ / bits_per_word] &= (word_type(1) << tail) - 1;
+            }
+        }
+
+        void invalidate_index() {
+            index_valid_ = false;
+        }
+
+        void check_range(size_type pos) const {
+            if (pos >= size_) {
+                throw std::out_of_range("Index out of bit_vector range");
+            }
+        }
+
+        void check_same_size(const bit_vector &other) const {
+            if (other.size_ != size_) {
+                throw std::invalid_argument("bit_vector sizes differ");
+            }
+        }
+    };
+}
@@ -0,0 +1,463 @@
+#pragma once
+#include <algorithm>
+#include <stdexcept>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // Ring buffer over one allocator block: element i lives at
+    // data_[(head_ + i) % capacity_]. push_back/pop_front are O(1) and never shift
+    // elements. A growable buffer reallocates like vector when full; a fixed one
+    // refuses pushes past its capacity.
+    template<class T, class Allocator = pretty_allocator::allocator<T>>
+    class circular_vector {
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+        using reference = T &;
+        using const_reference = const T &;
+        using pointer = typename std::allocator_traits<Allocator>::pointer;
+        float resize_coefficient = 1.5;
+
+        enum class capacity_policy { growable, fixed };
+
+        // a contiguous run inside the ring
+        template<class U>
+        struct basic_segment {
+            U *data;
+            size_type size;
+
+            U *begin() const { return data; }
+
+            U *end() const { return data + size; }
+        };
+
+        // the (at most two) runs covering a range of the ring, in order
+        template<class U>
+        struct basic_segments {
+            basic_segment<U> first, second;
+
+            size_type size() const { return first.size + second.size; }
+        };
+
+        using segment = basic_segment<T>;
+        using const_segment = basic_segment<const T>;
+        using segments = basic_segments<T>;
+        using const_segments = basic_segments<const T>;
+
+        template<bool Const>
+        class basic_iterator {
+            using owner = typename std::conditional<Const, const circular_vector, circular_vector>::type;
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, const T &, T &>::type;
+            using pointer = typename std::conditional<Const, const T *, T *>::type;
+
+            basic_iterator() : container_(nullptr), index_(0) {}
+
+            basic_iterator(owner *container, size_type index) : container_(container), index_(index) {}
+
+            template<bool C, class = typename std::enable_if<Const && !C>::type>
+            basic_iterator(const basic_iterator<C> &other) : container_(other.container_), index_(other.index_) {}
+
+            reference operator*() const { return (*container_)[index_]; }
+
+            pointer operator->() const { return &(*container_)[index_]; }
+
+            reference operator[](difference_type n) const { return (*container_)[index_ + n]; }
+
+            basic_iterator &operator++() {
+                ++index_;
+                return *this;
+            }
+
+            basic_iterator operator++(int) { return basic_iterator(container_, index_++); }
+
+            basic_iterator &operator--() {
+                --index_;
+                return *this;
+            }
+
+            basic_iterator operator--(int) { return basic_iterator(container_, index_--); }
+
+            basic_iterator &operator+=(difference_type n) {
+                index_ += n;
+                return *this;
+            }
+
+            basic_iterator &operator-=(difference_type n) {
+                index_ -= n;
+                return *this;
+            }
+
+            basic_iterator operator+(difference_type n) const { return basic_iterator(container_, index_ + n); }
+
+            basic_iterator operator-(difference_type n) const { return basic_iterator(container_, index_ - n); }
+
+            difference_type operator-(const basic_iterator &other) const {
+                return difference_type(index_) - difference_type(other.index_);
+            }
+
+            bool operator==(const basic_iterator &other) const { return index_ == other.index_; }
+
+            bool operator!=(const basic_iterator &other) const { return index_ != other.index_; }
+
+            bool operator<(const basic_iterator &other) const { return index_ < other.index_; }
+
+        private:
+            template<bool>
+            friend class basic_iterator;
+
+            owner *container_;
+            size_type index_;
+        };
+
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        explicit circular_vector(const Allocator &alloc = Allocator()) :
+                allocator_(alloc), data_(nullptr), capacity_(0), head_(0), size_(0),
+                policy_(capacity_policy::growable) {}
+
+        circular_vector(size_type capacity, capacity_policy policy, const Allocator &alloc = Allocator()) :
+                circular_vector(alloc) {
+            policy_ = policy;
+            reserve(capacity);
+        }
+
+        circular_vector(std::initializer_list<T> init, const Allocator &alloc = Allocator()) :
+                circular_vector(alloc) {
+            reserve(static_cast<size_type>(init.size()));
+            for (const T &value : init) {
+                emplace_back(value);
+            }
+        }
+
+        circular_vector(const circular_vector &other) :
+                circular_vector(std::allocator_traits<Allocator>::select_on_container_copy_construction(
+                        other.allocator_)) {
+            policy_ = other.policy_;
+            reserve(other.capacity_);
+            for (const T &value : other) {
+                emplace_back(value);
+            }
+        }
+
+        circular_vector(circular_vector &&other) noexcept :
+                allocator_(std::move(other.allocator_)), data_(other.data_), capacity_(other.capacity_),
+                head_(other.head_), size_(other.size_), policy_(other.policy_) {
+            other.data_ = nullptr;
+            other.capacity_ = other.head_ = other.size_ = 0;
+        }
+
+        circular_vector &operator=(const circular_vector &other) {
+            if (this != &other) {
+                circular_vector copy(other);
+                swap(copy);
+            }
+            return *this;
+        }
+
+        circular_vector &operator=(circular_vector &&other) noexcept {
+            if (this != &other) {
+                circular_vector moved(std::move(other));
+                swap(moved);
+            }
+            return *this;
+        }
+
+        ~circular_vector() {
+            clear();
+            if (data_) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, data_, capacity_);
+            }
+        }
+
+        size_type size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        bool full() const { return size_ == capacity_; }
+
+        size_type capacity() const { return capacity_; }
+
+        capacity_policy policy() const { return policy_; }
+
+        reference operator[](size_type pos) { return data_[slot(pos)]; }
+
+        const_reference operator[](size_type pos) const { return data_[slot(pos)]; }
+
+        reference at(size_type pos) {
+            check_range(pos);
+            return (*this)[pos];
+        }
+
+        const_reference at(size_type pos) const {
+            check_range(pos);
+            return (*this)[pos];
+        }
+
+        reference front() { return at(0); }
+
+        const_reference front() const { return at(0); }
+
+        reference back() { return at(size_ - 1); }
+
+        const_reference back() const { return at(size_ - 1); }
+
+        iterator begin() { return iterator(this, 0); }
+
+        iterator end() { return iterator(this, size_); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+
+        const_iterator end() const { return const_iterator(this, size_); }
+
+        // a fixed buffer only grows through reserve
+        void reserve(size_type size) {
+            if (size > capacity_) {
+                reallocate(size);
+            }
+        }
+
+        void shrink_to_fit() {
+            if (size_ < capacity_) {
+                reallocate(size_);
+            }
+        }
+
+        void clear() {
+            for (size_type i = 0; i < size_; ++i) {
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + slot(i));
+            }
+            head_ = 0;
+            size_ = 0;
+        }
+
+        template<typename ...Args>
+        reference emplace_back(Args &&... args) {
+            if (size_ == capacity_) {
+                if (policy_ == capacity_policy::fixed) {
+                    throw std::length_error("circular_vector is full");
+                }
+                T value(std::forward<Args>(args)...);
+                reallocate(grown_capacity(size_ + 1));
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + slot(size_), std::move(value));
+            } else {
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + slot(size_),
+                                                            std::forward<Args>(args)...);
+            }
+            return data_[slot(size_++)];
+        }
+
+        void push_back(const T &value) { emplace_back(value); }
+
+        void push_back(T &&value) { emplace_back(std::move(value)); }
+
+        // false instead of an exception when a fixed buffer is full
+        bool try_push_back(const T &value) {
+            if (size_ == capacity_ && policy_ == capacity_policy::fixed) {
+                return false;
+            }
+            emplace_back(value);
+            return true;
+        }
+
+        void pop_front() {
+            if (size_ > 0) {
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + head_);
+                head_ = head_ + 1 == capacity_ ? 0 : head_ + 1;
+                --size_;
+            }
+        }
+
+        void pop_back() {
+            if (size_ > 0) {
+                --size_;
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + slot(size_));
+            }
+        }
+
+        // Appends up to `count` elements copied from `values` and returns how many
+        // were taken: all of them when growable, at most the free space when fixed.
+        // Each wrapped run is copied in one pass.
+        size_type push_back_n(const T *values, size_type count) {
+            if (policy_ == capacity_policy::fixed) {
+                count = std::min(count, capacity_ - size_);
+            } else if (count > capacity_ - size_) {
+                reallocate(grown_capacity(size_ + count));
+            }
+            segments free = free_segments(count);
+            size_type done = 0;
+            try {
+                for (; done < free.first.size; ++done) {
+                    std::allocator_traits<Allocator>::construct(allocator_, free.first.data + done, values[done]);
+                }
+                for (; done < count; ++done) {
+                    std::allocator_traits<Allocator>::construct(allocator_, free.second.data + done - free.first.size,
+                                                                values[done]);
+                }
+            } catch (...) {
+                size_ += done;
+                while (done-- > 0) {
+                    pop_back();
+                }
+                throw;
+            }
+            size_ += count;
+            return count;
+        }
+
+        // Moves up to `count` of the oldest elements into `out`, removes them and
+        // returns how many were moved.
+        size_type pop_front_n(T *out, size_type count) {
+            count = std::min(count, size_);
+            const_segments used = data_segments(count);
+            for (size_type i = 0; i < used.first.size; ++i) {
+                out[i] = std::move(data_[head_ + i]);
+            }
+            for (size_type i = 0; i < used.second.size; ++i) {
+                out[used.first.size + i] = std::move(data_[i]);
+            }
+            consume(count);
+            return count;
+        }
+
+        // Zero-copy read side: the oldest `count` elements (all of them by default)
+        // as at most two contiguous runs. Release them with consume().
+        segments readable(size_type count = std::numeric_limits<size_type>::max()) {
+            const_segments used = data_segments(std::min(count, size_));
+            return segments{segment{const_cast<T *>(used.first.data), used.first.size},
+                            segment{const_cast<T *>(used.second.data), used.second.size}};
+        }
+
+        const_segments readable(size_type count = std::numeric_limits<size_type>::max()) const {
+            return data_segments(std::min(count, size_));
+        }
+
+        // destroys the `count` oldest elements
+        void consume(size_type count) {
+            count = std::min(count, size_);
+            for (size_type i = 0; i < count; ++i) {
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + slot(i));
+            }
+            size_ -= count;
+            head_ = size_ == 0 ? 0 : slot(count);
+        }
+
+        // Zero-copy write side for trivially copyable elements: up to `count` free
+        // slots after the back (growing first when allowed), as at most two runs.
+        // Fill a prefix of them and publish it with commit().
+        segments writable(size_type count) {
+            static_assert(std::is_trivially_copyable<T>::value,
+                          "writable() hands out raw slots, T must be trivially copyable");
+            if (policy_ == capacity_policy::fixed) {
+                count = std::min(count, capacity_ - size_);
+            } else if (count > capacity_ - size_) {
+                reallocate(grown_capacity(size_ + count));
+            }
+            return free_segments(count);
+        }
+
+        void commit(size_type count) {
+            size_ += std::min(count, capacity_ - size_);
+        }
+
+        void swap(circular_vector &other) noexcept {
+            if (std::allocator_traits<Allocator>::propagate_on_container_swap::value) {
+                std::swap(allocator_, other.allocator_);
+            }
+            std::swap(data_, other.data_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(head_, other.head_);
+            std::swap(size_, other.size_);
+            std::swap(policy_, other.policy_);
+        }
+
+        friend void swap(circular_vector &lhs, circular_vector &rhs) noexcept {
+            lhs.swap(rhs);
+        }
+
+    private:
+        static constexpr bool bitwise_relocatable = is_bitwise_relocatable<T, Allocator>::value;
+
+        Allocator allocator_;
+        pointer data_;
+        size_type capacity_, head_, size_;
+        capacity_policy policy_;
+
+        size_type slot(size_type pos) const {
+            size_type to_end = capacity_ - head_;
+            return pos < to_end ? head_ + pos : pos - to_end;
+        }
+
+        const_segments data_segments(size_type count) const {
+            size_type first = std::min(count, capacity_ - head_);
+            return const_segments{const_segment{data_ + head_, first}, const_segment{data_, count - first}};
+        }
+
+        segments free_segments(size_type count) const {
+            if (capacity_ == 0) {
+                return segments{segment{data_, 0}, segment{data_, 0}};
+            }
+            size_type tail = slot(size_);
+            size_type first = std::min(count, capacity_ - tail);
+            return segments{segment{data_ + tail, first}, segment{data_, count - first}};
+        }
+
+        size_type grown_capacity(size_type needed) const {
+            size_type grown = static_cast<size_type>(ceil(capacity_ * resize_coefficient));
+            return std::max<size_type>(std::max<size_type>(grown, 4), needed);
+        }
+
+        // moves the elements to the front of a new block of `new_capacity`;
+        // throwing moves are replaced by copies so a failure leaves *this unchanged
+        void reallocate(size_type new_capacity) {
+            pointer new_data = new_capacity ? std::allocator_traits<Allocator>::allocate(allocator_, new_capacity)
+                                            : nullptr;
+            if constexpr (bitwise_relocatable) {
+                const_segments used = data_segments(size_);
+                if (used.first.size > 0) {
+                    std::memcpy(static_cast<void *>(new_data), static_cast<const void *>(used.first.data),
+                                used.first.size * sizeof(T));
+                }
+                if (used.second.size > 0) {
+                    std::memcpy(static_cast<void *>(new_data + used.first.size),
+                                static_cast<const void *>(used.second.data), used.second.size * sizeof(T));
+                }
+            } else {
+                size_type i = 0;
+                try {
+                    for (; i < size_; ++i) {
+                        std::allocator_traits<Allocator>::construct(allocator_, new_data + i,
+                                                                    std::move_if_noexcept(data_[slot(i)]));
+                    }
+                } catch (...) {
+                    for (size_type j = 0; j < i; ++j) {
+                        std::allocator_traits<Allocator>::destroy(allocator_, new_data + j);
+                    }
+                    std::allocator_traits<Allocator>::deallocate(allocator_, new_data, new_capacity);
+                    throw;
+                }
+                for (i = 0; i < size_; ++i) {
+                    std::allocator_traits<Allocator>::destroy(allocator_, data_ + slot(i));
+                }
+            }
+            if (data_) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, data_, capacity_);
+            }
+            data_ = new_data;
+            capacity_ = new_capacity;
+            head_ = 0;
+        }
+
+        void check_range(size_type pos) const {
+            if (pos >= size_) {
+                throw std::out_of_range("Index out of circular_vector range");
+            }
+        }
+    };
+}
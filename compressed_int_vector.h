@@ -0,0 +1,458 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include "allocator.h"
+#include "simd_kernels.h"
+#include "vector.h"
+
+namespace pretty_vector {
+
+    namespace compressed_detail {
+        constexpr unsigned int block_size = 128;
+        // values are interleaved over four 32-bit lanes: value i is number i / 4
+        // of lane i % 4, so one 128-bit load holds the same bits of four values
+        constexpr unsigned int lanes = 4;
+        constexpr unsigned int per_lane = block_size / lanes;
+        // an exception costs its position byte and its high bits as a 64-bit word
+        constexpr unsigned int exception_bits = 8 + 64;
+
+        struct block_header {
+            // frame of reference, or the start of every lane for delta blocks
+            std::uint64_t base;
+            // first 32-bit word of the block
+            std::uint32_t offset;
+            // bits per packed value, 0 - 64
+            std::uint8_t width;
+            // values whose packed bits miss their high part (patched frame of
+            // reference); their positions and high parts follow the planes
+            std::uint8_t exceptions;
+            // packed values are v[i] - v[i - 4] rather than v[i] - base
+            std::uint8_t delta;
+            std::uint8_t unused;
+        };
+
+        inline unsigned int bit_width(std::uint64_t value) {
+            return value ? 64 - static_cast<unsigned int>(__builtin_clzll(value)) : 0;
+        }
+
+        inline std::uint32_t low_mask(unsigned int width) {
+            return width >= 32 ? ~std::uint32_t(0) : (std::uint32_t(1) << width) - 1;
+        }
+
+        // number k of lane j in a plane of `width` bits (0 - 32)
+        inline std::uint32_t plane_value(const std::uint32_t *words, unsigned int width, unsigned int k,
+                                         unsigned int j) {
+            unsigned int bit = k * width, word = bit / 32, shift = bit % 32;
+            std::uint64_t pair = words[word * lanes + j];
+            if (shift + width > 32) {
+                pair |= std::uint64_t(words[(word + 1) * lanes + j]) << 32;
+            }
+            return static_cast<std::uint32_t>(pair >> shift) & low_mask(width);
+        }
+
+        // writes the low `width` bits (0 - 32) of the 128 values to a plane
+        inline void pack_plane(const std::uint64_t *values, unsigned int shift, unsigned int width,
+                               std::uint32_t *words) {
+            std::fill(words, words + lanes * width, 0u);
+            for (unsigned int k = 0; k < per_lane; ++k) {
+                unsigned int bit = k * width, word = bit / 32, at = bit % 32;
+                for (unsigned int j = 0; j < lanes; ++j) {
+                    std::uint64_t value = (values[k * lanes + j] >> shift) & low_mask(width);
+                    words[word * lanes + j] |= static_cast<std::uint32_t>(value << at);
+                    if (at + width > 32) {
+                        words[(word + 1) * lanes + j] |= static_cast<std::uint32_t>(value >> (32 - at));
+                    }
+                }
+            }
+        }
+
+        // cheapest width for packing `values` with exceptions for the rest
+        inline unsigned int best_width(const std::uint64_t *values, unsigned int &cost) {
+            unsigned int widths[65] = {};
+            for (unsigned int i = 0; i < block_size; ++i) {
+                ++widths[bit_width(values[i])];
+            }
+            unsigned int best = 64, above = 0;
+            cost = block_size * 64;
+            for (unsigned int width = 64; width-- > 0;) {
+                above += widths[width + 1];
+                unsigned int here = block_size * width + above * exception_bits;
+                if (above <= 255 && here < cost) {
+                    best = width;
+                    cost = here;
+                }
+            }
+            return best;
+        }
+
+        inline std::size_t block_words(unsigned int width, unsigned int exceptions) {
+            return lanes * width + (exceptions + 3) / 4 + 2 * exceptions;
+        }
+    }
+
+    // Append-only vector of 64-bit unsigned integers stored in blocks of 128,
+    // each packed at the fewest bits that fit (frame of reference) or, when
+    // the block is sorted, at the fewest bits that fit its gaps (delta). A few outliers do not widen a block: they are packed as
+    // exceptions whose high bits are kept aside (patched frame of reference).
+    // Gaps are taken four values apart (so a block only needs to be sorted
+    // within each lane), which keeps decoding a vertical add over the four
+    // interleaved lanes. The last, partial block stays
+    // uncompressed until it fills up.
+    //
+    // Blocks decode with the SIMD unpack kernel of the active dispatch level;
+    // iteration decodes one block at a time, and operator[] reads one value
+    // through the block headers without decoding the rest of its block.
+    template<class Allocator = pretty_allocator::allocator<std::uint64_t>>
+    class compressed_int_vector {
+        using header = compressed_detail::block_header;
+        using header_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<header>;
+        using word_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::uint32_t>;
+
+    public:
+        using value_type = std::uint64_t;
+        using size_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+        using allocator_type = Allocator;
+        static constexpr size_type block_size = compressed_detail::block_size;
+
+        // Decodes the block it is in on first dereference and keeps it, so
+        // copies are about a kilobyte; compare and advance them freely, but
+        // prefer for_each_block for bulk reads.
+        class const_iterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = std::uint64_t;
+            using difference_type = std::ptrdiff_t;
+            using reference = std::uint64_t;
+            using pointer = const std::uint64_t *;
+
+            const_iterator() : container_(nullptr), index_(0), block_(npos) {}
+
+            const_iterator(const compressed_int_vector *container, size_type index) :
+                    container_(container), index_(index), block_(npos) {}
+
+            std::uint64_t operator*() const {
+                size_type block = index_ / block_size;
+                if (block != block_) {
+                    container_->decode_block(block, values_);
+                    block_ = block;
+                }
+                return values_[index_ % block_size];
+            }
+
+            const_iterator &operator++() {
+                ++index_;
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                const_iterator result = *this;
+                ++index_;
+                return result;
+            }
+
+            bool operator==(const const_iterator &other) const { return index_ == other.index_; }
+
+            bool operator!=(const const_iterator &other) const { return index_ != other.index_; }
+
+        private:
+            static constexpr size_type npos = static_cast<size_type>(-1);
+
+            const compressed_int_vector *container_;
+            size_type index_;
+            mutable size_type block_;
+            mutable std::uint64_t values_[block_size];
+        };
+
+        using iterator = const_iterator;
+
+        explicit compressed_int_vector(const Allocator &alloc = Allocator()) :
+                headers_(header_allocator(alloc)), words_(word_allocator(alloc)), tail_(alloc), size_(0) {
+            words_.resize(compressed_detail::lanes);
+        }
+
+        template<class InputIt, class = typename std::enable_if<
+                !std::is_integral<InputIt>::value>::type>
+        compressed_int_vector(InputIt first, InputIt last, const Allocator &alloc = Allocator()) :
+                compressed_int_vector(alloc) {
+            for (; first != last; ++first) {
+                push_back(*first);
+            }
+        }
+
+        compressed_int_vector(std::initializer_list<std::uint64_t> init, const Allocator &alloc = Allocator()) :
+                compressed_int_vector(init.begin(), init.end(), alloc) {}
+
+        size_type size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        // blocks holding values, the partial last one included
+        size_type block_count() const { return (size_ + block_size - 1) / block_size; }
+
+        allocator_type get_allocator() const { return tail_.get_allocator(); }
+
+        void push_back(std::uint64_t value) {
+            if (tail_.capacity() < block_size) {
+                tail_.reserve(block_size);
+            }
+            tail_.push_back(value);
+            ++size_;
+            if (tail_.size() == block_size) {
+                encode(tail_.data());
+                tail_.clear();
+            }
+        }
+
+        std::uint64_t operator[](size_type pos) const {
+            size_type block = pos / block_size, at = pos % block_size;
+            if (block == headers_.size()) {
+                return tail_.data()[at];
+            }
+            return value_in(headers_.data()[block], at);
+        }
+
+        std::uint64_t at(size_type pos) const {
+            if (pos >= size_) {
+                throw std::out_of_range("compressed_int_vector::at");
+            }
+            return (*this)[pos];
+        }
+
+        std::uint64_t front() const { return (*this)[0]; }
+
+        std::uint64_t back() const { return (*this)[size_ - 1]; }
+
+        // Writes the values of block b to out: 128 of them, or size() % 128
+        // for the partial last block. Returns how many were written.
+        size_type decode_block(size_type b, std::uint64_t *out) const {
+            if (b == headers_.size()) {
+                std::copy(tail_.data(), tail_.data() + tail_.size(), out);
+                return tail_.size();
+            }
+            const header &h = headers_.data()[b];
+            const std::uint32_t *words = words_.data() + h.offset;
+            if (h.width <= 32 && h.exceptions == 0) {
+                simd::unpack(words, h.width, h.base, h.delta != 0, out);
+                return block_size;
+            }
+            unpack_patched(h, words, out);
+            return block_size;
+        }
+
+        // calls f(values, count) once per block, in order, with the block
+        // decoded into a buffer on the stack
+        template<class F>
+        void for_each_block(F f) const {
+            std::uint64_t values[block_size];
+            for (size_type b = 0; b < block_count(); ++b) {
+                size_type count = decode_block(b, values);
+                f(static_cast<const std::uint64_t *>(values), count);
+            }
+        }
+
+        template<class OtherAllocator>
+        void copy_to(vector<std::uint64_t, OtherAllocator> &out) const {
+            out.resize(size_);
+            std::uint64_t *to = out.data();
+            for (size_type b = 0; b < headers_.size(); ++b, to += block_size) {
+                decode_block(b, to);
+            }
+            std::copy(tail_.data(), tail_.data() + tail_.size(), to);
+        }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+
+        const_iterator end() const { return const_iterator(this, size_); }
+
+        // bytes held by the blocks, their headers and the partial block
+        std::size_t memory_bytes() const {
+            return headers_.capacity() * sizeof(header) + words_.capacity() * sizeof(std::uint32_t) +
+                   tail_.capacity() * sizeof(std::uint64_t);
+        }
+
+        void shrink_to_fit() {
+            headers_.shrink_to_fit();
+            words_.shrink_to_fit();
+            tail_.shrink_to_fit();
+        }
+
+        void clear() {
+            headers_.clear();
+            words_.resize(compressed_detail::lanes);
+            tail_.clear();
+            size_ = 0;
+        }
+
+        void swap(compressed_int_vector &other) noexcept {
+            headers_.swap(other.headers_);
+            words_.swap(other.words_);
+            tail_.swap(other.tail_);
+            std::swap(size_, other.size_);
+        }
+
+        friend void swap(compressed_int_vector &lhs, compressed_int_vector &rhs) noexcept { lhs.swap(rhs); }
+
+        friend bool operator==(const compressed_int_vector &lhs, const compressed_int_vector &rhs) {
+            if (lhs.size_ != rhs.size_) {
+                return false;
+            }
+            std::uint64_t a[block_size], b[block_size];
+            for (size_type block = 0; block < lhs.block_count(); ++block) {
+                size_type count = lhs.decode_block(block, a);
+                rhs.decode_block(block, b);
+                if (!std::equal(a, a + count, b)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        friend bool operator!=(const compressed_int_vector &lhs, const compressed_int_vector &rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        // Packs 128 values as the cheaper of frame of reference and delta.
+        // The word stream always ends in four spare words, which the unpack
+        // kernel may read past the last plane.
+        void encode(const std::uint64_t *values) {
+            using namespace compressed_detail;
+            std::uint64_t frame[block_size], gaps[block_size];
+            std::uint64_t low = *std::min_element(values, values + block_size);
+            std::uint64_t start = *std::min_element(values, values + lanes);
+            bool ordered = true;
+            for (unsigned int i = 0; i < block_size; ++i) {
+                frame[i] = values[i] - low;
+                std::uint64_t previous = i < lanes ? start : values[i - lanes];
+                ordered = ordered && values[i] >= previous;
+                gaps[i] = values[i] - previous;
+            }
+            unsigned int frame_cost, gap_cost = ~0u;
+            unsigned int width = best_width(frame, frame_cost);
+            if (ordered) {
+                unsigned int gap_width = best_width(gaps, gap_cost);
+                if (gap_cost < frame_cost) {
+                    width = gap_width;
+                }
+            }
+            bool delta = ordered && gap_cost < frame_cost;
+            const std::uint64_t *packed = delta ? gaps : frame;
+
+            unsigned int exceptions = 0;
+            unsigned char positions[block_size];
+            for (unsigned int i = 0; i < block_size; ++i) {
+                if (bit_width(packed[i]) > width) {
+                    positions[exceptions++] = static_cast<unsigned char>(i);
+                }
+            }
+            if (words_.size() + block_words(width, exceptions) > 0xffffffffu) {
+                throw std::length_error("compressed_int_vector: too many words");
+            }
+            header h;
+            h.base = delta ? start : low;
+            h.offset = static_cast<std::uint32_t>(words_.size() - lanes);
+            h.width = static_cast<std::uint8_t>(width);
+            h.exceptions = static_cast<std::uint8_t>(exceptions);
+            h.delta = delta;
+            h.unused = 0;
+            headers_.push_back(h);
+
+            words_.resize(static_cast<unsigned int>(h.offset + block_words(width, exceptions) + lanes));
+            std::uint32_t *out = words_.data() + h.offset;
+            unsigned int low_width = std::min(width, 32u);
+            pack_plane(packed, 0, low_width, out);
+            if (width > 32) {
+                pack_plane(packed, 32, width - 32, out + lanes * low_width);
+            }
+            std::uint32_t *patch = out + lanes * width;
+            std::fill(patch, words_.data() + words_.size(), 0u);
+            for (unsigned int e = 0; e < exceptions; ++e) {
+                patch[e / 4] |= std::uint32_t(positions[e]) << (e % 4 * 8);
+            }
+            std::uint32_t *high = patch + (exceptions + 3) / 4;
+            for (unsigned int e = 0; e < exceptions; ++e) {
+                std::uint64_t rest = packed[positions[e]] >> width;
+                high[2 * e] = static_cast<std::uint32_t>(rest);
+                high[2 * e + 1] = static_cast<std::uint32_t>(rest >> 32);
+            }
+        }
+
+        // exception e of a block: its position and the bits above the width
+        static void exception_at(const header &h, const std::uint32_t *words, unsigned int e, unsigned int &position,
+                                 std::uint64_t &rest) {
+            const std::uint32_t *patch = words + compressed_detail::lanes * h.width;
+            position = (patch[e / 4] >> (e % 4 * 8)) & 0xff;
+            const std::uint32_t *high = patch + (h.exceptions + 3) / 4;
+            rest = high[2 * e] | std::uint64_t(high[2 * e + 1]) << 32;
+        }
+
+        // A frame of reference value is the base plus its packed bits; a delta
+        // value is the base plus every packed value of its lane up to it.
+        // Either way the planes and the exceptions add up separately.
+        std::uint64_t value_in(const header &h, unsigned int at) const {
+            using namespace compressed_detail;
+            const std::uint32_t *words = words_.data() + h.offset;
+            unsigned int lane = at % lanes, last = at / lanes, first = h.delta ? 0 : last;
+            unsigned int low_width = std::min<unsigned int>(h.width, 32);
+            std::uint64_t value = h.base;
+            for (unsigned int k = first; k <= last; ++k) {
+                value += plane_value(words, low_width, k, lane);
+            }
+            if (h.width > 32) {
+                for (unsigned int k = first; k <= last; ++k) {
+                    value += std::uint64_t(plane_value(words + lanes * low_width, h.width - 32, k, lane)) << 32;
+                }
+            }
+            for (unsigned int e = 0; e < h.exceptions; ++e) {
+                unsigned int position;
+                std::uint64_t rest;
+                exception_at(h, words, e, position, rest);
+                if (position % lanes == lane && position / lanes >= first && position / lanes <= last) {
+                    value += rest << h.width;
+                }
+            }
+            return value;
+        }
+
+        // blocks wider than 32 bits or with exceptions: both planes and the
+        // exceptions are put together first, then based or summed
+        static void unpack_patched(const header &h, const std::uint32_t *words, std::uint64_t *out) {
+            using namespace compressed_detail;
+            unsigned int low_width = std::min<unsigned int>(h.width, 32);
+            simd::unpack(words, low_width, 0, false, out);
+            if (h.width > 32) {
+                std::uint64_t high[block_size];
+                simd::unpack(words + lanes * low_width, h.width - 32, 0, false, high);
+                for (unsigned int i = 0; i < block_size; ++i) {
+                    out[i] |= high[i] << 32;
+                }
+            }
+            for (unsigned int e = 0; e < h.exceptions; ++e) {
+                unsigned int position;
+                std::uint64_t rest;
+                exception_at(h, words, e, position, rest);
+                out[position] |= rest << h.width;
+            }
+            if (h.delta) {
+                for (unsigned int i = 0; i < block_size; ++i) {
+                    out[i] += i < lanes ? h.base : out[i - lanes];
+                }
+            } else {
+                for (unsigned int i = 0; i < block_size; ++i) {
+                    out[i] += h.base;
+                }
+            }
+        }
+
+        vector<header, header_allocator> headers_;
+        vector<std::uint32_t, word_allocator> words_;
+        vector<std::uint64_t, Allocator> tail_;
+        size_type size_;
+    };
+}
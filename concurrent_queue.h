@@ -0,0 +1,323 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include "allocator.h"
+
+namespace pretty_vector {
+
+    namespace detail {
+        constexpr std::size_t cache_line = 64;
+
+        inline std::size_t queue_capacity(std::size_t requested) {
+            if (requested < 2) {
+                requested = 2;
+            }
+            std::size_t capacity = 1;
+            while (capacity < requested) {
+                capacity <<= 1;
+            }
+            return capacity;
+        }
+    }
+
+    // Bounded wait-free queue for exactly one producer and one consumer thread.
+    // The producer owns tail_ and the consumer owns head_; each lives on its own
+    // cache line next to a cached copy of the other side's index, so the other
+    // line is only read again when the queue looks full (or empty).
+    // The capacity is rounded up to a power of two.
+    template<class T, class Allocator = pretty_allocator::allocator<T>>
+    class spsc_queue {
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+
+        explicit spsc_queue(size_type capacity, const Allocator &alloc = Allocator()) :
+                allocator_(alloc), capacity_(detail::queue_capacity(capacity)), mask_(capacity_ - 1),
+                slots_(std::allocator_traits<Allocator>::allocate(allocator_, capacity_)) {}
+
+        spsc_queue(const spsc_queue &) = delete;
+
+        spsc_queue &operator=(const spsc_queue &) = delete;
+
+        ~spsc_queue() {
+            std::size_t tail = tail_.load(std::memory_order_acquire);
+            for (std::size_t i = head_.load(std::memory_order_relaxed); i != tail; ++i) {
+                std::allocator_traits<Allocator>::destroy(allocator_, slots_ + (i & mask_));
+            }
+            std::allocator_traits<Allocator>::deallocate(allocator_, slots_, capacity_);
+        }
+
+        size_type capacity() const { return static_cast<size_type>(capacity_); }
+
+        // exact from either thread's point of view only while the other is idle
+        size_type size_approx() const {
+            return static_cast<size_type>(tail_.load(std::memory_order_acquire) -
+                                          head_.load(std::memory_order_acquire));
+        }
+
+        // producer side
+        template<typename ...Args>
+        bool try_emplace(Args &&... args) {
+            std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - cached_head_ == capacity_) {
+                cached_head_ = head_.load(std::memory_order_acquire);
+                if (tail - cached_head_ == capacity_) {
+                    return false;
+                }
+            }
+            std::allocator_traits<Allocator>::construct(allocator_, slots_ + (tail & mask_),
+                                                        std::forward<Args>(args)...);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_push(const T &value) { return try_emplace(value); }
+
+        bool try_push(T &&value) { return try_emplace(std::move(value)); }
+
+        // Producer side: moves up to `count` elements out of `values` and
+        // publishes them with one store. Returns how many fitted.
+        size_type push_n(T *values, size_type count) {
+            std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (capacity_ - (tail - cached_head_) < count) {
+                cached_head_ = head_.load(std::memory_order_acquire);
+            }
+            size_type n = static_cast<size_type>(std::min<std::size_t>(count, capacity_ - (tail - cached_head_)));
+            size_type done = 0;
+            try {
+                for (; done < n; ++done) {
+                    std::allocator_traits<Allocator>::construct(allocator_, slots_ + ((tail + done) & mask_),
+                                                                std::move(values[done]));
+                }
+            } catch (...) {
+                tail_.store(tail + done, std::memory_order_release);
+                throw;
+            }
+            tail_.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        // consumer side
+        bool try_pop(T &out) {
+            std::size_t head = head_.load(std::memory_order_relaxed);
+            if (head == cached_tail_) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head == cached_tail_) {
+                    return false;
+                }
+            }
+            T *slot = slots_ + (head & mask_);
+            out = std::move(*slot);
+            std::allocator_traits<Allocator>::destroy(allocator_, slot);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side: moves up to `count` elements to `out` and frees their
+        // slots with one store. Returns how many were moved.
+        size_type pop_n(T *out, size_type count) {
+            std::size_t head = head_.load(std::memory_order_relaxed);
+            if (cached_tail_ - head < count) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+            }
+            size_type n = static_cast<size_type>(std::min<std::size_t>(count, cached_tail_ - head));
+            for (size_type i = 0; i < n; ++i) {
+                T *slot = slots_ + ((head + i) & mask_);
+                out[i] = std::move(*slot);
+                std::allocator_traits<Allocator>::destroy(allocator_, slot);
+            }
+            head_.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+    private:
+        alignas(detail::cache_line) std::atomic<std::size_t> head_{0};
+        std::size_t cached_tail_ = 0;
+        alignas(detail::cache_line) std::atomic<std::size_t> tail_{0};
+        std::size_t cached_head_ = 0;
+        alignas(detail::cache_line) Allocator allocator_;
+        std::size_t capacity_, mask_;
+        T *slots_;
+    };
+
+    // Bounded lock-free queue for any number of producers and consumers
+    // (Vyukov's array queue). Each cell carries a sequence number saying whether
+    // it is free or full for the current lap, so producers and consumers only
+    // contend on their own position counter. Those live on separate cache lines.
+    //
+    // A claimed cell must be filled, so values enter by nothrow move: try_push
+    // takes its argument by value (any copy happens before the claim).
+    template<class T, class Allocator = pretty_allocator::allocator<T>>
+    class mpmc_queue {
+        static_assert(std::is_nothrow_move_constructible<T>::value && std::is_nothrow_move_assignable<T>::value,
+                      "mpmc_queue moves elements in and out of claimed cells, T must move without throwing");
+
+        struct cell {
+            std::atomic<std::size_t> sequence;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+            T *value() { return reinterpret_cast<T *>(&storage); }
+        };
+
+        using cell_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<cell>;
+
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+
+        explicit mpmc_queue(size_type capacity, const Allocator &alloc = Allocator()) :
+                allocator_(alloc), capacity_(detail::queue_capacity(capacity)), mask_(capacity_ - 1),
+                cells_(std::allocator_traits<cell_allocator>::allocate(allocator_, capacity_)) {
+            for (std::size_t i = 0; i < capacity_; ++i) {
+                ::new(static_cast<void *>(cells_ + i)) cell();
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        mpmc_queue(const mpmc_queue &) = delete;
+
+        mpmc_queue &operator=(const mpmc_queue &) = delete;
+
+        ~mpmc_queue() {
+            std::size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+            for (std::size_t i = dequeue_pos_.load(std::memory_order_acquire); i != tail; ++i) {
+                cells_[i & mask_].value()->~T();
+            }
+            for (std::size_t i = 0; i < capacity_; ++i) {
+                cells_[i].~cell();
+            }
+            std::allocator_traits<cell_allocator>::deallocate(allocator_, cells_, capacity_);
+        }
+
+        size_type capacity() const { return static_cast<size_type>(capacity_); }
+
+        size_type size_approx() const {
+            std::size_t head = dequeue_pos_.load(std::memory_order_acquire);
+            std::size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+            return tail > head ? static_cast<size_type>(tail - head) : 0;
+        }
+
+        bool try_push(T value) {
+            std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+            cell *target;
+            for (;;) {
+                target = &cells_[pos & mask_];
+                std::intptr_t diff = static_cast<std::intptr_t>(target->sequence.load(std::memory_order_acquire)) -
+                                     static_cast<std::intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+            ::new(static_cast<void *>(target->value())) T(std::move(value));
+            target->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T &out) {
+            std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+            cell *source;
+            for (;;) {
+                source = &cells_[pos & mask_];
+                std::intptr_t diff = static_cast<std::intptr_t>(source->sequence.load(std::memory_order_acquire)) -
+                                     static_cast<std::intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+            take(source, out);
+            source->sequence.store(pos + capacity_, std::memory_order_release);
+            return true;
+        }
+
+        // Moves up to `count` values from `values` into consecutive cells claimed
+        // with a single CAS and returns how many went in. Only cells already free
+        // for this lap are claimed: a cell can only be refilled by whoever wins
+        // the position counter, so checking them before the CAS is enough.
+        size_type push_n(T *values, size_type count) {
+            std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+            size_type n;
+            for (;;) {
+                n = 0;
+                while (n < count && cells_[(pos + n) & mask_].sequence.load(std::memory_order_acquire) == pos + n) {
+                    ++n;
+                }
+                if (n == 0) {
+                    std::intptr_t diff = static_cast<std::intptr_t>(
+                            cells_[pos & mask_].sequence.load(std::memory_order_acquire)) -
+                                         static_cast<std::intptr_t>(pos);
+                    if (diff < 0 || count == 0) {
+                        return 0;
+                    }
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                } else if (enqueue_pos_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            for (size_type i = 0; i < n; ++i) {
+                cell &target = cells_[(pos + i) & mask_];
+                ::new(static_cast<void *>(target.value())) T(std::move(values[i]));
+                target.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            return n;
+        }
+
+        // moves up to `count` values into `out` from cells claimed with a single
+        // CAS and returns how many were taken
+        size_type pop_n(T *out, size_type count) {
+            std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+            size_type n;
+            for (;;) {
+                n = 0;
+                while (n < count &&
+                       cells_[(pos + n) & mask_].sequence.load(std::memory_order_acquire) == pos + n + 1) {
+                    ++n;
+                }
+                if (n == 0) {
+                    std::intptr_t diff = static_cast<std::intptr_t>(
+                            cells_[pos & mask_].sequence.load(std::memory_order_acquire)) -
+                                         static_cast<std::intptr_t>(pos + 1);
+                    if (diff < 0 || count == 0) {
+                        return 0;
+                    }
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                } else if (dequeue_pos_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            for (size_type i = 0; i < n; ++i) {
+                cell &source = cells_[(pos + i) & mask_];
+                take(&source, out[i]);
+                source.sequence.store(pos + i + capacity_, std::memory_order_release);
+            }
+            return n;
+        }
+
+    private:
+        alignas(detail::cache_line) std::atomic<std::size_t> enqueue_pos_{0};
+        alignas(detail::cache_line) std::atomic<std::size_t> dequeue_pos_{0};
+        alignas(detail::cache_line) cell_allocator allocator_;
+        std::size_t capacity_, mask_;
+        cell *cells_;
+
+        static void take(cell *source, T &out) {
+            T *value = source->value();
+            out = std::move(*value);
+            value->~T();
+        }
+    };
+}
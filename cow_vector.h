@@ -0,0 +1,214 @@
+#pragma once
+#include <atomic>
+#include <stdexcept>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // Copy-on-write vector: copies share one reference-counted block holding a
+    // pretty_vector::vector, so taking a snapshot is an atomic increment and no
+    // allocation. The first mutation through a shared copy clones the elements;
+    // later mutations of the now unique copy go straight to the block.
+    //
+    // Reads are const-only on purpose: a non-const operator[] would have to clone
+    // on every access through a non-const object. Writes go through the explicit
+    // mutable_at/mutable_data/set and the usual modifiers.
+    template<class T, class Allocator = std::allocator<T>>
+    class cow_vector {
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+        using const_reference = const T &;
+        using storage_type = vector<T, Allocator>;
+        using const_iterator = typename storage_type::const_iterator;
+
+        explicit cow_vector(const Allocator &alloc = Allocator()) : allocator_(alloc), block_(nullptr) {}
+
+        cow_vector(std::initializer_list<T> init, const Allocator &alloc = Allocator()) : cow_vector(alloc) {
+            storage_type &items = unique_storage();
+            items.reserve(static_cast<size_type>(init.size()));
+            for (const T &value : init) {
+                items.push_back(value);
+            }
+        }
+
+        explicit cow_vector(storage_type items, const Allocator &alloc = Allocator()) : cow_vector(alloc) {
+            unique_storage() = std::move(items);
+        }
+
+        cow_vector(const cow_vector &other) noexcept : allocator_(other.allocator_), block_(other.block_) {
+            if (block_) {
+                block_->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        cow_vector(cow_vector &&other) noexcept : allocator_(std::move(other.allocator_)), block_(other.block_) {
+            other.block_ = nullptr;
+        }
+
+        cow_vector &operator=(const cow_vector &other) noexcept {
+            cow_vector copy(other);
+            swap(copy);
+            return *this;
+        }
+
+        cow_vector &operator=(cow_vector &&other) noexcept {
+            if (this != &other) {
+                release();
+                allocator_ = std::move(other.allocator_);
+                block_ = other.block_;
+                other.block_ = nullptr;
+            }
+            return *this;
+        }
+
+        ~cow_vector() {
+            release();
+        }
+
+        size_type size() const { return block_ ? block_->items.size() : 0; }
+
+        bool empty() const { return size() == 0; }
+
+        size_type capacity() const { return block_ ? block_->items.capacity() : 0; }
+
+        // number of cow_vectors sharing the block, 0 when there is none
+        size_type use_count() const { return block_ ? block_->refs.load(std::memory_order_acquire) : 0; }
+
+        bool shares_with(const cow_vector &other) const { return block_ && block_ == other.block_; }
+
+        const T *data() const { return block_ ? block_->items.data() : nullptr; }
+
+        const_reference operator[](size_type pos) const { return block_->items.data()[pos]; }
+
+        const_reference at(size_type pos) const {
+            if (pos >= size()) {
+                throw std::out_of_range("Index out of cow_vector range");
+            }
+            return (*this)[pos];
+        }
+
+        const_reference front() const { return at(0); }
+
+        const_reference back() const { return at(size() - 1); }
+
+        const_iterator begin() const { return items().begin(); }
+
+        const_iterator end() const { return items().end(); }
+
+        // read-only view of the shared elements
+        const storage_type &items() const {
+            static const storage_type empty_items;
+            return block_ ? block_->items : empty_items;
+        }
+
+        // writers: each one makes the storage unique first
+        T &mutable_at(size_type pos) {
+            if (pos >= size()) {
+                throw std::out_of_range("Index out of cow_vector range");
+            }
+            return unique_storage().data()[pos];
+        }
+
+        T *mutable_data() { return unique_storage().data(); }
+
+        void set(size_type pos, const T &value) { mutable_at(pos) = value; }
+
+        // the unique underlying vector, for bulk edits
+        storage_type &edit() { return unique_storage(); }
+
+        template<typename ...Args>
+        void emplace_back(Args &&... args) {
+            unique_storage().emplace_back(std::forward<Args>(args)...);
+        }
+
+        void push_back(const T &value) { emplace_back(value); }
+
+        void push_back(T &&value) { emplace_back(std::move(value)); }
+
+        void pop_back() {
+            if (!empty()) {
+                unique_storage().pop_back();
+            }
+        }
+
+        void reserve(size_type size) {
+            if (size > capacity()) {
+                unique_storage().reserve(size);
+            }
+        }
+
+        void resize(size_type count) { unique_storage().resize(count); }
+
+        // drops this reference only; other snapshots keep the elements
+        void clear() { release(); }
+
+        void swap(cow_vector &other) noexcept {
+            std::swap(allocator_, other.allocator_);
+            std::swap(block_, other.block_);
+        }
+
+        friend void swap(cow_vector &lhs, cow_vector &rhs) noexcept {
+            lhs.swap(rhs);
+        }
+
+        friend bool operator==(const cow_vector &lhs, const cow_vector &rhs) {
+            return lhs.block_ == rhs.block_ || lhs.items() == rhs.items();
+        }
+
+        friend bool operator!=(const cow_vector &lhs, const cow_vector &rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        struct block {
+            template<typename ...Args>
+            explicit block(Args &&... args) : refs(1), items(std::forward<Args>(args)...) {}
+
+            std::atomic<size_type> refs;
+            storage_type items;
+        };
+
+        using block_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<block>;
+
+        Allocator allocator_;
+        block *block_;
+
+        template<typename ...Args>
+        block *make_block(Args &&... args) {
+            block_allocator alloc(allocator_);
+            block *result = std::allocator_traits<block_allocator>::allocate(alloc, 1);
+            try {
+                ::new(static_cast<void *>(result)) block(std::forward<Args>(args)...);
+            } catch (...) {
+                std::allocator_traits<block_allocator>::deallocate(alloc, result, 1);
+                throw;
+            }
+            return result;
+        }
+
+        // The acquire in the count check pairs with the release in release(), so
+        // a writer that sees itself as the only owner also sees every other
+        // owner's reads finished.
+        storage_type &unique_storage() {
+            if (!block_) {
+                block_ = make_block(allocator_);
+            } else if (block_->refs.load(std::memory_order_acquire) != 1) {
+                block *copy = make_block(block_->items);
+                release();
+                block_ = copy;
+            }
+            return block_->items;
+        }
+
+        void release() noexcept {
+            if (block_ && block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                block_allocator alloc(allocator_);
+                block_->~block();
+                std::allocator_traits<block_allocator>::deallocate(alloc, block_, 1);
+            }
+            block_ = nullptr;
+        }
+    };
+}
@@ -0,0 +1,417 @@
+#pragma once
+#include <algorithm>
+#include <stdexcept>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // Contiguous vector with spare capacity at both ends: elements live in
+    // data_[begin_, begin_ + size_). push_front/pop_front are amortized O(1),
+    // insert/erase shift whichever side of the position is shorter, and data()
+    // is still one contiguous block.
+    template<class T, class Allocator = std::allocator<T>>
+    class devector {
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+        using reference = T &;
+        using const_reference = const T &;
+        using pointer = typename std::allocator_traits<Allocator>::pointer;
+        using const_pointer = typename std::allocator_traits<Allocator>::const_pointer;
+        using iterator = T *;
+        using const_iterator = const T *;
+        float resize_coefficient = 1.5;
+
+        explicit devector(const Allocator &alloc = Allocator()) :
+                allocator_(alloc), data_(nullptr), capacity_(0), begin_(0), size_(0) {}
+
+        explicit devector(size_type count, const T &value = T(), const Allocator &alloc = Allocator()) :
+                devector(alloc) {
+            reserve(count);
+            while (size_ < count) {
+                emplace_back(value);
+            }
+        }
+
+        devector(std::initializer_list<T> init, const Allocator &alloc = Allocator()) : devector(alloc) {
+            reserve(static_cast<size_type>(init.size()));
+            for (const T &value : init) {
+                emplace_back(value);
+            }
+        }
+
+        devector(const devector &other) :
+                devector(std::allocator_traits<Allocator>::select_on_container_copy_construction(other.allocator_)) {
+            reserve(other.size_);
+            for (const T &value : other) {
+                emplace_back(value);
+            }
+        }
+
+        devector(devector &&other) noexcept :
+                allocator_(std::move(other.allocator_)), data_(other.data_), capacity_(other.capacity_),
+                begin_(other.begin_), size_(other.size_) {
+            other.data_ = nullptr;
+            other.capacity_ = other.begin_ = other.size_ = 0;
+        }
+
+        devector &operator=(const devector &other) {
+            if (this != &other) {
+                devector copy(other);
+                swap(copy);
+            }
+            return *this;
+        }
+
+        devector &operator=(devector &&other) noexcept {
+            if (this != &other) {
+                devector moved(std::move(other));
+                swap(moved);
+            }
+            return *this;
+        }
+
+        ~devector() {
+            clear();
+            if (data_) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, data_, capacity_);
+            }
+        }
+
+        size_type size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        size_type capacity() const { return capacity_; }
+
+        size_type front_free_capacity() const { return begin_; }
+
+        size_type back_free_capacity() const { return capacity_ - begin_ - size_; }
+
+        T *data() { return data_ + begin_; }
+
+        const T *data() const { return data_ + begin_; }
+
+        reference operator[](size_type pos) { return data()[pos]; }
+
+        const_reference operator[](size_type pos) const { return data()[pos]; }
+
+        reference at(size_type pos) {
+            check_range(pos);
+            return data()[pos];
+        }
+
+        const_reference at(size_type pos) const {
+            check_range(pos);
+            return data()[pos];
+        }
+
+        reference front() { return at(0); }
+
+        const_reference front() const { return at(0); }
+
+        reference back() { return at(size_ - 1); }
+
+        const_reference back() const { return at(size_ - 1); }
+
+        iterator begin() { return data(); }
+
+        iterator end() { return data() + size_; }
+
+        const_iterator begin() const { return data(); }
+
+        const_iterator end() const { return data() + size_; }
+
+        // room to push_back until size() == size, like vector::reserve
+        void reserve(size_type size) {
+            reserve_back(size);
+        }
+
+        void reserve_back(size_type size) {
+            if (capacity_ - begin_ < size) {
+                reallocate(begin_ + size, begin_);
+            }
+        }
+
+        // room to push_front until size() == size
+        void reserve_front(size_type size) {
+            if (begin_ + size_ < size) {
+                reallocate(size + back_free_capacity(), size - size_);
+            }
+        }
+
+        void shrink_to_fit() {
+            if (size_ == capacity_) {
+                return;
+            }
+            if (size_ == 0) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, data_, capacity_);
+                data_ = nullptr;
+                capacity_ = begin_ = 0;
+                return;
+            }
+            reallocate(size_, 0);
+        }
+
+        void clear() {
+            for (size_type i = 0; i < size_; ++i) {
+                std::allocator_traits<Allocator>::destroy(allocator_, data() + i);
+            }
+            size_ = 0;
+            begin_ = capacity_ / 2;
+        }
+
+        template<typename ...Args>
+        reference emplace_back(Args &&... args) {
+            if (back_free_capacity() == 0) {
+                T value(std::forward<Args>(args)...);
+                make_room_back();
+                construct_at(begin_ + size_, std::move(value));
+            } else {
+                construct_at(begin_ + size_, std::forward<Args>(args)...);
+            }
+            return data()[size_++];
+        }
+
+        template<typename ...Args>
+        reference emplace_front(Args &&... args) {
+            if (front_free_capacity() == 0) {
+                T value(std::forward<Args>(args)...);
+                make_room_front();
+                reference result = construct_at(begin_ - 1, std::move(value));
+                --begin_;
+                ++size_;
+                return result;
+            }
+            reference result = construct_at(begin_ - 1, std::forward<Args>(args)...);
+            --begin_;
+            ++size_;
+            return result;
+        }
+
+        void push_back(const T &value) { emplace_back(value); }
+
+        void push_back(T &&value) { emplace_back(std::move(value)); }
+
+        void push_front(const T &value) { emplace_front(value); }
+
+        void push_front(T &&value) { emplace_front(std::move(value)); }
+
+        void pop_back() {
+            if (size_ > 0) {
+                --size_;
+                std::allocator_traits<Allocator>::destroy(allocator_, data() + size_);
+            }
+        }
+
+        void pop_front() {
+            if (size_ > 0) {
+                std::allocator_traits<Allocator>::destroy(allocator_, data());
+                ++begin_;
+                --size_;
+            }
+        }
+
+        template<typename ...Args>
+        iterator emplace(const_iterator position, Args &&... args) {
+            size_type index = static_cast<size_type>(position - begin());
+            if (index == size_) {
+                emplace_back(std::forward<Args>(args)...);
+                return begin() + index;
+            }
+            if (index == 0) {
+                emplace_front(std::forward<Args>(args)...);
+                return begin();
+            }
+
+            T value(std::forward<Args>(args)...);
+            if (index < size_ / 2) {
+                if (front_free_capacity() == 0) {
+                    make_room_front();
+                }
+                // shift [0, index) one slot towards the front
+                relocate_one(data() - 1, data(), index, true);
+                --begin_;
+            } else {
+                if (back_free_capacity() == 0) {
+                    make_room_back();
+                }
+                relocate_one(data() + index + 1, data() + index, size_ - index, false);
+            }
+            construct_at(begin_ + index, std::move(value));
+            ++size_;
+            return begin() + index;
+        }
+
+        iterator insert(const_iterator position, const T &value) {
+            return emplace(position, value);
+        }
+
+        iterator insert(const_iterator position, T &&value) {
+            return emplace(position, std::move(value));
+        }
+
+        iterator erase(const_iterator position) {
+            size_type index = static_cast<size_type>(position - begin());
+            std::allocator_traits<Allocator>::destroy(allocator_, data() + index);
+            if (index < size_ / 2) {
+                // close the gap from the front
+                relocate_one(data() + 1, data(), index, false);
+                ++begin_;
+            } else {
+                relocate_one(data() + index, data() + index + 1, size_ - index - 1, true);
+            }
+            --size_;
+            return begin() + index;
+        }
+
+        void resize(size_type count) {
+            while (size_ > count) {
+                pop_back();
+            }
+            reserve_back(count);
+            while (size_ < count) {
+                emplace_back();
+            }
+        }
+
+        void swap(devector &other) noexcept {
+            if (std::allocator_traits<Allocator>::propagate_on_container_swap::value) {
+                std::swap(allocator_, other.allocator_);
+            }
+            std::swap(data_, other.data_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(begin_, other.begin_);
+            std::swap(size_, other.size_);
+        }
+
+        friend void swap(devector &lhs, devector &rhs) noexcept {
+            lhs.swap(rhs);
+        }
+
+        friend bool operator==(const devector &lhs, const devector &rhs) {
+            return lhs.size_ == rhs.size_ && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+        }
+
+        friend bool operator!=(const devector &lhs, const devector &rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        static constexpr bool bitwise_relocatable = is_bitwise_relocatable<T, Allocator>::value;
+        static constexpr bool nothrow_relocatable =
+                bitwise_relocatable || std::is_nothrow_move_constructible<T>::value;
+
+        Allocator allocator_;
+        pointer data_;
+        size_type capacity_, begin_, size_;
+
+        template<typename ...Args>
+        reference construct_at(size_type slot, Args &&... args) {
+            std::allocator_traits<Allocator>::construct(allocator_, data_ + slot, std::forward<Args>(args)...);
+            return data_[slot];
+        }
+
+        // moves `count` elements from `from` to the overlapping range at `to`,
+        // walking forwards when `ascending` (to < from) and backwards otherwise
+        void relocate_one(T *to, T *from, size_type count, bool ascending) {
+            if (count == 0) {
+                return;
+            }
+            if constexpr (bitwise_relocatable) {
+                std::memmove(static_cast<void *>(to), static_cast<const void *>(from), count * sizeof(T));
+            } else if (ascending) {
+                for (size_type i = 0; i < count; ++i) {
+                    std::allocator_traits<Allocator>::construct(allocator_, to + i, std::move(from[i]));
+                    std::allocator_traits<Allocator>::destroy(allocator_, from + i);
+                }
+            } else {
+                for (size_type i = count; i-- > 0;) {
+                    std::allocator_traits<Allocator>::construct(allocator_, to + i, std::move(from[i]));
+                    std::allocator_traits<Allocator>::destroy(allocator_, from + i);
+                }
+            }
+        }
+
+        size_type grown_capacity() const {
+            size_type grown = static_cast<size_type>(ceil(std::max(capacity_, size_ + 1) * resize_coefficient));
+            return std::max<size_type>(grown, 4);
+        }
+
+        // Front (or back) is full. If the buffer is less than half used the elements
+        // are re-centred, which leaves at least a quarter of the capacity free at
+        // that end; otherwise the buffer grows. Either way the cost is amortized
+        // over the pushes that filled the end, and a fixed-size window that slides
+        // (push_back + pop_front) stops growing the buffer once it fills less
+        // than half of it.
+        void make_room_front() {
+            if (size_ < capacity_ / 2) {
+                recentre(capacity_ - size_ - (capacity_ - size_) / 2);
+            } else {
+                size_type new_capacity = grown_capacity();
+                reallocate(new_capacity, new_capacity - size_ - (new_capacity - size_) / 2);
+            }
+        }
+
+        void make_room_back() {
+            if (size_ < capacity_ / 2) {
+                recentre((capacity_ - size_) / 2);
+            } else {
+                size_type new_capacity = grown_capacity();
+                reallocate(new_capacity, (new_capacity - size_) / 2);
+            }
+        }
+
+        void recentre(size_type new_begin) {
+            if constexpr (nothrow_relocatable) {
+                relocate_one(data_ + new_begin, data(), size_, new_begin < begin_);
+                begin_ = new_begin;
+            } else {
+                // a throwing move could strand elements half-way, copy into a fresh block instead
+                reallocate(capacity_, new_begin);
+            }
+        }
+
+        // moves the elements into a new block of `new_capacity`, starting at `new_begin`;
+        // throwing moves are replaced by copies so a failure leaves *this unchanged
+        void reallocate(size_type new_capacity, size_type new_begin) {
+            pointer new_data = std::allocator_traits<Allocator>::allocate(allocator_, new_capacity);
+            if constexpr (bitwise_relocatable) {
+                if (size_ > 0) {
+                    std::memcpy(static_cast<void *>(new_data + new_begin), static_cast<const void *>(data()),
+                                size_ * sizeof(T));
+                }
+            } else {
+                size_type i = 0;
+                try {
+                    for (; i < size_; ++i) {
+                        std::allocator_traits<Allocator>::construct(allocator_, new_data + new_begin + i,
+                                                                    std::move_if_noexcept(data()[i]));
+                    }
+                } catch (...) {
+                    for (size_type j = 0; j < i; ++j) {
+                        std::allocator_traits<Allocator>::destroy(allocator_, new_data + new_begin + j);
+                    }
+                    std::allocator_traits<Allocator>::deallocate(allocator_, new_data, new_capacity);
+                    throw;
+                }
+                for (i = 0; i < size_; ++i) {
+                    std::allocator_traits<Allocator>::destroy(allocator_, data() + i);
+                }
+            }
+            if (data_) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, data_, capacity_);
+            }
+            data_ = new_data;
+            capacity_ = new_capacity;
+            begin_ = new_begin;
+        }
+
+        void check_range(size_type pos) const {
+            if (pos >= size_) {
+                throw std::out_of_range("Index out of devector range");
+            }
+        }
+    };
+}
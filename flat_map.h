@@ -0,0 +1,567 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // Branchless lower_bound over a sorted array: the loop body is a compare and
+    // a conditional add, which compiles to cmov instead of a mispredicted branch.
+    template<class K, class Key, class Compare>
+    unsigned int branchless_lower_bound(const K *keys, unsigned int size, const Key &key, Compare comp) {
+        if (size == 0) {
+            return 0;
+        }
+        const K *base = keys;
+        while (size > 1) {
+            unsigned int half = size / 2;
+            base += comp(base[half], key) ? half : 0;
+            size -= half;
+        }
+        return static_cast<unsigned int>(base - keys) + (comp(*base, key) ? 1 : 0);
+    }
+
+    // Copy of a sorted key array in Eytzinger (breadth-first) order, slot 1 being
+    // the root and slots 2k, 2k + 1 the children of k. A search walks one root to
+    // leaf path, the first levels share a few cache lines and deeper levels are
+    // prefetched ahead, which beats binary search once the keys outgrow the cache.
+    // ranks_[k] maps a slot back to its position in the sorted array.
+    template<class K, class Compare>
+    class eytzinger_index {
+    public:
+        using size_type = unsigned int;
+
+        bool valid() const { return valid_; }
+
+        void invalidate() { valid_ = false; }
+
+        void build(const K *sorted, size_type size) {
+            keys_.clear();
+            ranks_.clear();
+            valid_ = false;
+            if (size == 0) {
+                valid_ = true;
+                return;
+            }
+            ranks_.resize(size + 1);
+            size_type next = 0;
+            assign_ranks(1, size, next);
+            keys_.reserve(size + 1);
+            keys_.push_back(sorted[0]);
+            for (size_type k = 1; k <= size; ++k) {
+                keys_.push_back(sorted[ranks_[k]]);
+            }
+            valid_ = true;
+        }
+
+        // position of the first sorted key not less than `key`, or the size
+        template<class Key>
+        size_type lower_bound(const Key &key, Compare comp) const {
+            size_type k = search(key, comp);
+            return k == 0 ? size() : ranks_.data()[k];
+        }
+
+        // membership only needs the node the search stopped at, not its rank
+        template<class Key>
+        bool contains(const Key &key, Compare comp) const {
+            size_type k = search(key, comp);
+            return k != 0 && !comp(key, keys_.data()[k]);
+        }
+
+    private:
+        // with 64-byte aligned storage, the descendants of k a few levels down
+        // (slots k * prefetch_stride onwards) share one cache line
+        static constexpr size_type prefetch_stride = 64 / sizeof(K) >= 2 ? 64 / sizeof(K) : 2;
+
+        vector<K, pretty_allocator::allocator<K, 64>> keys_;
+        vector<size_type> ranks_;
+        bool valid_ = false;
+
+        size_type size() const { return ranks_.size() == 0 ? 0 : ranks_.size() - 1; }
+
+        // slot of the first key not less than `key`, 0 when there is none
+        template<class Key>
+        size_type search(const Key &key, Compare comp) const {
+            size_type size = this->size();
+            const K *keys = keys_.data();
+            size_type k = 1;
+            while (k <= size) {
+                __builtin_prefetch(keys + std::min(k * prefetch_stride, size));
+                k = 2 * k + (comp(keys[k], key) ? 1 : 0);
+            }
+            // drop the trailing right turns and the last left turn to get back
+            // to the last node where the search went left
+            return k >> __builtin_ffs(~k);
+        }
+
+        void assign_ranks(size_type k, size_type size, size_type &next) {
+            if (k <= size) {
+                assign_ranks(2 * k, size, next);
+                ranks_[k] = next++;
+                assign_ranks(2 * k + 1, size, next);
+            }
+        }
+    };
+
+    // Sorted set of unique keys in one pretty_vector::vector. Lookups use a
+    // branchless binary search, or the Eytzinger index once build_index() has
+    // been called; any mutation drops the index until it is built again.
+    template<class Key, class Compare = std::less<Key>, class Allocator = std::allocator<Key>>
+    class flat_set {
+    public:
+        using key_type = Key;
+        using value_type = Key;
+        using size_type = unsigned int;
+        using key_compare = Compare;
+        using iterator = typename vector<Key, Allocator>::const_iterator;
+        using const_iterator = iterator;
+
+        explicit flat_set(const Compare &comp = Compare()) : comp_(comp) {}
+
+        // bulk construction: sort once, drop duplicates (the first one wins)
+        template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+        flat_set(InputIt first, InputIt last, const Compare &comp = Compare()) : comp_(comp) {
+            for (; first != last; ++first) {
+                keys_.push_back(*first);
+            }
+            Key *begin = keys_.data(), *end = keys_.data() + keys_.size();
+            std::stable_sort(begin, end, comp_);
+            Key *unique_end = std::unique(begin, end, [this](const Key &a, const Key &b) { return !comp_(a, b); });
+            while (keys_.size() > static_cast<size_type>(unique_end - begin)) {
+                keys_.pop_back();
+            }
+        }
+
+        flat_set(std::initializer_list<Key> init, const Compare &comp = Compare()) :
+                flat_set(init.begin(), init.end(), comp) {}
+
+        size_type size() const { return keys_.size(); }
+
+        bool empty() const { return keys_.size() == 0; }
+
+        void reserve(size_type size) { keys_.reserve(size); }
+
+        void clear() {
+            keys_.clear();
+            index_.invalidate();
+        }
+
+        const vector<Key, Allocator> &keys() const { return keys_; }
+
+        const_iterator begin() const { return keys_.begin(); }
+
+        const_iterator end() const { return keys_.end(); }
+
+        const Key &operator[](size_type pos) const { return keys_.data()[pos]; }
+
+        void build_index() { index_.build(keys_.data(), keys_.size()); }
+
+        bool index_valid() const { return index_.valid(); }
+
+        size_type lower_bound_index(const Key &key) const {
+            if (index_.valid()) {
+                return index_.lower_bound(key, comp_);
+            }
+            return branchless_lower_bound(keys_.data(), keys_.size(), key, comp_);
+        }
+
+        const_iterator lower_bound(const Key &key) const { return begin() + lower_bound_index(key); }
+
+        const_iterator find(const Key &key) const {
+            size_type pos = lower_bound_index(key);
+            return matches(pos, key) ? begin() + pos : end();
+        }
+
+        bool contains(const Key &key) const {
+            if (index_.valid()) {
+                return index_.contains(key, comp_);
+            }
+            return matches(lower_bound_index(key), key);
+        }
+
+        size_type count(const Key &key) const { return contains(key) ? 1 : 0; }
+
+        std::pair<const_iterator, bool> insert(const Key &key) {
+            size_type pos = lower_bound_index(key);
+            if (matches(pos, key)) {
+                return std::make_pair(begin() + pos, false);
+            }
+            keys_.emplace(keys_.begin() + pos, key);
+            index_.invalidate();
+            return std::make_pair(begin() + pos, true);
+        }
+
+        // batched insertion: the new keys are sorted on their own and merged
+        // with the existing ones in a single linear pass. Existing keys are
+        // moved over as in vector growth (copied only when their move may
+        // throw and a copy exists).
+        template<class InputIt>
+        void insert(InputIt first, InputIt last) {
+            flat_set incoming(first, last, comp_);
+            vector<Key, Allocator> merged(keys_.get_allocator());
+            merged.reserve(keys_.size() + incoming.size());
+            Key *a = keys_.data(), *a_end = a + keys_.size();
+            Key *b = incoming.keys_.data(), *b_end = b + incoming.keys_.size();
+            while (a != a_end && b != b_end) {
+                if (comp_(*b, *a)) {
+                    merged.push_back(std::move(*b++));
+                } else {
+                    if (!comp_(*a, *b)) {
+                        ++b;
+                    }
+                    merged.push_back(std::move_if_noexcept(*a++));
+                }
+            }
+            for (; a != a_end; ++a) {
+                merged.push_back(std::move_if_noexcept(*a));
+            }
+            for (; b != b_end; ++b) {
+                merged.push_back(std::move(*b));
+            }
+            keys_.swap(merged);
+            index_.invalidate();
+        }
+
+        size_type erase(const Key &key) {
+            size_type pos = lower_bound_index(key);
+            if (!matches(pos, key)) {
+                return 0;
+            }
+            keys_.erase(keys_.begin() + pos);
+            index_.invalidate();
+            return 1;
+        }
+
+        void swap(flat_set &other) noexcept {
+            keys_.swap(other.keys_);
+            std::swap(comp_, other.comp_);
+            std::swap(index_, other.index_);
+        }
+
+    private:
+        vector<Key, Allocator> keys_;
+        Compare comp_;
+        eytzinger_index<Key, Compare> index_;
+
+        bool matches(size_type pos, const Key &key) const {
+            return pos < keys_.size() && !comp_(key, keys_.data()[pos]);
+        }
+    };
+
+    // Sorted map with the keys and the mapped values in two parallel vectors, so
+    // searches only touch key memory. Iterators yield pair<const Key &, T &>.
+    // Lookups work as in flat_set, including the optional Eytzinger index.
+    template<class Key, class T, class Compare = std::less<Key>,
+            class KeyAllocator = std::allocator<Key>, class MappedAllocator = std::allocator<T>>
+    class flat_map {
+    public:
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<Key, T>;
+        using size_type = unsigned int;
+        using key_compare = Compare;
+
+        template<bool Const>
+        class basic_iterator {
+            using owner = typename std::conditional<Const, const flat_map, flat_map>::type;
+            using mapped_reference = typename std::conditional<Const, const T &, T &>::type;
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = flat_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = std::pair<const Key &, mapped_reference>;
+
+            struct pointer {
+                reference ref;
+
+                const reference *operator->() const { return &ref; }
+            };
+
+            basic_iterator() : container_(nullptr), index_(0) {}
+
+            basic_iterator(owner *container, size_type index) : container_(container), index_(index) {}
+
+            template<bool C, class = typename std::enable_if<Const && !C>::type>
+            basic_iterator(const basic_iterator<C> &other) : container_(other.container_), index_(other.index_) {}
+
+            reference operator*() const {
+                return reference(container_->keys_.data()[index_], container_->values_.data()[index_]);
+            }
+
+            pointer operator->() const { return pointer{**this}; }
+
+            reference operator[](difference_type n) const { return *(*this + n); }
+
+            basic_iterator &operator++() {
+                ++index_;
+                return *this;
+            }
+
+            basic_iterator operator++(int) { return basic_iterator(container_, index_++); }
+
+            basic_iterator &operator--() {
+                --index_;
+                return *this;
+            }
+
+            basic_iterator operator--(int) { return basic_iterator(container_, index_--); }
+
+            basic_iterator &operator+=(difference_type n) {
+                index_ += n;
+                return *this;
+            }
+
+            basic_iterator &operator-=(difference_type n) {
+                index_ -= n;
+                return *this;
+            }
+
+            basic_iterator operator+(difference_type n) const { return basic_iterator(container_, index_ + n); }
+
+            basic_iterator operator-(difference_type n) const { return basic_iterator(container_, index_ - n); }
+
+            difference_type operator-(const basic_iterator &other) const {
+                return difference_type(index_) - difference_type(other.index_);
+            }
+
+            bool operator==(const basic_iterator &other) const { return index_ == other.index_; }
+
+            bool operator!=(const basic_iterator &other) const { return index_ != other.index_; }
+
+            bool operator<(const basic_iterator &other) const { return index_ < other.index_; }
+
+            size_type index() const { return index_; }
+
+        private:
+            template<bool>
+            friend class basic_iterator;
+
+            owner *container_;
+            size_type index_;
+        };
+
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        explicit flat_map(const Compare &comp = Compare()) : comp_(comp) {}
+
+        // bulk construction: sort once, drop duplicate keys (the first one wins)
+        template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+        flat_map(InputIt first, InputIt last, const Compare &comp = Compare()) : comp_(comp) {
+            vector<value_type> items;
+            for (; first != last; ++first) {
+                items.push_back(*first);
+            }
+            value_type *begin = items.data(), *end = items.data() + items.size();
+            std::stable_sort(begin, end, [this](const value_type &a, const value_type &b) {
+                return comp_(a.first, b.first);
+            });
+            value_type *unique_end = std::unique(begin, end, [this](const value_type &a, const value_type &b) {
+                return !comp_(a.first, b.first);
+            });
+            keys_.reserve(static_cast<size_type>(unique_end - begin));
+            values_.reserve(static_cast<size_type>(unique_end - begin));
+            for (value_type *item = begin; item != unique_end; ++item) {
+                keys_.push_back(std::move(item->first));
+                values_.push_back(std::move(item->second));
+            }
+        }
+
+        flat_map(std::initializer_list<value_type> init, const Compare &comp = Compare()) :
+                flat_map(init.begin(), init.end(), comp) {}
+
+        size_type size() const { return keys_.size(); }
+
+        bool empty() const { return keys_.size() == 0; }
+
+        void reserve(size_type size) {
+            keys_.reserve(size);
+            values_.reserve(size);
+        }
+
+        void clear() {
+            keys_.clear();
+            values_.clear();
+            index_.invalidate();
+        }
+
+        const vector<Key, KeyAllocator> &keys() const { return keys_; }
+
+        const vector<T, MappedAllocator> &values() const { return values_; }
+
+        iterator begin() { return iterator(this, 0); }
+
+        iterator end() { return iterator(this, size()); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+
+        const_iterator end() const { return const_iterator(this, size()); }
+
+        void build_index() { index_.build(keys_.data(), keys_.size()); }
+
+        bool index_valid() const { return index_.valid(); }
+
+        size_type lower_bound_index(const Key &key) const {
+            if (index_.valid()) {
+                return index_.lower_bound(key, comp_);
+            }
+            return branchless_lower_bound(keys_.data(), keys_.size(), key, comp_);
+        }
+
+        iterator lower_bound(const Key &key) { return iterator(this, lower_bound_index(key)); }
+
+        const_iterator lower_bound(const Key &key) const { return const_iterator(this, lower_bound_index(key)); }
+
+        iterator find(const Key &key) {
+            size_type pos = lower_bound_index(key);
+            return matches(pos, key) ? iterator(this, pos) : end();
+        }
+
+        const_iterator find(const Key &key) const {
+            size_type pos = lower_bound_index(key);
+            return matches(pos, key) ? const_iterator(this, pos) : end();
+        }
+
+        bool contains(const Key &key) const {
+            if (index_.valid()) {
+                return index_.contains(key, comp_);
+            }
+            return matches(lower_bound_index(key), key);
+        }
+
+        size_type count(const Key &key) const { return contains(key) ? 1 : 0; }
+
+        T &at(const Key &key) {
+            size_type pos = lower_bound_index(key);
+            if (!matches(pos, key)) {
+                throw std::out_of_range("Key not found in flat_map");
+            }
+            return values_.data()[pos];
+        }
+
+        const T &at(const Key &key) const {
+            size_type pos = lower_bound_index(key);
+            if (!matches(pos, key)) {
+                throw std::out_of_range("Key not found in flat_map");
+            }
+            return values_.data()[pos];
+        }
+
+        T &operator[](const Key &key) {
+            return (*try_emplace(key).first).second;
+        }
+
+        // inserts T(args...) under `key` unless the key is already present
+        template<class... Args>
+        std::pair<iterator, bool> try_emplace(const Key &key, Args &&... args) {
+            size_type pos = lower_bound_index(key);
+            if (matches(pos, key)) {
+                return std::make_pair(iterator(this, pos), false);
+            }
+            keys_.emplace(keys_.begin() + pos, key);
+            try {
+                values_.emplace(values_.begin() + pos, std::forward<Args>(args)...);
+            } catch (...) {
+                keys_.erase(keys_.begin() + pos);
+                throw;
+            }
+            index_.invalidate();
+            return std::make_pair(iterator(this, pos), true);
+        }
+
+        std::pair<iterator, bool> insert(const value_type &value) {
+            return try_emplace(value.first, value.second);
+        }
+
+        // batched insertion: the new items are sorted on their own and merged
+        // with the existing ones in a single linear pass; existing keys win.
+        // Existing items are moved over only when neither their keys nor their
+        // values can throw on the move, and copied otherwise, so a throw
+        // leaves the map as it was (move-only items are moved regardless).
+        template<class InputIt>
+        void insert(InputIt first, InputIt last) {
+            flat_map incoming(first, last, comp_);
+            vector<Key, KeyAllocator> keys(keys_.get_allocator());
+            vector<T, MappedAllocator> values(values_.get_allocator());
+            keys.reserve(keys_.size() + incoming.size());
+            values.reserve(keys_.size() + incoming.size());
+            size_type a = 0, b = 0;
+            Key *a_keys = keys_.data();
+            T *a_values = values_.data();
+            Key *b_keys = incoming.keys_.data();
+            while (a < keys_.size() && b < incoming.size()) {
+                if (comp_(b_keys[b], a_keys[a])) {
+                    keys.push_back(std::move(b_keys[b]));
+                    values.push_back(std::move(incoming.values_.data()[b++]));
+                } else {
+                    if (!comp_(a_keys[a], b_keys[b])) {
+                        ++b;
+                    }
+                    keys.push_back(existing(a_keys[a]));
+                    values.push_back(existing(a_values[a++]));
+                }
+            }
+            for (; a < keys_.size(); ++a) {
+                keys.push_back(existing(a_keys[a]));
+                values.push_back(existing(a_values[a]));
+            }
+            for (; b < incoming.size(); ++b) {
+                keys.push_back(std::move(b_keys[b]));
+                values.push_back(std::move(incoming.values_.data()[b]));
+            }
+            keys_.swap(keys);
+            values_.swap(values);
+            index_.invalidate();
+        }
+
+        size_type erase(const Key &key) {
+            size_type pos = lower_bound_index(key);
+            if (!matches(pos, key)) {
+                return 0;
+            }
+            erase_at(pos);
+            return 1;
+        }
+
+        iterator erase(const_iterator position) {
+            erase_at(position.index());
+            return iterator(this, position.index());
+        }
+
+        void swap(flat_map &other) noexcept {
+            keys_.swap(other.keys_);
+            values_.swap(other.values_);
+            std::swap(comp_, other.comp_);
+            std::swap(index_, other.index_);
+        }
+
+    private:
+        vector<Key, KeyAllocator> keys_;
+        vector<T, MappedAllocator> values_;
+        Compare comp_;
+        eytzinger_index<Key, Compare> index_;
+
+        static constexpr bool move_existing =
+                (std::is_nothrow_move_constructible<Key>::value && std::is_nothrow_move_constructible<T>::value) ||
+                !std::is_copy_constructible<Key>::value || !std::is_copy_constructible<T>::value;
+
+        // an existing key or value as batched insert takes it over
+        template<class U>
+        static typename std::conditional<move_existing, U &&, const U &>::type existing(U &item) {
+            return static_cast<typename std::conditional<move_existing, U &&, const U &>::type>(item);
+        }
+
+        bool matches(size_type pos, const Key &key) const {
+            return pos < keys_.size() && !comp_(key, keys_.data()[pos]);
+        }
+
+        void erase_at(size_type pos) {
+            keys_.erase(keys_.begin() + pos);
+            values_.erase(values_.begin() + pos);
+            index_.invalidate();
+        }
+    };
+}
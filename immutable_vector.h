@@ -0,0 +1,825 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // Persistent vector: a relaxed radix balanced tree with 32-way nodes. Every
+    // "modifying" member is const and returns a new version that shares all
+    // untouched nodes with the old one, so keeping many versions costs
+    // O(log n) nodes per change instead of a full copy.
+    //
+    // Nodes are reference counted. An edit copies each node on its path unless
+    // the node is referenced only once, in which case nobody else can observe it
+    // and it is changed in place. Persistent edits always start from a shared
+    // root, so they copy the path; a transient holds the only reference to its
+    // nodes and batches edits in place until persistent() shares them again.
+    //
+    // Inner nodes keep cumulative child sizes. A node whose children (but the
+    // last) are all full is indexed by radix; concat and drop leave partly
+    // filled nodes along the seam, which are marked relaxed and searched
+    // through the size table instead.
+    template<class T, class Allocator = std::allocator<T>>
+    class immutable_vector {
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+        using reference = const T &;
+        using const_reference = const T &;
+
+        static constexpr unsigned int bits = 5;
+        static constexpr size_type branching = 1u << bits;
+
+        // random access by index; the current leaf is cached, so walking the
+        // vector only descends the tree once per 32 elements
+        class const_iterator {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using reference = const T &;
+            using pointer = const T *;
+
+            const_iterator() : container_(nullptr), index_(0), leaf_(nullptr), leaf_begin_(0), leaf_end_(0) {}
+
+            const_iterator(const immutable_vector *container, size_type index) :
+                    container_(container), index_(index), leaf_(nullptr), leaf_begin_(0), leaf_end_(0) {}
+
+            reference operator*() const {
+                if (index_ < leaf_begin_ || index_ >= leaf_end_) {
+                    container_->locate(index_, leaf_, leaf_begin_, leaf_end_);
+                }
+                return leaf_[index_ - leaf_begin_];
+            }
+
+            pointer operator->() const { return &**this; }
+
+            reference operator[](difference_type n) const { return (*container_)[index_ + n]; }
+
+            const_iterator &operator++() {
+                ++index_;
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                const_iterator result = *this;
+                ++index_;
+                return result;
+            }
+
+            const_iterator &operator--() {
+                --index_;
+                return *this;
+            }
+
+            const_iterator operator--(int) {
+                const_iterator result = *this;
+                --index_;
+                return result;
+            }
+
+            const_iterator &operator+=(difference_type n) {
+                index_ += n;
+                return *this;
+            }
+
+            const_iterator &operator-=(difference_type n) {
+                index_ -= n;
+                return *this;
+            }
+
+            const_iterator operator+(difference_type n) const { return const_iterator(container_, index_ + n); }
+
+            const_iterator operator-(difference_type n) const { return const_iterator(container_, index_ - n); }
+
+            difference_type operator-(const const_iterator &other) const {
+                return difference_type(index_) - difference_type(other.index_);
+            }
+
+            bool operator==(const const_iterator &other) const { return index_ == other.index_; }
+
+            bool operator!=(const const_iterator &other) const { return index_ != other.index_; }
+
+            bool operator<(const const_iterator &other) const { return index_ < other.index_; }
+
+        private:
+            const immutable_vector *container_;
+            size_type index_;
+            mutable const T *leaf_;
+            mutable size_type leaf_begin_, leaf_end_;
+        };
+
+        using iterator = const_iterator;
+
+        // Batches edits on nodes it owns alone. persistent() hands out a version
+        // sharing those nodes; the next edit of the transient copies its path once.
+        class transient {
+        public:
+            explicit transient(const immutable_vector &from) : tree_(from) {}
+
+            size_type size() const { return tree_.size_; }
+
+            bool empty() const { return tree_.size_ == 0; }
+
+            const_reference operator[](size_type pos) const { return tree_[pos]; }
+
+            void push_back(const T &value) { tree_.push_back_in_place(value); }
+
+            void set(size_type pos, const T &value) {
+                tree_.check_range(pos);
+                tree_.set_in_place(pos, value);
+            }
+
+            void pop_back() {
+                if (tree_.size_ > 0) {
+                    tree_.take_in_place(tree_.size_ - 1);
+                }
+            }
+
+            void take(size_type count) { tree_.take_in_place(count); }
+
+            void drop(size_type count) { tree_.drop_in_place(count); }
+
+            immutable_vector persistent() const { return tree_; }
+
+        private:
+            immutable_vector tree_;
+        };
+
+        explicit immutable_vector(const Allocator &alloc = Allocator()) :
+                allocator_(alloc), root_(nullptr), size_(0), height_(0) {}
+
+        immutable_vector(std::initializer_list<T> init, const Allocator &alloc = Allocator()) :
+                immutable_vector(alloc) {
+            for (const T &value : init) {
+                push_back_in_place(value);
+            }
+        }
+
+        template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+        immutable_vector(InputIt first, InputIt last, const Allocator &alloc = Allocator()) :
+                immutable_vector(alloc) {
+            for (; first != last; ++first) {
+                push_back_in_place(*first);
+            }
+        }
+
+        immutable_vector(const immutable_vector &other) noexcept :
+                allocator_(other.allocator_), root_(other.root_), size_(other.size_), height_(other.height_) {
+            retain(root_);
+        }
+
+        immutable_vector(immutable_vector &&other) noexcept :
+                allocator_(std::move(other.allocator_)), root_(other.root_), size_(other.size_),
+                height_(other.height_) {
+            other.root_ = nullptr;
+            other.size_ = other.height_ = 0;
+        }
+
+        immutable_vector &operator=(const immutable_vector &other) noexcept {
+            immutable_vector copy(other);
+            swap(copy);
+            return *this;
+        }
+
+        immutable_vector &operator=(immutable_vector &&other) noexcept {
+            immutable_vector moved(std::move(other));
+            swap(moved);
+            return *this;
+        }
+
+        ~immutable_vector() {
+            release(root_, height_);
+        }
+
+        size_type size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        // levels of inner nodes above the leaves
+        unsigned int height() const { return height_; }
+
+        const_reference operator[](size_type pos) const {
+            const node *n = root_;
+            for (unsigned int h = height_; h > 0; --h) {
+                const inner *in = as_inner(n);
+                n = in->children[find_child(in, h, pos)];
+            }
+            return as_leaf(n)->items()[pos];
+        }
+
+        const_reference at(size_type pos) const {
+            check_range(pos);
+            return (*this)[pos];
+        }
+
+        const_reference front() const { return at(0); }
+
+        const_reference back() const { return at(size_ - 1); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+
+        const_iterator end() const { return const_iterator(this, size_); }
+
+        // calls f(pointer, count) once per leaf, in order
+        template<class F>
+        void for_each_chunk(F f) const {
+            if (root_) {
+                visit_leaves(root_, height_, f);
+            }
+        }
+
+        immutable_vector push_back(const T &value) const {
+            immutable_vector result(*this);
+            result.push_back_in_place(value);
+            return result;
+        }
+
+        immutable_vector set(size_type pos, const T &value) const {
+            check_range(pos);
+            immutable_vector result(*this);
+            result.set_in_place(pos, value);
+            return result;
+        }
+
+        immutable_vector pop_back() const {
+            return take(size_ > 0 ? size_ - 1 : 0);
+        }
+
+        // the first `count` elements
+        immutable_vector take(size_type count) const {
+            immutable_vector result(*this);
+            result.take_in_place(count);
+            return result;
+        }
+
+        // everything but the first `count` elements
+        immutable_vector drop(size_type count) const {
+            immutable_vector result(*this);
+            result.drop_in_place(count);
+            return result;
+        }
+
+        // elements [first, last)
+        immutable_vector slice(size_type first, size_type last) const {
+            immutable_vector result(*this);
+            result.take_in_place(last);
+            result.drop_in_place(first);
+            return result;
+        }
+
+        // shares both operands' nodes except along the seam
+        immutable_vector concat(const immutable_vector &other) const {
+            if (other.empty()) {
+                return *this;
+            }
+            if (empty()) {
+                return other;
+            }
+            immutable_vector result(allocator_);
+            retain(root_);
+            retain(other.root_);
+            unsigned int joined_height;
+            result.root_ = result.join(root_, height_, other.root_, other.height_, joined_height);
+            result.height_ = joined_height;
+            result.size_ = size_ + other.size_;
+            return result;
+        }
+
+        transient make_transient() const { return transient(*this); }
+
+        void swap(immutable_vector &other) noexcept {
+            std::swap(allocator_, other.allocator_);
+            std::swap(root_, other.root_);
+            std::swap(size_, other.size_);
+            std::swap(height_, other.height_);
+        }
+
+        friend void swap(immutable_vector &lhs, immutable_vector &rhs) noexcept {
+            lhs.swap(rhs);
+        }
+
+        friend bool operator==(const immutable_vector &lhs, const immutable_vector &rhs) {
+            return lhs.size_ == rhs.size_ && (lhs.root_ == rhs.root_ || std::equal(lhs.begin(), lhs.end(), rhs.begin()));
+        }
+
+        friend bool operator!=(const immutable_vector &lhs, const immutable_vector &rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        struct node {
+            node() : refs(1), count(0) {}
+
+            std::atomic<unsigned int> refs;
+            size_type count;
+        };
+
+        struct leaf : node {
+            T *items() { return reinterpret_cast<T *>(slots); }
+
+            const T *items() const { return reinterpret_cast<const T *>(slots); }
+
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[branching];
+        };
+
+        struct inner : node {
+            bool relaxed = false;
+            size_type sizes[branching];
+            node *children[branching];
+        };
+
+        using leaf_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<leaf>;
+        using inner_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<inner>;
+
+        Allocator allocator_;
+        node *root_;
+        size_type size_;
+        unsigned int height_;
+
+        static leaf *as_leaf(node *n) { return static_cast<leaf *>(n); }
+
+        static const leaf *as_leaf(const node *n) { return static_cast<const leaf *>(n); }
+
+        static inner *as_inner(node *n) { return static_cast<inner *>(n); }
+
+        static const inner *as_inner(const node *n) { return static_cast<const inner *>(n); }
+
+        // elements in a full subtree whose root is at level h - 1
+        static std::uint64_t full_child_size(unsigned int h) { return std::uint64_t(1) << (bits * h); }
+
+        static size_type subtree_size(const node *n, unsigned int h) {
+            return h == 0 ? n->count : as_inner(n)->sizes[n->count - 1];
+        }
+
+        // index of the child of `in` (at level h) holding element `pos`; `pos`
+        // becomes the offset inside that child
+        static size_type find_child(const inner *in, unsigned int h, size_type &pos) {
+            size_type index = bits * h < 32 ? pos >> (bits * h) : 0;
+            if (in->relaxed) {
+                while (in->sizes[index] <= pos) {
+                    ++index;
+                }
+            }
+            if (index > 0) {
+                pos -= in->sizes[index - 1];
+            }
+            return index;
+        }
+
+        static void refresh(inner *in, unsigned int h) {
+            std::uint64_t full = full_child_size(h);
+            size_type total = 0;
+            in->relaxed = false;
+            for (size_type i = 0; i < in->count; ++i) {
+                size_type size = subtree_size(in->children[i], h - 1);
+                total += size;
+                in->sizes[i] = total;
+                if (i + 1 < in->count && size != full) {
+                    in->relaxed = true;
+                }
+            }
+        }
+
+        static void retain(node *n) {
+            if (n) {
+                n->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void release(node *n, unsigned int h) noexcept {
+            if (!n || n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            if (h == 0) {
+                leaf *l = as_leaf(n);
+                destroy_items(l, 0, l->count);
+                leaf_allocator alloc(allocator_);
+                l->~leaf();
+                std::allocator_traits<leaf_allocator>::deallocate(alloc, l, 1);
+            } else {
+                inner *in = as_inner(n);
+                for (size_type i = 0; i < in->count; ++i) {
+                    release(in->children[i], h - 1);
+                }
+                inner_allocator alloc(allocator_);
+                in->~inner();
+                std::allocator_traits<inner_allocator>::deallocate(alloc, in, 1);
+            }
+        }
+
+        void destroy_items(leaf *l, size_type first, size_type last) {
+            for (size_type i = first; i < last; ++i) {
+                std::allocator_traits<Allocator>::destroy(allocator_, l->items() + i);
+            }
+        }
+
+        leaf *new_leaf() {
+            leaf_allocator alloc(allocator_);
+            leaf *l = std::allocator_traits<leaf_allocator>::allocate(alloc, 1);
+            ::new(static_cast<void *>(l)) leaf();
+            return l;
+        }
+
+        inner *new_inner() {
+            inner_allocator alloc(allocator_);
+            inner *in = std::allocator_traits<inner_allocator>::allocate(alloc, 1);
+            ::new(static_cast<void *>(in)) inner();
+            return in;
+        }
+
+        // copies `count` elements from `from` to the end of `to`; on failure the
+        // ones already copied stay counted, so releasing `to` cleans them up
+        void append_items(leaf *to, const T *from, size_type count) {
+            for (size_type i = 0; i < count; ++i) {
+                std::allocator_traits<Allocator>::construct(allocator_, to->items() + to->count, from[i]);
+                ++to->count;
+            }
+        }
+
+        node *clone(node *n, unsigned int h) {
+            if (h == 0) {
+                leaf *copy = new_leaf();
+                try {
+                    append_items(copy, as_leaf(n)->items(), n->count);
+                } catch (...) {
+                    release(copy, 0);
+                    throw;
+                }
+                return copy;
+            }
+            inner *copy = new_inner();
+            const inner *in = as_inner(n);
+            copy->count = in->count;
+            copy->relaxed = in->relaxed;
+            for (size_type i = 0; i < in->count; ++i) {
+                copy->sizes[i] = in->sizes[i];
+                copy->children[i] = in->children[i];
+                retain(in->children[i]);
+            }
+            return copy;
+        }
+
+        // after this the node in `slot` is referenced only by `slot`
+        void make_unique(node *&slot, unsigned int h) {
+            if (slot->refs.load(std::memory_order_acquire) != 1) {
+                node *copy = clone(slot, h);
+                release(slot, h);
+                slot = copy;
+            }
+        }
+
+        // a subtree of height h holding just `value`
+        node *new_path(unsigned int h, const T &value) {
+            leaf *l = new_leaf();
+            try {
+                append_items(l, &value, 1);
+            } catch (...) {
+                release(l, 0);
+                throw;
+            }
+            node *path = l;
+            for (unsigned int level = 1; level <= h; ++level) {
+                inner *in;
+                try {
+                    in = new_inner();
+                } catch (...) {
+                    release(path, level - 1);
+                    throw;
+                }
+                in->children[0] = path;
+                in->count = 1;
+                in->sizes[0] = 1;
+                path = in;
+            }
+            return path;
+        }
+
+        static bool has_room(const node *n, unsigned int h) {
+            if (n->count < branching) {
+                return true;
+            }
+            return h > 0 && has_room(as_inner(n)->children[n->count - 1], h - 1);
+        }
+
+        void push_back_in_place(const T &value) {
+            if (!root_) {
+                root_ = new_path(0, value);
+            } else if (has_room(root_, height_)) {
+                push_into(root_, height_, value);
+            } else {
+                node *path = new_path(height_, value);
+                inner *top;
+                try {
+                    top = new_inner();
+                } catch (...) {
+                    release(path, height_);
+                    throw;
+                }
+                top->children[0] = root_;
+                top->children[1] = path;
+                top->count = 2;
+                refresh(top, height_ + 1);
+                root_ = top;
+                ++height_;
+            }
+            ++size_;
+        }
+
+        void push_into(node *&slot, unsigned int h, const T &value) {
+            make_unique(slot, h);
+            if (h == 0) {
+                append_items(as_leaf(slot), &value, 1);
+                return;
+            }
+            // only the last size changes, so the table is patched instead of refreshed
+            inner *in = as_inner(slot);
+            node *&last = in->children[in->count - 1];
+            if (has_room(last, h - 1)) {
+                push_into(last, h - 1, value);
+            } else {
+                in->children[in->count] = new_path(h - 1, value);
+                in->sizes[in->count] = in->sizes[in->count - 1];
+                if (subtree_size(last, h - 1) != full_child_size(h)) {
+                    in->relaxed = true;
+                }
+                ++in->count;
+            }
+            ++in->sizes[in->count - 1];
+        }
+
+        void set_in_place(size_type pos, const T &value) {
+            node **slot = &root_;
+            for (unsigned int h = height_; h > 0; --h) {
+                make_unique(*slot, h);
+                inner *in = as_inner(*slot);
+                slot = &in->children[find_child(in, h, pos)];
+            }
+            make_unique(*slot, 0);
+            as_leaf(*slot)->items()[pos] = value;
+        }
+
+        void take_in_place(size_type count) {
+            if (count >= size_) {
+                return;
+            }
+            if (count == 0) {
+                release(root_, height_);
+                root_ = nullptr;
+                size_ = height_ = 0;
+                return;
+            }
+            take_into(root_, height_, count);
+            size_ = count;
+            collapse();
+        }
+
+        // keeps the first `count` elements of the subtree, 0 < count < its size
+        void take_into(node *&slot, unsigned int h, size_type count) {
+            make_unique(slot, h);
+            if (h == 0) {
+                destroy_items(as_leaf(slot), count, slot->count);
+                slot->count = count;
+                return;
+            }
+            inner *in = as_inner(slot);
+            size_type keep = count - 1;
+            size_type index = find_child(in, h, keep);
+            ++keep;
+            for (size_type i = index + 1; i < in->count; ++i) {
+                release(in->children[i], h - 1);
+            }
+            in->count = index + 1;
+            if (keep < subtree_size(in->children[index], h - 1)) {
+                take_into(in->children[index], h - 1, keep);
+            }
+            refresh(in, h);
+        }
+
+        void drop_in_place(size_type count) {
+            if (count == 0) {
+                return;
+            }
+            if (count >= size_) {
+                take_in_place(0);
+                return;
+            }
+            drop_into(root_, height_, count);
+            size_ -= count;
+            collapse();
+        }
+
+        // removes the first `count` elements of the subtree, 0 < count < its size
+        void drop_into(node *&slot, unsigned int h, size_type count) {
+            if (h == 0) {
+                leaf *copy = new_leaf();
+                try {
+                    append_items(copy, as_leaf(slot)->items() + count, slot->count - count);
+                } catch (...) {
+                    release(copy, 0);
+                    throw;
+                }
+                release(slot, 0);
+                slot = copy;
+                return;
+            }
+            make_unique(slot, h);
+            inner *in = as_inner(slot);
+            size_type index = find_child(in, h, count);
+            for (size_type i = 0; i < index; ++i) {
+                release(in->children[i], h - 1);
+            }
+            std::copy(in->children + index, in->children + in->count, in->children);
+            in->count -= index;
+            if (count > 0) {
+                drop_into(in->children[0], h - 1, count);
+            }
+            refresh(in, h);
+        }
+
+        // a root with a single child is replaced by that child
+        void collapse() {
+            while (height_ > 0 && root_->count == 1) {
+                node *child = as_inner(root_)->children[0];
+                retain(child);
+                release(root_, height_);
+                root_ = child;
+                --height_;
+            }
+        }
+
+        // a node of height h whose only child is `child`
+        node *wrap(node *child, unsigned int h) {
+            inner *in = new_inner();
+            in->children[0] = child;
+            in->count = 1;
+            refresh(in, h);
+            return in;
+        }
+
+        node *parent_of(node *left, node *right, unsigned int h) {
+            inner *in = new_inner();
+            in->children[0] = left;
+            in->children[1] = right;
+            in->count = 2;
+            refresh(in, h);
+            return in;
+        }
+
+        // Joins two subtrees, taking over one reference to each, and returns the
+        // result with its height in `out_height`: either max(ha, hb) or one more.
+        // Like a B-tree join, it descends the edge of the taller tree and merges
+        // the two nodes that meet when they fit in one; nodes along the seam are
+        // not rebalanced beyond that and may be left partly filled (relaxed).
+        // If anything throws, both operands are released.
+        node *join(node *a, unsigned int ha, node *b, unsigned int hb, unsigned int &out_height) {
+            try {
+                if (ha == hb) {
+                    if (a->count + b->count > branching) {
+                        out_height = ha + 1;
+                        return parent_of(a, b, out_height);
+                    }
+                    make_unique(a, ha);
+                    if (ha == 0) {
+                        append_items(as_leaf(a), as_leaf(b)->items(), b->count);
+                    } else {
+                        inner *in = as_inner(a);
+                        const inner *right = as_inner(b);
+                        for (size_type i = 0; i < right->count; ++i) {
+                            in->children[in->count++] = right->children[i];
+                            retain(right->children[i]);
+                        }
+                        refresh(in, ha);
+                    }
+                    release(b, hb);
+                    out_height = ha;
+                    return a;
+                }
+                if (ha > hb) {
+                    make_unique(a, ha);
+                } else {
+                    make_unique(b, hb);
+                }
+            } catch (...) {
+                release(a, ha);
+                release(b, hb);
+                throw;
+            }
+
+            unsigned int joined_height;
+            if (ha > hb) {
+                inner *in = as_inner(a);
+                node *last = in->children[in->count - 1];
+                in->children[in->count - 1] = nullptr;
+                node *joined;
+                try {
+                    joined = join(last, ha - 1, b, hb, joined_height);
+                } catch (...) {
+                    release(a, ha);
+                    throw;
+                }
+                out_height = ha;
+                if (joined_height < ha) {
+                    in->children[in->count - 1] = joined;
+                    refresh(in, ha);
+                    return a;
+                }
+                // the seam split into two children of a
+                node *left = as_inner(joined)->children[0], *right = as_inner(joined)->children[1];
+                retain(left);
+                retain(right);
+                release(joined, ha);
+                in->children[in->count - 1] = left;
+                if (in->count < branching) {
+                    in->children[in->count++] = right;
+                    refresh(in, ha);
+                    return a;
+                }
+                refresh(in, ha);
+                try {
+                    node *wrapped = wrap(right, ha);
+                    out_height = ha + 1;
+                    return parent_of(a, wrapped, out_height);
+                } catch (...) {
+                    release(right, ha - 1);
+                    release(a, ha);
+                    throw;
+                }
+            }
+
+            inner *in = as_inner(b);
+            node *first = in->children[0];
+            in->children[0] = nullptr;
+            node *joined;
+            try {
+                joined = join(a, ha, first, hb - 1, joined_height);
+            } catch (...) {
+                release(b, hb);
+                throw;
+            }
+            out_height = hb;
+            if (joined_height < hb) {
+                in->children[0] = joined;
+                refresh(in, hb);
+                return b;
+            }
+            node *left = as_inner(joined)->children[0], *right = as_inner(joined)->children[1];
+            retain(left);
+            retain(right);
+            release(joined, hb);
+            in->children[0] = right;
+            if (in->count < branching) {
+                std::copy_backward(in->children, in->children + in->count, in->children + in->count + 1);
+                in->children[0] = left;
+                ++in->count;
+                refresh(in, hb);
+                return b;
+            }
+            refresh(in, hb);
+            try {
+                node *wrapped = wrap(left, hb);
+                out_height = hb + 1;
+                return parent_of(wrapped, b, out_height);
+            } catch (...) {
+                release(left, hb - 1);
+                release(b, hb);
+                throw;
+            }
+        }
+
+        // leaf holding element `pos` and the element range it covers
+        void locate(size_type pos, const T *&items, size_type &first, size_type &last) const {
+            size_type offset = pos;
+            const node *n = root_;
+            for (unsigned int h = height_; h > 0; --h) {
+                const inner *in = as_inner(n);
+                n = in->children[find_child(in, h, offset)];
+            }
+            items = as_leaf(n)->items();
+            first = pos - offset;
+            last = first + n->count;
+        }
+
+        template<class F>
+        static void visit_leaves(const node *n, unsigned int h, F &f) {
+            if (h == 0) {
+                f(as_leaf(n)->items(), n->count);
+                return;
+            }
+            const inner *in = as_inner(n);
+            for (size_type i = 0; i < in->count; ++i) {
+                visit_leaves(in->children[i], h - 1, f);
+            }
+        }
+
+        void check_range(size_type pos) const {
+            if (pos >= size_) {
+                throw std::out_of_range("Index out of immutable_vector range");
+            }
+        }
+    };
+}
@@ -0,0 +1,501 @@
+#pragma once
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include "allocator.h"
+#include "simd.h"
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // Base of every numeric expression. An expression E provides value_type,
+    // size(), a scalar operator[] and a pack load(i, out) filling a SIMD
+    // register's worth of elements starting at i.
+    template<class E>
+    struct numeric_expression {
+        const E &self() const { return static_cast<const E &>(*this); }
+    };
+
+    template<class T, class Allocator>
+    class numeric_vector;
+
+    namespace numeric_ops {
+        // Packs travel by reference so no vector type is passed or returned by
+        // value across functions compiled for different instruction sets.
+        struct plus {
+            template<class V>
+            static PRETTY_VECTOR_ALWAYS_INLINE void apply(V &out, const V &a, const V &b) { out = a + b; }
+        };
+
+        struct minus {
+            template<class V>
+            static PRETTY_VECTOR_ALWAYS_INLINE void apply(V &out, const V &a, const V &b) { out = a - b; }
+        };
+
+        struct multiplies {
+            template<class V>
+            static PRETTY_VECTOR_ALWAYS_INLINE void apply(V &out, const V &a, const V &b) { out = a * b; }
+        };
+
+        struct divides {
+            template<class V>
+            static PRETTY_VECTOR_ALWAYS_INLINE void apply(V &out, const V &a, const V &b) { out = a / b; }
+        };
+
+        struct negate {
+            template<class V>
+            static PRETTY_VECTOR_ALWAYS_INLINE void apply(V &out, const V &a) { out = -a; }
+        };
+
+        // operands are held by reference when they are vectors, by value when
+        // they are (small) expression nodes
+        template<class E>
+        struct operand {
+            typedef const E type;
+        };
+
+        template<class T, class Allocator>
+        struct operand<numeric_vector<T, Allocator>> {
+            typedef const numeric_vector<T, Allocator> &type;
+        };
+    }
+
+    // a scalar broadcast to every element
+    template<class T>
+    class numeric_scalar : public numeric_expression<numeric_scalar<T>> {
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+        static constexpr bool broadcast = true;
+
+        explicit numeric_scalar(T value) : value_(value) {}
+
+        size_type size() const { return 0; }
+
+        T operator[](size_type) const { return value_; }
+
+        template<class P>
+        PRETTY_VECTOR_ALWAYS_INLINE void load(size_type, P &out) const { out = P{} + value_; }
+
+    private:
+        T value_;
+    };
+
+    template<class L, class R, class Op>
+    class numeric_binary : public numeric_expression<numeric_binary<L, R, Op>> {
+    public:
+        using value_type = typename L::value_type;
+        using size_type = unsigned int;
+        static constexpr bool broadcast = false;
+
+        numeric_binary(const L &lhs, const R &rhs) : lhs_(lhs), rhs_(rhs) {
+            if (!L::broadcast && !R::broadcast && lhs.size() != rhs.size()) {
+                throw std::length_error("numeric_vector operands differ in size");
+            }
+            size_ = L::broadcast ? rhs.size() : lhs.size();
+        }
+
+        size_type size() const { return size_; }
+
+        value_type operator[](size_type i) const {
+            value_type result;
+            Op::apply(result, lhs_[i], rhs_[i]);
+            return result;
+        }
+
+        template<class P>
+        PRETTY_VECTOR_ALWAYS_INLINE void load(size_type i, P &out) const {
+            P a, b;
+            lhs_.load(i, a);
+            rhs_.load(i, b);
+            Op::apply(out, a, b);
+        }
+
+    private:
+        typename numeric_ops::operand<L>::type lhs_;
+        typename numeric_ops::operand<R>::type rhs_;
+        size_type size_;
+    };
+
+    template<class E, class Op>
+    class numeric_unary : public numeric_expression<numeric_unary<E, Op>> {
+    public:
+        using value_type = typename E::value_type;
+        using size_type = unsigned int;
+        static constexpr bool broadcast = false;
+
+        explicit numeric_unary(const E &operand) : operand_(operand) {}
+
+        size_type size() const { return operand_.size(); }
+
+        value_type operator[](size_type i) const {
+            value_type result;
+            Op::apply(result, operand_[i]);
+            return result;
+        }
+
+        template<class P>
+        PRETTY_VECTOR_ALWAYS_INLINE void load(size_type i, P &out) const {
+            P a;
+            operand_.load(i, a);
+            Op::apply(out, a);
+        }
+
+    private:
+        typename numeric_ops::operand<E>::type operand_;
+    };
+
+    namespace numeric_kernels {
+        using size_type = unsigned int;
+
+        template<class T, class E>
+        void assign_scalar(T *out, const E &e, size_type n) {
+            for (size_type i = 0; i < n; ++i) {
+                out[i] = e[i];
+            }
+        }
+
+        // Reductions keep four accumulators so consecutive packs do not wait on
+        // each other; each reducer supplies the identity to start them from.
+        struct sum_reducer {
+            template<class T>
+            static T identity() { return T(); }
+
+            template<class V>
+            static PRETTY_VECTOR_ALWAYS_INLINE void apply(V &acc, const V &x) { acc = acc + x; }
+        };
+
+        struct min_reducer {
+            template<class T>
+            static T identity() {
+                return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                            : std::numeric_limits<T>::max();
+            }
+
+            template<class V>
+            static PRETTY_VECTOR_ALWAYS_INLINE void apply(V &acc, const V &x) { acc = x < acc ? x : acc; }
+        };
+
+        struct max_reducer {
+            template<class T>
+            static T identity() {
+                return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                            : std::numeric_limits<T>::lowest();
+            }
+
+            template<class V>
+            static PRETTY_VECTOR_ALWAYS_INLINE void apply(V &acc, const V &x) { acc = acc < x ? x : acc; }
+        };
+
+        template<class Reducer, class E>
+        typename E::value_type reduce_scalar(const E &e) {
+            typename E::value_type acc = Reducer::template identity<typename E::value_type>();
+            for (size_type i = 0; i < e.size(); ++i) {
+                Reducer::apply(acc, e[i]);
+            }
+            return acc;
+        }
+
+#if defined(PRETTY_VECTOR_X86_SIMD)
+        // the fused loop: one pass, one pack of every operand per step
+        template<class P, class T, class E>
+        PRETTY_VECTOR_ALWAYS_INLINE void assign_packs(T *out, const E &e, size_type n) {
+            constexpr size_type lanes = sizeof(P) / sizeof(T);
+            size_type i = 0;
+            for (; i + lanes <= n; i += lanes) {
+                P value;
+                e.load(i, value);
+                std::memcpy(out + i, &value, sizeof(P));
+            }
+            for (; i < n; ++i) {
+                out[i] = e[i];
+            }
+        }
+
+        template<class P, class Reducer, class E>
+        PRETTY_VECTOR_ALWAYS_INLINE typename E::value_type reduce_packs(const E &e) {
+            using T = typename E::value_type;
+            constexpr size_type lanes = sizeof(P) / sizeof(T);
+            const T identity = Reducer::template identity<T>();
+            P acc[4];
+            for (P &a : acc) {
+                a = P{} + identity;
+            }
+            size_type n = e.size(), i = 0;
+            for (; i + 4 * lanes <= n; i += 4 * lanes) {
+                for (size_type k = 0; k < 4; ++k) {
+                    P x;
+                    e.load(i + k * lanes, x);
+                    Reducer::apply(acc[k], x);
+                }
+            }
+            for (; i + lanes <= n; i += lanes) {
+                P x;
+                e.load(i, x);
+                Reducer::apply(acc[0], x);
+            }
+            Reducer::apply(acc[0], acc[1]);
+            Reducer::apply(acc[2], acc[3]);
+            Reducer::apply(acc[0], acc[2]);
+            T spilled[lanes];
+            std::memcpy(spilled, &acc[0], sizeof(P));
+            T result = identity;
+            for (size_type k = 0; k < lanes; ++k) {
+                Reducer::apply(result, spilled[k]);
+            }
+            for (; i < n; ++i) {
+                Reducer::apply(result, e[i]);
+            }
+            return result;
+        }
+
+        template<class T, class E>
+        PRETTY_VECTOR_TARGET_SSE2 void assign_sse2(T *out, const E &e, size_type n) {
+            assign_packs<typename simd::pack<T, 16>::type>(out, e, n);
+        }
+
+        template<class T, class E>
+        PRETTY_VECTOR_TARGET_AVX2 void assign_avx2(T *out, const E &e, size_type n) {
+            assign_packs<typename simd::pack<T, 32>::type>(out, e, n);
+        }
+
+        template<class T, class E>
+        PRETTY_VECTOR_TARGET_AVX512 void assign_avx512(T *out, const E &e, size_type n) {
+            assign_packs<typename simd::pack<T, 64>::type>(out, e, n);
+        }
+
+        template<class Reducer, class E>
+        PRETTY_VECTOR_TARGET_SSE2 typename E::value_type reduce_sse2(const E &e) {
+            return reduce_packs<typename simd::pack<typename E::value_type, 16>::type, Reducer>(e);
+        }
+
+        template<class Reducer, class E>
+        PRETTY_VECTOR_TARGET_AVX2 typename E::value_type reduce_avx2(const E &e) {
+            return reduce_packs<typename simd::pack<typename E::value_type, 32>::type, Reducer>(e);
+        }
+
+        template<class Reducer, class E>
+        PRETTY_VECTOR_TARGET_AVX512 typename E::value_type reduce_avx512(const E &e) {
+            return reduce_packs<typename simd::pack<typename E::value_type, 64>::type, Reducer>(e);
+        }
+#endif
+
+        template<class T, class E>
+        void assign(T *out, const E &e, size_type n) {
+#if defined(PRETTY_VECTOR_X86_SIMD)
+            switch (simd::active()) {
+                case simd::level::avx512:
+                    return assign_avx512(out, e, n);
+                case simd::level::avx2:
+                    return assign_avx2(out, e, n);
+                case simd::level::sse42:
+                case simd::level::sse2:
+                    return assign_sse2(out, e, n);
+                default:
+                    break;
+            }
+#endif
+            assign_scalar(out, e, n);
+        }
+
+        template<class Reducer, class E>
+        typename E::value_type reduce(const E &e) {
+#if defined(PRETTY_VECTOR_X86_SIMD)
+            switch (simd::active()) {
+                case simd::level::avx512:
+                    return reduce_avx512<Reducer>(e);
+                case simd::level::avx2:
+                    return reduce_avx2<Reducer>(e);
+                case simd::level::sse42:
+                case simd::level::sse2:
+                    return reduce_sse2<Reducer>(e);
+                default:
+                    break;
+            }
+#endif
+            return reduce_scalar<Reducer>(e);
+        }
+    }
+
+    // Vector of arithmetic values whose operators build expression templates:
+    // `a = b * c + d` creates no temporaries and runs as one loop over packs of
+    // the widest instruction set the CPU supports (see simd.h). Storage is
+    // 64-byte aligned by default.
+    //
+    // An expression holds references to its vector operands, so evaluate it
+    // (assign it to a numeric_vector or reduce it) before they go away.
+    template<class T, class Allocator = pretty_allocator::allocator<T, 64>>
+    class numeric_vector : public numeric_expression<numeric_vector<T, Allocator>> {
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && sizeof(T) <= 8,
+                      "numeric_vector holds integer or floating point elements");
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+        using storage_type = vector<T, Allocator>;
+        using iterator = typename storage_type::iterator;
+        using const_iterator = typename storage_type::const_iterator;
+        static constexpr bool broadcast = false;
+
+        explicit numeric_vector(const Allocator &alloc = Allocator()) : items_(alloc) {}
+
+        explicit numeric_vector(size_type count, T value = T(), const Allocator &alloc = Allocator()) :
+                items_(count, value, alloc) {}
+
+        numeric_vector(std::initializer_list<T> init, const Allocator &alloc = Allocator()) : items_(init, alloc) {}
+
+        explicit numeric_vector(storage_type items) : items_(std::move(items)) {}
+
+        template<class E>
+        numeric_vector(const numeric_expression<E> &e, const Allocator &alloc = Allocator()) :
+                items_(e.self().size(), T(), alloc) {
+            numeric_kernels::assign(items_.data(), e.self(), items_.size());
+        }
+
+        numeric_vector(const numeric_vector &) = default;
+
+        numeric_vector(numeric_vector &&) noexcept = default;
+
+        numeric_vector &operator=(const numeric_vector &) = default;
+
+        numeric_vector &operator=(numeric_vector &&) noexcept = default;
+
+        // evaluates `e` into this vector, resizing it to e's size; `e` may
+        // refer to this vector
+        template<class E>
+        numeric_vector &operator=(const numeric_expression<E> &e) {
+            size_type n = e.self().size();
+            if (n != items_.size()) {
+                items_.resize(n);
+            }
+            numeric_kernels::assign(items_.data(), e.self(), n);
+            return *this;
+        }
+
+        template<class E>
+        numeric_vector &operator+=(const numeric_expression<E> &e) { return *this = *this + e.self(); }
+
+        template<class E>
+        numeric_vector &operator-=(const numeric_expression<E> &e) { return *this = *this - e.self(); }
+
+        template<class E>
+        numeric_vector &operator*=(const numeric_expression<E> &e) { return *this = *this * e.self(); }
+
+        template<class E>
+        numeric_vector &operator/=(const numeric_expression<E> &e) { return *this = *this / e.self(); }
+
+        numeric_vector &operator+=(T value) { return *this = *this + value; }
+
+        numeric_vector &operator-=(T value) { return *this = *this - value; }
+
+        numeric_vector &operator*=(T value) { return *this = *this * value; }
+
+        numeric_vector &operator/=(T value) { return *this = *this / value; }
+
+        size_type size() const { return items_.size(); }
+
+        bool empty() const { return items_.size() == 0; }
+
+        T &operator[](size_type i) { return items_.data()[i]; }
+
+        T operator[](size_type i) const { return items_.data()[i]; }
+
+        T *data() { return items_.data(); }
+
+        const T *data() const { return items_.data(); }
+
+        iterator begin() { return items_.begin(); }
+
+        iterator end() { return items_.end(); }
+
+        const_iterator begin() const { return items_.begin(); }
+
+        const_iterator end() const { return items_.end(); }
+
+        void resize(size_type count) { items_.resize(count); }
+
+        void push_back(T value) { items_.push_back(value); }
+
+        const storage_type &storage() const { return items_; }
+
+        template<class P>
+        PRETTY_VECTOR_ALWAYS_INLINE void load(size_type i, P &out) const {
+            std::memcpy(&out, items_.data() + i, sizeof(P));
+        }
+
+        friend bool operator==(const numeric_vector &lhs, const numeric_vector &rhs) {
+            return lhs.items_ == rhs.items_;
+        }
+
+        friend bool operator!=(const numeric_vector &lhs, const numeric_vector &rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        storage_type items_;
+    };
+
+#define PRETTY_VECTOR_NUMERIC_OPERATOR(symbol, op)                                                              \
+    template<class L, class R>                                                                                  \
+    numeric_binary<L, R, numeric_ops::op>                                                                       \
+    operator symbol(const numeric_expression<L> &lhs, const numeric_expression<R> &rhs) {                       \
+        return numeric_binary<L, R, numeric_ops::op>(lhs.self(), rhs.self());                                   \
+    }                                                                                                           \
+                                                                                                                \
+    template<class L>                                                                                           \
+    numeric_binary<L, numeric_scalar<typename L::value_type>, numeric_ops::op>                                  \
+    operator symbol(const numeric_expression<L> &lhs, typename L::value_type rhs) {                             \
+        return numeric_binary<L, numeric_scalar<typename L::value_type>, numeric_ops::op>(                      \
+                lhs.self(), numeric_scalar<typename L::value_type>(rhs));                                       \
+    }                                                                                                           \
+                                                                                                                \
+    template<class R>                                                                                           \
+    numeric_binary<numeric_scalar<typename R::value_type>, R, numeric_ops::op>                                  \
+    operator symbol(typename R::value_type lhs, const numeric_expression<R> &rhs) {                             \
+        return numeric_binary<numeric_scalar<typename R::value_type>, R, numeric_ops::op>(                      \
+                numeric_scalar<typename R::value_type>(lhs), rhs.self());                                       \
+    }
+
+    PRETTY_VECTOR_NUMERIC_OPERATOR(+, plus)
+
+    PRETTY_VECTOR_NUMERIC_OPERATOR(-, minus)
+
+    PRETTY_VECTOR_NUMERIC_OPERATOR(*, multiplies)
+
+    PRETTY_VECTOR_NUMERIC_OPERATOR(/, divides)
+
+#undef PRETTY_VECTOR_NUMERIC_OPERATOR
+
+    template<class E>
+    numeric_unary<E, numeric_ops::negate> operator-(const numeric_expression<E> &e) {
+        return numeric_unary<E, numeric_ops::negate>(e.self());
+    }
+
+    // reductions run the expression and fold it in the same pass
+
+    template<class E>
+    typename E::value_type sum(const numeric_expression<E> &e) {
+        return numeric_kernels::reduce<numeric_kernels::sum_reducer>(e.self());
+    }
+
+    template<class L, class R>
+    typename L::value_type dot(const numeric_expression<L> &lhs, const numeric_expression<R> &rhs) {
+        return sum(lhs * rhs);
+    }
+
+    template<class E>
+    typename E::value_type min(const numeric_expression<E> &e) {
+        if (e.self().size() == 0) {
+            throw std::length_error("min of an empty numeric expression");
+        }
+        return numeric_kernels::reduce<numeric_kernels::min_reducer>(e.self());
+    }
+
+    template<class E>
+    typename E::value_type max(const numeric_expression<E> &e) {
+        if (e.self().size() == 0) {
+            throw std::length_error("max of an empty numeric expression");
+        }
+        return numeric_kernels::reduce<numeric_kernels::max_reducer>(e.self());
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    namespace detail {
+        // Threads for n elements: one below `threshold`, else `threads` (0 means
+        // one per core) but no more than give each a few thousand elements.
+        inline unsigned int thread_count(unsigned int threads, std::size_t threshold, std::size_t n) {
+            if (n < threshold) {
+                return 1;
+            }
+            threads = threads ? threads : std::thread::hardware_concurrency();
+            threads = threads ? threads : 1;
+            std::size_t most = n / 4096 + 1;
+            return static_cast<unsigned int>(std::min<std::size_t>(threads, most));
+        }
+
+        // Runs fn(0) .. fn(count - 1) on `count` threads, fn(0) on the caller,
+        // and rethrows the first exception once all of them have finished.
+        template<class Function>
+        void parallel_for(unsigned int count, const Function &fn) {
+            if (count <= 1) {
+                fn(0u);
+                return;
+            }
+            vector<std::exception_ptr> errors(count, std::exception_ptr());
+            vector<std::thread> workers;
+            workers.reserve(count - 1);
+            auto guarded = [&](unsigned int index) {
+                try {
+                    fn(index);
+                } catch (...) {
+                    errors[index] = std::current_exception();
+                }
+            };
+            try {
+                for (unsigned int i = 1; i < count; ++i) {
+                    workers.emplace_back(guarded, i);
+                }
+            } catch (...) {
+                for (std::thread &worker : workers) {
+                    worker.join();
+                }
+                throw;
+            }
+            guarded(0);
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            for (const std::exception_ptr &error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,327 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include "bit_vector.h"
+#include "simd_kernels.h"
+#include "vector.h"
+
+namespace pretty_vector {
+
+    struct permute_options {
+        // Gathers from inputs larger than this prefetch the element they will
+        // load a few dozen iterations ahead instead of using the SIMD gather.
+        // Out-of-order execution already overlaps the independent loads, so
+        // that only helps once they also miss the last level cache.
+        std::size_t gather_prefetch_bytes = std::size_t(128) << 20;
+        // Scatters into outputs larger than this prefetch the line they will
+        // store to; a missed store stalls the store buffer much sooner.
+        std::size_t scatter_prefetch_bytes = std::size_t(1) << 20;
+        // Inputs larger than this are reordered by cache-blocked partitioning:
+        // the requests are bucketed by source block and then by destination
+        // block, so every random access stays inside one cache-sized block.
+        // That trades the random misses for four streaming passes, which only
+        // pays off well beyond the last level cache and the TLB reach.
+        std::size_t blocked_bytes = std::size_t(1) << 32;
+    };
+
+    namespace detail {
+        // Uninitialized storage for n elements from a copy of a container's
+        // allocator; destroys the first `constructed` elements when it goes.
+        template<class T, class Allocator>
+        class scratch {
+        public:
+            typedef typename std::allocator_traits<Allocator>::template rebind_alloc<T> allocator_type;
+
+            scratch(const Allocator &alloc, std::size_t n) :
+                    allocator_(alloc), n_(n),
+                    data_(n ? std::allocator_traits<allocator_type>::allocate(allocator_, n) : nullptr) {}
+
+            scratch(const scratch &) = delete;
+
+            scratch &operator=(const scratch &) = delete;
+
+            ~scratch() {
+                for (std::size_t i = 0; i < constructed; ++i) {
+                    std::allocator_traits<allocator_type>::destroy(allocator_, data_ + i);
+                }
+                if (data_) {
+                    std::allocator_traits<allocator_type>::deallocate(allocator_, data_, n_);
+                }
+            }
+
+            T *data() { return data_; }
+
+            std::size_t constructed = 0;
+
+        private:
+            allocator_type allocator_;
+            std::size_t n_;
+            T *data_;
+        };
+
+        constexpr std::size_t prefetch_distance = 64;
+        // elements per block of the blocked passes: about half of L2
+        constexpr std::size_t block_bytes = std::size_t(1) << 20;
+
+        // throws `what` unless every index is in [0, bound), using the SIMD
+        // range search
+        template<class Index, class IndexAllocator>
+        void check_indices(const vector<Index, IndexAllocator> &index, std::size_t bound, const char *what) {
+            static_assert(std::is_integral<Index>::value, "indices must be integral");
+            const Index *at = index.data();
+            std::size_t n = index.size();
+            Index largest = std::numeric_limits<Index>::max();
+            if constexpr (std::is_signed<Index>::value) {
+                if (simd::find_in_range(at, n, std::numeric_limits<Index>::min(), Index(-1)) != n) {
+                    throw std::out_of_range(what);
+                }
+            }
+            if (bound <= static_cast<std::size_t>(largest) &&
+                simd::find_in_range(at, n, static_cast<Index>(bound), largest) != n) {
+                throw std::out_of_range(what);
+            }
+        }
+
+        // shift that cuts [0, n) into blocks of about block_bytes, at most 256
+        // of them so the partition passes write to few streams at once
+        template<class T>
+        unsigned int block_shift(std::size_t n) {
+            unsigned int shift = 0;
+            while ((std::size_t(1) << (shift + 1)) * sizeof(T) <= block_bytes) {
+                ++shift;
+            }
+            while ((n >> shift) > 256) {
+                ++shift;
+            }
+            return shift;
+        }
+
+        template<class Index, class T>
+        struct indexed {
+            Index index;
+            T value;
+        };
+
+        // offset[b] = where bucket b starts, from per-bucket counts
+        inline void exclusive_offsets(std::size_t *count, std::size_t buckets) {
+            std::size_t next = 0;
+            for (std::size_t b = 0; b < buckets; ++b) {
+                std::size_t here = count[b];
+                count[b] = next;
+                next += here;
+            }
+        }
+
+        // to[i] = from[index[i]] for i < n in four streaming passes; the
+        // destinations are kept as 32-bit positions (n fits a vector's
+        // size_type), not in Index, which may be narrower than n
+        template<class T, class Index, class Allocator>
+        void blocked_gather(T *to, const T *from, std::size_t from_size, const Index *index, std::size_t n,
+                            const Allocator &alloc) {
+            typedef indexed<Index, std::uint32_t> request;
+            typedef indexed<std::uint32_t, T> reply;
+            unsigned int source_shift = block_shift<T>(from_size), target_shift = block_shift<T>(n);
+            std::size_t counts[258] = {};
+            for (std::size_t i = 0; i < n; ++i) {
+                ++counts[static_cast<std::size_t>(index[i]) >> source_shift];
+            }
+            exclusive_offsets(counts, 257);
+
+            scratch<request, Allocator> requests(alloc, n);
+            request *by_source = requests.data();
+            for (std::size_t i = 0; i < n; ++i) {
+                by_source[counts[static_cast<std::size_t>(index[i]) >> source_shift]++] =
+                        request{index[i], static_cast<std::uint32_t>(i)};
+            }
+
+            // every target block but the last holds exactly 1 << target_shift slots
+            scratch<reply, Allocator> replies(alloc, n);
+            reply *by_target = replies.data();
+            for (std::size_t b = 0; b < 257; ++b) {
+                counts[b] = std::min(n, b << target_shift);
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                const request &r = by_source[i];
+                by_target[counts[static_cast<std::size_t>(r.value) >> target_shift]++] =
+                        reply{r.value, from[static_cast<std::size_t>(r.index)]};
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                to[static_cast<std::size_t>(by_target[i].index)] = by_target[i].value;
+            }
+        }
+
+        // to[index[i]] = from[i] for i < n in two streaming passes
+        template<class T, class Index, class Allocator>
+        void blocked_scatter(T *to, std::size_t to_size, const T *from, const Index *index, std::size_t n,
+                             const Allocator &alloc) {
+            typedef indexed<Index, T> reply;
+            unsigned int target_shift = block_shift<T>(to_size);
+            std::size_t counts[258] = {};
+            for (std::size_t i = 0; i < n; ++i) {
+                ++counts[static_cast<std::size_t>(index[i]) >> target_shift];
+            }
+            exclusive_offsets(counts, 257);
+
+            scratch<reply, Allocator> replies(alloc, n);
+            reply *by_target = replies.data();
+            for (std::size_t i = 0; i < n; ++i) {
+                by_target[counts[static_cast<std::size_t>(index[i]) >> target_shift]++] = reply{index[i], from[i]};
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                to[static_cast<std::size_t>(by_target[i].index)] = by_target[i].value;
+            }
+        }
+
+        // to[i] = from[index[i]]: the SIMD gather for 32-bit indices into
+        // inputs below the gather prefetch threshold, a prefetching loop above
+        template<class T, class Index, class Allocator>
+        void gather_into(T *to, const T *from, std::size_t from_size, const Index *index, std::size_t n,
+                         const permute_options &options, const Allocator &alloc) {
+            std::size_t bytes = from_size * sizeof(T);
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                if (bytes > options.blocked_bytes) {
+                    blocked_gather(to, from, from_size, index, n, alloc);
+                    return;
+                }
+            }
+            if constexpr (simd::has_kernel_width<T>::value && std::is_unsigned<Index>::value &&
+                          sizeof(Index) == sizeof(std::uint32_t)) {
+                if (bytes <= options.gather_prefetch_bytes &&
+                    from_size <= static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+                    simd::gather(to, from, reinterpret_cast<const std::uint32_t *>(index), n);
+                    return;
+                }
+            }
+            std::size_t i = 0;
+            if (bytes > options.gather_prefetch_bytes) {
+                for (; i + prefetch_distance < n; ++i) {
+                    __builtin_prefetch(from + index[i + prefetch_distance]);
+                    to[i] = from[index[i]];
+                }
+            }
+            for (; i < n; ++i) {
+                to[i] = from[index[i]];
+            }
+        }
+
+        // throws unless perm holds every index below its size exactly once
+        template<class Index, class IndexAllocator>
+        void check_permutation(const vector<Index, IndexAllocator> &perm) {
+            check_indices(perm, perm.size(), "apply_permutation: index out of range");
+            bit_vector<> seen(perm.size());
+            for (unsigned int i = 0; i < perm.size(); ++i) {
+                unsigned int at = static_cast<unsigned int>(perm[i]);
+                if (seen.test(at)) {
+                    throw std::invalid_argument("apply_permutation: index repeated");
+                }
+                seen.set(at);
+            }
+        }
+    }
+
+    // out[i] = in[index[i]], with out resized to index.size(). Trivially
+    // copyable elements of 4 or 8 bytes with 32-bit unsigned indices use the
+    // AVX2 gather when the input fits options.gather_prefetch_bytes; larger inputs
+    // prefetch ahead, and the largest are cache-blocked (see permute_options).
+    // Throws std::out_of_range, before writing anything, for an index past
+    // the end of in.
+    template<class T, class Allocator, class Index, class IndexAllocator, class OutAllocator>
+    void gather(const vector<T, Allocator> &in, const vector<Index, IndexAllocator> &index,
+                vector<T, OutAllocator> &out, permute_options options = permute_options()) {
+        detail::check_indices(index, in.size(), "gather: index out of range");
+        if constexpr (std::is_trivially_copyable<T>::value && std::is_default_constructible<T>::value) {
+            out.resize(index.size());
+            detail::gather_into(out.data(), in.data(), in.size(), index.data(), index.size(), options,
+                                out.get_allocator());
+        } else {
+            out.clear();
+            out.reserve(index.size());
+            for (unsigned int i = 0; i < index.size(); ++i) {
+                out.push_back(in[static_cast<unsigned int>(index[i])]);
+            }
+        }
+    }
+
+    // the same into a new vector with in's allocator
+    template<class T, class Allocator, class Index, class IndexAllocator>
+    vector<T, Allocator> gather(const vector<T, Allocator> &in, const vector<Index, IndexAllocator> &index,
+                                permute_options options = permute_options()) {
+        vector<T, Allocator> out(in.get_allocator());
+        gather(in, index, out, options);
+        return out;
+    }
+
+    // out[index[i]] = in[i] for every i; positions of out no index names keep
+    // their values, and with repeated indices the last write wins. Throws
+    // std::length_error if index and in differ in length and
+    // std::out_of_range for an index past the end of out, before writing.
+    template<class T, class Allocator, class Index, class IndexAllocator, class OutAllocator>
+    void scatter(const vector<T, Allocator> &in, const vector<Index, IndexAllocator> &index,
+                 vector<T, OutAllocator> &out, permute_options options = permute_options()) {
+        if (index.size() != in.size()) {
+            throw std::length_error("scatter: index and values differ in length");
+        }
+        detail::check_indices(index, out.size(), "scatter: index out of range");
+        std::size_t n = in.size();
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            if (out.size() * sizeof(T) > options.blocked_bytes) {
+                detail::blocked_scatter(out.data(), out.size(), in.data(), index.data(), n, out.get_allocator());
+                return;
+            }
+        }
+        T *to = out.data();
+        const T *from = in.data();
+        const Index *at = index.data();
+        std::size_t i = 0;
+        if (out.size() * sizeof(T) > options.scatter_prefetch_bytes) {
+            for (; i + detail::prefetch_distance < n; ++i) {
+                __builtin_prefetch(to + at[i + detail::prefetch_distance], 1);
+                to[at[i]] = from[i];
+            }
+        }
+        for (; i < n; ++i) {
+            to[at[i]] = from[i];
+        }
+    }
+
+    // Reorders v so that v[i] becomes the old v[perm[i]]. Trivially copyable
+    // elements are gathered into a new buffer that then replaces v's;
+    // others are moved along the permutation's cycles in place. Throws
+    // std::length_error if the sizes differ and std::invalid_argument (or
+    // std::out_of_range) if perm is not a permutation, leaving v unchanged.
+    template<class T, class Allocator, class Index, class IndexAllocator>
+    void apply_permutation(vector<T, Allocator> &v, const vector<Index, IndexAllocator> &perm,
+                           permute_options options = permute_options()) {
+        if (perm.size() != v.size()) {
+            throw std::length_error("apply_permutation: permutation and values differ in length");
+        }
+        detail::check_permutation(perm);
+        if constexpr (std::is_trivially_copyable<T>::value && std::is_default_constructible<T>::value) {
+            vector<T, Allocator> out = gather(v, perm, options);
+            v.swap(out);
+        } else {
+            bit_vector<> done(v.size());
+            for (unsigned int start = 0; start < v.size(); ++start) {
+                if (done.test(start)) {
+                    continue;
+                }
+                T held(std::move(v[start]));
+                unsigned int at = start;
+                for (;;) {
+                    done.set(at);
+                    unsigned int next = static_cast<unsigned int>(perm[at]);
+                    if (next == start) {
+                        v[at] = std::move(held);
+                        break;
+                    }
+                    v[at] = std::move(v[next]);
+                    at = next;
+                }
+            }
+        }
+    }
+}
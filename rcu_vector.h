@@ -0,0 +1,246 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // Read-copy-update wrapper around pretty_vector::vector. Readers pin the
+    // current snapshot without locks: each reader owns a cache-line sized slot
+    // where it announces the epoch it entered in, so concurrent readers never
+    // write to a shared line. Writers build a new vector, publish it with one
+    // atomic pointer exchange and retire the old one; a retired snapshot is freed
+    // once no reader slot shows an epoch old enough to still be looking at it.
+    //
+    // Writers are serialized by a mutex readers never touch. Each reader handle
+    // holds at most one read_guard at a time.
+    template<class T, class Allocator = std::allocator<T>>
+    class rcu_vector {
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+        using storage_type = vector<T, Allocator>;
+
+        static constexpr std::size_t cache_line = 64;
+
+        // keeps one snapshot alive; reading through it never blocks the writer
+        class read_guard {
+        public:
+            read_guard(read_guard &&other) noexcept : slot_(other.slot_), items_(other.items_) {
+                other.slot_ = nullptr;
+            }
+
+            read_guard(const read_guard &) = delete;
+
+            read_guard &operator=(const read_guard &) = delete;
+
+            ~read_guard() {
+                if (slot_) {
+                    slot_->epoch.store(idle, std::memory_order_release);
+                }
+            }
+
+            const storage_type &operator*() const { return *items_; }
+
+            const storage_type *operator->() const { return items_; }
+
+            size_type size() const { return items_->size(); }
+
+            const T &operator[](size_type pos) const { return items_->data()[pos]; }
+
+        private:
+            friend class rcu_vector;
+
+            read_guard(typename rcu_vector::slot *slot, const storage_type *items) : slot_(slot), items_(items) {}
+
+            typename rcu_vector::slot *slot_;
+            const storage_type *items_;
+        };
+
+        // a registered reader; create one per reading thread and keep it
+        class reader {
+        public:
+            reader(reader &&other) noexcept : owner_(other.owner_), slot_(other.slot_) {
+                other.slot_ = nullptr;
+            }
+
+            reader(const reader &) = delete;
+
+            reader &operator=(const reader &) = delete;
+
+            ~reader() {
+                if (slot_) {
+                    slot_->in_use.store(false, std::memory_order_release);
+                }
+            }
+
+            // The slot store and the pointer load are both seq_cst: a writer that
+            // swaps the pointer afterwards is guaranteed to see this slot when it
+            // decides what to free.
+            read_guard read() const {
+                std::uint64_t epoch = owner_->epoch_.load(std::memory_order_seq_cst);
+                slot_->epoch.store(epoch, std::memory_order_seq_cst);
+                return read_guard(slot_, owner_->current_.load(std::memory_order_seq_cst));
+            }
+
+        private:
+            friend class rcu_vector;
+
+            reader(const rcu_vector *owner, typename rcu_vector::slot *slot) : owner_(owner), slot_(slot) {}
+
+            const rcu_vector *owner_;
+            typename rcu_vector::slot *slot_;
+        };
+
+        explicit rcu_vector(size_type max_readers = 64, const Allocator &alloc = Allocator()) :
+                rcu_vector(storage_type(alloc), max_readers, alloc) {}
+
+        explicit rcu_vector(storage_type items, size_type max_readers = 64, const Allocator &alloc = Allocator()) :
+                allocator_(alloc), slots_(max_readers), epoch_(0), current_(make_snapshot(std::move(items))) {}
+
+        rcu_vector(const rcu_vector &) = delete;
+
+        rcu_vector &operator=(const rcu_vector &) = delete;
+
+        // all reader handles must be gone by now
+        ~rcu_vector() {
+            for (size_type i = 0; i < retired_.size(); ++i) {
+                destroy_snapshot(retired_.data()[i].items);
+            }
+            destroy_snapshot(current_.load(std::memory_order_relaxed));
+        }
+
+        // claims a free reader slot; throws length_error when all are taken
+        reader make_reader() const {
+            for (size_type i = 0; i < slots_.size(); ++i) {
+                bool expected = false;
+                slot &candidate = slots_.data()[i];
+                if (candidate.in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    return reader(this, &candidate);
+                }
+            }
+            throw std::length_error("rcu_vector has no free reader slot");
+        }
+
+        // publishes `items` as the new snapshot; the old one is retired
+        void publish(storage_type items) {
+            storage_type *next = make_snapshot(std::move(items));
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            retire(current_.exchange(next, std::memory_order_seq_cst));
+        }
+
+        // copies the current snapshot, lets f edit the copy and publishes it
+        template<class F>
+        void update(F f) {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            storage_type *next = make_snapshot(*current_.load(std::memory_order_relaxed));
+            try {
+                f(*next);
+            } catch (...) {
+                destroy_snapshot(next);
+                throw;
+            }
+            retire(current_.exchange(next, std::memory_order_seq_cst));
+        }
+
+        // frees the retired snapshots no reader can still see and returns how
+        // many are left waiting
+        size_type reclaim() {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            return reclaim_locked();
+        }
+
+        // waits until every retired snapshot has been freed
+        void synchronize() {
+            while (reclaim() > 0) {
+                std::this_thread::yield();
+            }
+        }
+
+        size_type retired() const {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            return retired_.size();
+        }
+
+        std::uint64_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+
+        // snapshot size as a writer sees it; readers use read()->size()
+        size_type size() const { return current_.load(std::memory_order_acquire)->size(); }
+
+    private:
+        static constexpr std::uint64_t idle = std::numeric_limits<std::uint64_t>::max();
+
+        struct alignas(cache_line) slot {
+            slot() : epoch(idle), in_use(false) {}
+
+            std::atomic<std::uint64_t> epoch;
+            std::atomic<bool> in_use;
+        };
+
+        struct retired_snapshot {
+            storage_type *items;
+            std::uint64_t epoch;
+        };
+
+        using snapshot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<storage_type>;
+
+        Allocator allocator_;
+        mutable vector<slot, pretty_allocator::allocator<slot, cache_line>> slots_;
+        alignas(cache_line) std::atomic<std::uint64_t> epoch_;
+        alignas(cache_line) std::atomic<storage_type *> current_;
+        alignas(cache_line) mutable std::mutex writer_mutex_;
+        vector<retired_snapshot> retired_;
+
+        template<class Items>
+        storage_type *make_snapshot(Items &&items) {
+            snapshot_allocator alloc(allocator_);
+            storage_type *result = std::allocator_traits<snapshot_allocator>::allocate(alloc, 1);
+            try {
+                ::new(static_cast<void *>(result)) storage_type(std::forward<Items>(items));
+            } catch (...) {
+                std::allocator_traits<snapshot_allocator>::deallocate(alloc, result, 1);
+                throw;
+            }
+            return result;
+        }
+
+        void destroy_snapshot(storage_type *items) {
+            snapshot_allocator alloc(allocator_);
+            items->~storage_type();
+            std::allocator_traits<snapshot_allocator>::deallocate(alloc, items, 1);
+        }
+
+        // Readers that saw the old pointer read the epoch before this increment,
+        // so the snapshot is tagged with the pre-increment value and freed once
+        // every active slot shows a later epoch.
+        void retire(storage_type *old) {
+            std::uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+            retired_.push_back(retired_snapshot{old, epoch});
+            reclaim_locked();
+        }
+
+        size_type reclaim_locked() {
+            std::uint64_t oldest = idle;
+            for (size_type i = 0; i < slots_.size(); ++i) {
+                oldest = std::min(oldest, slots_.data()[i].epoch.load(std::memory_order_seq_cst));
+            }
+            size_type kept = 0;
+            for (size_type i = 0; i < retired_.size(); ++i) {
+                retired_snapshot entry = retired_.data()[i];
+                if (entry.epoch < oldest) {
+                    destroy_snapshot(entry.items);
+                } else {
+                    retired_.data()[kept++] = entry;
+                }
+            }
+            while (retired_.size() > kept) {
+                retired_.pop_back();
+            }
+            return kept;
+        }
+    };
+}
@@ -0,0 +1,245 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include "bit_vector.h"
+#include "parallel.h"
+#include "simd_kernels.h"
+#include "vector.h"
+
+namespace pretty_vector {
+
+    struct scan_options {
+        // worker threads, the calling one included; 0 means one per core
+        unsigned int threads = 0;
+        // shorter inputs are scanned on the calling thread only; a scan is
+        // bound by memory bandwidth well before it is by the adds
+        unsigned int parallel_threshold = 1u << 18;
+    };
+
+    namespace scan_detail {
+        template<class T>
+        void check_element() {
+            static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                          "scans need arithmetic elements");
+        }
+
+        // first element of chunk t of `chunks`, on a 64-byte boundary so no two
+        // threads write to the same cache line
+        template<class T>
+        std::size_t chunk_begin(std::size_t n, unsigned int chunks, unsigned int t) {
+            if (t == chunks) {
+                return n;
+            }
+            constexpr std::size_t line = 64 / sizeof(T) ? 64 / sizeof(T) : 1;
+            return n / chunks * t / line * line;
+        }
+
+        // a + b in the kernels' scan type, so integer sums wrap around as
+        // unsigned instead of overflowing
+        template<class T>
+        T add(T a, T b) {
+            typedef typename simd::kernels_detail::scan_type<T>::type U;
+            return static_cast<T>(static_cast<U>(static_cast<U>(a) + static_cast<U>(b)));
+        }
+
+        // Runs below this length are added up in place; longer ones go
+        // through the dispatched SIMD kernel.
+        constexpr std::size_t short_run = 16;
+
+        template<class T>
+        T scan_run(const T *in, T *out, std::size_t n, T carry, bool exclusive) {
+            if (n >= short_run) {
+                return exclusive ? simd::exclusive_scan(in, out, n, carry)
+                                 : simd::inclusive_scan(in, out, n, carry);
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                T x = in[i];
+                if (exclusive) {
+                    out[i] = carry;
+                }
+                carry = add(carry, x);
+                if (!exclusive) {
+                    out[i] = carry;
+                }
+            }
+            return carry;
+        }
+
+        // Reduce-then-scan: every thread sums its chunk, the chunk offsets are
+        // added up in order, then every thread scans its chunk from its
+        // offset. The input is read twice but the output written only once.
+        template<class T>
+        void scan(const T *in, T *out, std::size_t n, T init, bool exclusive, const scan_options &options) {
+            unsigned int threads = detail::thread_count(options.threads, options.parallel_threshold, n);
+            if (threads <= 1) {
+                scan_run(in, out, n, init, exclusive);
+                return;
+            }
+            vector<T> offset(threads, T());
+            detail::parallel_for(threads - 1, [&](unsigned int t) {
+                std::size_t begin = chunk_begin<T>(n, threads, t), end = chunk_begin<T>(n, threads, t + 1);
+                offset[t + 1] = simd::sum(in + begin, end - begin);
+            });
+            offset[0] = init;
+            for (unsigned int t = 1; t < threads; ++t) {
+                offset[t] = add(offset[t - 1], offset[t]);
+            }
+            detail::parallel_for(threads, [&](unsigned int t) {
+                std::size_t begin = chunk_begin<T>(n, threads, t), end = chunk_begin<T>(n, threads, t + 1);
+                scan_run(in + begin, out + begin, end - begin, offset[t], exclusive);
+            });
+        }
+
+        // last set bit in [begin, end), or end if there is none
+        inline std::size_t last_set(const std::uint64_t *words, std::size_t begin, std::size_t end) {
+            std::size_t limit = end;
+            while (limit > begin) {
+                std::size_t word = (limit - 1) / 64, low = word * 64;
+                std::uint64_t bits = words[word];
+                if (limit - low < 64) {
+                    bits &= (std::uint64_t(1) << (limit - low)) - 1;
+                }
+                if (low < begin) {
+                    bits &= ~std::uint64_t(0) << (begin - low);
+                }
+                if (bits) {
+                    return low + 63 - static_cast<std::size_t>(__builtin_clzll(bits));
+                }
+                limit = low;
+            }
+            return end;
+        }
+
+        // scans [begin, end), restarting from init at every set bit of heads;
+        // the running total enters begin as carry
+        template<class T>
+        void segmented_run(const T *in, T *out, std::size_t begin, std::size_t end, const std::uint64_t *heads,
+                           T carry, T init, bool exclusive) {
+            if (exclusive) {
+                simd::segmented_exclusive_scan(in + begin, out + begin, end - begin, heads, begin, carry, init);
+            } else {
+                simd::segmented_inclusive_scan(in + begin, out + begin, end - begin, heads, begin, carry, init);
+            }
+        }
+
+        // As scan, except that a chunk with a head in it passes on only the
+        // sum after its last head, started from init.
+        template<class T>
+        void segmented_scan(const T *in, T *out, std::size_t n, const std::uint64_t *heads, T init,
+                            bool exclusive, const scan_options &options) {
+            if (n == 0) {
+                return;
+            }
+            unsigned int threads = detail::thread_count(options.threads, options.parallel_threshold, n);
+            if (threads <= 1) {
+                segmented_run(in, out, 0, n, heads, init, init, exclusive);
+                return;
+            }
+            vector<T> tail(threads, T());
+            vector<unsigned char> restarts(threads, 0);
+            detail::parallel_for(threads - 1, [&](unsigned int t) {
+                std::size_t begin = chunk_begin<T>(n, threads, t), end = chunk_begin<T>(n, threads, t + 1);
+                std::size_t last = last_set(heads, begin, end);
+                restarts[t] = last != end;
+                std::size_t from = last != end ? last : begin;
+                tail[t] = simd::sum(in + from, end - from);
+            });
+            vector<T> carry(threads, init);
+            for (unsigned int t = 1; t < threads; ++t) {
+                carry[t] = add(restarts[t - 1] ? init : carry[t - 1], tail[t - 1]);
+            }
+            detail::parallel_for(threads, [&](unsigned int t) {
+                std::size_t begin = chunk_begin<T>(n, threads, t), end = chunk_begin<T>(n, threads, t + 1);
+                segmented_run(in, out, begin, end, heads, carry[t], init, exclusive);
+            });
+        }
+
+        template<class T, class Allocator, class HeadAllocator>
+        void check_heads(const vector<T, Allocator> &in, const bit_vector<HeadAllocator> &heads) {
+            if (heads.size() != in.size()) {
+                throw std::length_error("segmented scan: heads and values differ in length");
+            }
+        }
+    }
+
+    // out[i] = in[0] + ... + in[i], with out resized to in.size(); out may be
+    // in. Integers wrap around. Floating point sums are grouped per register
+    // and per thread, so they can round differently than a plain loop.
+    template<class T, class Allocator, class OutAllocator>
+    void inclusive_scan(const vector<T, Allocator> &in, vector<T, OutAllocator> &out,
+                        scan_options options = scan_options()) {
+        scan_detail::check_element<T>();
+        out.resize(in.size());
+        scan_detail::scan(in.data(), out.data(), in.size(), T(), false, options);
+    }
+
+    // the same into a new vector with in's allocator
+    template<class T, class Allocator>
+    vector<T, Allocator> inclusive_scan(const vector<T, Allocator> &in, scan_options options = scan_options()) {
+        vector<T, Allocator> out(in.get_allocator());
+        pretty_vector::inclusive_scan(in, out, options);
+        return out;
+    }
+
+    // out[i] = init + in[0] + ... + in[i - 1]: the offsets of records whose
+    // lengths are in. Otherwise as inclusive_scan.
+    template<class T, class Allocator, class OutAllocator>
+    void exclusive_scan(const vector<T, Allocator> &in, vector<T, OutAllocator> &out,
+                        typename vector<T, Allocator>::value_type init = T(), scan_options options = scan_options()) {
+        scan_detail::check_element<T>();
+        out.resize(in.size());
+        scan_detail::scan(in.data(), out.data(), in.size(), init, true, options);
+    }
+
+    template<class T, class Allocator>
+    vector<T, Allocator> exclusive_scan(const vector<T, Allocator> &in,
+                                        typename vector<T, Allocator>::value_type init = T(),
+                                        scan_options options = scan_options()) {
+        vector<T, Allocator> out(in.get_allocator());
+        pretty_vector::exclusive_scan(in, out, init, options);
+        return out;
+    }
+
+    // inclusive_scan restarted at every set bit of heads (a segment always
+    // starts at 0). Throws std::length_error unless heads is as long as in.
+    template<class T, class Allocator, class HeadAllocator, class OutAllocator>
+    void segmented_inclusive_scan(const vector<T, Allocator> &in, const bit_vector<HeadAllocator> &heads,
+                                  vector<T, OutAllocator> &out, scan_options options = scan_options()) {
+        scan_detail::check_element<T>();
+        scan_detail::check_heads(in, heads);
+        out.resize(in.size());
+        scan_detail::segmented_scan(in.data(), out.data(), in.size(), heads.words(), T(), false, options);
+    }
+
+    template<class T, class Allocator, class HeadAllocator>
+    vector<T, Allocator> segmented_inclusive_scan(const vector<T, Allocator> &in,
+                                                  const bit_vector<HeadAllocator> &heads,
+                                                  scan_options options = scan_options()) {
+        vector<T, Allocator> out(in.get_allocator());
+        pretty_vector::segmented_inclusive_scan(in, heads, out, options);
+        return out;
+    }
+
+    // exclusive_scan restarted from init at every set bit of heads
+    template<class T, class Allocator, class HeadAllocator, class OutAllocator>
+    void segmented_exclusive_scan(const vector<T, Allocator> &in, const bit_vector<HeadAllocator> &heads,
+                                  vector<T, OutAllocator> &out, typename vector<T, Allocator>::value_type init = T(),
+                                  scan_options options = scan_options()) {
+        scan_detail::check_element<T>();
+        scan_detail::check_heads(in, heads);
+        out.resize(in.size());
+        scan_detail::segmented_scan(in.data(), out.data(), in.size(), heads.words(), init, true, options);
+    }
+
+    template<class T, class Allocator, class HeadAllocator>
+    vector<T, Allocator> segmented_exclusive_scan(const vector<T, Allocator> &in,
+                                                  const bit_vector<HeadAllocator> &heads,
+                                                  typename vector<T, Allocator>::value_type init = T(),
+                                                  scan_options options = scan_options()) {
+        vector<T, Allocator> out(in.get_allocator());
+        pretty_vector::segmented_exclusive_scan(in, heads, out, init, options);
+        return out;
+    }
+}
@@ -0,0 +1,289 @@
+#pragma once
+#include <stdexcept>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // Vector made of fixed-size chunks. Growing appends a chunk and never moves
+    // existing elements, so pointers and references stay valid until the element
+    // is removed. Element i lives at chunks_[i / ChunkSize][i % ChunkSize].
+    template<class T, std::size_t ChunkSize = 512, class Allocator = pretty_allocator::allocator<T>>
+    class segmented_vector {
+        static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of two");
+    public:
+        using value_type = T;
+        using size_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+        using reference = T &;
+        using const_reference = const T &;
+        using pointer = typename std::allocator_traits<Allocator>::pointer;
+        static constexpr size_type chunk_size = ChunkSize;
+
+        // iterators address elements by index through the owning container, so
+        // they survive growth of the chunk table
+        template<bool Const>
+        class basic_iterator {
+            using owner = typename std::conditional<Const, const segmented_vector, segmented_vector>::type;
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using reference = typename std::conditional<Const, const T &, T &>::type;
+            using pointer = typename std::conditional<Const, const T *, T *>::type;
+
+            basic_iterator() : container_(nullptr), index_(0) {}
+
+            basic_iterator(owner *container, size_type index) : container_(container), index_(index) {}
+
+            template<bool C, class = typename std::enable_if<Const && !C>::type>
+            basic_iterator(const basic_iterator<C> &other) : container_(other.container_), index_(other.index_) {}
+
+            reference operator*() const { return (*container_)[index_]; }
+
+            pointer operator->() const { return &(*container_)[index_]; }
+
+            reference operator[](difference_type n) const { return (*container_)[index_ + n]; }
+
+            basic_iterator &operator++() {
+                ++index_;
+                return *this;
+            }
+
+            basic_iterator operator++(int) { return basic_iterator(container_, index_++); }
+
+            basic_iterator &operator--() {
+                --index_;
+                return *this;
+            }
+
+            basic_iterator operator--(int) { return basic_iterator(container_, index_--); }
+
+            basic_iterator &operator+=(difference_type n) {
+                index_ += n;
+                return *this;
+            }
+
+            basic_iterator &operator-=(difference_type n) {
+                index_ -= n;
+                return *this;
+            }
+
+            basic_iterator operator+(difference_type n) const { return basic_iterator(container_, index_ + n); }
+
+            basic_iterator operator-(difference_type n) const { return basic_iterator(container_, index_ - n); }
+
+            difference_type operator-(const basic_iterator &other) const {
+                return difference_type(index_) - difference_type(other.index_);
+            }
+
+            bool operator==(const basic_iterator &other) const { return index_ == other.index_; }
+
+            bool operator!=(const basic_iterator &other) const { return index_ != other.index_; }
+
+            bool operator<(const basic_iterator &other) const { return index_ < other.index_; }
+
+        private:
+            template<bool>
+            friend class basic_iterator;
+
+            owner *container_;
+            size_type index_;
+        };
+
+        using iterator = basic_iterator<false>;
+        using const_iterator = basic_iterator<true>;
+
+        explicit segmented_vector(const Allocator &alloc = Allocator()) : allocator_(alloc), size_(0) {}
+
+        segmented_vector(std::initializer_list<T> init, const Allocator &alloc = Allocator()) :
+                segmented_vector(alloc) {
+            for (const T &value : init) {
+                push_back(value);
+            }
+        }
+
+        segmented_vector(const segmented_vector &other) :
+                allocator_(std::allocator_traits<Allocator>::select_on_container_copy_construction(other.allocator_)),
+                size_(0) {
+            append_from(other);
+        }
+
+        segmented_vector(segmented_vector &&other) noexcept :
+                allocator_(std::move(other.allocator_)), chunks_(std::move(other.chunks_)), size_(other.size_) {
+            other.size_ = 0;
+        }
+
+        segmented_vector &operator=(const segmented_vector &other) {
+            if (this != &other) {
+                clear();
+                append_from(other);
+            }
+            return *this;
+        }
+
+        segmented_vector &operator=(segmented_vector &&other) noexcept {
+            if (this != &other) {
+                release_chunks();
+                allocator_ = std::move(other.allocator_);
+                chunks_ = std::move(other.chunks_);
+                size_ = other.size_;
+                other.size_ = 0;
+            }
+            return *this;
+        }
+
+        ~segmented_vector() {
+            release_chunks();
+        }
+
+        size_type size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        size_type capacity() const { return chunks_.size() * chunk_size; }
+
+        size_type chunk_count() const { return chunks_.size(); }
+
+        reference operator[](size_type pos) {
+            return chunks_.data()[pos / chunk_size][pos % chunk_size];
+        }
+
+        const_reference operator[](size_type pos) const {
+            return chunks_.data()[pos / chunk_size][pos % chunk_size];
+        }
+
+        reference at(size_type pos) {
+            check_range(pos);
+            return (*this)[pos];
+        }
+
+        const_reference at(size_type pos) const {
+            check_range(pos);
+            return (*this)[pos];
+        }
+
+        reference front() { return at(0); }
+
+        const_reference front() const { return at(0); }
+
+        reference back() { return at(size_ - 1); }
+
+        const_reference back() const { return at(size_ - 1); }
+
+        // allocates chunks up front; elements still never move
+        void reserve(size_type size) {
+            while (capacity() < size) {
+                add_chunk();
+            }
+        }
+
+        template<typename ...Args>
+        reference emplace_back(Args &&... args) {
+            if (size_ == capacity()) {
+                add_chunk();
+            }
+            pointer slot = chunks_.data()[size_ / chunk_size] + size_ % chunk_size;
+            std::allocator_traits<Allocator>::construct(allocator_, slot, std::forward<Args>(args)...);
+            ++size_;
+            return *slot;
+        }
+
+        void push_back(const T &value) {
+            emplace_back(value);
+        }
+
+        void push_back(T &&value) {
+            emplace_back(std::move(value));
+        }
+
+        void pop_back() {
+            if (size_ > 0) {
+                --size_;
+                std::allocator_traits<Allocator>::destroy(allocator_, &(*this)[size_]);
+            }
+        }
+
+        void clear() {
+            while (size_ > 0) {
+                pop_back();
+            }
+        }
+
+        // frees the chunks past the last element
+        void shrink_to_fit() {
+            size_type used = (size_ + chunk_size - 1) / chunk_size;
+            while (chunks_.size() > used) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, chunks_.back(), chunk_size);
+                chunks_.pop_back();
+            }
+            chunks_.shrink_to_fit();
+        }
+
+        // calls f(pointer, count) once per chunk holding elements, in order
+        template<class F>
+        void for_each_chunk(F f) {
+            for (size_type done = 0, chunk = 0; done < size_; done += chunk_size, ++chunk) {
+                f(chunks_.data()[chunk], std::min<size_type>(chunk_size, size_ - done));
+            }
+        }
+
+        template<class F>
+        void for_each_chunk(F f) const {
+            for (size_type done = 0, chunk = 0; done < size_; done += chunk_size, ++chunk) {
+                f(static_cast<const T *>(chunks_.data()[chunk]), std::min<size_type>(chunk_size, size_ - done));
+            }
+        }
+
+        iterator begin() { return iterator(this, 0); }
+
+        iterator end() { return iterator(this, size_); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+
+        const_iterator end() const { return const_iterator(this, size_); }
+
+        void swap(segmented_vector &other) noexcept {
+            std::swap(allocator_, other.allocator_);
+            chunks_.swap(other.chunks_);
+            std::swap(size_, other.size_);
+        }
+
+    private:
+        Allocator allocator_;
+        vector<pointer> chunks_;
+        size_type size_;
+
+        void add_chunk() {
+            pointer chunk = std::allocator_traits<Allocator>::allocate(allocator_, chunk_size);
+            try {
+                chunks_.push_back(chunk);
+            } catch (...) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, chunk, chunk_size);
+                throw;
+            }
+        }
+
+        void release_chunks() noexcept {
+            clear();
+            for (size_type i = 0; i < chunks_.size(); ++i) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, chunks_.data()[i], chunk_size);
+            }
+            chunks_.clear();
+        }
+
+        void append_from(const segmented_vector &other) {
+            reserve(other.size_);
+            other.for_each_chunk([this](const T *data, size_type count) {
+                for (size_type i = 0; i < count; ++i) {
+                    emplace_back(data[i]);
+                }
+            });
+        }
+
+        void check_range(size_type pos) const {
+            if (pos >= size_) {
+                throw std::out_of_range("Index out of segmented_vector range");
+            }
+        }
+    };
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PRETTY_VECTOR_X86_SIMD 1
+#define PRETTY_VECTOR_TARGET_SSE2 __attribute__((target("sse2")))
+#define PRETTY_VECTOR_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define PRETTY_VECTOR_TARGET_AVX2 __attribute__((target("avx2,bmi2,popcnt")))
+#define PRETTY_VECTOR_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,bmi2,popcnt")))
+#endif
+
+#if defined(__GNUC__)
+#define PRETTY_VECTOR_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define PRETTY_VECTOR_ALWAYS_INLINE inline
+#endif
+
+namespace pretty_vector {
+    namespace simd {
+
+        // instruction sets kernels are compiled for, narrowest first
+        enum class level {
+            scalar, sse2, sse42, avx2, avx512
+        };
+
+        inline const char *name(level l) {
+            switch (l) {
+                case level::sse2:
+                    return "sse2";
+                case level::sse42:
+                    return "sse4.2";
+                case level::avx2:
+                    return "avx2";
+                case level::avx512:
+                    return "avx512";
+                default:
+                    return "scalar";
+            }
+        }
+
+        struct cpu_features {
+            bool sse2 = false;
+            bool sse42 = false;
+            bool popcnt = false;
+            bool avx2 = false;
+            bool bmi2 = false;
+            bool avx512f = false;
+            bool avx512bw = false;
+        };
+
+        // What this CPU and OS support, read once. __builtin_cpu_supports runs
+        // cpuid at startup and also checks that the OS saves the AVX registers.
+        inline const cpu_features &features() {
+            static const cpu_features result = [] {
+                cpu_features f;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                __builtin_cpu_init();
+                f.sse2 = __builtin_cpu_supports("sse2");
+                f.sse42 = __builtin_cpu_supports("sse4.2");
+                f.popcnt = __builtin_cpu_supports("popcnt");
+                f.avx2 = __builtin_cpu_supports("avx2");
+                f.bmi2 = __builtin_cpu_supports("bmi2");
+                f.avx512f = __builtin_cpu_supports("avx512f");
+                f.avx512bw = __builtin_cpu_supports("avx512bw");
+#endif
+                return f;
+            }();
+            return result;
+        }
+
+        // the widest level this CPU runs; each level needs all the features its
+        // kernels are compiled for
+        inline level detected() {
+            static const level result = [] {
+                const cpu_features &f = features();
+                if (f.avx512f && f.avx512bw && f.avx2 && f.bmi2 && f.popcnt) {
+                    return level::avx512;
+                }
+                if (f.avx2 && f.bmi2 && f.popcnt) {
+                    return level::avx2;
+                }
+                if (f.sse42 && f.popcnt) {
+                    return level::sse42;
+                }
+                if (f.sse2) {
+                    return level::sse2;
+                }
+                return level::scalar;
+            }();
+            return result;
+        }
+
+        inline std::atomic<level> &level_cap() {
+            static std::atomic<level> cap(level::avx512);
+            return cap;
+        }
+
+        // the level kernels dispatch to: detected(), unless lowered by set_level
+        inline level active() {
+            level cap = level_cap().load(std::memory_order_relaxed);
+            return cap < detected() ? cap : detected();
+        }
+
+        // Caps the dispatch level, e.g. to test or time the narrower kernels.
+        // Returns the previous cap.
+        inline level set_level(level cap) {
+            return level_cap().exchange(cap, std::memory_order_relaxed);
+        }
+
+#if defined(PRETTY_VECTOR_X86_SIMD)
+        // GCC vector extension type of `Bytes` bytes of T
+        template<class T, unsigned int Bytes>
+        struct pack {
+            typedef T type __attribute__((vector_size(Bytes)));
+        };
+#endif
+    }
+}
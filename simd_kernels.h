@@ -0,0 +1,1300 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "simd.h"
+
+#if defined(PRETTY_VECTOR_X86_SIMD)
+#include <immintrin.h>
+#endif
+
+namespace pretty_vector {
+    namespace simd {
+
+        // Bulk kernels over trivially copyable elements of 1, 2, 4 or 8 bytes,
+        // one entry per width (see width_index). Element values are passed as
+        // their bit pattern in the low bytes of a uint64_t, so find and count
+        // compare bits; the typed find() and count() below fix up floats.
+        struct kernel_table {
+            level isa;
+            bool (*equal)(const void *a, const void *b, std::size_t bytes);
+            void (*fill[4])(void *first, std::uint64_t value, std::size_t count);
+            std::size_t (*find[4])(const void *first, std::size_t count, std::uint64_t value);
+            std::size_t (*count[4])(const void *first, std::size_t count, std::uint64_t value);
+            // index of the first differing byte, or `bytes`
+            std::size_t (*mismatch)(const void *a, const void *b, std::size_t bytes);
+            // Left-packs the elements of `first` whose bit in `drop` is clear
+            // (bit i of drop[i / 64] is element i) to `to` and returns how many
+            // were kept. `to` may equal `first` or lie before it; up to `count`
+            // elements of `to` may be written.
+            std::size_t (*compact[4])(void *to, const void *first, const std::uint64_t *drop, std::size_t count);
+            // to[i] = first[index[i]] for i < count; indices must be below 2^31
+            void (*gather[4])(void *to, const void *first, const std::uint32_t *index, std::size_t count);
+            // overlapping moves of raw bytes; libc's memmove already picks its
+            // own per-CPU implementation, so every level shares it
+            void *(*relocate)(void *to, const void *from, std::size_t bytes);
+        };
+
+        template<class T>
+        struct has_kernel_width : std::integral_constant<bool, std::is_trivially_copyable<T>::value &&
+                                                               (sizeof(T) == 1 || sizeof(T) == 2 ||
+                                                                sizeof(T) == 4 || sizeof(T) == 8)> {
+        };
+
+        constexpr unsigned int width_index(std::size_t bytes) {
+            return bytes == 1 ? 0 : bytes == 2 ? 1 : bytes == 4 ? 2 : 3;
+        }
+
+        namespace kernels_detail {
+            template<class U>
+            PRETTY_VECTOR_ALWAYS_INLINE U from_bits(std::uint64_t bits) {
+                U value;
+                std::memcpy(&value, &bits, sizeof(U));
+                return value;
+            }
+
+            // Every kernel has a scalar body (Bytes == 0) and a pack body for a
+            // register of Bytes bytes. The bodies are always inlined into the
+            // per-level entry points below, which is where they pick up the
+            // instruction set; they use GCC vector extensions only, so nothing
+            // in them is tied to one target.
+#if defined(PRETTY_VECTOR_X86_SIMD)
+            template<class M>
+            PRETTY_VECTOR_ALWAYS_INLINE bool any_set(const M &mask) {
+                std::uint64_t words[sizeof(M) / 8];
+                std::memcpy(words, &mask, sizeof(M));
+                std::uint64_t folded = 0;
+                for (unsigned int k = 0; k < sizeof(M) / 8; ++k) {
+                    folded |= words[k];
+                }
+                return folded != 0;
+            }
+#endif
+
+            struct equal_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE bool run(const void *a, const void *b, std::size_t bytes) {
+                    const unsigned char *x = static_cast<const unsigned char *>(a);
+                    const unsigned char *y = static_cast<const unsigned char *>(b);
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0) {
+                        typedef typename pack<std::uint64_t, Bytes>::type words;
+                        for (; i + 4 * Bytes <= bytes; i += 4 * Bytes) {
+                            words diff = words{};
+                            for (unsigned int k = 0; k < 4; ++k) {
+                                words u, v;
+                                std::memcpy(&u, x + i + k * Bytes, Bytes);
+                                std::memcpy(&v, y + i + k * Bytes, Bytes);
+                                diff |= u ^ v;
+                            }
+                            if (any_set(diff)) {
+                                return false;
+                            }
+                        }
+                    }
+#endif
+                    return std::memcmp(x + i, y + i, bytes - i) == 0;
+                }
+            };
+
+            struct mismatch_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE std::size_t run(const void *a, const void *b, std::size_t bytes) {
+                    const unsigned char *x = static_cast<const unsigned char *>(a);
+                    const unsigned char *y = static_cast<const unsigned char *>(b);
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0) {
+                        typedef typename pack<std::uint64_t, Bytes>::type words;
+                        for (; i + Bytes <= bytes; i += Bytes) {
+                            words u, v;
+                            std::memcpy(&u, x + i, Bytes);
+                            std::memcpy(&v, y + i, Bytes);
+                            if (any_set(u ^ v)) {
+                                break;
+                            }
+                        }
+                    }
+#endif
+                    for (; i < bytes; ++i) {
+                        if (x[i] != y[i]) {
+                            return i;
+                        }
+                    }
+                    return bytes;
+                }
+            };
+
+            template<class U>
+            struct fill_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE void run(void *first, std::uint64_t bits, std::size_t count) {
+                    U *out = static_cast<U *>(first);
+                    U value = from_bits<U>(bits);
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0) {
+                        typedef typename pack<U, Bytes>::type values;
+                        constexpr std::size_t lanes = Bytes / sizeof(U);
+                        values pattern = values{} + value;
+                        for (; i + lanes <= count; i += lanes) {
+                            std::memcpy(out + i, &pattern, Bytes);
+                        }
+                    }
+#endif
+                    for (; i < count; ++i) {
+                        out[i] = value;
+                    }
+                }
+            };
+
+            // Scans four registers per step and only looks for the lane once
+            // one of them matched.
+            template<class U>
+            struct find_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE std::size_t run(const void *first, std::size_t count,
+                                                                   std::uint64_t bits) {
+                    const U *in = static_cast<const U *>(first);
+                    U value = from_bits<U>(bits);
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0) {
+                        typedef typename pack<U, Bytes>::type values;
+                        constexpr std::size_t lanes = Bytes / sizeof(U);
+                        typedef typename pack<std::uint64_t, Bytes>::type mask;
+                        values needle = values{} + value;
+                        for (; i + 4 * lanes <= count; i += 4 * lanes) {
+                            values a, b, c, d;
+                            std::memcpy(&a, in + i, Bytes);
+                            std::memcpy(&b, in + i + lanes, Bytes);
+                            std::memcpy(&c, in + i + 2 * lanes, Bytes);
+                            std::memcpy(&d, in + i + 3 * lanes, Bytes);
+                            // the masks are combined as plain words; GCC splits OR-ed
+                            // compare results into scalar code otherwise
+                            if (any_set((mask) (a == needle) | (mask) (b == needle) |
+                                        (mask) (c == needle) | (mask) (d == needle))) {
+                                break;
+                            }
+                        }
+                    }
+#endif
+                    for (; i < count; ++i) {
+                        if (in[i] == value) {
+                            return i;
+                        }
+                    }
+                    return count;
+                }
+            };
+
+            // Matching lanes compare to -1, so subtracting the comparison counts
+            // per lane; narrow lanes are folded before they can wrap.
+            template<class U>
+            struct count_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE std::size_t run(const void *first, std::size_t count,
+                                                                   std::uint64_t bits) {
+                    const U *in = static_cast<const U *>(first);
+                    U value = from_bits<U>(bits);
+                    std::size_t i = 0, total = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0) {
+                        typedef typename pack<U, Bytes>::type values;
+                        constexpr std::size_t lanes = Bytes / sizeof(U);
+                        constexpr std::size_t max_steps = sizeof(U) >= 4 ? std::size_t(1) << 30
+                                                                         : std::numeric_limits<U>::max();
+                        values needle = values{} + value;
+                        while (i + lanes <= count) {
+                            values hits = values{};
+                            std::size_t steps = std::min<std::size_t>((count - i) / lanes, max_steps);
+                            for (std::size_t s = 0; s < steps; ++s, i += lanes) {
+                                values x;
+                                std::memcpy(&x, in + i, Bytes);
+                                hits -= (values) (x == needle);
+                            }
+                            U lane_hits[lanes];
+                            std::memcpy(lane_hits, &hits, Bytes);
+                            for (std::size_t k = 0; k < lanes; ++k) {
+                                total += lane_hits[k];
+                            }
+                        }
+                    }
+#endif
+                    for (; i < count; ++i) {
+                        total += in[i] == value;
+                    }
+                    return total;
+                }
+            };
+
+            // first index with lo <= x <= hi, compared as E (signed, unsigned or
+            // floating point), so NaN never matches
+            template<class E>
+            struct range_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE std::size_t run(const E *in, std::size_t count, E lo, E hi) {
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0) {
+                        typedef typename pack<E, Bytes>::type values;
+                        constexpr std::size_t lanes = Bytes / sizeof(E);
+                        typedef typename pack<std::uint64_t, Bytes>::type mask;
+                        values low = values{} + lo, high = values{} + hi;
+                        for (; i + 2 * lanes <= count; i += 2 * lanes) {
+                            values a, b;
+                            std::memcpy(&a, in + i, Bytes);
+                            std::memcpy(&b, in + i + lanes, Bytes);
+                            mask hit = ((mask) (a >= low) & (mask) (a <= high)) |
+                                       ((mask) (b >= low) & (mask) (b <= high));
+                            if (any_set(hit)) {
+                                break;
+                            }
+                        }
+                    }
+#endif
+                    for (; i < count; ++i) {
+                        if (lo <= in[i] && in[i] <= hi) {
+                            return i;
+                        }
+                    }
+                    return count;
+                }
+            };
+
+            // Per-level building blocks that need instructions the vector
+            // extensions cannot express (movemask, compress, permute). They are
+            // plain inline functions compiled for their level; GCC inlines them
+            // once the kernel body has been inlined into an entry point of that
+            // level. The primary templates mean "no such instruction here".
+            template<unsigned int Bytes, std::size_t Width>
+            struct lane_bits {
+                static constexpr bool available = false;
+            };
+
+            // loads the lanes of one register from from[index[0]] ...; returns how
+            // many indices were consumed, a multiple of the register's lanes
+            template<unsigned int Bytes, std::size_t Width>
+            struct hardware_gather {
+                static constexpr bool available = false;
+            };
+
+            // left-packs the 64 elements at `from` whose bit in `keep` is set to
+            // `to` (to <= from) and returns how many were written; whole
+            // registers are stored, so up to 64 elements of `to` may change
+            template<unsigned int Bytes, std::size_t Width>
+            struct left_pack {
+                static constexpr bool available = false;
+            };
+
+#if defined(PRETTY_VECTOR_X86_SIMD)
+            // one bit per lane of an all-ones-or-zero mask, from the sign bits
+            template<std::size_t Width>
+            struct lane_bits<16, Width> {
+                static constexpr bool available = true;
+
+                static PRETTY_VECTOR_TARGET_SSE2 inline std::uint64_t
+                get(const typename pack<std::uint64_t, 16>::type &mask) {
+                    __m128i m = (__m128i) mask;
+                    if constexpr (Width == 1) {
+                        return static_cast<unsigned int>(_mm_movemask_epi8(m));
+                    } else if constexpr (Width == 2) {
+                        return static_cast<unsigned int>(_mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128())));
+                    } else if constexpr (Width == 4) {
+                        return static_cast<unsigned int>(_mm_movemask_ps(_mm_castsi128_ps(m)));
+                    } else {
+                        return static_cast<unsigned int>(_mm_movemask_pd(_mm_castsi128_pd(m)));
+                    }
+                }
+            };
+
+            template<std::size_t Width>
+            struct lane_bits<32, Width> {
+                static constexpr bool available = true;
+
+                static PRETTY_VECTOR_TARGET_AVX2 inline std::uint64_t
+                get(const typename pack<std::uint64_t, 32>::type &mask) {
+                    __m256i m = (__m256i) mask;
+                    if constexpr (Width == 1) {
+                        return static_cast<unsigned int>(_mm256_movemask_epi8(m));
+                    } else if constexpr (Width == 2) {
+                        return _pext_u32(static_cast<unsigned int>(_mm256_movemask_epi8(m)), 0xAAAAAAAAu);
+                    } else if constexpr (Width == 4) {
+                        return static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+                    } else {
+                        return static_cast<unsigned int>(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+                    }
+                }
+            };
+
+            template<std::size_t Width>
+            struct lane_bits<64, Width> {
+                static constexpr bool available = true;
+
+                static PRETTY_VECTOR_TARGET_AVX512 inline std::uint64_t
+                get(const typename pack<std::uint64_t, 64>::type &mask) {
+                    __m512i m = (__m512i) mask;
+                    if constexpr (Width == 1) {
+                        return _mm512_movepi8_mask(m);
+                    } else if constexpr (Width == 2) {
+                        return _mm512_movepi16_mask(m);
+                    } else if constexpr (Width == 4) {
+                        return _mm512_test_epi32_mask(m, m);
+                    } else {
+                        return _mm512_test_epi64_mask(m, m);
+                    }
+                }
+            };
+
+            // AVX2 has no compress: the kept lane indices are gathered into a
+            // vpermd control with pdep/pext, 8 dwords (or 4 qwords) at a time
+            template<std::size_t Width>
+            struct left_pack<32, Width> {
+                static constexpr bool available = Width == 4 || Width == 8;
+
+                static PRETTY_VECTOR_TARGET_AVX2 inline std::size_t
+                run(void *to, const void *from, std::uint64_t keep) {
+                    unsigned char *out = static_cast<unsigned char *>(to);
+                    const unsigned char *in = static_cast<const unsigned char *>(from);
+                    constexpr unsigned int lanes = 32 / Width;
+                    std::size_t kept = 0;
+                    for (unsigned int c = 0; c < 64; c += lanes) {
+                        std::uint64_t dwords = (keep >> c) & ((std::uint64_t(1) << lanes) - 1);
+                        if (Width == 8) {
+                            dwords = _pdep_u64(dwords, 0x55) * 3;
+                        }
+                        std::uint64_t spread = _pdep_u64(dwords, 0x0101010101010101ull) * 0xFF;
+                        __m256i order = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(
+                                static_cast<long long>(_pext_u64(0x0706050403020100ull, spread))));
+                        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + c * Width));
+                        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + kept * Width),
+                                            _mm256_permutevar8x32_epi32(v, order));
+                        kept += _mm_popcnt_u64(dwords) * 4 / Width;
+                    }
+                    return kept;
+                }
+            };
+
+            template<std::size_t Width>
+            struct hardware_gather<32, Width> {
+                static constexpr bool available = Width == 4 || Width == 8;
+
+                static PRETTY_VECTOR_TARGET_AVX2 inline std::size_t
+                run(void *to, const void *from, const std::uint32_t *index, std::size_t count) {
+                    unsigned char *out = static_cast<unsigned char *>(to);
+                    std::size_t i = 0;
+                    if constexpr (Width == 4) {
+                        for (; i + 8 <= count; i += 8) {
+                            __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(index + i));
+                            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i * 4),
+                                                _mm256_i32gather_epi32(static_cast<const int *>(from), lanes, 4));
+                        }
+                    } else {
+                        for (; i + 4 <= count; i += 4) {
+                            __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(index + i));
+                            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i * 8),
+                                                _mm256_i64gather_epi64(static_cast<const long long *>(from),
+                                                                       _mm256_cvtepu32_epi64(lanes), 8));
+                        }
+                    }
+                    return i;
+                }
+            };
+
+            // the 256-bit gathers measured faster than the 512-bit ones, so the
+            // AVX-512 level keeps them
+            template<std::size_t Width>
+            struct hardware_gather<64, Width> : hardware_gather<32, Width> {
+            };
+
+            template<std::size_t Width>
+            struct left_pack<64, Width> {
+                static constexpr bool available = Width == 4 || Width == 8;
+
+                static PRETTY_VECTOR_TARGET_AVX512 inline std::size_t
+                run(void *to, const void *from, std::uint64_t keep) {
+                    unsigned char *out = static_cast<unsigned char *>(to);
+                    const unsigned char *in = static_cast<const unsigned char *>(from);
+                    constexpr unsigned int lanes = 64 / Width;
+                    std::size_t kept = 0;
+                    for (unsigned int c = 0; c < 64; c += lanes) {
+                        std::uint64_t lane_keep = (keep >> c) & ((std::uint64_t(1) << lanes) - 1);
+                        __m512i v = _mm512_loadu_si512(in + c * Width);
+                        __m512i packed = Width == 4 ? _mm512_maskz_compress_epi32(static_cast<__mmask16>(lane_keep), v)
+                                                    : _mm512_maskz_compress_epi64(static_cast<__mmask8>(lane_keep), v);
+                        _mm512_storeu_si512(out + kept * Width, packed);
+                        kept += _mm_popcnt_u64(lane_keep);
+                    }
+                    return kept;
+                }
+            };
+#endif
+
+            // Left-packs the elements whose drop bit is clear, one 64-element
+            // word at a time: runs with nothing dropped are moved in one piece,
+            // fully dropped words are skipped, and mixed words use the level's
+            // left_pack or a branchless store-and-advance loop.
+            template<class U>
+            struct compact_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE std::size_t run(void *to, const void *first,
+                                                                   const std::uint64_t *drop, std::size_t count) {
+                    U *out = static_cast<U *>(to);
+                    const U *in = static_cast<const U *>(first);
+                    std::size_t kept = 0;
+                    for (std::size_t i = 0; i < count; i += 64) {
+                        std::size_t block = std::min<std::size_t>(64, count - i);
+                        std::uint64_t word = drop[i / 64];
+                        if (block < 64) {
+                            word |= ~std::uint64_t(0) << block;
+                        }
+                        if (word == 0) {
+                            if (out + kept != in + i) {
+                                std::memmove(out + kept, in + i, 64 * sizeof(U));
+                            }
+                            kept += 64;
+                            continue;
+                        }
+                        if (~word == 0) {
+                            continue;
+                        }
+                        if constexpr (left_pack<Bytes, sizeof(U)>::available) {
+                            if (block == 64) {
+                                kept += left_pack<Bytes, sizeof(U)>::run(out + kept, in + i, ~word);
+                                continue;
+                            }
+                        }
+                        for (std::size_t j = 0; j < block; ++j) {
+                            out[kept] = in[i + j];
+                            kept += ((word >> j) & 1) ^ 1;
+                        }
+                    }
+                    return kept;
+                }
+            };
+
+            template<class U>
+            struct gather_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE void run(void *to, const void *first, const std::uint32_t *index,
+                                                            std::size_t count) {
+                    U *out = static_cast<U *>(to);
+                    const U *in = static_cast<const U *>(first);
+                    std::size_t i = 0;
+                    if constexpr (hardware_gather<Bytes, sizeof(U)>::available) {
+                        i = hardware_gather<Bytes, sizeof(U)>::run(out, in, index, count);
+                    }
+                    for (; i < count; ++i) {
+                        out[i] = in[index[i]];
+                    }
+                }
+            };
+
+#if defined(PRETTY_VECTOR_X86_SIMD)
+            // lane k of the result is lane k - Shift of x, zero below Shift;
+            // Lane is the signed integer as wide as one lane of V
+            template<std::size_t Shift, class Lane, class V, std::size_t ...K>
+            PRETTY_VECTOR_ALWAYS_INLINE void shift_lanes_up(const V &x, V &out, std::index_sequence<K...>) {
+                typedef typename pack<Lane, sizeof(V)>::type lanes;
+                out = __builtin_shuffle(x, V{}, lanes{static_cast<Lane>(K >= Shift ? K - Shift
+                                                                                   : sizeof...(K) + K)...});
+            }
+
+            // every lane set to the last lane of x
+            template<class Lane, class V, std::size_t ...K>
+            PRETTY_VECTOR_ALWAYS_INLINE void broadcast_last(const V &x, V &out, std::index_sequence<K...>) {
+                typedef typename pack<Lane, sizeof(V)>::type lanes;
+                out = __builtin_shuffle(x, lanes{static_cast<Lane>(K * 0 + sizeof...(K) - 1)...});
+            }
+
+            // in-register inclusive scan: log2(N) shifted adds
+            template<class Lane, std::size_t N, std::size_t Shift = 1, class V>
+            PRETTY_VECTOR_ALWAYS_INLINE void scan_lanes(V &x) {
+                if constexpr (Shift < N) {
+                    V shifted;
+                    shift_lanes_up<Shift, Lane>(x, shifted, std::make_index_sequence<N>());
+                    x += shifted;
+                    scan_lanes<Lane, N, 2 * Shift>(x);
+                }
+            }
+
+            // scan_lanes that stops at heads: a lane only adds the lane Shift
+            // below it while no head has been seen in between, and `seen`
+            // ends up set from each lane's first head on
+            template<class Lane, std::size_t N, std::size_t Shift = 1, class V, class L>
+            PRETTY_VECTOR_ALWAYS_INLINE void segmented_steps(V &x, L &seen) {
+                if constexpr (Shift < N) {
+                    typedef typename pack<std::uint64_t, sizeof(V)>::type mask;
+                    V shifted;
+                    L shifted_seen;
+                    shift_lanes_up<Shift, Lane>(x, shifted, std::make_index_sequence<N>());
+                    shift_lanes_up<Shift, Lane>(seen, shifted_seen, std::make_index_sequence<N>());
+                    x += (V) ((mask) shifted & ~(mask) seen);
+                    seen = (L) ((mask) seen | (mask) shifted_seen);
+                    segmented_steps<Lane, N, 2 * Shift>(x, seen);
+                }
+            }
+#endif
+
+            // out[i] = carry + in[0] + ... + in[i] (inclusive) or + in[i - 1]
+            // (exclusive); returns carry plus the sum of all of in. E is an
+            // unsigned integer (so sums wrap) or a floating point type, whose
+            // sums are added in a different order than a plain loop would.
+            // `out` may equal `in`.
+            template<class E, bool Exclusive>
+            struct scan_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE E run(const E *in, E *out, std::size_t count, E carry) {
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0 && sizeof(E) >= 4) {
+                        typedef typename pack<E, Bytes>::type values;
+                        typedef typename std::conditional<sizeof(E) == 4, std::int32_t, std::int64_t>::type lane;
+                        constexpr std::size_t n = Bytes / sizeof(E);
+                        values total = values{} + carry;
+                        for (; i + n <= count; i += n) {
+                            values x;
+                            std::memcpy(&x, in + i, Bytes);
+                            values local = x;
+                            scan_lanes<lane, n>(local);
+                            values result = local;
+                            if constexpr (Exclusive) {
+                                shift_lanes_up<1, lane>(local, result, std::make_index_sequence<n>());
+                            }
+                            result += total;
+                            std::memcpy(out + i, &result, Bytes);
+                            values last;
+                            broadcast_last<lane>(local, last, std::make_index_sequence<n>());
+                            total += last;
+                        }
+                        carry = total[0];
+                    }
+#endif
+                    for (; i < count; ++i) {
+                        E x = in[i];
+                        if (Exclusive) {
+                            out[i] = carry;
+                            carry += x;
+                        } else {
+                            carry += x;
+                            out[i] = carry;
+                        }
+                    }
+                    return carry;
+                }
+            };
+
+            // As scan_kernel, but the running total restarts from init at every
+            // element whose bit is set in heads, where in[i] is bit offset + i.
+            // Inside a register the heads stop the shifted adds from crossing
+            // them (flags spread like the sums), and the carry only reaches the
+            // lanes before the first head.
+            template<class E, bool Exclusive>
+            struct segmented_scan_kernel {
+                static PRETTY_VECTOR_ALWAYS_INLINE std::uint64_t head_bits(const std::uint64_t *heads, std::size_t at,
+                                                                           std::size_t count) {
+                    std::size_t word = at / 64, shift = at % 64;
+                    std::uint64_t bits = heads[word] >> shift;
+                    if (shift + count > 64) {
+                        bits |= heads[word + 1] << (64 - shift);
+                    }
+                    return bits;
+                }
+
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE E run(const E *in, E *out, std::size_t count,
+                                                         const std::uint64_t *heads, std::size_t offset,
+                                                         E carry, E init) {
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0 && sizeof(E) >= 4) {
+                        typedef typename pack<E, Bytes>::type values;
+                        typedef typename std::conditional<sizeof(E) == 4, std::int32_t, std::int64_t>::type lane;
+                        typedef typename pack<lane, Bytes>::type lanes;
+                        typedef typename pack<std::uint64_t, Bytes>::type mask;
+                        constexpr std::size_t n = Bytes / sizeof(E);
+                        lanes bit = lanes{}, first = lanes{};
+                        for (std::size_t k = 0; k < n; ++k) {
+                            bit[k] = lane(1) << k;
+                        }
+                        first[0] = -1;
+                        values total = values{} + carry, restart = values{} + init;
+                        for (; i + n <= count; i += n) {
+                            values x;
+                            std::memcpy(&x, in + i, Bytes);
+                            lanes head = ((lanes{} + static_cast<lane>(head_bits(heads, offset + i, n))) & bit) != 0;
+                            lanes seen = head;
+                            values local = x;
+                            segmented_steps<lane, n>(local, seen);
+                            values result = (values) (((mask) (local + restart) & (mask) seen) |
+                                               ((mask) (local + total) & ~(mask) seen));
+                            values last;
+                            broadcast_last<lane>(result, last, std::make_index_sequence<n>());
+                            if constexpr (Exclusive) {
+                                values shifted;
+                                shift_lanes_up<1, lane>(result, shifted, std::make_index_sequence<n>());
+                                shifted = (values) ((mask) shifted | ((mask) total & (mask) first));
+                                result = (values) (((mask) restart & (mask) head) | ((mask) shifted & ~(mask) head));
+                            }
+                            std::memcpy(out + i, &result, Bytes);
+                            total = last;
+                        }
+                        carry = total[0];
+                    }
+#endif
+                    for (; i < count; ++i) {
+                        if ((heads[(offset + i) / 64] >> ((offset + i) % 64)) & 1) {
+                            carry = init;
+                        }
+                        E x = in[i];
+                        if (Exclusive) {
+                            out[i] = carry;
+                            carry += x;
+                        } else {
+                            carry += x;
+                            out[i] = carry;
+                        }
+                    }
+                    return carry;
+                }
+            };
+
+            // in[0] + ... + in[count - 1] in four accumulator registers; E as
+            // for scan_kernel
+            template<class E>
+            struct sum_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE E run(const E *in, std::size_t count) {
+                    std::size_t i = 0;
+                    E total = E();
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0 && sizeof(E) >= 4) {
+                        typedef typename pack<E, Bytes>::type values;
+                        constexpr std::size_t n = Bytes / sizeof(E);
+                        values sums[4] = {};
+                        for (; i + 4 * n <= count; i += 4 * n) {
+                            for (unsigned int k = 0; k < 4; ++k) {
+                                values x;
+                                std::memcpy(&x, in + i + k * n, Bytes);
+                                sums[k] += x;
+                            }
+                        }
+                        values folded = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+                        for (std::size_t k = 0; k < n; ++k) {
+                            total += folded[k];
+                        }
+                    }
+#endif
+                    for (; i < count; ++i) {
+                        total += in[i];
+                    }
+                    return total;
+                }
+            };
+
+#if defined(PRETTY_VECTOR_X86_SIMD)
+            // lanes of the low (or high) halves of a and b, alternately
+            template<class Lane, bool High, class V, std::size_t ...K>
+            PRETTY_VECTOR_ALWAYS_INLINE void interleave(const V &a, const V &b, V &out, std::index_sequence<K...>) {
+                typedef typename pack<Lane, sizeof(V)>::type lanes;
+                constexpr std::size_t n = sizeof...(K);
+                out = (V) __builtin_shuffle((lanes) a, (lanes) b,
+                                            lanes{static_cast<Lane>((High ? n / 2 : 0) + K / 2 + K % 2 * n)...});
+            }
+
+            // byte k of out is byte (k % Rows) * (16 / Rows) + k / Rows of x: the
+            // transpose of x read as Rows rows
+            template<std::size_t Rows, class V, std::size_t ...K>
+            PRETTY_VECTOR_ALWAYS_INLINE void transpose_bytes(const V &x, V &out, std::index_sequence<K...>) {
+                typedef typename pack<std::int8_t, 16>::type lanes;
+                out = (V) __builtin_shuffle(x, lanes{static_cast<std::int8_t>(K % Rows * (16 / Rows) + K / Rows)...});
+            }
+
+            // the even (or odd) bytes of a, then those of b
+            template<std::size_t Odd, class V, std::size_t ...K>
+            PRETTY_VECTOR_ALWAYS_INLINE void pick_bytes(const V &a, const V &b, V &out, std::index_sequence<K...>) {
+                typedef typename pack<std::int8_t, 16>::type lanes;
+                out = (V) __builtin_shuffle(a, b, lanes{static_cast<std::int8_t>(2 * K + Odd)...});
+            }
+
+            // lane j of row k to lane k of row j, for 4 rows of 32-bit lanes or
+            // 8 rows of 16-bit lanes
+            template<std::size_t N, class V>
+            PRETTY_VECTOR_ALWAYS_INLINE void transpose_rows(const V *r, V *out) {
+                typedef std::make_index_sequence<4> quads;
+                typedef std::make_index_sequence<2> halves;
+                if constexpr (N == 4) {
+                    V a[4];
+                    interleave<std::int32_t, false>(r[0], r[1], a[0], quads());
+                    interleave<std::int32_t, true>(r[0], r[1], a[1], quads());
+                    interleave<std::int32_t, false>(r[2], r[3], a[2], quads());
+                    interleave<std::int32_t, true>(r[2], r[3], a[3], quads());
+                    for (std::size_t k = 0; k < 2; ++k) {
+                        interleave<std::int64_t, false>(a[k], a[k + 2], out[2 * k], halves());
+                        interleave<std::int64_t, true>(a[k], a[k + 2], out[2 * k + 1], halves());
+                    }
+                } else {
+                    V a[8], b[8];
+                    for (std::size_t k = 0; k < 8; k += 2) {
+                        interleave<std::int16_t, false>(r[k], r[k + 1], a[k], std::make_index_sequence<8>());
+                        interleave<std::int16_t, true>(r[k], r[k + 1], a[k + 1], std::make_index_sequence<8>());
+                    }
+                    for (std::size_t k = 0; k < 8; k += 4) {
+                        for (std::size_t j = 0; j < 2; ++j) {
+                            interleave<std::int32_t, false>(a[k + j], a[k + j + 2], b[k + 2 * j], quads());
+                            interleave<std::int32_t, true>(a[k + j], a[k + j + 2], b[k + 2 * j + 1], quads());
+                        }
+                    }
+                    for (std::size_t k = 0; k < 4; ++k) {
+                        interleave<std::int64_t, false>(b[k], b[k + 4], out[2 * k], halves());
+                        interleave<std::int64_t, true>(b[k], b[k + 4], out[2 * k + 1], halves());
+                    }
+                }
+            }
+#endif
+
+            // Byte b of element i of `count` elements of Width bytes to
+            // out[b * count + i], gathering each byte position into a plane, or
+            // with Inverse back from the planes. Sixteen elements at a time are
+            // transposed in registers; SSE2 has no byte shuffle, so for 4 and 8
+            // byte elements it runs no faster than the scalar loop.
+            template<std::size_t Width, bool Inverse>
+            struct byte_shuffle_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE void run(const unsigned char *in, std::size_t count,
+                                                            unsigned char *out) {
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0) {
+                        typedef pack<unsigned char, 16>::type row;
+                        typedef std::make_index_sequence<16> lanes;
+                        for (; i + 16 <= count; i += 16) {
+                            row r[Width], t[Width];
+                            for (std::size_t k = 0; k < Width; ++k) {
+                                std::memcpy(&r[k], Inverse ? in + k * count + i : in + i * Width + k * 16, 16);
+                            }
+                            if constexpr (Width == 2 && !Inverse) {
+                                pick_bytes<0>(r[0], r[1], t[0], lanes());
+                                pick_bytes<1>(r[0], r[1], t[1], lanes());
+                            } else if constexpr (Width == 2) {
+                                interleave<std::int8_t, false>(r[0], r[1], t[0], lanes());
+                                interleave<std::int8_t, true>(r[0], r[1], t[1], lanes());
+                            } else if constexpr (!Inverse) {
+                                for (std::size_t k = 0; k < Width; ++k) {
+                                    transpose_bytes<16 / Width>(r[k], r[k], lanes());
+                                }
+                                transpose_rows<Width>(r, t);
+                            } else {
+                                transpose_rows<Width>(r, t);
+                                for (std::size_t k = 0; k < Width; ++k) {
+                                    transpose_bytes<Width>(t[k], t[k], lanes());
+                                }
+                            }
+                            for (std::size_t k = 0; k < Width; ++k) {
+                                std::memcpy(Inverse ? out + i * Width + k * 16 : out + k * count + i, &t[k], 16);
+                            }
+                        }
+                    }
+#endif
+                    for (; i < count; ++i) {
+                        for (std::size_t b = 0; b < Width; ++b) {
+                            if (Inverse) {
+                                out[i * Width + b] = in[b * count + i];
+                            } else {
+                                out[b * count + i] = in[i * Width + b];
+                            }
+                        }
+                    }
+                }
+            };
+
+            // sets bit i of bits[i / 64] when lo <= in[i] <= hi; the words are
+            // overwritten, unused high bits of the last one are cleared
+            template<class E>
+            struct range_mask_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE void run(const E *in, std::size_t count, E lo, E hi,
+                                                            std::uint64_t *bits) {
+                    std::size_t i = 0;
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (lane_bits<Bytes, sizeof(E)>::available) {
+                        typedef typename pack<E, Bytes>::type values;
+                        typedef typename pack<std::uint64_t, Bytes>::type mask;
+                        constexpr std::size_t lanes = Bytes / sizeof(E);
+                        values low = values{} + lo, high = values{} + hi;
+                        for (; i + 64 <= count; i += 64) {
+                            std::uint64_t word = 0;
+                            for (std::size_t j = 0; j < 64; j += lanes) {
+                                values a;
+                                std::memcpy(&a, in + i + j, Bytes);
+                                mask hit = (mask) (a >= low) & (mask) (a <= high);
+                                word |= lane_bits<Bytes, sizeof(E)>::get(hit) << j;
+                            }
+                            bits[i / 64] = word;
+                        }
+                    }
+#endif
+                    for (; i < count; i += 64) {
+                        std::size_t block = std::min<std::size_t>(64, count - i);
+                        std::uint64_t word = 0;
+                        for (std::size_t j = 0; j < block; ++j) {
+                            word |= std::uint64_t(lo <= in[i + j] && in[i + j] <= hi) << j;
+                        }
+                        bits[i / 64] = word;
+                    }
+                }
+            };
+
+            // number k of lane j of a plane of `width` bits (0 - 32); see unpack.
+            // The next word is read only when the value runs into it.
+            PRETTY_VECTOR_ALWAYS_INLINE std::uint32_t plane_value(const std::uint32_t *words, unsigned int width,
+                                                                  unsigned int k, unsigned int j) {
+                unsigned int bit = k * width, word = bit / 32;
+                std::uint64_t pair = words[word * 4 + j];
+                if (bit % 32 + width > 32) {
+                    pair |= std::uint64_t(words[word * 4 + 4 + j]) << 32;
+                }
+                return static_cast<std::uint32_t>(pair >> bit % 32) & std::uint32_t((std::uint64_t(1) << width) - 1);
+            }
+
+#if defined(PRETTY_VECTOR_X86_SIMD)
+            // four 32-bit words zero-extended to 64 bits; GCC builds the generic
+            // conversion from two halves, AVX2 has it as one load
+            template<unsigned int Bytes>
+            struct widen_quad {
+                static PRETTY_VECTOR_ALWAYS_INLINE void
+                load(const std::uint32_t *from, typename pack<std::uint64_t, 32>::type &out) {
+                    typename pack<std::uint32_t, 16>::type quad;
+                    std::memcpy(&quad, from, 16);
+                    out = __builtin_convertvector(quad, typename pack<std::uint64_t, 32>::type);
+                }
+            };
+
+            template<>
+            struct widen_quad<32> {
+                static PRETTY_VECTOR_TARGET_AVX2 inline void
+                load(const std::uint32_t *from, pack<std::uint64_t, 32>::type &out) {
+                    out = (pack<std::uint64_t, 32>::type) _mm256_cvtepu32_epi64(
+                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(from)));
+                }
+            };
+
+            template<>
+            struct widen_quad<64> {
+                static PRETTY_VECTOR_TARGET_AVX512 inline void
+                load(const std::uint32_t *from, pack<std::uint64_t, 32>::type &out) {
+                    out = (pack<std::uint64_t, 32>::type) _mm256_cvtepu32_epi64(
+                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(from)));
+                }
+            };
+#endif
+
+            // 128 values of `width` bits from a plane of four interleaved lanes,
+            // stored as base + value or, with delta, as running sums per lane.
+            // A width 0 plane has no words, so nothing is loaded for it; for
+            // wider ones the word after the last is always in the stream.
+            struct unpack_kernel {
+                template<unsigned int Bytes>
+                static PRETTY_VECTOR_ALWAYS_INLINE void run(const std::uint32_t *words, unsigned int width,
+                                                            std::uint64_t base, bool delta, std::uint64_t *out) {
+                    if (width == 0) {
+                        std::fill(out, out + 128, base);
+                        return;
+                    }
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                    if constexpr (Bytes != 0) {
+                        typedef pack<std::uint64_t, 32>::type wide;
+                        wide mask = wide{} + ((std::uint64_t(1) << width) - 1);
+                        wide running = wide{} + base;
+                        for (unsigned int k = 0; k < 32; ++k) {
+                            // each lane's word and the next one as a 64-bit pair
+                            unsigned int bit = k * width;
+                            wide lo, hi;
+                            widen_quad<Bytes>::load(words + bit / 32 * 4, lo);
+                            widen_quad<Bytes>::load(words + bit / 32 * 4 + 4, hi);
+                            wide value = ((lo | hi << 32) >> (bit % 32)) & mask;
+                            if (delta) {
+                                running += value;
+                                std::memcpy(out + k * 4, &running, 32);
+                            } else {
+                                value += running;
+                                std::memcpy(out + k * 4, &value, 32);
+                            }
+                        }
+                        return;
+                    }
+#endif
+                    std::uint64_t running[4] = {base, base, base, base};
+                    for (unsigned int k = 0; k < 32; ++k) {
+                        for (unsigned int j = 0; j < 4; ++j) {
+                            std::uint64_t value = plane_value(words, width, k, j);
+                            running[j] = delta ? running[j] + value : running[j];
+                            out[k * 4 + j] = delta ? running[j] : base + value;
+                        }
+                    }
+                }
+            };
+
+            // per-level entry points: the kernel bodies inline into these and are
+            // compiled for the level's instruction set
+            template<class Kernel, class R, class ...Args>
+            struct scalar_entry {
+                static R call(Args... args) { return Kernel::template run<0>(args...); }
+            };
+
+#if defined(PRETTY_VECTOR_X86_SIMD)
+            template<class Kernel, class R, class ...Args>
+            struct sse2_entry {
+                static PRETTY_VECTOR_TARGET_SSE2 R call(Args... args) { return Kernel::template run<16>(args...); }
+            };
+
+            template<class Kernel, class R, class ...Args>
+            struct sse42_entry {
+                static PRETTY_VECTOR_TARGET_SSE42 R call(Args... args) { return Kernel::template run<16>(args...); }
+            };
+
+            template<class Kernel, class R, class ...Args>
+            struct avx2_entry {
+                static PRETTY_VECTOR_TARGET_AVX2 R call(Args... args) { return Kernel::template run<32>(args...); }
+            };
+
+            template<class Kernel, class R, class ...Args>
+            struct avx512_entry {
+                static PRETTY_VECTOR_TARGET_AVX512 R call(Args... args) { return Kernel::template run<64>(args...); }
+            };
+#endif
+
+            inline void *move_bytes(void *to, const void *from, std::size_t bytes) {
+                return std::memmove(to, from, bytes);
+            }
+
+            // the table of one level; `Run` instantiates a kernel for it
+            template<template<class, class, class...> class Run>
+            kernel_table make_table(level isa) {
+                typedef const void *in;
+                typedef std::uint64_t bits;
+                typedef std::size_t size;
+                return kernel_table{
+                        isa,
+                        &Run<equal_kernel, bool, in, in, size>::call,
+                        {&Run<fill_kernel<std::uint8_t>, void, void *, bits, size>::call,
+                         &Run<fill_kernel<std::uint16_t>, void, void *, bits, size>::call,
+                         &Run<fill_kernel<std::uint32_t>, void, void *, bits, size>::call,
+                         &Run<fill_kernel<std::uint64_t>, void, void *, bits, size>::call},
+                        {&Run<find_kernel<std::uint8_t>, size, in, size, bits>::call,
+                         &Run<find_kernel<std::uint16_t>, size, in, size, bits>::call,
+                         &Run<find_kernel<std::uint32_t>, size, in, size, bits>::call,
+                         &Run<find_kernel<std::uint64_t>, size, in, size, bits>::call},
+                        {&Run<count_kernel<std::uint8_t>, size, in, size, bits>::call,
+                         &Run<count_kernel<std::uint16_t>, size, in, size, bits>::call,
+                         &Run<count_kernel<std::uint32_t>, size, in, size, bits>::call,
+                         &Run<count_kernel<std::uint64_t>, size, in, size, bits>::call},
+                        &Run<mismatch_kernel, size, in, in, size>::call,
+                        {&Run<compact_kernel<std::uint8_t>, size, void *, in, const bits *, size>::call,
+                         &Run<compact_kernel<std::uint16_t>, size, void *, in, const bits *, size>::call,
+                         &Run<compact_kernel<std::uint32_t>, size, void *, in, const bits *, size>::call,
+                         &Run<compact_kernel<std::uint64_t>, size, void *, in, const bits *, size>::call},
+                        {&Run<gather_kernel<std::uint8_t>, void, void *, in, const std::uint32_t *, size>::call,
+                         &Run<gather_kernel<std::uint16_t>, void, void *, in, const std::uint32_t *, size>::call,
+                         &Run<gather_kernel<std::uint32_t>, void, void *, in, const std::uint32_t *, size>::call,
+                         &Run<gather_kernel<std::uint64_t>, void, void *, in, const std::uint32_t *, size>::call},
+                        &move_bytes
+                };
+            }
+
+            inline const kernel_table &table_for(level isa) {
+                static const kernel_table scalar_table = make_table<scalar_entry>(level::scalar);
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                static const kernel_table tables[] = {scalar_table,
+                                                      make_table<sse2_entry>(level::sse2),
+                                                      make_table<sse42_entry>(level::sse42),
+                                                      make_table<avx2_entry>(level::avx2),
+                                                      make_table<avx512_entry>(level::avx512)};
+                return tables[static_cast<int>(isa)];
+#else
+                return scalar_table;
+#endif
+            }
+        }
+
+        // The kernels for active(): the dispatch table is built once per level
+        // and picking it is one relaxed load, so callers fetch it per call.
+        inline const kernel_table &kernels() {
+            return kernels_detail::table_for(active());
+        }
+
+        // typed front ends; T must satisfy has_kernel_width
+
+        template<class T>
+        void fill(T *first, const T &value, std::size_t n) {
+            static_assert(has_kernel_width<T>::value, "fill needs a trivially copyable 1, 2, 4 or 8 byte type");
+            std::uint64_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(T));
+            kernels().fill[width_index(sizeof(T))](first, bits, n);
+        }
+
+        template<class T>
+        std::size_t find_bits(const T *first, std::size_t n, const T &value) {
+            static_assert(has_kernel_width<T>::value, "find needs a trivially copyable 1, 2, 4 or 8 byte type");
+            std::uint64_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(T));
+            return kernels().find[width_index(sizeof(T))](first, n, bits);
+        }
+
+        template<class T>
+        std::size_t count_bits(const T *first, std::size_t n, const T &value) {
+            static_assert(has_kernel_width<T>::value, "count needs a trivially copyable 1, 2, 4 or 8 byte type");
+            std::uint64_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(T));
+            return kernels().count[width_index(sizeof(T))](first, n, bits);
+        }
+
+        // Index of the first element equal to `value`, or n. Bit equality is
+        // value equality for everything but floating point, where NaN equals
+        // nothing and the two zeros equal each other; those are handled here.
+        template<class T>
+        std::size_t find(const T *first, std::size_t n, const T &value) {
+            if constexpr (std::is_floating_point<T>::value) {
+                if (value != value) {
+                    return n;
+                }
+                if (value == T(0)) {
+                    std::size_t positive = find_bits(first, n, T(0));
+                    return find_bits(first, positive, -T(0));
+                }
+            }
+            return find_bits(first, n, value);
+        }
+
+        template<class T>
+        std::size_t count(const T *first, std::size_t n, const T &value) {
+            if constexpr (std::is_floating_point<T>::value) {
+                if (value != value) {
+                    return 0;
+                }
+                if (value == T(0)) {
+                    return count_bits(first, n, T(0)) + count_bits(first, n, -T(0));
+                }
+            }
+            return count_bits(first, n, value);
+        }
+
+        namespace kernels_detail {
+            // Kernels typed on the element (rather than its width) get one small
+            // table per instantiation, with one entry per level.
+            template<class Kernel, class R, class ...Args>
+            R (*typed_kernel())(Args...) {
+#if defined(PRETTY_VECTOR_X86_SIMD)
+                static R (*const table[])(Args...) = {&scalar_entry<Kernel, R, Args...>::call,
+                                                      &sse2_entry<Kernel, R, Args...>::call,
+                                                      &sse42_entry<Kernel, R, Args...>::call,
+                                                      &avx2_entry<Kernel, R, Args...>::call,
+                                                      &avx512_entry<Kernel, R, Args...>::call};
+                return table[static_cast<int>(active())];
+#else
+                return &scalar_entry<Kernel, R, Args...>::call;
+#endif
+            }
+        }
+
+        // First index in [first, first + n) whose value lies in [lo, hi], or n.
+        template<class E>
+        std::size_t find_in_range(const E *first, std::size_t n, E lo, E hi) {
+            static_assert(std::is_arithmetic<E>::value && sizeof(E) <= 8, "find_in_range needs arithmetic elements");
+            return kernels_detail::typed_kernel<kernels_detail::range_kernel<E>, std::size_t,
+                                                const E *, std::size_t, E, E>()(first, n, lo, hi);
+        }
+
+        // Writes (n + 63) / 64 words to `bits`: bit i of bits[i / 64] is set
+        // when lo <= first[i] <= hi.
+        template<class E>
+        void mask_in_range(const E *first, std::size_t n, E lo, E hi, std::uint64_t *bits) {
+            static_assert(std::is_arithmetic<E>::value && sizeof(E) <= 8, "mask_in_range needs arithmetic elements");
+            kernels_detail::typed_kernel<kernels_detail::range_mask_kernel<E>, void,
+                                         const E *, std::size_t, E, E, std::uint64_t *>()(first, n, lo, hi, bits);
+        }
+
+        namespace kernels_detail {
+            // the type the scan and sum kernels run on: integers wrap as unsigned
+            template<class E>
+            struct scan_type {
+                typedef typename std::conditional<std::is_integral<E>::value,
+                        std::make_unsigned<E>, std::common_type<E>>::type::type type;
+            };
+        }
+
+        // out[i] = carry + first[0] + ... + first[i] for i < n; returns carry
+        // plus the whole sum. Integers wrap around; floating point sums are
+        // grouped per register, so they may round differently than a plain
+        // loop. `out` may equal `first`.
+        template<class E>
+        E inclusive_scan(const E *first, E *out, std::size_t n, E carry) {
+            static_assert(std::is_arithmetic<E>::value && !std::is_same<E, bool>::value && sizeof(E) <= 8,
+                          "inclusive_scan needs arithmetic elements");
+            typedef typename kernels_detail::scan_type<E>::type U;
+            return static_cast<E>(kernels_detail::typed_kernel<kernels_detail::scan_kernel<U, false>, U,
+                                                               const U *, U *, std::size_t, U>()(
+                    reinterpret_cast<const U *>(first), reinterpret_cast<U *>(out), n, static_cast<U>(carry)));
+        }
+
+        // out[i] = carry + first[0] + ... + first[i - 1]; otherwise as above
+        template<class E>
+        E exclusive_scan(const E *first, E *out, std::size_t n, E carry) {
+            static_assert(std::is_arithmetic<E>::value && !std::is_same<E, bool>::value && sizeof(E) <= 8,
+                          "exclusive_scan needs arithmetic elements");
+            typedef typename kernels_detail::scan_type<E>::type U;
+            return static_cast<E>(kernels_detail::typed_kernel<kernels_detail::scan_kernel<U, true>, U,
+                                                               const U *, U *, std::size_t, U>()(
+                    reinterpret_cast<const U *>(first), reinterpret_cast<U *>(out), n, static_cast<U>(carry)));
+        }
+
+        // inclusive_scan restarted from init at every element whose bit is set
+        // in heads, where first[i] is bit offset + i; returns the running total
+        // after the last element
+        template<class E>
+        E segmented_inclusive_scan(const E *first, E *out, std::size_t n, const std::uint64_t *heads,
+                                   std::size_t offset, E carry, E init) {
+            static_assert(std::is_arithmetic<E>::value && !std::is_same<E, bool>::value && sizeof(E) <= 8,
+                          "segmented_inclusive_scan needs arithmetic elements");
+            typedef typename kernels_detail::scan_type<E>::type U;
+            return static_cast<E>(kernels_detail::typed_kernel<kernels_detail::segmented_scan_kernel<U, false>, U,
+                                                               const U *, U *, std::size_t, const std::uint64_t *,
+                                                               std::size_t, U, U>()(
+                    reinterpret_cast<const U *>(first), reinterpret_cast<U *>(out), n, heads, offset,
+                    static_cast<U>(carry), static_cast<U>(init)));
+        }
+
+        template<class E>
+        E segmented_exclusive_scan(const E *first, E *out, std::size_t n, const std::uint64_t *heads,
+                                   std::size_t offset, E carry, E init) {
+            static_assert(std::is_arithmetic<E>::value && !std::is_same<E, bool>::value && sizeof(E) <= 8,
+                          "segmented_exclusive_scan needs arithmetic elements");
+            typedef typename kernels_detail::scan_type<E>::type U;
+            return static_cast<E>(kernels_detail::typed_kernel<kernels_detail::segmented_scan_kernel<U, true>, U,
+                                                               const U *, U *, std::size_t, const std::uint64_t *,
+                                                               std::size_t, U, U>()(
+                    reinterpret_cast<const U *>(first), reinterpret_cast<U *>(out), n, heads, offset,
+                    static_cast<U>(carry), static_cast<U>(init)));
+        }
+
+        // first[0] + ... + first[n - 1], grouped like inclusive_scan
+        template<class E>
+        E sum(const E *first, std::size_t n) {
+            static_assert(std::is_arithmetic<E>::value && !std::is_same<E, bool>::value && sizeof(E) <= 8,
+                          "sum needs arithmetic elements");
+            typedef typename kernels_detail::scan_type<E>::type U;
+            return static_cast<E>(kernels_detail::typed_kernel<kernels_detail::sum_kernel<U>, U,
+                                                               const U *, std::size_t>()(
+                    reinterpret_cast<const U *>(first), n));
+        }
+
+        // Unpacks 128 values of `width` bits (0 - 32) from a plane of four
+        // interleaved 32-bit lanes: value i is number i / 4 of lane i % 4, and
+        // its bits start at bit (i / 4) * width of its lane, where word w of a
+        // lane is words[w * 4 + lane]. Writes base + value to out[i], or with
+        // delta the running sum of each lane from base. Reads the four words
+        // after the plane.
+        inline void unpack(const std::uint32_t *words, unsigned int width, std::uint64_t base, bool delta,
+                           std::uint64_t *out) {
+            kernels_detail::typed_kernel<kernels_detail::unpack_kernel, void, const std::uint32_t *, unsigned int,
+                                         std::uint64_t, bool, std::uint64_t *>()(words, width, base, delta, out);
+        }
+
+        // Byte b of element i of `count` elements of `width` bytes goes to
+        // out[b * count + i]: every byte position gets a plane of its own, so
+        // the high bytes of small numbers line up. byte_unshuffle undoes it.
+        inline void byte_shuffle(const unsigned char *in, std::size_t count, std::size_t width, unsigned char *out) {
+            typedef void (*shuffle)(const unsigned char *, std::size_t, unsigned char *);
+            using kernels_detail::byte_shuffle_kernel;
+            using kernels_detail::typed_kernel;
+            if (width == 2 || width == 4 || width == 8) {
+                shuffle run = width == 2 ? typed_kernel<byte_shuffle_kernel<2, false>, void, const unsigned char *,
+                                                        std::size_t, unsigned char *>()
+                              : width == 4 ? typed_kernel<byte_shuffle_kernel<4, false>, void, const unsigned char *,
+                                                          std::size_t, unsigned char *>()
+                              : typed_kernel<byte_shuffle_kernel<8, false>, void, const unsigned char *, std::size_t,
+                                             unsigned char *>();
+                return run(in, count, out);
+            }
+            for (std::size_t b = 0; b < width; ++b) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    out[b * count + i] = in[i * width + b];
+                }
+            }
+        }
+
+        inline void byte_unshuffle(const unsigned char *in, std::size_t count, std::size_t width,
+                                   unsigned char *out) {
+            typedef void (*shuffle)(const unsigned char *, std::size_t, unsigned char *);
+            using kernels_detail::byte_shuffle_kernel;
+            using kernels_detail::typed_kernel;
+            if (width == 2 || width == 4 || width == 8) {
+                shuffle run = width == 2 ? typed_kernel<byte_shuffle_kernel<2, true>, void, const unsigned char *,
+                                                        std::size_t, unsigned char *>()
+                              : width == 4 ? typed_kernel<byte_shuffle_kernel<4, true>, void, const unsigned char *,
+                                                          std::size_t, unsigned char *>()
+                              : typed_kernel<byte_shuffle_kernel<8, true>, void, const unsigned char *, std::size_t,
+                                             unsigned char *>();
+                return run(in, count, out);
+            }
+            for (std::size_t b = 0; b < width; ++b) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    out[i * width + b] = in[b * count + i];
+                }
+            }
+        }
+
+        // Moves the elements of [first, first + n) whose bit in `drop` is clear
+        // to the front of `to` and returns how many there are; see
+        // kernel_table::compact.
+        template<class T>
+        std::size_t compact(T *to, const T *first, const std::uint64_t *drop, std::size_t n) {
+            static_assert(has_kernel_width<T>::value, "compact needs a trivially copyable 1, 2, 4 or 8 byte type");
+            return kernels().compact[width_index(sizeof(T))](to, first, drop, n);
+        }
+
+        // to[i] = first[index[i]] for i < n, with the level's hardware gather
+        // where it has one; every index must be below 2^31
+        template<class T>
+        void gather(T *to, const T *first, const std::uint32_t *index, std::size_t n) {
+            static_assert(has_kernel_width<T>::value, "gather needs a trivially copyable 1, 2, 4 or 8 byte type");
+            kernels().gather[width_index(sizeof(T))](to, first, index, n);
+        }
+
+        // index of the first element where the two ranges differ bitwise, or n
+        template<class T>
+        std::size_t mismatch(const T *a, const T *b, std::size_t n) {
+            static_assert(std::is_trivially_copyable<T>::value, "mismatch compares the bytes of the elements");
+            return kernels().mismatch(a, b, n * sizeof(T)) / sizeof(T);
+        }
+
+        // what was detected and which kernels run, for logs and bug reports
+        inline std::string dispatch_report() {
+            const cpu_features &f = features();
+            std::string result = "cpu:";
+            const std::pair<const char *, bool> flags[] = {{"sse2",     f.sse2},
+                                                           {"sse4.2",   f.sse42},
+                                                           {"popcnt",   f.popcnt},
+                                                           {"avx2",     f.avx2},
+                                                           {"bmi2",     f.bmi2},
+                                                           {"avx512f",  f.avx512f},
+                                                           {"avx512bw", f.avx512bw}};
+            for (const auto &flag : flags) {
+                if (flag.second) {
+                    result += std::string(" ") + flag.first;
+                }
+            }
+            level isa = kernels().isa;
+            result += std::string("\ndetected: ") + name(detected()) + ", active: " + name(isa);
+            result += std::string("\nkernels: equal, fill, find, count, mismatch, compact, gather, "
+                                  "find_in_range, mask_in_range, scan, segmented_scan, sum, unpack, "
+                                  "byte_shuffle: ") + name(isa) + "; relocate: memmove (libc)\n";
+            return result;
+        }
+    }
+}
@@ -0,0 +1,314 @@
+#pragma once
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    // contiguous view of one column of an soa_vector
+    template<class T>
+    class column_span {
+    public:
+        using value_type = typename std::remove_const<T>::type;
+        using size_type = unsigned int;
+
+        column_span(T *data, size_type size) : data_(data), size_(size) {}
+
+        T *data() const { return data_; }
+
+        size_type size() const { return size_; }
+
+        bool empty() const { return size_ == 0; }
+
+        T &operator[](size_type i) const { return data_[i]; }
+
+        T *begin() const { return data_; }
+
+        T *end() const { return data_ + size_; }
+
+    private:
+        T *data_;
+        size_type size_;
+    };
+
+    // Structure-of-arrays container: row i is spread over one pretty_vector::vector
+    // per field, so a scan over a single field only touches that field's memory.
+    // All columns go through the same push/pop sequence, so they share the
+    // vector's growth policy and always have equal size and capacity.
+    template<class... Fields>
+    class soa_vector {
+    public:
+        static_assert(sizeof...(Fields) > 0, "soa_vector needs at least one field");
+
+        static constexpr std::size_t column_alignment = 64;
+
+        template<class T>
+        using column_vector = vector<T, pretty_allocator::allocator<T, column_alignment>>;
+
+        using value_type = std::tuple<Fields...>;
+        using size_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+
+        template<std::size_t I>
+        using field_type = typename std::tuple_element<I, value_type>::type;
+
+        // proxy for one row; reads and writes go straight to the columns
+        template<bool Const>
+        class basic_row_reference {
+            using owner = typename std::conditional<Const, const soa_vector, soa_vector>::type;
+        public:
+            basic_row_reference(owner *container, size_type row) : container_(container), row_(row) {}
+
+            template<std::size_t I>
+            auto &get() const {
+                return container_->template column<I>()[row_];
+            }
+
+            operator value_type() const {
+                return container_->row_value(row_, std::index_sequence_for<Fields...>());
+            }
+
+            template<bool C = Const, class = typename std::enable_if<!C>::type>
+            const basic_row_reference &operator=(const value_type &value) const {
+                container_->assign_row(row_, value, std::index_sequence_for<Fields...>());
+                return *this;
+            }
+
+            const basic_row_reference &operator=(const basic_row_reference &other) const {
+                return *this = static_cast<value_type>(other);
+            }
+
+            size_type row() const { return row_; }
+
+        private:
+            owner *container_;
+            size_type row_;
+        };
+
+        using reference = basic_row_reference<false>;
+        using const_reference = basic_row_reference<true>;
+
+        template<bool Const>
+        class row_iterator {
+            using owner = typename std::conditional<Const, const soa_vector, soa_vector>::type;
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = soa_vector::value_type;
+            using difference_type = std::ptrdiff_t;
+            using reference = basic_row_reference<Const>;
+            using pointer = void;
+
+            row_iterator(owner *container, size_type row) : container_(container), row_(row) {}
+
+            reference operator*() const { return reference(container_, row_); }
+
+            reference operator[](difference_type n) const { return reference(container_, row_ + n); }
+
+            row_iterator &operator++() {
+                ++row_;
+                return *this;
+            }
+
+            row_iterator operator++(int) { return row_iterator(container_, row_++); }
+
+            row_iterator &operator--() {
+                --row_;
+                return *this;
+            }
+
+            row_iterator operator--(int) { return row_iterator(container_, row_--); }
+
+            row_iterator &operator+=(difference_type n) {
+                row_ += n;
+                return *this;
+            }
+
+            row_iterator &operator-=(difference_type n) {
+                row_ -= n;
+                return *this;
+            }
+
+            row_iterator operator+(difference_type n) const { return row_iterator(container_, row_ + n); }
+
+            row_iterator operator-(difference_type n) const { return row_iterator(container_, row_ - n); }
+
+            difference_type operator-(const row_iterator &other) const {
+                return difference_type(row_) - difference_type(other.row_);
+            }
+
+            bool operator==(const row_iterator &other) const { return row_ == other.row_; }
+
+            bool operator!=(const row_iterator &other) const { return row_ != other.row_; }
+
+            bool operator<(const row_iterator &other) const { return row_ < other.row_; }
+
+        private:
+            owner *container_;
+            size_type row_;
+        };
+
+        using iterator = row_iterator<false>;
+        using const_iterator = row_iterator<true>;
+
+        soa_vector() = default;
+
+        soa_vector(std::initializer_list<value_type> rows) {
+            reserve(static_cast<size_type>(rows.size()));
+            for (const value_type &row : rows) {
+                push_back(row);
+            }
+        }
+
+        size_type size() const { return std::get<0>(columns_).size(); }
+
+        size_type capacity() const { return std::get<0>(columns_).capacity(); }
+
+        bool empty() const { return size() == 0; }
+
+        // all or nothing: the new blocks of every column are allocated and
+        // filled before any column adopts its own
+        void reserve(size_type size) {
+            if (size > capacity()) {
+                reserve_columns(size, std::index_sequence_for<Fields...>());
+            }
+        }
+
+        void shrink_to_fit() {
+            for_each_column([](auto &column) { column.shrink_to_fit(); });
+        }
+
+        void clear() {
+            for_each_column([](auto &column) { column.clear(); });
+        }
+
+        // if a field's constructor throws, every column goes back to its old size
+        void resize(size_type count) {
+            size_type old_size = size();
+            reserve(count);
+            try {
+                for_each_column([count](auto &column) { column.resize(count); });
+            } catch (...) {
+                for_each_column([old_size](auto &column) { column.resize(old_size); });
+                throw;
+            }
+        }
+
+        template<class... Args>
+        void emplace_back(Args &&... args) {
+            static_assert(sizeof...(Args) == sizeof...(Fields), "emplace_back takes one argument per field");
+            push_row(std::index_sequence_for<Fields...>(), std::forward<Args>(args)...);
+        }
+
+        void push_back(const value_type &row) {
+            push_tuple(row, std::index_sequence_for<Fields...>());
+        }
+
+        void pop_back() {
+            for_each_column([](auto &column) { column.pop_back(); });
+        }
+
+        void erase(size_type row) {
+            for_each_column([row](auto &column) { column.erase(column.begin() + row); });
+        }
+
+        reference operator[](size_type row) { return reference(this, row); }
+
+        const_reference operator[](size_type row) const { return const_reference(this, row); }
+
+        reference at(size_type row) {
+            if (row >= size()) {
+                throw std::out_of_range("Index out of soa_vector range");
+            }
+            return reference(this, row);
+        }
+
+        const_reference at(size_type row) const {
+            if (row >= size()) {
+                throw std::out_of_range("Index out of soa_vector range");
+            }
+            return const_reference(this, row);
+        }
+
+        template<std::size_t I>
+        column_span<field_type<I>> column() {
+            auto &column = std::get<I>(columns_);
+            return column_span<field_type<I>>(column.data(), column.size());
+        }
+
+        template<std::size_t I>
+        column_span<const field_type<I>> column() const {
+            const auto &column = std::get<I>(columns_);
+            return column_span<const field_type<I>>(column.data(), column.size());
+        }
+
+        iterator begin() { return iterator(this, 0); }
+
+        iterator end() { return iterator(this, size()); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+
+        const_iterator end() const { return const_iterator(this, size()); }
+
+        void swap(soa_vector &other) noexcept {
+            columns_.swap(other.columns_);
+        }
+
+    private:
+        std::tuple<column_vector<Fields>...> columns_;
+
+        template<class F>
+        void for_each_column(F f) {
+            std::apply([&f](auto &... column) { (f(column), ...); }, columns_);
+        }
+
+        // pushes one value per column; if a column throws, the columns that already
+        // received their value are popped again so all columns stay the same length
+        template<std::size_t... I, class... Args>
+        void push_row(std::index_sequence<I...>, Args &&... args) {
+            std::size_t pushed = 0;
+            try {
+                ((std::get<I>(columns_).emplace_back(std::forward<Args>(args)), ++pushed), ...);
+            } catch (...) {
+                ((I < pushed ? std::get<I>(columns_).pop_back() : void()), ...);
+                throw;
+            }
+        }
+
+        // the elements move over only when no column's move can throw, and are
+        // copied otherwise, so a throw leaves columns_ untouched
+        template<std::size_t... I>
+        void reserve_columns(size_type size, std::index_sequence<I...>) {
+            constexpr bool nothrow_moves = (std::is_nothrow_move_constructible<Fields>::value && ...);
+            std::tuple<column_vector<Fields>...> fresh(std::get<I>(columns_).get_allocator()...);
+            (std::get<I>(fresh).reserve(size), ...);
+            auto transfer = [](auto &from, auto &to) {
+                for (size_type i = 0; i < from.size(); ++i) {
+                    if constexpr (nothrow_moves) {
+                        to.push_back(std::move(from.data()[i]));
+                    } else {
+                        to.push_back(std::as_const(from.data()[i]));
+                    }
+                }
+            };
+            (transfer(std::get<I>(columns_), std::get<I>(fresh)), ...);
+            columns_.swap(fresh);
+        }
+
+        template<std::size_t... I>
+        void push_tuple(const value_type &row, std::index_sequence<I...> seq) {
+            push_row(seq, std::get<I>(row)...);
+        }
+
+        template<std::size_t... I>
+        value_type row_value(size_type row, std::index_sequence<I...>) const {
+            return value_type(std::get<I>(columns_).data()[row]...);
+        }
+
+        template<std::size_t... I>
+        void assign_row(size_type row, const value_type &value, std::index_sequence<I...>) {
+            ((std::get<I>(columns_).data()[row] = std::get<I>(value)), ...);
+        }
+    };
+}
@@ -0,0 +1,328 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include "parallel.h"
+#include "permute.h"
+#include "vector.h"
+
+namespace pretty_vector {
+
+    struct sort_options {
+        // worker threads, the calling one included; 0 means one per core
+        unsigned int threads = 0;
+        // shorter inputs are sorted on the calling thread only
+        unsigned int parallel_threshold = 1u << 16;
+    };
+
+    namespace sort_detail {
+        // Maps a radix-sortable key to an unsigned integer with the same order:
+        // signed integers flip the sign bit, floating point flips the sign bit
+        // of positives and every bit of negatives. -0.0 sorts before +0.0 and
+        // NaNs go to the end matching their sign bit.
+        template<class K, class = void>
+        struct radix_traits {
+            static constexpr bool available = false;
+        };
+
+        template<class K>
+        struct radix_traits<K, typename std::enable_if<std::is_integral<K>::value &&
+                                                        !std::is_same<K, bool>::value>::type> {
+            static constexpr bool available = true;
+            typedef typename std::make_unsigned<K>::type key_type;
+
+            static key_type key(K value) {
+                key_type bits = static_cast<key_type>(value);
+                if (std::is_signed<K>::value) {
+                    bits ^= key_type(1) << (8 * sizeof(K) - 1);
+                }
+                return bits;
+            }
+        };
+
+        template<class K>
+        struct radix_traits<K, typename std::enable_if<std::is_floating_point<K>::value &&
+                                                        (sizeof(K) == 4 || sizeof(K) == 8)>::type> {
+            static constexpr bool available = true;
+            typedef typename std::conditional<sizeof(K) == 4, std::uint32_t, std::uint64_t>::type key_type;
+
+            static key_type key(K value) {
+                key_type bits;
+                std::memcpy(&bits, &value, sizeof(K));
+                key_type sign = key_type(1) << (8 * sizeof(K) - 1);
+                return bits & sign ? ~bits : bits | sign;
+            }
+        };
+
+        // stands in for the values of a keys-only sort
+        struct no_values {
+        };
+
+        inline unsigned int thread_count(const sort_options &options, std::size_t n) {
+            return detail::thread_count(options.threads, options.parallel_threshold, n);
+        }
+
+        using detail::parallel_for;
+
+        // Stable LSD radix sort with 8-bit digits, ping-ponging between the
+        // caller's arrays and the scratch arrays. Digits every key shares are
+        // skipped. With several threads each one counts and scatters its own
+        // slice of every pass; the offsets interleave the slices in order, so
+        // the result is still stable.
+        template<class K, class V>
+        void radix_sort(K *keys, K *key_scratch, V *values, V *value_scratch, std::size_t n, unsigned int threads) {
+            typedef radix_traits<K> traits;
+            typedef typename traits::key_type key_type;
+            constexpr bool with_values = !std::is_same<V, no_values>::value;
+            constexpr unsigned int passes = sizeof(K);
+            if (n < 2) {
+                return;
+            }
+
+            // one histogram of every digit decides which passes can be skipped
+            vector<std::size_t> totals(passes * 256, std::size_t(0));
+            for (std::size_t i = 0; i < n; ++i) {
+                key_type key = traits::key(keys[i]);
+                for (unsigned int p = 0; p < passes; ++p) {
+                    ++totals[p * 256 + ((key >> (8 * p)) & 0xFF)];
+                }
+            }
+
+            std::size_t slice = (n + threads - 1) / threads;
+            vector<std::size_t> offsets(threads * 256, std::size_t(0));
+            K *key_from = keys, *key_to = key_scratch;
+            V *value_from = values, *value_to = value_scratch;
+            for (unsigned int p = 0; p < passes; ++p) {
+                const std::size_t *total = &totals[p * 256];
+                if (std::find(total, total + 256, n) != total + 256) {
+                    continue;
+                }
+                unsigned int shift = 8 * p;
+                if (threads == 1) {
+                    std::size_t next = 0;
+                    for (unsigned int d = 0; d < 256; ++d) {
+                        offsets[d] = next;
+                        next += total[d];
+                    }
+                } else {
+                    parallel_for(threads, [&](unsigned int t) {
+                        std::size_t *count = &offsets[t * 256];
+                        std::fill(count, count + 256, std::size_t(0));
+                        std::size_t end = std::min(n, (t + 1) * slice);
+                        for (std::size_t i = t * slice; i < end; ++i) {
+                            ++count[(traits::key(key_from[i]) >> shift) & 0xFF];
+                        }
+                    });
+                    std::size_t next = 0;
+                    for (unsigned int d = 0; d < 256; ++d) {
+                        for (unsigned int t = 0; t < threads; ++t) {
+                            std::size_t count = offsets[t * 256 + d];
+                            offsets[t * 256 + d] = next;
+                            next += count;
+                        }
+                    }
+                }
+                parallel_for(threads, [&](unsigned int t) {
+                    std::size_t *offset = &offsets[t * 256];
+                    std::size_t end = std::min(n, (t + 1) * slice);
+                    for (std::size_t i = t * slice; i < end; ++i) {
+                        std::size_t to = offset[(traits::key(key_from[i]) >> shift) & 0xFF]++;
+                        key_to[to] = key_from[i];
+                        if constexpr (with_values) {
+                            value_to[to] = value_from[i];
+                        }
+                    }
+                });
+                std::swap(key_from, key_to);
+                std::swap(value_from, value_to);
+            }
+            if (key_from != keys) {
+                std::memcpy(keys, key_from, n * sizeof(K));
+                if constexpr (with_values) {
+                    std::memcpy(values, value_from, n * sizeof(V));
+                }
+            }
+        }
+
+        // number of elements taken from `a` among the first m of the stable
+        // merge of a[0, la) and b[0, lb) (merge path co-rank)
+        template<class T, class Compare>
+        std::size_t co_rank(std::size_t m, const T *a, std::size_t la, const T *b, std::size_t lb,
+                            Compare &comp) {
+            std::size_t lo = m > lb ? m - lb : 0, hi = std::min(m, la);
+            while (lo < hi) {
+                std::size_t i = lo + (hi - lo) / 2;
+                if (comp(b[m - i - 1], a[i])) {
+                    hi = i;
+                } else {
+                    lo = i + 1;
+                }
+            }
+            return lo;
+        }
+
+        // One bottom-up round: merges neighbouring runs of `width` from `from`
+        // into `to`. The output is cut into equal parts, one per thread. Where
+        // each part starts in its runs is co-ranked for all of them before any
+        // element is moved; a part then merges exactly a[i, i_end) and
+        // b[j, j_end) and never looks at the elements another thread moves.
+        template<class T, class Compare>
+        void merge_round(T *from, T *to, std::size_t n, std::size_t width, unsigned int threads,
+                         Compare &comp) {
+            auto pair_of = [&](std::size_t out, std::size_t &base, std::size_t &la, std::size_t &lb) {
+                base = out / (2 * width) * (2 * width);
+                la = std::min(width, n - base);
+                lb = std::min(width, n - base - la);
+            };
+            vector<std::size_t> starts(threads + 1, 0);
+            parallel_for(threads, [&](unsigned int t) {
+                std::size_t out = n * t / threads, base, la, lb;
+                if (out < n) {
+                    pair_of(out, base, la, lb);
+                    starts[t] = co_rank(out - base, from + base, la, from + base + la, lb, comp);
+                }
+            });
+            parallel_for(threads, [&](unsigned int t) {
+                std::size_t out = n * t / threads, out_end = n * (t + 1) / threads;
+                std::size_t i = starts[t];
+                while (out < out_end) {
+                    std::size_t base, la, lb;
+                    pair_of(out, base, la, lb);
+                    const T *a = from + base, *b = a + la;
+                    std::size_t stop = std::min(out_end, base + la + lb);
+                    // the pair is either finished here or the next part starts inside it
+                    std::size_t i_end = stop < base + la + lb ? starts[t + 1] : la;
+                    std::size_t j = out - base - i, j_end = stop - base - i_end;
+                    for (; out < stop; ++out) {
+                        if (j < j_end && (i == i_end || comp(b[j], a[i]))) {
+                            to[out] = std::move(from[base + la + j++]);
+                        } else {
+                            to[out] = std::move(from[base + i++]);
+                        }
+                    }
+                    i = 0;
+                }
+            });
+        }
+
+        template<class T, class Compare>
+        void insertion_sort(T *first, T *last, Compare &comp) {
+            for (T *i = first + 1; i < last; ++i) {
+                if (comp(*i, *(i - 1))) {
+                    T value(std::move(*i));
+                    T *j = i;
+                    do {
+                        *j = std::move(*(j - 1));
+                        --j;
+                    } while (j > first && comp(value, *(j - 1)));
+                    *j = std::move(value);
+                }
+            }
+        }
+    }
+
+    // Stable merge sort for any comparator: short runs are insertion sorted,
+    // then merged bottom-up between the vector and a scratch buffer from its
+    // allocator. Every round is split evenly over the threads by merge path
+    // partitioning, so the last merges are as parallel as the first; comp is
+    // called from all of them. If comp throws, v keeps its size but its
+    // contents are unspecified.
+    template<class T, class Allocator, class Compare = std::less<T>>
+    void merge_sort(vector<T, Allocator> &v, Compare comp = Compare(), sort_options options = sort_options()) {
+        std::size_t n = v.size();
+        if (n < 2) {
+            return;
+        }
+        // The rounds alternate between the buffers starting from the scratch,
+        // so their count must be odd to end in v: runs are 32 or 64 long.
+        std::size_t run = 32;
+        unsigned int rounds = 0;
+        for (std::size_t width = run; width < n; width *= 2) {
+            ++rounds;
+        }
+        if (rounds % 2 == 0 && rounds > 0) {
+            run *= 2;
+            --rounds;
+        }
+
+        unsigned int threads = sort_detail::thread_count(options, n);
+        T *data = v.data();
+        std::size_t runs = (n + run - 1) / run;
+        sort_detail::parallel_for(threads, [&](unsigned int t) {
+            for (std::size_t r = runs * t / threads; r < runs * (t + 1) / threads; ++r) {
+                sort_detail::insertion_sort(data + r * run, data + std::min(n, (r + 1) * run), comp);
+            }
+        });
+        if (rounds == 0) {
+            return;
+        }
+
+        detail::scratch<T, Allocator> buffer(v.get_allocator(), n);
+        std::uninitialized_move(data, data + n, buffer.data());
+        buffer.constructed = n;
+        T *from = buffer.data(), *to = data;
+        for (std::size_t width = run; width < n; width *= 2) {
+            sort_detail::merge_round(from, to, n, width, threads, comp);
+            std::swap(from, to);
+        }
+    }
+
+    // Sorts ascending. Integral and float/double elements use a stable LSD
+    // radix sort (see sort_detail::radix_traits for where -0.0 and NaN go);
+    // other elements use merge_sort.
+    template<class T, class Allocator>
+    void sort(vector<T, Allocator> &v, sort_options options = sort_options()) {
+        if constexpr (sort_detail::radix_traits<T>::available) {
+            std::size_t n = v.size();
+            detail::scratch<T, Allocator> keys(v.get_allocator(), n);
+            sort_detail::radix_sort<T, sort_detail::no_values>(v.data(), keys.data(), nullptr, nullptr, n,
+                                                               sort_detail::thread_count(options, n));
+        } else {
+            merge_sort(v, std::less<T>(), options);
+        }
+    }
+
+    // std::less on radix-sortable elements still takes the radix sort
+    template<class T, class Allocator, class Compare>
+    void sort(vector<T, Allocator> &v, Compare comp, sort_options options = sort_options()) {
+        if constexpr (sort_detail::radix_traits<T>::available &&
+                      (std::is_same<Compare, std::less<T>>::value || std::is_same<Compare, std::less<>>::value)) {
+            sort(v, options);
+        } else {
+            merge_sort(v, comp, options);
+        }
+    }
+
+    // Stable radix sort of `keys` that applies the same permutation to
+    // `values`. Trivially copyable values travel with their keys; others
+    // are moved along the sorted order by apply_permutation.
+    template<class K, class KeyAllocator, class V, class ValueAllocator>
+    void sort_by_key(vector<K, KeyAllocator> &keys, vector<V, ValueAllocator> &values,
+                     sort_options options = sort_options()) {
+        static_assert(sort_detail::radix_traits<K>::available, "sort_by_key needs integral or float/double keys");
+        if (keys.size() != values.size()) {
+            throw std::length_error("sort_by_key: keys and values differ in length");
+        }
+        std::size_t n = keys.size();
+        unsigned int threads = sort_detail::thread_count(options, n);
+        detail::scratch<K, KeyAllocator> key_buffer(keys.get_allocator(), n);
+        if constexpr (std::is_trivially_copyable<V>::value) {
+            detail::scratch<V, ValueAllocator> value_buffer(values.get_allocator(), n);
+            sort_detail::radix_sort(keys.data(), key_buffer.data(), values.data(), value_buffer.data(), n, threads);
+        } else {
+            typedef typename vector<V, ValueAllocator>::size_type size_type;
+            vector<size_type> order;
+            order.reserve(static_cast<size_type>(n));
+            for (std::size_t i = 0; i < n; ++i) {
+                order.push_back(static_cast<size_type>(i));
+            }
+            detail::scratch<size_type, KeyAllocator> order_buffer(keys.get_allocator(), n);
+            sort_detail::radix_sort(keys.data(), key_buffer.data(), order.data(), order_buffer.data(), n, threads);
+            apply_permutation(values, order);
+        }
+    }
+}
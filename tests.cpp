@@ -1,5 +1,30 @@
 #include "tests.h"
 #include "vector.h"
+#include "soa_vector.h"
+#include "bit_vector.h"
+#include "segmented_vector.h"
+#include "devector.h"
+#include "circular_vector.h"
+#include "flat_map.h"
+#include "cow_vector.h"
+#include "immutable_vector.h"
+#include "rcu_vector.h"
+#include "concurrent_queue.h"
+#include "vector_pool.h"
+#include "numeric_vector.h"
+#include "simd_kernels.h"
+#include "sort.h"
+#include "permute.h"
+#include "scan.h"
+#include "compressed_int_vector.h"
+#include "vector_file.h"
+#include <map>
+#include <set>
+#include <deque>
+#include <random>
+#include <thread>
+#include <filesystem>
+#include <fstream>
 
 template <class T, class U, class = typename T::iterator, class = typename U::iterator>
 bool is_same(const T& a, const U& s)
@@ -86,6 +111,91 @@ public:
     char b_;
 };
 
+template <class T>
+class IdAllocator
+{
+public:
+    typedef T value_type;
+    typedef std::false_type propagate_on_container_move_assignment;
+    explicit IdAllocator(int id = 0) : id_(id) {}
+    template <class U> IdAllocator(const IdAllocator<U>& other) : id_(other.id_) {}
+    // copies of a container get a distinct allocator, as a scoped or arena allocator might hand out
+    IdAllocator select_on_container_copy_construction() const { return IdAllocator(id_ + 100); }
+    T* allocate(std::size_t n) { return std::allocator<T>().allocate(n); }
+    void deallocate(T* p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+    template <class... Args> void construct(T* p, Args&&... args) { new((void *) p) T(std::forward<Args>(args)...); }
+    void destroy(T* p) { p->~T(); }
+    friend bool operator==(const IdAllocator& lhs, const IdAllocator& rhs) { return lhs.id_ == rhs.id_; }
+    friend bool operator!=(const IdAllocator& lhs, const IdAllocator& rhs) { return !(lhs == rhs); }
+    int id_;
+};
+
+class Counted
+{
+public:
+    static int live;
+    Counted(int v = 0) : v_(v) { ++live; }
+    Counted(const Counted& other) : v_(other.v_) { ++live; }
+    Counted(Counted&& other) : v_(other.v_) { other.v_ = -1; ++live; }
+    Counted& operator=(const Counted& other) = default;
+    Counted& operator=(Counted&& other) = default;
+    ~Counted() { --live; }
+    int value() const { return v_; }
+private:
+    int v_;
+};
+
+int Counted::live = 0;
+
+template <class T>
+class ShrinkInPlaceAllocator : public pretty_allocator::tracking_allocator<T>
+{
+public:
+    template <class U> struct rebind { typedef ShrinkInPlaceAllocator<U> other; };
+    ShrinkInPlaceAllocator() {}
+    template <class U> ShrinkInPlaceAllocator(const ShrinkInPlaceAllocator<U>&) {}
+    bool shrink_in_place(T*, std::size_t old_n, std::size_t new_n) {
+        pretty_allocator::tracked_stats().bytes_deallocated += (old_n - new_n) * sizeof(T);
+        ++shrinks;
+        return true;
+    }
+    static int shrinks;
+};
+
+template <class T> int ShrinkInPlaceAllocator<T>::shrinks = 0;
+
+class ThrowingCopy
+{
+public:
+    static int copies_left;
+    static int moves;
+    ThrowingCopy(int v) : v_(v) {}
+    ThrowingCopy(const ThrowingCopy& other) : v_(other.v_) {
+        if (copies_left-- == 0) {
+            throw std::runtime_error("copy failed");
+        }
+    }
+    ThrowingCopy(ThrowingCopy&& other) : v_(other.v_) { other.v_ = -1; ++moves; }
+    ThrowingCopy& operator=(const ThrowingCopy&) = default;
+    ThrowingCopy& operator=(ThrowingCopy&&) = default;
+    int v_;
+};
+
+int ThrowingCopy::copies_left = 0;
+int ThrowingCopy::moves = 0;
+
+struct ThrowingDefault {
+    static int constructions_left;
+    ThrowingDefault() {
+        if (constructions_left-- == 0) {
+            throw std::runtime_error("construction failed");
+        }
+    }
+    int v_ = 0;
+};
+
+int ThrowingDefault::constructions_left = 0;
+
 TEST_CASE("Constructors") {
     SECTION("vector(size_type n)") {
         pretty_vector::vector<double> test_vector(500);
@@ -139,6 +249,80 @@ TEST_CASE("Constructors") {
 
 }
 
+TEST_CASE("Move and copy assignment") {
+    SECTION("move constructor steals the buffer") {
+        pretty_vector::vector<int> a({1, 2, 3});
+        int* buffer = a.data();
+        pretty_vector::vector<int> b(std::move(a));
+        REQUIRE(b.data() == buffer);
+        REQUIRE(b.size() == 3);
+        REQUIRE(a.empty());
+        REQUIRE(a.capacity() == 0);
+        REQUIRE(std::is_nothrow_move_constructible<pretty_vector::vector<NotIntegralType>>::value);
+    }
+
+    SECTION("move assignment steals the buffer") {
+        pretty_vector::vector<int> a({1, 2, 3});
+        pretty_vector::vector<int> b({4, 5});
+        int* buffer = a.data();
+        b = std::move(a);
+        REQUIRE(b.data() == buffer);
+        REQUIRE(is_same(b, std::vector<int>{1, 2, 3}));
+        REQUIRE(a.empty());
+        REQUIRE(std::is_nothrow_move_assignable<pretty_vector::vector<NotIntegralType>>::value);
+    }
+
+    SECTION("copy assignment reuses capacity") {
+        pretty_vector::vector<int> a;
+        a.reserve(16);
+        a.push_back(9);
+        int* buffer = a.data();
+        pretty_vector::vector<int> b({1, 2, 3});
+        a = b;
+        REQUIRE(a.data() == buffer);
+        REQUIRE(a.capacity() == 16);
+        REQUIRE(is_same(a, b));
+
+        a = {7, 8};
+        REQUIRE(a.data() == buffer);
+        REQUIRE(is_same(a, std::vector<int>{7, 8}));
+    }
+
+    SECTION("copy assignment is deep") {
+        pretty_vector::vector<NotIntegralType> a(3);
+        a[1].large_field_a[0] = 42;
+        pretty_vector::vector<NotIntegralType> b(1);
+        b = a;
+        a[1].large_field_a[0] = 43;
+        REQUIRE(b.size() == 3);
+        REQUIRE(b[1].large_field_a[0] == 42);
+    }
+
+    SECTION("move between unequal allocators moves elements") {
+        pretty_vector::vector<int, IdAllocator<int>> a({1, 2, 3}, IdAllocator<int>(1));
+        pretty_vector::vector<int, IdAllocator<int>> b(IdAllocator<int>(2));
+        int* buffer = a.data();
+        b = std::move(a);
+        REQUIRE(b.data() != buffer);
+        REQUIRE(is_same(b, std::vector<int>{1, 2, 3}));
+
+        pretty_vector::vector<int, IdAllocator<int>> c(std::move(b), IdAllocator<int>(2));
+        REQUIRE(c.size() == 3);
+        REQUIRE(b.empty());
+    }
+
+    SECTION("copies ask the allocator which allocator to use and fit the size") {
+        pretty_vector::vector<int, IdAllocator<int>> a(IdAllocator<int>(1));
+        a.reserve(64);
+        a.push_back(1);
+        a.push_back(2);
+        pretty_vector::vector<int, IdAllocator<int>> b(a);
+        REQUIRE(b.get_allocator().id_ == 101);
+        REQUIRE(b.capacity() == 2);
+        REQUIRE(is_same(b, std::vector<int>{1, 2}));
+    }
+}
+
 TEST_CASE("Inserts and emplaces") {
     SECTION ("Inserts") {
         pretty_vector::vector<char> a(pretty_vector::vector<char>::size_type(1));
@@ -392,4 +576,2245 @@ TEST_CASE("operators"){
         pretty_vector::vector<char> d({'a','d','a'});
         REQUIRE(c <= d);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("storage ownership"){
+    SECTION("shrink_to_fit relocates into a right-sized block"){
+        pretty_allocator::allocation_stats before = pretty_allocator::tracked_stats();
+        {
+            pretty_vector::vector<NotIntegralType, pretty_allocator::tracking_allocator<NotIntegralType>> a(3);
+            a[2].large_field_a[0] = 7;
+            a.reserve(100);
+            a.shrink_to_fit();
+            REQUIRE(a.capacity() == 3);
+            REQUIRE(a[2].large_field_a[0] == 7);
+            a.clear();
+            a.shrink_to_fit();
+            REQUIRE(a.capacity() == 0);
+        }
+        pretty_allocator::allocation_stats after = pretty_allocator::tracked_stats();
+        REQUIRE(after.live_allocations() == before.live_allocations());
+        REQUIRE(after.live_bytes() == before.live_bytes());
+    }
+
+    SECTION("shrink_to_fit uses in-place shrink when the allocator has it"){
+        pretty_vector::vector<int, ShrinkInPlaceAllocator<int>> a({1, 2, 3});
+        a.reserve(50);
+        int* buffer = a.data();
+        a.shrink_to_fit();
+        REQUIRE(ShrinkInPlaceAllocator<int>::shrinks == 1);
+        REQUIRE(a.data() == buffer);
+        REQUIRE(a.capacity() == 3);
+        REQUIRE(a[2] == 3);
+    }
+
+    SECTION("no leaks under churn"){
+        typedef pretty_vector::vector<Counted, pretty_allocator::tracking_allocator<Counted>> V;
+        pretty_allocator::allocation_stats before = pretty_allocator::tracked_stats();
+        {
+            std::mt19937 rng(7);
+            std::vector<int> ref;
+            V v;
+            auto pick = [&](std::size_t bound) { return static_cast<V::size_type>(rng() % (bound + 1)); };
+
+            for (int step = 0; step < 20000; ++step) {
+                int x = static_cast<int>(rng() % 1000);
+                V::size_type pos = pick(ref.size());
+                switch (rng() % 20) {
+                    case 0: v.push_back(Counted(x)); ref.push_back(x); break;
+                    case 1: v.emplace_back(x); ref.push_back(x); break;
+                    case 2: v.emplace(v.begin() + pos, x); ref.insert(ref.begin() + pos, x); break;
+                    case 3: { Counted c(x); v.insert(v.begin() + pos, c); ref.insert(ref.begin() + pos, x); break; }
+                    case 4: v.insert(v.begin() + pos, V::size_type(3), Counted(x)); ref.insert(ref.begin() + pos, 3, x); break;
+                    case 5: {
+                        std::vector<Counted> src{Counted(x), Counted(x + 1)};
+                        v.insert(v.begin() + pos, src.begin(), src.end());
+                        ref.insert(ref.begin() + pos, {x, x + 1});
+                        break;
+                    }
+                    case 6: v.insert(v.begin() + pos, {Counted(x), Counted(x + 2)}); ref.insert(ref.begin() + pos, {x, x + 2}); break;
+                    case 7:
+                        if (!ref.empty()) {
+                            pos = pick(ref.size() - 1);
+                            v.erase(v.begin() + pos);
+                            ref.erase(ref.begin() + pos);
+                        }
+                        break;
+                    case 8: {
+                        V::size_type last = pos + pick(ref.size() - pos);
+                        v.erase(v.begin() + pos, v.begin() + last);
+                        ref.erase(ref.begin() + pos, ref.begin() + last);
+                        break;
+                    }
+                    case 9: if (!ref.empty()) { v.pop_back(); ref.pop_back(); } break;
+                    case 10: v.resize(pick(120)); ref.resize(v.size(), 0); break;
+                    case 11: { V::size_type n = pick(120); v.resize(n, Counted(x)); ref.resize(n, x); break; }
+                    case 12: v.reserve(pick(300)); break;
+                    case 13: v.shrink_to_fit(); break;
+                    case 14: if (rng() % 8 == 0) { v.clear(); ref.clear(); } break;
+                    case 15: { V::size_type n = pick(60); v.assign(n, Counted(x)); ref.assign(n, x); break; }
+                    case 16: {
+                        std::vector<Counted> src(pick(60), Counted(x));
+                        v.assign(src.begin(), src.end());
+                        ref.assign(src.size(), x);
+                        break;
+                    }
+                    case 17: { V copy(v); V other({Counted(1)}); other = copy; v = other; break; }
+                    case 18: { V moved(std::move(v)); v = std::move(moved); break; }
+                    case 19: { V copy(v); V empty; v.swap(empty); v = std::move(copy); break; }
+                }
+                if (ref.size() > 150) {
+                    v.resize(50);
+                    ref.resize(50);
+                }
+
+                REQUIRE(v.size() == ref.size());
+                REQUIRE(v.capacity() >= v.size());
+                for (V::size_type i = 0; i < v.size(); ++i) {
+                    if (v[i].value() != ref[i]) {
+                        FAIL("mismatch at " << i << " after step " << step);
+                    }
+                }
+            }
+        }
+        pretty_allocator::allocation_stats after = pretty_allocator::tracked_stats();
+        REQUIRE(Counted::live == 0);
+        REQUIRE(after.live_allocations() == before.live_allocations());
+        REQUIRE(after.live_bytes() == before.live_bytes());
+    }
+}
+
+TEST_CASE("growth exception safety"){
+    SECTION("throwing move constructors are not used when relocating"){
+        pretty_vector::vector<ThrowingCopy> v;
+        v.reserve(10);
+        for (int i = 0; i < 4; ++i) {
+            v.emplace_back(i);
+        }
+        ThrowingCopy::moves = 0;
+        ThrowingCopy::copies_left = 2;
+        REQUIRE_THROWS_AS(v.reserve(100), std::runtime_error);
+        REQUIRE(v.capacity() == 10);
+        REQUIRE(v.size() == 4);
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(v[i].v_ == i);
+        }
+
+        ThrowingCopy::copies_left = 1000;
+        v.reserve(100);
+        REQUIRE(ThrowingCopy::moves == 0);
+        REQUIRE(v.capacity() == 100);
+        REQUIRE(v[3].v_ == 3);
+    }
+
+    SECTION("push_back keeps the vector intact when growth throws"){
+        pretty_vector::vector<ThrowingCopy> v;
+        ThrowingCopy::copies_left = 1000;
+        while (v.size() + 1 < v.capacity() || v.size() < 3) {
+            v.push_back(ThrowingCopy(static_cast<int>(v.size())));
+        }
+        pretty_vector::vector<ThrowingCopy>::size_type capacity = v.capacity();
+        pretty_vector::vector<ThrowingCopy>::size_type size = v.size();
+        ThrowingCopy::copies_left = 1;
+        REQUIRE_THROWS_AS(v.push_back(ThrowingCopy(100)), std::runtime_error);
+        REQUIRE(v.capacity() == capacity);
+        REQUIRE(v.size() == size);
+        REQUIRE(v.back().v_ == static_cast<int>(size) - 1);
+    }
+
+    SECTION("push_back of an own element while growing"){
+        pretty_vector::vector<std::string> v;
+        v.push_back(std::string(64, 'x'));
+        for (int i = 0; i < 20; ++i) {
+            v.push_back(v[0]);
+        }
+        REQUIRE(v.size() == 21);
+        REQUIRE(v[20] == std::string(64, 'x'));
+    }
+
+    SECTION("constructors release everything when an element throws"){
+        typedef pretty_vector::vector<ThrowingCopy, pretty_allocator::tracking_allocator<ThrowingCopy>> Copies;
+        typedef pretty_vector::vector<ThrowingDefault, pretty_allocator::tracking_allocator<ThrowingDefault>> Defaults;
+        ThrowingCopy::copies_left = 1000;
+        Copies source;
+        for (int i = 0; i < 5; ++i) {
+            source.emplace_back(i);
+        }
+        std::size_t live = pretty_allocator::tracked_stats().live_allocations();
+        ThrowingCopy::copies_left = 2;
+        REQUIRE_THROWS_AS(Copies(source), std::runtime_error);
+        ThrowingCopy::copies_left = 2;
+        REQUIRE_THROWS_AS(Copies(5, ThrowingCopy(1)), std::runtime_error);
+        ThrowingCopy::copies_left = 1;
+        REQUIRE_THROWS_AS((Copies{ThrowingCopy(1), ThrowingCopy(2)}), std::runtime_error);
+        ThrowingDefault::constructions_left = 3;
+        REQUIRE_THROWS_AS(Defaults(10), std::runtime_error);
+        REQUIRE(pretty_allocator::tracked_stats().live_allocations() == live);
+        ThrowingCopy::copies_left = 1000;
+    }
+
+    SECTION("insert of an own element, with and without growing"){
+        pretty_vector::vector<std::string> v;
+        v.push_back(std::string(64, 'a'));
+        v.push_back(std::string(64, 'b'));
+        for (int i = 0; i < 20; ++i) {
+            if (i == 10) {
+                v.reserve(v.size() + 8);
+            }
+            v.insert(v.begin(), v[0]);
+            v.emplace(v.begin() + 1, v[v.size() - 1]);
+        }
+        REQUIRE(v.size() == 42);
+        for (unsigned int i = 0; i < v.size(); i += 2) {
+            REQUIRE(v[i] == std::string(64, 'a'));
+            REQUIRE(v[i + 1] == std::string(64, 'b'));
+        }
+    }
+
+    SECTION("insert keeps the vector intact when the constructor throws"){
+        pretty_vector::vector<ThrowingCopy> v;
+        ThrowingCopy::copies_left = 1000;
+        v.reserve(10);
+        for (int i = 0; i < 4; ++i) {
+            v.emplace_back(i);
+        }
+        ThrowingCopy value(100);
+        ThrowingCopy::copies_left = 0;
+        REQUIRE_THROWS_AS(v.insert(v.begin() + 1, value), std::runtime_error);
+        REQUIRE(v.size() == 4);
+        REQUIRE(v.capacity() == 10);
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(v[i].v_ == i);
+        }
+        ThrowingCopy::copies_left = 1000;
+        v.insert(v.begin() + 1, value);
+        REQUIRE(v.size() == 5);
+        REQUIRE(v[1].v_ == 100);
+        REQUIRE(v[4].v_ == 3);
+    }
+}
+
+TEST_CASE("aligned storage"){
+    auto offset = [](const void *p, std::size_t alignment) {
+        return reinterpret_cast<std::uintptr_t>(p) % alignment;
+    };
+
+    SECTION("blocks keep the allocator's alignment through growth"){
+        pretty_vector::vector<char, pretty_allocator::allocator<char, 64>> lines;
+        pretty_vector::vector<int, pretty_allocator::allocator<int, 4096>> pages;
+        REQUIRE(lines.alignment == 64);
+        REQUIRE(pages.alignment == 4096);
+        bool aligned = true;
+        for (int i = 0; i < 5000; ++i) {
+            lines.push_back(static_cast<char>(i));
+            pages.push_back(i);
+            aligned = aligned && offset(lines.data(), 64) == 0 && offset(pages.data(), 4096) == 0;
+        }
+        pages.reserve(100000);
+        lines.shrink_to_fit();
+        REQUIRE(aligned);
+        REQUIRE(offset(pages.data(), 4096) == 0);
+        REQUIRE(offset(lines.data(), 64) == 0);
+        REQUIRE(pages[4999] == 4999);
+    }
+
+    SECTION("over-aligned elements and defaults"){
+        struct alignas(128) block {
+            int value;
+        };
+        pretty_vector::vector<block, pretty_allocator::allocator<block>> blocks(3, block{7});
+        REQUIRE(blocks.alignment == 128);
+        REQUIRE(offset(blocks.data(), 128) == 0);
+        REQUIRE(pretty_vector::vector<int>::alignment == alignof(int));
+        REQUIRE(pretty_vector::vector<float, pretty_allocator::allocator<float, 32>>::alignment == 32);
+    }
+
+    SECTION("allocators of different alignment are not interchangeable"){
+        REQUIRE(pretty_allocator::allocator<int>() == pretty_allocator::allocator<long>());
+        REQUIRE(pretty_allocator::allocator<int, 64>() != pretty_allocator::allocator<int, 32>());
+        typedef std::allocator_traits<pretty_allocator::allocator<int, 64>>::rebind_alloc<double> rebound;
+        REQUIRE(rebound::alignment == 64);
+    }
+}
+
+TEST_CASE("soa_vector"){
+    typedef pretty_vector::soa_vector<int, char> Records;
+
+    SECTION("rows are split into aligned columns"){
+        Records records;
+        for (int i = 0; i < 100; ++i) {
+            records.emplace_back(i, static_cast<char>('a' + i % 26));
+        }
+        REQUIRE(records.size() == 100);
+        auto ints = records.column<0>();
+        auto chars = records.column<1>();
+        REQUIRE(ints.size() == 100);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(ints.data()) % Records::column_alignment == 0);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(chars.data()) % Records::column_alignment == 0);
+        long sum = 0;
+        for (int value : ints) {
+            sum += value;
+        }
+        REQUIRE(sum == 4950);
+        REQUIRE(chars[27] == 'b');
+    }
+
+    SECTION("row proxies read and write through"){
+        Records records({std::make_tuple(1, 'x'), std::make_tuple(2, 'y')});
+        records[0].get<0>() = 10;
+        records[1] = std::make_tuple(20, 'z');
+        std::tuple<int, char> first = records[0];
+        REQUIRE(first == std::make_tuple(10, 'x'));
+        REQUIRE(records.column<0>()[1] == 20);
+        REQUIRE(records.column<1>()[1] == 'z');
+
+        records[0] = records[1];
+        REQUIRE(records.at(0).get<1>() == 'z');
+        REQUIRE_THROWS_AS(records.at(2), std::out_of_range);
+    }
+
+    SECTION("iteration, erase and capacity"){
+        Records records;
+        records.reserve(10);
+        for (int i = 0; i < 5; ++i) {
+            records.push_back(std::make_tuple(i, 'c'));
+        }
+        records.erase(1);
+        std::vector<int> seen;
+        for (auto row : records) {
+            seen.push_back(row.get<0>());
+        }
+        REQUIRE(seen == std::vector<int>{0, 2, 3, 4});
+        REQUIRE(records.capacity() == 10);
+        records.shrink_to_fit();
+        REQUIRE(records.capacity() == 4);
+        records.clear();
+        REQUIRE(records.empty());
+    }
+
+    SECTION("reserve and resize keep the columns in step when they throw"){
+        pretty_vector::soa_vector<int, ThrowingCopy> copies;
+        ThrowingCopy::copies_left = 1000;
+        for (int i = 0; i < 6; ++i) {
+            copies.emplace_back(i, ThrowingCopy(i));
+        }
+        auto capacity = copies.capacity();
+        ThrowingCopy::copies_left = 3;
+        REQUIRE_THROWS_AS(copies.reserve(capacity + 50), std::runtime_error);
+        ThrowingCopy::copies_left = 1000;
+        REQUIRE(copies.capacity() == capacity);
+        REQUIRE(copies.column<0>().size() == 6);
+        REQUIRE(copies.column<1>().size() == 6);
+        for (int i = 0; i < 6; ++i) {
+            REQUIRE(copies.column<1>()[i].v_ == i);
+        }
+        copies.reserve(capacity + 50);
+        REQUIRE(copies.capacity() == capacity + 50);
+        REQUIRE(copies.column<1>()[5].v_ == 5);
+
+        pretty_vector::soa_vector<int, ThrowingDefault> defaults;
+        ThrowingDefault::constructions_left = 1000;
+        defaults.resize(4);
+        ThrowingDefault::constructions_left = 5;
+        REQUIRE_THROWS_AS(defaults.resize(20), std::runtime_error);
+        REQUIRE(defaults.size() == 4);
+        REQUIRE(defaults.column<0>().size() == 4);
+        REQUIRE(defaults.column<1>().size() == 4);
+        ThrowingDefault::constructions_left = 1000;
+        defaults.resize(20);
+        REQUIRE(defaults.column<1>().size() == 20);
+    }
+}
+
+TEST_CASE("bit_vector"){
+    typedef pretty_vector::bit_vector<> Bits;
+
+    SECTION("push, access and resize across word boundaries"){
+        Bits bits;
+        std::vector<bool> ref;
+        for (int i = 0; i < 200; ++i) {
+            bits.push_back(i % 3 == 0);
+            ref.push_back(i % 3 == 0);
+        }
+        bits[5] = true;
+        ref[5] = true;
+        bits.flip(64);
+        ref[64] = !ref[64];
+        bits.resize(250, true);
+        ref.resize(250, true);
+        bits.pop_back();
+        ref.pop_back();
+        REQUIRE(bits.size() == ref.size());
+        REQUIRE(bits.word_size() == 4);
+        for (std::size_t i = 0; i < ref.size(); ++i) {
+            REQUIRE(bits[i] == ref[i]);
+        }
+        REQUIRE_THROWS_AS(bits.at(249), std::out_of_range);
+        bits.resize(70);
+        REQUIRE(bits.count() == static_cast<Bits::size_type>(std::count(ref.begin(), ref.begin() + 70, true)));
+    }
+
+    SECTION("bulk operations"){
+        Bits a(130);
+        Bits b(130);
+        for (Bits::size_type i = 0; i < 130; i += 2) {
+            a.set(i);
+        }
+        for (Bits::size_type i = 0; i < 130; i += 3) {
+            b.set(i);
+        }
+        REQUIRE(a.count() == 65);
+        REQUIRE((a & b).count() == 22);
+        REQUIRE((a | b).count() == 87);
+        REQUIRE((a ^ b).count() == 65);
+        a.flip();
+        REQUIRE(a.count() == 65);
+        REQUIRE(a.find_first() == 1);
+        REQUIRE(a.find_next(1) == 3);
+        REQUIRE(a.find_next(129) == Bits::npos);
+        Bits none(100);
+        REQUIRE(none.find_first() == Bits::npos);
+        REQUIRE(none.none());
+        REQUIRE_THROWS_AS(a &= none, std::invalid_argument);
+        Bits ones(70, true);
+        REQUIRE(ones.count() == 70);
+    }
+
+    SECTION("rank and select match a naive scan"){
+        std::mt19937 rng(3);
+        Bits bits;
+        for (int i = 0; i < 5000; ++i) {
+            bits.push_back(rng() % 5 == 0);
+        }
+        std::vector<Bits::size_type> ones;
+        for (Bits::size_type i = 0; i < bits.size(); ++i) {
+            if (bits[i]) {
+                ones.push_back(i);
+            }
+        }
+        for (int pass = 0; pass < 2; ++pass) {
+            Bits::size_type seen = 0;
+            for (Bits::size_type i = 0; i <= bits.size(); ++i) {
+                REQUIRE(bits.rank(i) == seen);
+                if (i < bits.size() && bits.test(i)) {
+                    ++seen;
+                }
+            }
+            for (Bits::size_type k = 0; k < ones.size(); ++k) {
+                REQUIRE(bits.select(k) == ones[k]);
+            }
+            REQUIRE(bits.select(static_cast<Bits::size_type>(ones.size())) == Bits::npos);
+            bits.build_index();
+            REQUIRE(bits.has_index());
+        }
+        bool first = bits[0], second = bits[1];
+        REQUIRE(bits.has_index());
+        bits[1] = second;
+        REQUIRE_FALSE(bits.has_index());
+        bits.build_index();
+        bits[2].flip();
+        REQUIRE_FALSE(bits.has_index());
+        bits.build_index();
+        bits.set(0, !first);
+        REQUIRE_FALSE(bits.has_index());
+        REQUIRE(bits.rank(1) == (first ? 0u : 1u));
+    }
+}
+
+TEST_CASE("segmented_vector"){
+    SECTION("growth never moves elements"){
+        pretty_vector::segmented_vector<int, 16> v;
+        std::vector<int*> addresses;
+        for (int i = 0; i < 1000; ++i) {
+            addresses.push_back(&v.emplace_back(i));
+        }
+        REQUIRE(v.size() == 1000);
+        REQUIRE(v.chunk_count() == 63);
+        for (int i = 0; i < 1000; ++i) {
+            REQUIRE(&v[i] == addresses[i]);
+            REQUIRE(*addresses[i] == i);
+        }
+        REQUIRE(v.back() == 999);
+        REQUIRE_THROWS_AS(v.at(1000), std::out_of_range);
+    }
+
+    SECTION("chunk-wise and element-wise iteration agree"){
+        pretty_vector::segmented_vector<int, 8> v({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+        long by_chunk = 0;
+        int chunks = 0;
+        v.for_each_chunk([&](const int* data, pretty_vector::segmented_vector<int, 8>::size_type count) {
+            for (pretty_vector::segmented_vector<int, 8>::size_type i = 0; i < count; ++i) {
+                by_chunk += data[i];
+            }
+            ++chunks;
+        });
+        long by_element = 0;
+        for (int value : v) {
+            by_element += value;
+        }
+        REQUIRE(chunks == 2);
+        REQUIRE(by_chunk == 66);
+        REQUIRE(by_element == 66);
+        REQUIRE(std::distance(v.begin(), v.end()) == 11);
+    }
+
+    SECTION("chunks are returned to the allocator"){
+        typedef pretty_vector::segmented_vector<Counted, 4, pretty_allocator::tracking_allocator<Counted>> V;
+        pretty_allocator::allocation_stats before = pretty_allocator::tracked_stats();
+        {
+            V v;
+            for (int i = 0; i < 50; ++i) {
+                v.push_back(Counted(i));
+            }
+            V copy(v);
+            REQUIRE(copy[49].value() == 49);
+            for (int i = 0; i < 45; ++i) {
+                v.pop_back();
+            }
+            v.shrink_to_fit();
+            REQUIRE(v.capacity() == 8);
+            V moved(std::move(copy));
+            REQUIRE(copy.empty());
+            v = moved;
+            REQUIRE(v.size() == 50);
+        }
+        pretty_allocator::allocation_stats after = pretty_allocator::tracked_stats();
+        REQUIRE(Counted::live == 0);
+        REQUIRE(after.live_allocations() == before.live_allocations());
+    }
+}
+
+TEST_CASE("devector"){
+    SECTION("push_front does not shift the whole buffer"){
+        pretty_vector::devector<int> v;
+        for (int i = 0; i < 1000; ++i) {
+            v.push_front(i);
+            v.push_back(-i);
+        }
+        REQUIRE(v.size() == 2000);
+        REQUIRE(v.front() == 999);
+        REQUIRE(v.back() == -999);
+        REQUIRE(v[999] == 0);
+        REQUIRE(v[1000] == 0);
+        REQUIRE(&v[1999] == v.data() + 1999);
+        v.pop_front();
+        v.pop_back();
+        REQUIRE(v.front() == 998);
+        REQUIRE(v.back() == -998);
+    }
+
+    SECTION("sliding window keeps its capacity"){
+        pretty_vector::devector<int> v;
+        for (int i = 0; i < 64; ++i) {
+            v.push_back(i);
+        }
+        for (int i = 64; i < 1000; ++i) {
+            v.push_back(i);
+            v.pop_front();
+        }
+        pretty_vector::devector<int>::size_type capacity = v.capacity();
+        REQUIRE(capacity < 256);
+        for (int i = 1000; i < 100000; ++i) {
+            v.push_back(i);
+            v.pop_front();
+        }
+        REQUIRE(v.capacity() == capacity);
+        REQUIRE(v.front() == 100000 - 64);
+        REQUIRE(v.back() == 99999);
+    }
+
+    SECTION("insert and erase agree with std::deque"){
+        pretty_vector::devector<int> v;
+        std::deque<int> d;
+        std::mt19937 rng(7);
+        for (int step = 0; step < 5000; ++step) {
+            unsigned int pos = d.empty() ? 0 : rng() % (d.size() + 1);
+            if (d.empty() || rng() % 3 != 0) {
+                int value = static_cast<int>(rng() % 1000);
+                REQUIRE(*v.insert(v.begin() + pos, value) == value);
+                d.insert(d.begin() + pos, value);
+            } else {
+                pos %= d.size();
+                v.erase(v.begin() + pos);
+                d.erase(d.begin() + pos);
+            }
+        }
+        REQUIRE(is_same(v, d));
+    }
+
+    SECTION("reserve_front and reserve_back"){
+        pretty_vector::devector<int> v;
+        v.reserve_front(10);
+        REQUIRE(v.front_free_capacity() == 10);
+        for (int i = 0; i < 10; ++i) {
+            v.push_front(i);
+        }
+        REQUIRE(v.capacity() == 10);
+        v.reserve_back(20);
+        REQUIRE(v.back_free_capacity() == 10);
+        v.resize(20);
+        REQUIRE(v.capacity() == 20);
+        REQUIRE(v.front() == 9);
+        REQUIRE(v.back() == 0);
+    }
+
+    SECTION("elements are released"){
+        typedef pretty_vector::devector<Counted, pretty_allocator::tracking_allocator<Counted>> V;
+        pretty_allocator::allocation_stats before = pretty_allocator::tracked_stats();
+        {
+            V v;
+            for (int i = 0; i < 300; ++i) {
+                v.push_front(Counted(i));
+                v.emplace_back(-i);
+            }
+            v.insert(v.begin() + 100, Counted(7));
+            v.erase(v.begin() + 500);
+            V copy(v);
+            REQUIRE(copy.size() == 600);
+            REQUIRE(copy[100].value() == 7);
+            for (int i = 0; i < 550; ++i) {
+                v.pop_front();
+            }
+            v.shrink_to_fit();
+            REQUIRE(v.capacity() == 50);
+            v = std::move(copy);
+            REQUIRE(v.size() == 600);
+            REQUIRE(Counted::live == 600);
+        }
+        pretty_allocator::allocation_stats after = pretty_allocator::tracked_stats();
+        REQUIRE(Counted::live == 0);
+        REQUIRE(after.live_allocations() == before.live_allocations());
+    }
+}
+
+TEST_CASE("circular_vector"){
+    typedef pretty_vector::circular_vector<int> ring;
+
+    SECTION("fifo across the wrap point"){
+        ring r(8, ring::capacity_policy::fixed);
+        std::deque<int> d;
+        for (int i = 0; i < 1000; ++i) {
+            if (r.full()) {
+                REQUIRE_FALSE(r.try_push_back(i));
+                REQUIRE_THROWS_AS(r.push_back(i), std::length_error);
+                REQUIRE(r.front() == d.front());
+                r.pop_front();
+                d.pop_front();
+            }
+            r.push_back(i);
+            d.push_back(i);
+        }
+        REQUIRE(r.capacity() == 8);
+        REQUIRE(is_same(r, d));
+    }
+
+    SECTION("growth keeps the order"){
+        ring r;
+        for (int i = 0; i < 5; ++i) {
+            r.push_back(i);
+        }
+        r.pop_front();
+        r.pop_front();
+        for (int i = 5; i < 100; ++i) {
+            r.push_back(i);
+        }
+        REQUIRE(r.size() == 98);
+        for (ring::size_type i = 0; i < r.size(); ++i) {
+            REQUIRE(r[i] == static_cast<int>(i) + 2);
+        }
+    }
+
+    SECTION("batch push and pop"){
+        ring r(10, ring::capacity_policy::fixed);
+        int values[16];
+        for (int i = 0; i < 16; ++i) {
+            values[i] = i;
+        }
+        REQUIRE(r.push_back_n(values, 6) == 6);
+        int out[16];
+        REQUIRE(r.pop_front_n(out, 4) == 4);
+        REQUIRE(out[3] == 3);
+        REQUIRE(r.push_back_n(values + 6, 16 - 6) == 8);
+        REQUIRE(r.full());
+
+        ring::segments used = r.readable();
+        REQUIRE(used.first.size == 6);
+        REQUIRE(used.second.size == 4);
+        REQUIRE(used.first.data[0] == 4);
+        REQUIRE(used.second.data[3] == 13);
+
+        REQUIRE(r.pop_front_n(out, 16) == 10);
+        REQUIRE(out[9] == 13);
+        REQUIRE(r.empty());
+    }
+
+    SECTION("zero-copy writes"){
+        ring r(6, ring::capacity_policy::fixed);
+        r.push_back(0);
+        r.push_back(1);
+        r.push_back(2);
+        r.pop_front();
+        r.pop_front();
+        r.push_back(3);
+        r.push_back(4);
+        ring::segments free = r.writable(100);
+        REQUIRE(free.size() == 3);
+        REQUIRE(free.first.size == 1);
+        free.first.data[0] = 5;
+        free.second.data[0] = 6;
+        r.commit(2);
+        REQUIRE(r.size() == 5);
+        REQUIRE(r.readable(3).first.size == 3);
+        REQUIRE(r.readable().second.size == 1);
+        r.consume(3);
+        REQUIRE(r.front() == 5);
+        REQUIRE(r.back() == 6);
+
+        ring growable;
+        ring::segments more = growable.writable(20);
+        REQUIRE(more.first.size == 20);
+        REQUIRE(growable.capacity() >= 20);
+    }
+
+    SECTION("elements are released"){
+        typedef pretty_vector::circular_vector<Counted, pretty_allocator::tracking_allocator<Counted>> C;
+        pretty_allocator::allocation_stats before = pretty_allocator::tracked_stats();
+        {
+            C c;
+            Counted values[7];
+            for (int i = 0; i < 100; ++i) {
+                c.push_back_n(values, 7);
+                c.consume(5);
+            }
+            REQUIRE(c.size() == 200);
+            C copy(c);
+            c.pop_back();
+            c.shrink_to_fit();
+            REQUIRE(c.capacity() == 199);
+            c = std::move(copy);
+            REQUIRE(Counted::live == 207);
+        }
+        pretty_allocator::allocation_stats after = pretty_allocator::tracked_stats();
+        REQUIRE(Counted::live == 0);
+        REQUIRE(after.live_allocations() == before.live_allocations());
+    }
+}
+
+TEST_CASE("flat_map and flat_set"){
+    SECTION("lower_bound agrees with std::lower_bound"){
+        std::mt19937 rng(11);
+        for (unsigned int n = 0; n < 70; ++n) {
+            std::vector<int> keys;
+            for (unsigned int i = 0; i < n; ++i) {
+                keys.push_back(static_cast<int>(rng() % 200) * 2);
+            }
+            pretty_vector::flat_set<int> set(keys.begin(), keys.end());
+            std::set<int> expected(keys.begin(), keys.end());
+            REQUIRE(is_same(set.keys(), std::vector<int>(expected.begin(), expected.end())));
+            for (int pass = 0; pass < 2; ++pass) {
+                for (int key = -1; key < 402; ++key) {
+                    unsigned int want = std::distance(expected.begin(), expected.lower_bound(key));
+                    REQUIRE(set.lower_bound_index(key) == want);
+                    REQUIRE(set.contains(key) == (expected.count(key) == 1));
+                }
+                set.build_index();
+                REQUIRE(set.index_valid());
+            }
+        }
+    }
+
+    SECTION("bulk construction keeps the first duplicate"){
+        std::vector<std::pair<int, std::string>> items = {{3, "c"}, {1, "a"}, {3, "x"}, {2, "b"}, {1, "y"}};
+        pretty_vector::flat_map<int, std::string> map(items.begin(), items.end());
+        REQUIRE(map.size() == 3);
+        REQUIRE(map.at(1) == "a");
+        REQUIRE(map.at(3) == "c");
+        REQUIRE_THROWS_AS(map.at(4), std::out_of_range);
+        REQUIRE(map.find(4) == map.end());
+        REQUIRE(map.find(2)->second == "b");
+    }
+
+    SECTION("single and batched insertion agree with std::map"){
+        pretty_vector::flat_map<int, int> map;
+        std::map<int, int> expected;
+        std::mt19937 rng(5);
+        for (int i = 0; i < 500; ++i) {
+            int key = static_cast<int>(rng() % 1000);
+            REQUIRE(map.insert(std::make_pair(key, i)).second == expected.insert(std::make_pair(key, i)).second);
+            if (i % 50 == 0) {
+                map.build_index();
+            }
+        }
+        std::vector<std::pair<int, int>> batch;
+        for (int i = 0; i < 800; ++i) {
+            batch.push_back(std::make_pair(static_cast<int>(rng() % 2000), -i));
+        }
+        map.insert(batch.begin(), batch.end());
+        expected.insert(batch.begin(), batch.end());
+        REQUIRE_FALSE(map.index_valid());
+        REQUIRE(map.size() == expected.size());
+        map.build_index();
+        for (const auto &item : expected) {
+            REQUIRE(map.at(item.first) == item.second);
+        }
+        unsigned int i = 0;
+        for (auto item : map) {
+            REQUIRE(item.first == map.keys()[i]);
+            REQUIRE(item.second == map.values()[i]);
+            ++i;
+        }
+
+        map[5000] = 1;
+        ++map[5000];
+        REQUIRE(map.at(5000) == 2);
+        REQUIRE(map.erase(5000) == 1);
+        REQUIRE(map.erase(5000) == 0);
+        map.erase(map.begin());
+        expected.erase(expected.begin());
+        REQUIRE(map.begin()->first == expected.begin()->first);
+        REQUIRE(map.size() == expected.size());
+    }
+
+    SECTION("batched set insertion"){
+        pretty_vector::flat_set<int> set({5, 1, 9});
+        std::vector<int> batch = {9, 2, 2, 7, 0};
+        set.insert(batch.begin(), batch.end());
+        REQUIRE(is_same(set.keys(), std::vector<int>({0, 1, 2, 5, 7, 9})));
+        REQUIRE_FALSE(set.insert(7).second);
+        REQUIRE(*set.insert(6).first == 6);
+        REQUIRE(set.erase(1) == 1);
+        REQUIRE(is_same(set.keys(), std::vector<int>({0, 2, 5, 6, 7, 9})));
+    }
+
+    SECTION("batched insertion moves move-only values"){
+        pretty_vector::flat_map<int, std::unique_ptr<int>> map;
+        map.try_emplace(4, new int(40));
+        map.try_emplace(1, new int(10));
+        const int *kept = map.at(4).get();
+        std::vector<std::pair<int, std::unique_ptr<int>>> batch;
+        batch.emplace_back(3, new int(30));
+        batch.emplace_back(4, new int(-1));
+        batch.emplace_back(0, new int(0));
+        map.insert(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        REQUIRE(map.size() == 4);
+        REQUIRE(map.at(4).get() == kept);
+        REQUIRE(*map.at(4) == 40);
+        REQUIRE(*map.at(3) == 30);
+        REQUIRE(*map.at(0) == 0);
+    }
+
+    SECTION("a throwing batched insertion leaves the map as it was"){
+        pretty_vector::flat_map<std::string, ThrowingCopy> map;
+        ThrowingCopy::copies_left = 1000;
+        for (int i = 0; i < 50; ++i) {
+            map.try_emplace(std::string(32, static_cast<char>('A' + i)), i);
+        }
+        std::vector<std::pair<std::string, ThrowingCopy>> batch;
+        batch.emplace_back("!", ThrowingCopy(-5));
+        ThrowingCopy::copies_left = 10;
+        REQUIRE_THROWS_AS(map.insert(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end())),
+                          std::runtime_error);
+        ThrowingCopy::copies_left = 1000;
+        REQUIRE(map.size() == 50);
+        for (int i = 0; i < 50; ++i) {
+            REQUIRE(map.keys()[i] == std::string(32, static_cast<char>('A' + i)));
+            REQUIRE(map.values()[i].v_ == i);
+        }
+    }
+}
+
+TEST_CASE("cow_vector"){
+    typedef pretty_vector::cow_vector<Counted, pretty_allocator::tracking_allocator<Counted>> C;
+
+    SECTION("snapshots share storage until the first write"){
+        pretty_allocator::allocation_stats before = pretty_allocator::tracked_stats();
+        {
+            C table;
+            for (int i = 0; i < 100; ++i) {
+                table.emplace_back(i);
+            }
+            pretty_allocator::allocation_stats filled = pretty_allocator::tracked_stats();
+            std::vector<C> snapshots;
+            snapshots.reserve(10);
+            for (int i = 0; i < 10; ++i) {
+                snapshots.push_back(table);
+            }
+            REQUIRE(pretty_allocator::tracked_stats().allocations == filled.allocations);
+            REQUIRE(table.use_count() == 11);
+            REQUIRE(Counted::live == 100);
+            REQUIRE(snapshots[3].shares_with(table));
+
+            table.set(5, Counted(-5));
+            REQUIRE(Counted::live == 200);
+            REQUIRE_FALSE(snapshots[3].shares_with(table));
+            REQUIRE(table[5].value() == -5);
+            REQUIRE(snapshots[3][5].value() == 5);
+            REQUIRE(table.use_count() == 1);
+            REQUIRE(snapshots[0].use_count() == 10);
+
+            pretty_allocator::allocation_stats cloned = pretty_allocator::tracked_stats();
+            table.mutable_at(6) = Counted(-6);
+            table.push_back(Counted(100));
+            REQUIRE(pretty_allocator::tracked_stats().allocations - cloned.allocations <= 1);
+
+            snapshots.clear();
+            REQUIRE(Counted::live == 101);
+        }
+        REQUIRE(Counted::live == 0);
+        REQUIRE(pretty_allocator::tracked_stats().live_allocations() == before.live_allocations());
+    }
+
+    SECTION("reads never clone"){
+        const pretty_vector::cow_vector<int> a({1, 2, 3});
+        pretty_vector::cow_vector<int> b(a);
+        int sum = 0;
+        for (int value : b) {
+            sum += value;
+        }
+        REQUIRE(sum == 6);
+        REQUIRE(b.at(2) == 3);
+        REQUIRE(b.data() == a.data());
+        REQUIRE(b == a);
+        b.pop_back();
+        REQUIRE(b != a);
+        REQUIRE(a.size() == 3);
+        REQUIRE(b.size() == 2);
+        b.clear();
+        REQUIRE(b.empty());
+        REQUIRE(b.begin() == b.end());
+        REQUIRE_THROWS_AS(b.at(0), std::out_of_range);
+    }
+}
+
+TEST_CASE("immutable_vector"){
+    typedef pretty_vector::immutable_vector<int> V;
+
+    SECTION("versions agree with a copied std::vector"){
+        std::mt19937 rng(3);
+        std::vector<V> versions(1);
+        std::vector<std::vector<int>> expected(1);
+        for (int step = 0; step < 3000; ++step) {
+            std::size_t from = rng() % versions.size();
+            const V &source = versions[from];
+            std::vector<int> model = expected[from];
+            V next;
+            unsigned int size = model.size();
+            switch (rng() % 7) {
+                case 0:
+                case 1: {
+                    next = source;
+                    for (int i = rng() % 100; i >= 0; --i) {
+                        next = next.push_back(step);
+                        model.push_back(step);
+                    }
+                    break;
+                }
+                case 2: {
+                    if (size == 0) {
+                        continue;
+                    }
+                    unsigned int pos = rng() % size;
+                    next = source.set(pos, -step);
+                    model[pos] = -step;
+                    break;
+                }
+                case 3: {
+                    unsigned int count = size ? rng() % (size + 1) : 0;
+                    next = source.take(count);
+                    model.resize(count);
+                    break;
+                }
+                case 4: {
+                    unsigned int count = size ? rng() % (size + 1) : 0;
+                    next = source.drop(count);
+                    model.erase(model.begin(), model.begin() + count);
+                    break;
+                }
+                case 5: {
+                    std::size_t other = rng() % versions.size();
+                    next = source.concat(versions[other]);
+                    model.insert(model.end(), expected[other].begin(), expected[other].end());
+                    break;
+                }
+                default: {
+                    unsigned int first = size ? rng() % (size + 1) : 0;
+                    unsigned int last = first + (size - first ? rng() % (size - first + 1) : 0);
+                    next = source.slice(first, last);
+                    model = std::vector<int>(model.begin() + first, model.begin() + last);
+                    break;
+                }
+            }
+            REQUIRE(next.size() == model.size());
+            REQUIRE(std::equal(next.begin(), next.end(), model.begin()));
+            REQUIRE(is_same(versions[from], expected[from]));
+            if (model.size() < 20000) {
+                versions.push_back(next);
+                expected.push_back(model);
+            }
+        }
+        for (std::size_t i = 0; i < versions.size(); ++i) {
+            REQUIRE(is_same(versions[i], expected[i]));
+        }
+    }
+
+    SECTION("transient edits in place"){
+        typedef pretty_vector::immutable_vector<int, pretty_allocator::tracking_allocator<int>> T;
+        pretty_allocator::allocation_stats before = pretty_allocator::tracked_stats();
+        {
+            T::transient builder = T().make_transient();
+            for (int i = 0; i < 32 * 32 * 4; ++i) {
+                builder.push_back(i);
+            }
+            // 128 leaves, 4 inner nodes and the root
+            REQUIRE(pretty_allocator::tracked_stats().allocations - before.allocations == 133);
+            T frozen = builder.persistent();
+            REQUIRE(frozen.height() == 2);
+
+            pretty_allocator::allocation_stats shared = pretty_allocator::tracked_stats();
+            builder.set(0, -1);
+            builder.set(1, -2);
+            REQUIRE(pretty_allocator::tracked_stats().allocations - shared.allocations == 3);
+            REQUIRE(frozen[0] == 0);
+            REQUIRE(builder[1] == -2);
+
+            T updated = frozen.set(4000, 7);
+            REQUIRE(updated[4000] == 7);
+            REQUIRE(frozen[4000] == 4000);
+            REQUIRE(updated.pop_back().size() == 4095);
+            REQUIRE_THROWS_AS(frozen.at(4096), std::out_of_range);
+
+            long sum = 0;
+            frozen.for_each_chunk([&sum](const int *data, unsigned int count) {
+                for (unsigned int i = 0; i < count; ++i) {
+                    sum += data[i];
+                }
+            });
+            REQUIRE(sum == 4095L * 4096 / 2);
+        }
+        REQUIRE(pretty_allocator::tracked_stats().live_allocations() == before.live_allocations());
+    }
+
+    SECTION("elements are released"){
+        typedef pretty_vector::immutable_vector<Counted> C;
+        {
+            C a;
+            for (int i = 0; i < 100; ++i) {
+                a = a.push_back(Counted(i));
+            }
+            C b = a.concat(a).drop(50).take(120);
+            REQUIRE(b[0].value() == 50);
+            REQUIRE(b[119].value() == 69);
+            REQUIRE(a.slice(10, 20).front().value() == 10);
+        }
+        REQUIRE(Counted::live == 0);
+    }
+}
+
+TEST_CASE("rcu_vector"){
+    SECTION("retired snapshots wait for readers"){
+        pretty_vector::rcu_vector<int> v(pretty_vector::vector<int>(4, 0), 2);
+        pretty_vector::rcu_vector<int>::reader first = v.make_reader();
+        pretty_vector::rcu_vector<int>::reader second = v.make_reader();
+        REQUIRE_THROWS_AS(v.make_reader(), std::length_error);
+        {
+            pretty_vector::rcu_vector<int>::read_guard pinned = first.read();
+            v.update([](pretty_vector::vector<int> &items) { items.push_back(1); });
+            REQUIRE(pinned.size() == 4);
+            REQUIRE(v.size() == 5);
+            REQUIRE(second.read().size() == 5);
+            REQUIRE(v.retired() == 1);
+            REQUIRE(v.reclaim() == 1);
+        }
+        REQUIRE(v.reclaim() == 0);
+        v.publish(pretty_vector::vector<int>(2, 7));
+        REQUIRE(v.retired() == 0);
+        REQUIRE(first.read()[1] == 7);
+        REQUIRE(v.epoch() == 2);
+    }
+
+    SECTION("readers always see a whole snapshot"){
+        pretty_vector::rcu_vector<int> v(pretty_vector::vector<int>(256, 0));
+        std::atomic<bool> done(false);
+        std::atomic<int> torn(0);
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 3; ++t) {
+            readers.emplace_back([&] {
+                pretty_vector::rcu_vector<int>::reader reader = v.make_reader();
+                while (!done.load()) {
+                    pretty_vector::rcu_vector<int>::read_guard snapshot = reader.read();
+                    for (unsigned int i = 1; i < snapshot.size(); ++i) {
+                        if (snapshot[i] != snapshot[0]) {
+                            ++torn;
+                        }
+                    }
+                }
+            });
+        }
+        for (int version = 1; version <= 300; ++version) {
+            v.publish(pretty_vector::vector<int>(256, version));
+        }
+        done = true;
+        for (std::thread &reader : readers) {
+            reader.join();
+        }
+        v.synchronize();
+        REQUIRE(torn == 0);
+        REQUIRE(v.retired() == 0);
+        REQUIRE(v.make_reader().read()[255] == 300);
+    }
+}
+
+TEST_CASE("concurrent queues"){
+    SECTION("spsc_queue is a bounded fifo"){
+        pretty_vector::spsc_queue<int> q(5);
+        REQUIRE(q.capacity() == 8);
+        int values[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+        REQUIRE(q.push_n(values, 10) == 8);
+        REQUIRE_FALSE(q.try_push(8));
+        int out[4];
+        REQUIRE(q.pop_n(out, 3) == 3);
+        REQUIRE(out[2] == 2);
+        REQUIRE(q.try_push(8));
+        REQUIRE(q.size_approx() == 6);
+        int value = -1;
+        for (int expected = 3; expected <= 8; ++expected) {
+            REQUIRE(q.try_pop(value));
+            REQUIRE(value == expected);
+        }
+        REQUIRE_FALSE(q.try_pop(value));
+        REQUIRE(q.pop_n(out, 4) == 0);
+    }
+
+    SECTION("mpmc_queue is a bounded fifo on one thread"){
+        pretty_vector::mpmc_queue<int> q(4);
+        int values[6] = {0, 1, 2, 3, 4, 5};
+        REQUIRE(q.push_n(values, 6) == 4);
+        REQUIRE_FALSE(q.try_push(4));
+        int out[6];
+        REQUIRE(q.pop_n(out, 2) == 2);
+        REQUIRE(out[1] == 1);
+        REQUIRE(q.push_n(values + 4, 2) == 2);
+        REQUIRE(q.pop_n(out, 6) == 4);
+        REQUIRE(out[0] == 2);
+        REQUIRE(out[3] == 5);
+        REQUIRE(q.size_approx() == 0);
+        REQUIRE(q.pop_n(out, 6) == 0);
+    }
+
+    SECTION("queued elements are destroyed with the queue"){
+        Counted::live = 0;
+        {
+            pretty_vector::mpmc_queue<pretty_vector::vector<Counted>> q(8);
+            pretty_vector::spsc_queue<Counted> s(8);
+            for (int i = 0; i < 3; ++i) {
+                REQUIRE(q.try_push(pretty_vector::vector<Counted>(2, Counted(i))));
+                REQUIRE(s.try_emplace(i));
+            }
+            pretty_vector::vector<Counted> out;
+            REQUIRE(q.try_pop(out));
+            Counted first;
+            REQUIRE(s.try_pop(first));
+            REQUIRE(Counted::live == 4 + 2 + 2 + 1);
+        }
+        REQUIRE(Counted::live == 0);
+    }
+
+    SECTION("spsc_queue hands vectors between threads"){
+        const int batches = 2000;
+        pretty_vector::spsc_queue<pretty_vector::vector<int>> q(16);
+        std::thread producer([&] {
+            for (int i = 0; i < batches;) {
+                pretty_vector::vector<int> batch[3] = {pretty_vector::vector<int>(4, i),
+                                                       pretty_vector::vector<int>(4, i + 1),
+                                                       pretty_vector::vector<int>(4, i + 2)};
+                int count = std::min(3, batches - i);
+                int sent = 0;
+                while (sent < count) {
+                    sent += q.push_n(batch + sent, count - sent);
+                }
+                i += count;
+            }
+        });
+        int expected = 0;
+        bool ordered = true;
+        pretty_vector::vector<int> received[5];
+        while (expected < batches) {
+            unsigned int n = q.pop_n(received, 5);
+            for (unsigned int i = 0; i < n; ++i, ++expected) {
+                ordered = ordered && received[i].size() == 4 && received[i][3] == expected;
+            }
+        }
+        producer.join();
+        REQUIRE(ordered);
+        REQUIRE(q.size_approx() == 0);
+    }
+
+    SECTION("mpmc_queue loses and duplicates nothing"){
+        const int producers = 3, consumers = 3, per_producer = 20000;
+        pretty_vector::mpmc_queue<pretty_vector::vector<int>> q(64);
+        std::vector<std::vector<int>> seen(consumers);
+        std::atomic<int> received(0);
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                for (int i = 0; i < per_producer;) {
+                    pretty_vector::vector<int> batch[4];
+                    int count = std::min(4, per_producer - i);
+                    for (int j = 0; j < count; ++j) {
+                        batch[j].push_back(p * per_producer + i + j);
+                    }
+                    int sent = 0;
+                    while (sent < count) {
+                        sent += p == 0 ? static_cast<int>(q.try_push(std::move(batch[sent])))
+                                       : static_cast<int>(q.push_n(batch + sent, count - sent));
+                        std::this_thread::yield();
+                    }
+                    i += count;
+                }
+            });
+        }
+        for (int c = 0; c < consumers; ++c) {
+            threads.emplace_back([&, c] {
+                pretty_vector::vector<int> out[4];
+                while (received.load() < producers * per_producer) {
+                    unsigned int n = c == 0 ? static_cast<unsigned int>(q.try_pop(out[0])) : q.pop_n(out, 4);
+                    for (unsigned int i = 0; i < n; ++i) {
+                        seen[c].push_back(out[i][0]);
+                    }
+                    received += n;
+                    if (n == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        std::vector<int> all;
+        for (const std::vector<int> &values : seen) {
+            all.insert(all.end(), values.begin(), values.end());
+        }
+        std::sort(all.begin(), all.end());
+        REQUIRE(all.size() == static_cast<std::size_t>(producers * per_producer));
+        bool exact = true;
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            exact = exact && all[i] == static_cast<int>(i);
+        }
+        REQUIRE(exact);
+    }
+}
+
+TEST_CASE("vector_pool"){
+    typedef pretty_vector::vector_pool<int, pretty_allocator::tracking_allocator<int>> pool_type;
+
+    SECTION("released vectors come back cleared with their capacity"){
+        pool_type pool;
+        pool_type::vector_type first = pool.acquire(100);
+        REQUIRE(first.capacity() >= 100);
+        first.push_back(1);
+        const int *storage = first.data();
+        pool.release(std::move(first));
+        REQUIRE(pool.stats().pooled == 1);
+        REQUIRE(pool.stats().retained_bytes == 100 * sizeof(int));
+
+        pretty_allocator::tracked_stats().reset();
+        pool_type::vector_type second = pool.acquire(50);
+        REQUIRE(second.empty());
+        REQUIRE(second.data() == storage);
+        REQUIRE(pretty_allocator::tracked_stats().allocations == 0);
+
+        pretty_vector::pool_stats stats = pool.stats();
+        REQUIRE(stats.acquires == 2);
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.hit_rate() == 0.5);
+        REQUIRE(stats.retained_bytes == 0);
+        REQUIRE(stats.pooled == 0);
+    }
+
+    SECTION("limits bound what is kept"){
+        pretty_vector::pool_limits limits;
+        limits.max_vectors = 2;
+        limits.max_capacity = 64;
+        limits.max_retained_bytes = 80 * sizeof(int);
+        pool_type pool(limits);
+        pool.release(pool.acquire(65));
+        pool.release(pool.acquire(0));
+        REQUIRE(pool.stats().pooled == 0);
+        REQUIRE(pool.stats().dropped == 1);
+
+        pool_type::vector_type a = pool.acquire(60), b = pool.acquire(30), c = pool.acquire(10), d = pool.acquire(30);
+        pool.release(std::move(a));
+        pool.release(std::move(b));
+        REQUIRE(pool.stats().dropped == 2);
+        pool.release(std::move(c));
+        pool.release(std::move(d));
+        REQUIRE(pool.stats().pooled == 2);
+        REQUIRE(pool.stats().dropped == 3);
+        REQUIRE(pool.stats().retained_bytes == 70 * sizeof(int));
+
+        pool.trim();
+        REQUIRE(pool.stats().pooled == 0);
+        REQUIRE(pool.stats().retained_bytes == 0);
+
+        // a dropped vector is deallocated even if the caller keeps it around
+        pool_type::vector_type big = pool.acquire(100);
+        pool.release(std::move(big));
+        REQUIRE(big.capacity() == 0);
+    }
+
+    SECTION("only a big enough pooled vector is a hit"){
+        pool_type pool;
+        pool_type::vector_type small = pool.acquire(10), large = pool.acquire(40), medium = pool.acquire(20);
+        pool.release(std::move(small));
+        pool.release(std::move(large));
+        pool.release(std::move(medium));
+        pool.reset_stats();
+        pool_type::vector_type items = pool.acquire(30);
+        REQUIRE(items.capacity() == 40);
+        REQUIRE(pool.stats().hits == 1);
+        pool_type::vector_type more = pool.acquire(50);
+        REQUIRE(more.capacity() >= 50);
+        REQUIRE(pool.stats().hits == 1);
+        REQUIRE(pool.stats().acquires == 2);
+        REQUIRE(pool.stats().pooled == 2);
+        REQUIRE(pool.stats().retained_bytes == 30 * sizeof(int));
+    }
+
+    SECTION("leases return their vector"){
+        pool_type pool;
+        {
+            pool_type::lease scratch = pool.acquire_lease(16);
+            scratch->push_back(3);
+            REQUIRE((*scratch)[0] == 3);
+        }
+        REQUIRE(pool.stats().pooled == 1);
+        pool_type::lease kept = pool.acquire_lease();
+        pool_type::vector_type owned = kept.detach();
+        REQUIRE(owned.capacity() >= 16);
+        REQUIRE(pool.stats().releases == 1);
+    }
+
+    SECTION("local pools are per thread"){
+        typedef pretty_vector::vector_pool<int> local_pool;
+        local_pool *main_pool = &local_pool::local();
+        local_pool *other_pool = nullptr;
+        std::thread([&] { other_pool = &local_pool::local(); }).join();
+        REQUIRE(main_pool != other_pool);
+        REQUIRE(main_pool == &local_pool::local());
+    }
+}
+
+TEST_CASE("numeric_vector"){
+    // every kernel width must agree with the scalar loop
+    const pretty_vector::simd::level levels[] = {pretty_vector::simd::level::scalar,
+                                                 pretty_vector::simd::level::sse2,
+                                                 pretty_vector::simd::level::avx2,
+                                                 pretty_vector::simd::level::avx512};
+
+    SECTION("expressions evaluate element-wise in one pass"){
+        for (pretty_vector::simd::level level : levels) {
+            pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+            // 37 elements leave a scalar tail after every pack width
+            pretty_vector::numeric_vector<float> b(37), c(37), d(37);
+            for (unsigned int i = 0; i < 37; ++i) {
+                b[i] = static_cast<float>(i);
+                c[i] = 2.0f;
+                d[i] = static_cast<float>(i % 3);
+            }
+            pretty_vector::numeric_vector<float> a = b * c + d;
+            bool exact = true;
+            for (unsigned int i = 0; i < 37; ++i) {
+                exact = exact && a[i] == static_cast<float>(i * 2 + i % 3);
+            }
+            REQUIRE(exact);
+
+            a = -(a - 1.0f) / 2.0f + b;
+            REQUIRE(a[10] == -(20.0f + 1.0f - 1.0f) / 2.0f + 10.0f);
+            a *= 2.0f;
+            a += a;
+            REQUIRE(a[10] == 0.0f);
+            REQUIRE(a[36] == 4.0f * (-(72.0f + 0.0f - 1.0f) / 2.0f + 36.0f));
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    SECTION("reductions"){
+        for (pretty_vector::simd::level level : levels) {
+            pretty_vector::simd::level previous = pretty_vector::simd::set_level(level);
+            pretty_vector::numeric_vector<int> v(101);
+            for (unsigned int i = 0; i < v.size(); ++i) {
+                v[i] = static_cast<int>(i) - 50;
+            }
+            REQUIRE(pretty_vector::sum(v) == 0);
+            REQUIRE(pretty_vector::sum(v * 2 + 1) == 101);
+            REQUIRE(pretty_vector::min(v) == -50);
+            REQUIRE(pretty_vector::max(v * v) == 2500);
+            REQUIRE(pretty_vector::dot(v, v) == 2 * 42925);
+
+            pretty_vector::numeric_vector<double> x(1000, 0.5);
+            REQUIRE(pretty_vector::sum(x) == Approx(500.0));
+            REQUIRE(pretty_vector::max(-x) == -0.5);
+            pretty_vector::numeric_vector<double> small = {3.0, -1.0};
+            REQUIRE(pretty_vector::min(small) == -1.0);
+            pretty_vector::simd::set_level(previous);
+        }
+        REQUIRE_THROWS_AS(pretty_vector::min(pretty_vector::numeric_vector<float>()), std::length_error);
+    }
+
+    SECTION("operands must agree in size"){
+        pretty_vector::numeric_vector<float> a(4, 1.0f), b(5, 1.0f);
+        REQUIRE_THROWS_AS(a + b, std::length_error);
+        pretty_vector::numeric_vector<float> c = 1.0f - a;
+        REQUIRE(c.size() == 4);
+        REQUIRE(c[3] == 0.0f);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(c.data()) % 64 == 0);
+    }
+
+    SECTION("dispatch level"){
+        REQUIRE(pretty_vector::simd::active() <= pretty_vector::simd::detected());
+        pretty_vector::simd::level previous = pretty_vector::simd::set_level(pretty_vector::simd::level::scalar);
+        REQUIRE(pretty_vector::simd::active() == pretty_vector::simd::level::scalar);
+        REQUIRE(std::string(pretty_vector::simd::name(pretty_vector::simd::active())) == "scalar");
+        pretty_vector::simd::set_level(previous);
+    }
+}
+
+TEST_CASE("simd kernels"){
+    using pretty_vector::simd::level;
+    const level levels[] = {level::scalar, level::sse2, level::sse42, level::avx2, level::avx512};
+
+    SECTION("every level agrees with the scalar reference"){
+        std::mt19937 rng(7);
+        std::vector<std::uint8_t> bytes(700);
+        std::vector<std::uint16_t> shorts(700);
+        std::vector<std::uint32_t> ints(700);
+        std::vector<std::uint64_t> longs(700);
+        for (std::size_t i = 0; i < bytes.size(); ++i) {
+            bytes[i] = static_cast<std::uint8_t>(rng() % 4);
+            shorts[i] = static_cast<std::uint16_t>(rng() % 4);
+            ints[i] = rng() % 4;
+            longs[i] = (rng() % 4) << 40;
+        }
+        auto check = [](const auto &values, auto needle, std::size_t offset, std::size_t n) {
+            auto first = values.begin() + offset;
+            std::size_t found = pretty_vector::simd::find(values.data() + offset, n, needle);
+            std::size_t counted = pretty_vector::simd::count(values.data() + offset, n, needle);
+            return found == static_cast<std::size_t>(std::find(first, first + n, needle) - first) &&
+                   counted == static_cast<std::size_t>(std::count(first, first + n, needle));
+        };
+        for (level l : levels) {
+            level previous = pretty_vector::simd::set_level(l);
+            bool agrees = true;
+            for (std::size_t n : {0, 1, 15, 64, 129, 600}) {
+                for (std::size_t offset : {0, 3}) {
+                    agrees = agrees && check(bytes, std::uint8_t(3), offset, n) &&
+                             check(shorts, std::uint16_t(2), offset, n) &&
+                             check(ints, std::uint32_t(1), offset, n) &&
+                             check(longs, std::uint64_t(3) << 40, offset, n) &&
+                             check(ints, std::uint32_t(9), offset, n);
+                }
+            }
+            REQUIRE(agrees);
+
+            std::vector<std::uint16_t> filled(133, 0);
+            pretty_vector::simd::fill(filled.data() + 1, std::uint16_t(0xBEEF), 131);
+            REQUIRE(filled[0] == 0);
+            REQUIRE(std::count(filled.begin(), filled.end(), 0xBEEF) == 131);
+            REQUIRE(filled[132] == 0);
+
+            std::vector<std::uint32_t> copy = ints;
+            const pretty_vector::simd::kernel_table &table = pretty_vector::simd::kernels();
+            REQUIRE(table.isa == std::min(l, pretty_vector::simd::detected()));
+            REQUIRE(table.equal(copy.data(), ints.data(), ints.size() * 4));
+            copy[650] ^= 1;
+            REQUIRE_FALSE(table.equal(copy.data(), ints.data(), ints.size() * 4));
+            REQUIRE(table.equal(copy.data(), ints.data(), 650 * 4));
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    SECTION("vector bulk operations use the kernels"){
+        for (level l : {level::scalar, pretty_vector::simd::detected()}) {
+            level previous = pretty_vector::simd::set_level(l);
+            pretty_vector::vector<short> a(300, 7), b(300, 7);
+            REQUIRE(a == b);
+            b[299] = 8;
+            REQUIRE(a != b);
+            a.resize(310, 5);
+            REQUIRE(a[299] == 7);
+            REQUIRE(a[309] == 5);
+
+            pretty_vector::vector<int> v;
+            for (int i = 0; i < 100; ++i) {
+                v.push_back(i);
+            }
+            v.insert(v.begin() + 10, 3, -1);
+            v.erase(v.begin());
+            REQUIRE(v.size() == 102);
+            REQUIRE(v[8] == 9);
+            REQUIRE(v[9] == -1);
+            REQUIRE(v[12] == 10);
+            REQUIRE(v[101] == 99);
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    SECTION("diagnostics name the active kernels"){
+        level previous = pretty_vector::simd::set_level(level::scalar);
+        std::string report = pretty_vector::simd::dispatch_report();
+        REQUIRE(report.find("active: scalar") != std::string::npos);
+        REQUIRE(report.find("relocate: memmove") != std::string::npos);
+        pretty_vector::simd::set_level(previous);
+    }
+}
+
+TEST_CASE("vector searches"){
+    using pretty_vector::simd::level;
+
+    SECTION("find, count, contains"){
+        for (level l : {level::scalar, level::sse2, pretty_vector::simd::detected()}) {
+            level previous = pretty_vector::simd::set_level(l);
+            pretty_vector::vector<int> v;
+            for (int i = 0; i < 1000; ++i) {
+                v.push_back(i % 100);
+            }
+            REQUIRE(v.find(42) - v.begin() == 42);
+            REQUIRE(v.find(-1) == v.end());
+            REQUIRE(v.count(99) == 10);
+            REQUIRE(v.contains(0));
+            REQUIRE_FALSE(v.contains(100));
+
+            pretty_vector::vector<std::uint64_t> big(333, 1);
+            big[300] = std::uint64_t(1) << 63;
+            REQUIRE(big.find(std::uint64_t(1) << 63) - big.begin() == 300);
+            REQUIRE(big.count(1) == 332);
+
+            const pretty_vector::vector<int> empty;
+            REQUIRE(empty.find(1) == empty.end());
+            REQUIRE(empty.count(1) == 0);
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    SECTION("floating point compares by value"){
+        pretty_vector::vector<double> v(100, 1.5);
+        v[40] = -0.0;
+        v[70] = 0.0;
+        v[90] = std::numeric_limits<double>::quiet_NaN();
+        REQUIRE(v.find(0.0) - v.begin() == 40);
+        REQUIRE(v.count(-0.0) == 2);
+        REQUIRE_FALSE(v.contains(std::numeric_limits<double>::quiet_NaN()));
+        REQUIRE(v.count(1.5) == 97);
+    }
+
+    SECTION("find_if with range predicates and plain callables"){
+        pretty_vector::vector<int> v;
+        for (int i = 0; i < 500; ++i) {
+            v.push_back(i - 250);
+        }
+        REQUIRE(*v.find_if(pretty_vector::in_range(10, 20)) == 10);
+        REQUIRE(*v.find_if(pretty_vector::greater_than(240)) == 241);
+        REQUIRE(*v.find_if(pretty_vector::less_than(0)) == -250);
+        REQUIRE(v.find_if(pretty_vector::greater_than(std::numeric_limits<int>::max())) == v.end());
+        REQUIRE(*v.find_if([](int x) { return x % 97 == -96; }) == -193);
+
+        pretty_vector::vector<float> f(64, -1.0f);
+        f[50] = std::numeric_limits<float>::quiet_NaN();
+        f[60] = 0.25f;
+        REQUIRE(f.find_if(pretty_vector::at_least(0.0f)) - f.begin() == 60);
+        REQUIRE(f.find_if(pretty_vector::greater_than(-1.0f)) - f.begin() == 60);
+
+        pretty_vector::vector<unsigned char> bytes(100, 200);
+        bytes[77] = 3;
+        REQUIRE(bytes.find_if(pretty_vector::at_most<unsigned char>(127)) - bytes.begin() == 77);
+    }
+
+    SECTION("mismatch"){
+        pretty_vector::vector<int> a(300, 4), b(280, 4);
+        auto same = a.mismatch(b);
+        REQUIRE(same.first - a.begin() == 280);
+        REQUIRE(same.second == b.end());
+        b[123] = 5;
+        auto diff = a.mismatch(b);
+        REQUIRE(diff.first - a.begin() == 123);
+        REQUIRE(*diff.second == 5);
+
+        pretty_vector::vector<std::string> s = {"a", "b", "c"}, t = {"a", "x"};
+        REQUIRE(*s.mismatch(t).first == "b");
+    }
+}
+
+TEST_CASE("erase_if compaction"){
+    using pretty_vector::simd::level;
+
+    SECTION("matches remove_if at every level"){
+        for (level l : {level::scalar, level::sse2, level::avx2, pretty_vector::simd::detected()}) {
+            level previous = pretty_vector::simd::set_level(l);
+            for (unsigned int n : {0u, 1u, 63u, 64u, 65u, 200u, 4096u, 5000u}) {
+                pretty_vector::vector<int> v;
+                std::vector<int> expected;
+                for (unsigned int i = 0; i < n; ++i) {
+                    int x = static_cast<int>((i * 37) % 101);
+                    v.push_back(x);
+                    if (x < 30 || x > 70) {
+                        expected.push_back(x);
+                    }
+                }
+                REQUIRE(v.erase_if(pretty_vector::in_range(30, 70)) == n - expected.size());
+                REQUIRE(std::vector<int>(v.begin(), v.end()) == expected);
+
+                pretty_vector::vector<std::int64_t> w;
+                for (unsigned int i = 0; i < n; ++i) {
+                    w.push_back(i);
+                }
+                REQUIRE(w.erase_if([](std::int64_t x) { return x % 3 != 0; }) == n - (n + 2) / 3);
+                for (unsigned int i = 0; i < w.size(); ++i) {
+                    REQUIRE(w[i] == 3 * static_cast<std::int64_t>(i));
+                }
+            }
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    SECTION("floating point ranges drop nothing for NaN"){
+        pretty_vector::vector<double> v = {1.0, std::numeric_limits<double>::quiet_NaN(), -2.0, 0.5, 3.0};
+        REQUIRE(v.erase_if(pretty_vector::less_than(1.0)) == 2);
+        REQUIRE(v.size() == 3);
+        REQUIRE(v[0] == 1.0);
+        REQUIRE(std::isnan(v[1]));
+        REQUIRE(v[2] == 3.0);
+    }
+
+    SECTION("masks"){
+        pretty_vector::vector<unsigned char> v;
+        for (int i = 0; i < 150; ++i) {
+            v.push_back(static_cast<unsigned char>(i));
+        }
+        pretty_vector::vector<std::uint64_t> low = v.mask_if(pretty_vector::at_most<unsigned char>(9));
+        pretty_vector::vector<std::uint64_t> odd = v.mask_if([](unsigned char x) { return x % 2 == 1; });
+        REQUIRE(low.size() == 3);
+        REQUIRE(low[0] == 0x3FF);
+        REQUIRE(odd[2] == 0x2AAAAAu);
+        for (unsigned int w = 0; w < low.size(); ++w) {
+            low[w] |= odd[w];
+        }
+        REQUIRE(v.erase_masked(low.data()) == 80);
+        REQUIRE(v.size() == 70);
+        REQUIRE(v.front() == 10);
+        REQUIRE(v.back() == 148);
+    }
+
+    SECTION("elements that are not trivially copyable"){
+        pretty_vector::vector<std::string> v = {"keep", "", "this", "", "", "order"};
+        REQUIRE(v.erase_if([](const std::string &s) { return s.empty(); }) == 3);
+        REQUIRE(v == pretty_vector::vector<std::string>({"keep", "this", "order"}));
+
+        Counted::live = 0;
+        {
+            pretty_vector::vector<Counted> c;
+            for (int i = 0; i < 10; ++i) {
+                c.emplace_back(i);
+            }
+            c.erase_if([](const Counted &x) { return x.value() % 2 == 0; });
+            REQUIRE(c.size() == 5);
+            REQUIRE(c[4].value() == 9);
+            REQUIRE(Counted::live == 5);
+        }
+        REQUIRE(Counted::live == 0);
+    }
+
+    SECTION("a throwing predicate leaves the survivors in order"){
+        pretty_vector::vector<int> v;
+        for (int i = 0; i < 10000; ++i) {
+            v.push_back(i);
+        }
+        REQUIRE_THROWS(v.erase_if([](int x) {
+            if (x == 5000) {
+                throw std::runtime_error("stop");
+            }
+            return x % 2 == 0;
+        }));
+        REQUIRE(v.size() == 10000 - 2048);
+        REQUIRE(v[0] == 1);
+        REQUIRE(v[2047] == 4095);
+        REQUIRE(v[2048] == 4096);
+        REQUIRE(v.back() == 9999);
+    }
+}
+
+TEST_CASE("sort"){
+    pretty_vector::sort_options parallel;
+    parallel.threads = 4;
+    parallel.parallel_threshold = 0;
+    std::mt19937_64 rng(7);
+
+    SECTION("radix sort of integral and floating point keys"){
+        for (unsigned int n : {0u, 1u, 2u, 255u, 1000u, 20000u}) {
+            for (const pretty_vector::sort_options &options : {pretty_vector::sort_options(), parallel}) {
+                pretty_vector::vector<std::uint32_t> u;
+                pretty_vector::vector<std::int64_t> s;
+                pretty_vector::vector<float> f;
+                for (unsigned int i = 0; i < n; ++i) {
+                    u.push_back(static_cast<std::uint32_t>(rng()));
+                    s.push_back(static_cast<std::int64_t>(rng() % 2001) - 1000);
+                    f.push_back(static_cast<float>(static_cast<std::int64_t>(rng() % 20001) - 10000) / 7.0f);
+                }
+                std::vector<std::uint32_t> u_ref(u.begin(), u.end());
+                std::vector<std::int64_t> s_ref(s.begin(), s.end());
+                std::vector<float> f_ref(f.begin(), f.end());
+                std::sort(u_ref.begin(), u_ref.end());
+                std::sort(s_ref.begin(), s_ref.end());
+                std::sort(f_ref.begin(), f_ref.end());
+                pretty_vector::sort(u, options);
+                pretty_vector::sort(s, std::less<std::int64_t>(), options);
+                pretty_vector::sort(f, options);
+                REQUIRE(std::vector<std::uint32_t>(u.begin(), u.end()) == u_ref);
+                REQUIRE(std::vector<std::int64_t>(s.begin(), s.end()) == s_ref);
+                REQUIRE(std::vector<float>(f.begin(), f.end()) == f_ref);
+            }
+        }
+    }
+
+    SECTION("signed zeros, infinities and NaN"){
+        double nan = std::numeric_limits<double>::quiet_NaN();
+        double inf = std::numeric_limits<double>::infinity();
+        pretty_vector::vector<double> v = {0.0, nan, -inf, 1.0, -0.0, inf, -nan, -1.0};
+        pretty_vector::sort(v);
+        REQUIRE(std::isnan(v[0]));
+        REQUIRE(v[1] == -inf);
+        REQUIRE(v[2] == -1.0);
+        REQUIRE(std::signbit(v[3]));
+        REQUIRE(v[4] == 0.0);
+        REQUIRE_FALSE(std::signbit(v[4]));
+        REQUIRE(v[5] == 1.0);
+        REQUIRE(v[6] == inf);
+        REQUIRE(std::isnan(v[7]));
+    }
+
+    SECTION("sort_by_key is stable and carries the values"){
+        for (const pretty_vector::sort_options &options : {pretty_vector::sort_options(), parallel}) {
+            pretty_vector::vector<std::uint16_t> keys;
+            pretty_vector::vector<std::uint32_t> values;
+            pretty_vector::vector<std::string> names;
+            for (std::uint32_t i = 0; i < 30000; ++i) {
+                keys.push_back(static_cast<std::uint16_t>(rng() % 50));
+                values.push_back(i);
+                names.push_back(std::to_string(i));
+            }
+            pretty_vector::vector<std::uint16_t> name_keys = keys;
+            pretty_vector::sort_by_key(keys, values, options);
+            pretty_vector::sort_by_key(name_keys, names, options);
+            REQUIRE(keys == name_keys);
+            for (unsigned int i = 1; i < keys.size(); ++i) {
+                REQUIRE(keys[i - 1] <= keys[i]);
+                if (keys[i - 1] == keys[i]) {
+                    REQUIRE(values[i - 1] < values[i]);
+                }
+                REQUIRE(names[i] == std::to_string(values[i]));
+            }
+        }
+        pretty_vector::vector<int> k(3, 1), v(2, 1);
+        REQUIRE_THROWS_AS(pretty_vector::sort_by_key(k, v), std::length_error);
+    }
+
+    SECTION("merge sort with comparators"){
+        for (unsigned int n : {0u, 1u, 31u, 33u, 64u, 100u, 5000u, 70000u}) {
+            for (const pretty_vector::sort_options &options : {pretty_vector::sort_options(), parallel}) {
+                pretty_vector::vector<std::pair<int, int>> v;
+                for (unsigned int i = 0; i < n; ++i) {
+                    v.push_back(std::make_pair(static_cast<int>(rng() % 100), static_cast<int>(i)));
+                }
+                std::vector<std::pair<int, int>> expected(v.begin(), v.end());
+                auto by_first_descending = [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+                    return a.first > b.first;
+                };
+                std::stable_sort(expected.begin(), expected.end(), by_first_descending);
+                pretty_vector::sort(v, by_first_descending, options);
+                REQUIRE(std::vector<std::pair<int, int>>(v.begin(), v.end()) == expected);
+            }
+        }
+
+        pretty_vector::vector<std::string> words = {"pear", "fig", "apple", "kiwi", "banana"};
+        pretty_vector::sort(words);
+        REQUIRE(words == pretty_vector::vector<std::string>({"apple", "banana", "fig", "kiwi", "pear"}));
+
+        // strings are left empty once moved from, so a part that read another
+        // part's elements would show up as lost values
+        for (unsigned int n : {4300u, 4500u, 4900u, 20000u}) {
+            pretty_vector::vector<std::string> names;
+            for (unsigned int i = 0; i < n; ++i) {
+                names.push_back("name " + std::to_string(rng() % 1000000));
+            }
+            std::vector<std::string> expected(names.begin(), names.end());
+            std::stable_sort(expected.begin(), expected.end());
+            pretty_vector::merge_sort(names, std::less<std::string>(), parallel);
+            REQUIRE(std::vector<std::string>(names.begin(), names.end()) == expected);
+        }
+    }
+
+    SECTION("scratch comes from the vector's allocator"){
+        pretty_vector::vector<int, pretty_allocator::tracking_allocator<int>> v;
+        for (int i = 0; i < 1000; ++i) {
+            v.push_back(1000 - i);
+        }
+        std::size_t before = pretty_allocator::tracked_stats().allocations;
+        pretty_vector::sort(v);
+        REQUIRE(pretty_allocator::tracked_stats().allocations == before + 1);
+        REQUIRE(v.front() == 1);
+        REQUIRE(v.back() == 1000);
+    }
+
+    SECTION("a throwing comparator propagates from worker threads"){
+        pretty_vector::vector<int> v;
+        for (int i = 0; i < 20000; ++i) {
+            v.push_back(i % 977);
+        }
+        std::atomic<int> calls(0);
+        REQUIRE_THROWS_AS(pretty_vector::merge_sort(v, [&](int a, int b) {
+            if (++calls == 50000) {
+                throw std::runtime_error("comparator");
+            }
+            return a < b;
+        }, parallel), std::runtime_error);
+        REQUIRE(v.size() == 20000);
+    }
+}
+
+TEST_CASE("gather, scatter and apply_permutation"){
+    using pretty_vector::simd::level;
+    std::mt19937 rng(11);
+    pretty_vector::permute_options blocked;
+    blocked.blocked_bytes = 0;
+    pretty_vector::permute_options prefetched;
+    prefetched.gather_prefetch_bytes = 0;
+    prefetched.scatter_prefetch_bytes = 0;
+
+    SECTION("gather at every level"){
+        for (level l : {level::scalar, level::sse2, level::avx2, pretty_vector::simd::detected()}) {
+            level previous = pretty_vector::simd::set_level(l);
+            for (unsigned int n : {0u, 1u, 7u, 8u, 9u, 100u, 3001u}) {
+                pretty_vector::vector<std::uint32_t> index;
+                pretty_vector::vector<int> small;
+                pretty_vector::vector<double> wide;
+                pretty_vector::vector<std::uint16_t> narrow;
+                for (unsigned int i = 0; i < n; ++i) {
+                    small.push_back(static_cast<int>(i) * 3 - 7);
+                    wide.push_back(i * 0.5);
+                    narrow.push_back(static_cast<std::uint16_t>(i * 13));
+                }
+                for (unsigned int i = 0; i < 2 * n; ++i) {
+                    index.push_back(rng() % n);
+                }
+                for (const pretty_vector::permute_options &options : {pretty_vector::permute_options(), prefetched, blocked}) {
+                    pretty_vector::vector<int> a = pretty_vector::gather(small, index, options);
+                    pretty_vector::vector<double> b = pretty_vector::gather(wide, index, options);
+                    pretty_vector::vector<std::uint16_t> c = pretty_vector::gather(narrow, index, options);
+                    REQUIRE(a.size() == index.size());
+                    REQUIRE(b.size() == index.size());
+                    for (unsigned int i = 0; i < index.size(); ++i) {
+                        REQUIRE(a[i] == small[index[i]]);
+                        REQUIRE(b[i] == wide[index[i]]);
+                        REQUIRE(c[i] == narrow[index[i]]);
+                    }
+                }
+            }
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    SECTION("other index types and element types"){
+        pretty_vector::vector<std::string> names = {"a", "b", "c", "d"};
+        pretty_vector::vector<int> index = {3, 3, 0, 2};
+        pretty_vector::vector<std::string> picked = pretty_vector::gather(names, index);
+        REQUIRE(picked == pretty_vector::vector<std::string>({"d", "d", "a", "c"}));
+
+        pretty_vector::vector<std::uint64_t> wide_index = {1, 0};
+        pretty_vector::vector<std::int64_t> values = {5, 6};
+        REQUIRE(pretty_vector::gather(values, wide_index) == pretty_vector::vector<std::int64_t>({6, 5}));
+
+        pretty_vector::vector<int> bad = {0, 4};
+        pretty_vector::vector<int> negative = {-1};
+        REQUIRE_THROWS_AS(pretty_vector::gather(names, bad), std::out_of_range);
+        REQUIRE_THROWS_AS(pretty_vector::gather(values, negative), std::out_of_range);
+
+        // more outputs than a uint8_t index can count
+        pretty_vector::vector<int> ramp;
+        for (int i = 0; i < 200; ++i) {
+            ramp.push_back(i * 7);
+        }
+        pretty_vector::vector<std::uint8_t> byte_index;
+        for (unsigned int i = 0; i < 300; ++i) {
+            byte_index.push_back(static_cast<std::uint8_t>(rng() % ramp.size()));
+        }
+        for (const pretty_vector::permute_options &options : {pretty_vector::permute_options(), blocked}) {
+            pretty_vector::vector<int> out = pretty_vector::gather(ramp, byte_index, options);
+            REQUIRE(out.size() == 300);
+            for (unsigned int i = 0; i < out.size(); ++i) {
+                REQUIRE(out[i] == ramp[byte_index[i]]);
+            }
+        }
+    }
+
+    SECTION("scatter inverts gather"){
+        for (const pretty_vector::permute_options &options : {pretty_vector::permute_options(), prefetched, blocked}) {
+            pretty_vector::vector<std::uint32_t> perm;
+            pretty_vector::vector<std::int64_t> values;
+            for (unsigned int i = 0; i < 5000; ++i) {
+                perm.push_back(i);
+                values.push_back(static_cast<std::int64_t>(i) * 11);
+            }
+            std::shuffle(perm.begin(), perm.end(), rng);
+            pretty_vector::vector<std::int64_t> shuffled = pretty_vector::gather(values, perm, options);
+            pretty_vector::vector<std::int64_t> back(values.size(), -1);
+            pretty_vector::scatter(shuffled, perm, back, options);
+            REQUIRE(back == values);
+        }
+        pretty_vector::vector<int> in = {1, 2, 3};
+        pretty_vector::vector<int> out(4, 0);
+        pretty_vector::scatter(in, pretty_vector::vector<int>({3, 1, 3}), out);
+        REQUIRE(out == pretty_vector::vector<int>({0, 2, 0, 3}));
+        REQUIRE_THROWS_AS(pretty_vector::scatter(in, pretty_vector::vector<int>({0, 1}), out), std::length_error);
+        REQUIRE_THROWS_AS(pretty_vector::scatter(in, pretty_vector::vector<int>({0, 1, 4}), out),
+                          std::out_of_range);
+        REQUIRE(out == pretty_vector::vector<int>({0, 2, 0, 3}));
+    }
+
+    SECTION("apply_permutation"){
+        pretty_vector::vector<std::uint32_t> perm;
+        pretty_vector::vector<int> numbers;
+        pretty_vector::vector<std::string> names;
+        for (unsigned int i = 0; i < 1000; ++i) {
+            perm.push_back(i);
+            numbers.push_back(static_cast<int>(i));
+            names.push_back(std::to_string(i));
+        }
+        std::shuffle(perm.begin(), perm.end(), rng);
+        pretty_vector::apply_permutation(numbers, perm);
+        pretty_vector::apply_permutation(names, perm);
+        for (unsigned int i = 0; i < perm.size(); ++i) {
+            REQUIRE(numbers[i] == static_cast<int>(perm[i]));
+            REQUIRE(names[i] == std::to_string(perm[i]));
+        }
+
+        pretty_vector::vector<std::string> three = {"x", "y", "z"};
+        REQUIRE_THROWS_AS(pretty_vector::apply_permutation(three, pretty_vector::vector<int>({0, 1})),
+                          std::length_error);
+        REQUIRE_THROWS_AS(pretty_vector::apply_permutation(three, pretty_vector::vector<int>({0, 2, 2})),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(pretty_vector::apply_permutation(three, pretty_vector::vector<int>({0, 1, 3})),
+                          std::out_of_range);
+        REQUIRE(three == pretty_vector::vector<std::string>({"x", "y", "z"}));
+    }
+}
+
+TEST_CASE("scans"){
+    using pretty_vector::simd::level;
+    pretty_vector::scan_options parallel;
+    parallel.threads = 4;
+    parallel.parallel_threshold = 0;
+    std::mt19937 rng(5);
+
+    SECTION("inclusive and exclusive scans at every level"){
+        for (level l : {level::scalar, level::sse2, level::avx2, pretty_vector::simd::detected()}) {
+            level previous = pretty_vector::simd::set_level(l);
+            for (unsigned int n : {0u, 1u, 15u, 16u, 17u, 1000u, 70000u}) {
+                for (const pretty_vector::scan_options &options : {pretty_vector::scan_options(), parallel}) {
+                    pretty_vector::vector<int> counts;
+                    pretty_vector::vector<std::int8_t> small;
+                    pretty_vector::vector<double> reals;
+                    for (unsigned int i = 0; i < n; ++i) {
+                        counts.push_back(static_cast<int>(rng() % 100) - 20);
+                        small.push_back(static_cast<std::int8_t>(rng()));
+                        reals.push_back(static_cast<double>(rng() % 8));
+                    }
+                    pretty_vector::vector<int> inclusive = pretty_vector::inclusive_scan(counts, options);
+                    pretty_vector::vector<int> exclusive = pretty_vector::exclusive_scan(counts, 7, options);
+                    pretty_vector::vector<std::int8_t> wrapped = pretty_vector::inclusive_scan(small, options);
+                    pretty_vector::vector<double> offsets = pretty_vector::exclusive_scan(reals, 0.5, options);
+                    REQUIRE(inclusive.size() == n);
+                    REQUIRE(exclusive.size() == n);
+                    int running = 0;
+                    std::int8_t small_running = 0;
+                    double real_running = 0.5;
+                    for (unsigned int i = 0; i < n; ++i) {
+                        REQUIRE(exclusive[i] == running + 7);
+                        REQUIRE(offsets[i] == real_running);
+                        running += counts[i];
+                        small_running = static_cast<std::int8_t>(small_running + small[i]);
+                        real_running += reals[i];
+                        REQUIRE(inclusive[i] == running);
+                        REQUIRE(wrapped[i] == small_running);
+                    }
+
+                    pretty_vector::inclusive_scan(counts, counts, options);
+                    REQUIRE(counts == inclusive);
+                }
+            }
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    SECTION("signed integers wrap on the scalar and the threaded paths"){
+        for (unsigned int n : {5u, 40000u}) {
+            pretty_vector::vector<std::int64_t> big(n, std::numeric_limits<std::int64_t>::max() / 3);
+            pretty_vector::vector<std::int64_t> scanned = pretty_vector::inclusive_scan(big, parallel);
+            pretty_vector::vector<std::int64_t> offsets = pretty_vector::exclusive_scan(big, std::int64_t(1), parallel);
+            std::uint64_t running = 0;
+            for (unsigned int i = 0; i < n; ++i) {
+                REQUIRE(offsets[i] == static_cast<std::int64_t>(running + 1));
+                running += static_cast<std::uint64_t>(big[i]);
+                REQUIRE(scanned[i] == static_cast<std::int64_t>(running));
+            }
+        }
+    }
+
+    SECTION("results use the input's allocator"){
+        pretty_vector::vector<std::uint64_t, pretty_allocator::tracking_allocator<std::uint64_t>> sizes;
+        for (std::uint64_t i = 0; i < 100; ++i) {
+            sizes.push_back(i);
+        }
+        pretty_allocator::allocation_stats before = pretty_allocator::tracked_stats();
+        pretty_vector::vector<std::uint64_t, pretty_allocator::tracking_allocator<std::uint64_t>> offsets =
+                pretty_vector::exclusive_scan(sizes);
+        REQUIRE(pretty_allocator::tracked_stats().allocations - before.allocations == 1);
+        REQUIRE(offsets[99] == 99 * 98 / 2);
+    }
+
+    SECTION("segmented scans restart at every head"){
+        for (level l : {level::scalar, level::sse2, level::avx2, pretty_vector::simd::detected()}) {
+            level previous = pretty_vector::simd::set_level(l);
+            for (unsigned int n : {0u, 1u, 64u, 200u, 5000u, 70000u}) {
+                for (unsigned int spacing : {1u, 3u, 40u, 1000u, 100000u}) {
+                    for (const pretty_vector::scan_options &options : {pretty_vector::scan_options(), parallel}) {
+                        pretty_vector::vector<std::uint32_t> values;
+                        pretty_vector::bit_vector<> heads(n);
+                        for (unsigned int i = 0; i < n; ++i) {
+                            values.push_back(rng() % 1000);
+                            if (rng() % spacing == 0) {
+                                heads.set(i);
+                            }
+                        }
+                        pretty_vector::vector<std::uint32_t> inclusive =
+                                pretty_vector::segmented_inclusive_scan(values, heads, options);
+                        pretty_vector::vector<std::uint32_t> exclusive =
+                                pretty_vector::segmented_exclusive_scan(values, heads, 3u, options);
+                        std::uint32_t running = 0;
+                        for (unsigned int i = 0; i < n; ++i) {
+                            if (heads.test(i)) {
+                                running = 0;
+                            }
+                            REQUIRE(exclusive[i] == running + 3);
+                            running += values[i];
+                            REQUIRE(inclusive[i] == running);
+                        }
+                    }
+                }
+            }
+            pretty_vector::simd::set_level(previous);
+        }
+        pretty_vector::vector<int> values(3, 1);
+        REQUIRE_THROWS_AS(pretty_vector::segmented_inclusive_scan(values, pretty_vector::bit_vector<>(2)),
+                          std::length_error);
+    }
+}
+
+TEST_CASE("compressed_int_vector"){
+    using pretty_vector::simd::level;
+    typedef pretty_vector::compressed_int_vector<> compressed;
+    std::mt19937_64 rng(11);
+
+    // sorted ids with small gaps, unsorted values in a narrow range, both with
+    // a few huge jumps (exceptions), full 64-bit values, extremes and runs of
+    // one value per block (planes of width 0, the last block among them)
+    std::vector<std::vector<std::uint64_t>> inputs(7);
+    std::uint64_t id = 1000, jumping = 0;
+    for (unsigned int i = 0; i < 1000; ++i) {
+        id += rng() % 20;
+        jumping += 3 + (i % 97 == 5 ? std::uint64_t(1) << 40 : 0);
+        inputs[0].push_back(id);
+        inputs[1].push_back((std::uint64_t(1) << 40) + rng() % 5000);
+        inputs[2].push_back(jumping);
+        inputs[5].push_back(rng() % 5000 + (i % 97 == 5 ? std::uint64_t(1) << 50 : 0));
+        inputs[3].push_back(rng());
+        inputs[4].push_back(i % 2 ? ~std::uint64_t(0) : 0);
+        inputs[6].push_back(7 + i / 128 * 1000);
+    }
+
+    SECTION("round trips at every level"){
+        for (level l : {level::scalar, level::sse2, level::avx2, pretty_vector::simd::detected()}) {
+            level previous = pretty_vector::simd::set_level(l);
+            for (const std::vector<std::uint64_t> &input : inputs) {
+                for (unsigned int n : {0u, 1u, 127u, 128u, 129u, 1000u}) {
+                    compressed values(input.begin(), input.begin() + n);
+                    REQUIRE(values.size() == n);
+                    REQUIRE(values.block_count() == (n + 127) / 128);
+                    std::vector<std::uint64_t> iterated(values.begin(), values.end());
+                    REQUIRE(iterated == std::vector<std::uint64_t>(input.begin(), input.begin() + n));
+                    for (unsigned int i = 0; i < n; ++i) {
+                        REQUIRE(values[i] == input[i]);
+                    }
+                    pretty_vector::vector<std::uint64_t> copied;
+                    values.copy_to(copied);
+                    REQUIRE(copied.size() == n);
+                    REQUIRE(std::equal(iterated.begin(), iterated.end(), copied.data()));
+                }
+            }
+            pretty_vector::simd::set_level(previous);
+        }
+    }
+
+    SECTION("for_each_block visits every value in order"){
+        compressed values(inputs[0].begin(), inputs[0].end());
+        std::vector<std::uint64_t> visited;
+        values.for_each_block([&](const std::uint64_t *block, unsigned int count) {
+            visited.insert(visited.end(), block, block + count);
+        });
+        REQUIRE(visited == inputs[0]);
+        REQUIRE(values == compressed(visited.begin(), visited.end()));
+        REQUIRE(values != compressed(inputs[1].begin(), inputs[1].end()));
+    }
+
+    SECTION("sorted ids take a fraction of their raw size"){
+        compressed ids(inputs[0].begin(), inputs[0].begin() + 896);
+        ids.shrink_to_fit();
+        REQUIRE(ids.memory_bytes() * 4 <= 896 * sizeof(std::uint64_t));
+        compressed jumps(inputs[2].begin(), inputs[2].begin() + 896);
+        jumps.shrink_to_fit();
+        REQUIRE(jumps.memory_bytes() * 4 <= 896 * sizeof(std::uint64_t));
+    }
+
+    SECTION("at, clear and swap"){
+        compressed values = {5, 3, 9};
+        REQUIRE(values.front() == 5);
+        REQUIRE(values.back() == 9);
+        REQUIRE(values.at(1) == 3);
+        REQUIRE_THROWS_AS(values.at(3), std::out_of_range);
+        compressed other(inputs[3].begin(), inputs[3].end());
+        swap(values, other);
+        REQUIRE(values.size() == 1000);
+        REQUIRE(other.size() == 3);
+        values.clear();
+        REQUIRE(values.empty());
+        values.push_back(42);
+        REQUIRE(values[0] == 42);
+    }
+}
+
+TEST_CASE("vector_file"){
+    std::string path = (std::filesystem::temp_directory_path() / "pretty_vector_test.pvf").string();
+    pretty_vector::vector_file_options small;
+    small.block_bytes = 4096;
+    small.queue_blocks = 2;
+    std::mt19937_64 rng(3);
+
+    struct Point {
+        float x, y, z;
+    };
+
+    SECTION("round trips whatever the data compresses to"){
+        pretty_vector::vector<std::uint32_t> counting, zeros(20000, 0u), noise;
+        pretty_vector::vector<Point> points;
+        for (std::uint32_t i = 0; i < 20000; ++i) {
+            counting.push_back(i * 7);
+            noise.push_back(static_cast<std::uint32_t>(rng()));
+            points.push_back({float(i % 100), 0.5f, float(i)});
+        }
+        for (bool shuffle : {true, false}) {
+            small.shuffle = shuffle;
+            for (const pretty_vector::vector<std::uint32_t> *values : {&counting, &zeros, &noise}) {
+                pretty_vector::save_vector(path, *values, small);
+                REQUIRE(pretty_vector::load_vector<std::uint32_t>(path) == *values);
+            }
+            pretty_vector::save_vector(path, points, small);
+            pretty_vector::vector<Point> loaded = pretty_vector::load_vector<Point>(path);
+            REQUIRE(loaded.size() == points.size());
+            REQUIRE(std::memcmp(loaded.data(), points.data(), points.size() * sizeof(Point)) == 0);
+        }
+
+        small.shuffle = true;
+        pretty_vector::save_vector(path, counting, small);
+        REQUIRE(std::filesystem::file_size(path) * 4 < counting.size() * sizeof(std::uint32_t));
+        pretty_vector::save_vector(path, zeros, small);
+        REQUIRE(std::filesystem::file_size(path) * 50 < zeros.size() * sizeof(std::uint32_t));
+
+        pretty_vector::save_vector(path, pretty_vector::vector<double>());
+        REQUIRE(pretty_vector::load_vector<double>(path).empty());
+    }
+
+    SECTION("the writer takes single elements and ranges alike"){
+        pretty_vector::vector<std::uint64_t> expected;
+        {
+            pretty_vector::vector_file_writer<std::uint64_t> writer(path, small);
+            for (std::uint64_t i = 0; i < 3000; ++i) {
+                writer.push_back(i * i);
+                expected.push_back(i * i);
+            }
+            pretty_vector::vector<std::uint64_t> more(5000, 9);
+            writer.write(more);
+            for (unsigned int i = 0; i < more.size(); ++i) {
+                expected.push_back(9);
+            }
+            REQUIRE(writer.size() == 8000);
+        }
+        REQUIRE(pretty_vector::load_vector<std::uint64_t>(path) == expected);
+    }
+
+    SECTION("readers stream in chunks and seek anywhere"){
+        pretty_vector::vector<std::uint32_t> values;
+        for (std::uint32_t i = 0; i < 50000; ++i) {
+            values.push_back(static_cast<std::uint32_t>(rng() % 1000));
+        }
+        pretty_vector::save_vector(path, values, small);
+        pretty_vector::vector_file_reader<std::uint32_t> reader(path, small);
+        REQUIRE(reader.size() == values.size());
+        REQUIRE(reader.block_count() == (values.size() + 1023) / 1024);
+
+        std::vector<std::uint32_t> streamed(values.size() + 10);
+        std::size_t got = 0;
+        for (std::size_t chunk = 1; got < values.size(); chunk = chunk * 3 % 5000 + 1) {
+            got += reader.read(streamed.data() + got, chunk);
+        }
+        REQUIRE(got == values.size());
+        REQUIRE(reader.read(streamed.data(), 10) == 0);
+        REQUIRE(std::equal(values.begin(), values.end(), streamed.begin()));
+
+        for (int i = 0; i < 200; ++i) {
+            std::uint64_t pos = rng() % values.size();
+            reader.seek(pos);
+            std::uint32_t window[40];
+            std::size_t count = reader.read(window, 40);
+            REQUIRE(count == std::min<std::size_t>(40, values.size() - pos));
+            REQUIRE(std::equal(window, window + count, values.begin() + pos));
+            REQUIRE(reader.tell() == pos + count);
+            std::uint64_t other = rng() % values.size();
+            REQUIRE(reader.at(other) == values[static_cast<unsigned int>(other)]);
+        }
+        std::vector<std::uint32_t> block(1024);
+        REQUIRE(reader.read_block(reader.block_count() - 1, block.data()) == values.size() % 1024);
+        REQUIRE(block[0] == values[values.size() / 1024 * 1024]);
+        REQUIRE_THROWS_AS(reader.at(values.size()), std::out_of_range);
+        REQUIRE_THROWS_AS(reader.seek(values.size() + 1), std::out_of_range);
+    }
+
+    SECTION("bad files are reported"){
+        REQUIRE_THROWS_AS(pretty_vector::load_vector<int>(path + ".missing"), std::runtime_error);
+        pretty_vector::vector<std::uint32_t> values(10000, 5);
+        pretty_vector::save_vector(path, values, small);
+        REQUIRE_THROWS_AS(pretty_vector::load_vector<std::uint64_t>(path), std::runtime_error);
+        {
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(32);
+            file.put(char(0x7f));
+        }
+        REQUIRE_THROWS_AS(pretty_vector::load_vector<std::uint32_t>(path), std::runtime_error);
+        std::filesystem::resize_file(path, 40);
+        REQUIRE_THROWS_AS(pretty_vector::load_vector<std::uint32_t>(path), std::runtime_error);
+        {
+            std::ofstream file(path, std::ios::binary);
+            file << "not a vector file at all, just some text";
+        }
+        REQUIRE_THROWS_AS(pretty_vector::load_vector<std::uint32_t>(path), std::runtime_error);
+    }
+    std::filesystem::remove(path);
+}
@@ -1,9 +1,106 @@
+#pragma once
 #include <iostream>
 #include "allocator.h"
+#include "simd_kernels.h"
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <utility>
 
 namespace pretty_vector {
 
+    template<class T, class A, class = void>
+    struct allocator_has_construct : std::false_type {
+    };
+
+    template<class T, class A>
+    struct allocator_has_construct<T, A, decltype(std::declval<A &>().construct(std::declval<T *>(),
+                                                                                  std::declval<T &&>()), void())>
+            : std::true_type {
+    };
+
+    template<class Allocator>
+    struct is_pretty_allocator : std::false_type {
+    };
+
+    template<class T, std::size_t Alignment>
+    struct is_pretty_allocator<pretty_allocator::allocator<T, Alignment>> : std::true_type {
+    };
+
+    // elements may be relocated with memcpy when they are trivially copyable and
+    // the allocator's construct (if any) is a plain placement new
+    template<class T, class Allocator>
+    struct is_bitwise_relocatable : std::integral_constant<bool,
+            std::is_trivially_copyable<T>::value &&
+            (std::is_same<Allocator, std::allocator<T>>::value ||
+             is_pretty_allocator<Allocator>::value ||
+             !allocator_has_construct<T, Allocator>::value)> {
+    };
+
+    // the alignment every block from Allocator is known to have: its
+    // `alignment` member when it declares one, alignof(T) otherwise
+    template<class T, class Allocator, class = void>
+    struct allocator_alignment : std::integral_constant<std::size_t, alignof(T)> {
+    };
+
+    template<class T, class Allocator>
+    struct allocator_alignment<T, Allocator, decltype(void(Allocator::alignment))>
+            : std::integral_constant<std::size_t, Allocator::alignment> {
+    };
+
+    // Predicate for the closed range [lo, hi]. vector::find_if runs it as a
+    // SIMD kernel for arithmetic elements; any other predicate is called per
+    // element.
+    template<class T>
+    struct range_predicate {
+        T lo, hi;
+
+        bool operator()(const T &value) const { return lo <= value && value <= hi; }
+    };
+
+    template<class T>
+    range_predicate<T> in_range(T lo, T hi) {
+        return range_predicate<T>{lo, hi};
+    }
+
+    template<class T>
+    range_predicate<T> at_least(T lo) {
+        return range_predicate<T>{lo, std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                                           : std::numeric_limits<T>::max()};
+    }
+
+    template<class T>
+    range_predicate<T> at_most(T hi) {
+        return range_predicate<T>{std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                                       : std::numeric_limits<T>::lowest(), hi};
+    }
+
+    // the exclusive bounds step to the neighbouring value; an empty range
+    // (lo > hi) matches nothing
+    template<class T>
+    range_predicate<T> greater_than(T value) {
+        if constexpr (std::is_floating_point<T>::value) {
+            return at_least(std::nextafter(value, std::numeric_limits<T>::infinity()));
+        } else if (value == std::numeric_limits<T>::max()) {
+            return range_predicate<T>{T(1), T(0)};
+        } else {
+            return at_least(static_cast<T>(value + 1));
+        }
+    }
+
+    template<class T>
+    range_predicate<T> less_than(T value) {
+        if constexpr (std::is_floating_point<T>::value) {
+            return at_most(std::nextafter(value, -std::numeric_limits<T>::infinity()));
+        } else if (value == std::numeric_limits<T>::lowest()) {
+            return range_predicate<T>{T(1), T(0)};
+        } else {
+            return at_most(static_cast<T>(value - 1));
+        }
+    }
 
     template<class T, class Allocator = std::allocator<T>>
     class vector {
@@ -12,10 +109,12 @@ namespace pretty_vector {
         using value_type = T;
         using difference_type = std::ptrdiff_t;
         using size_type = unsigned int;
+        using allocator_type = Allocator;
         using reference = T &;
         using const_reference = const T &;
         using pointer = typename std::allocator_traits<Allocator>::pointer;
         using const_pointer = typename std::allocator_traits<Allocator>::const_pointer;
+        static constexpr std::size_t alignment = allocator_alignment<T, Allocator>::value;
         float resize_coefficient = 1.5;
 
         template<typename TypeT>
@@ -134,7 +233,6 @@ namespace pretty_vector {
         public:
             pointer data_;
             size_type index_;
-            typedef typename std::iterator<std::random_access_iterator_tag, TypeT, int>::difference_type difference_type;
         };
 
         typedef MyIterator<data_type> iterator;
@@ -247,65 +345,106 @@ namespace pretty_vector {
         typedef ReverseIterator<const data_type> const_reverse_iterator;
 
     public:
-        explicit vector(const Allocator &alloc = Allocator()) : allocator_(alloc), capacity_(0), size_(0) {};
+        explicit vector(const Allocator &alloc = Allocator()) : capacity_(0), size_(0), allocator_(alloc),
+                                                                data_(nullptr) {};
 
         explicit vector(size_type count, const T &value, const Allocator &alloc = Allocator()) :
-                allocator_(alloc), capacity_(count), size_(count), data_(allocator_.allocate(capacity_)) {
-            fill_with_value(value);
+                capacity_(count), size_(0), allocator_(alloc),
+                data_(std::allocator_traits<Allocator>::allocate(allocator_, count)) {
+            try {
+                fill_with_value(count, value);
+            } catch (...) {
+                // the destructor does not run for a constructor that throws
+                deallocate_storage();
+                throw;
+            }
         }
 
         explicit vector(size_type count) :
-                allocator_(Allocator()), capacity_(count), size_(count),
+                capacity_(count), size_(0), allocator_(Allocator()),
                 data_(std::allocator_traits<Allocator>::allocate(allocator_, count)) {
-            for (size_type i = 0; i < count; ++i) {
-                allocator_.construct(data_ + i);
+            try {
+                for (; size_ < count; ++size_) {
+                    std::allocator_traits<Allocator>::construct(allocator_, data_ + size_);
+                }
+            } catch (...) {
+                deallocate_storage();
+                throw;
             }
         };
 
-        template<class InputIt>
+        template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
         vector(InputIt first, InputIt last,
-               const Allocator &alloc = Allocator()) {
-            reserve(last - first);
-            iterator it = begin();
-            insert(it, first, last);
-            size_ = last - first;
+               const Allocator &alloc = Allocator()) : capacity_(0), size_(0), allocator_(alloc), data_(nullptr) {
+            assign_range(first, static_cast<size_type>(last - first));
         }
 
-        vector(const vector &other) : allocator_(other.allocator_), capacity_(other.capacity_), size_(other.size_),
-                                      data_(allocator_.allocate(capacity_)) {
-            int i = 0;
-            for (iterator it = other.begin(); it != other.end(); ++it) {
-                std::allocator_traits<Allocator>::construct(allocator_, data_ + i, *it);
-                ++i;
+        vector(const vector &other) :
+                capacity_(0), size_(0),
+                allocator_(std::allocator_traits<Allocator>::select_on_container_copy_construction(other.allocator_)),
+                data_(nullptr) {
+            assign_range(other.data_, other.size_);
+        }
+
+        vector(vector &&other) noexcept : capacity_(0), size_(0), allocator_(std::move(other.allocator_)),
+                                          data_(nullptr) {
+            steal_storage(other);
+        }
+
+        vector(vector &&other, const Allocator &alloc) : capacity_(0), size_(0), allocator_(alloc), data_(nullptr) {
+            if (allocator_ == other.allocator_) {
+                steal_storage(other);
+            } else {
+                // storage of a foreign allocator cannot be adopted, move element by element
+                assign_range(std::make_move_iterator(other.data_), other.size_);
             }
         }
 
-        vector(vector &&other, const Allocator &alloc) : allocator_(other.allocator_), capacity_(other.capacity_),
-                                                         size_(other.size_),
-                                                         data_(allocator_.allocate(capacity_)) {
-            int i = 0;
-            for (iterator it = other.begin(); it != other.end(); ++it) {
-                std::allocator_traits<Allocator>::construct(allocator_, data_ + i, std::move(*it));//copy
-                ++i;
+        vector(std::initializer_list<T> init, const Allocator &alloc = Allocator()) :
+                capacity_(0), size_(0), allocator_(alloc), data_(nullptr) {
+            assign_range(init.begin(), static_cast<size_type>(init.size()));
+        }
+
+        vector &operator=(const vector &other) {
+            if (this == &other) {
+                return *this;
+            }
+            if (std::allocator_traits<Allocator>::propagate_on_container_copy_assignment::value) {
+                if (allocator_ != other.allocator_) {
+                    deallocate_storage();
+                }
+                allocator_ = other.allocator_;
             }
+            assign_range(other.data_, other.size_);
+            return *this;
         }
 
-        vector(std::initializer_list<T> init, const Allocator &alloc = Allocator()) : allocator_(alloc),
-                                                                                      capacity_(init.size()),
-                                                                                      size_(init.size()),
-                                                                                      data_(allocator_.allocate(
-                                                                                              capacity_)) {
-            size_type i = 0;
-            for (auto it = init.begin(); it != init.end(); it++) {
-                allocator_.construct(data_ + i, *it);
-                i++;
+        vector &operator=(vector &&other) noexcept(
+                std::allocator_traits<Allocator>::propagate_on_container_move_assignment::value ||
+                std::allocator_traits<Allocator>::is_always_equal::value) {
+            if (this == &other) {
+                return *this;
             }
+            if (std::allocator_traits<Allocator>::propagate_on_container_move_assignment::value) {
+                deallocate_storage();
+                allocator_ = std::move(other.allocator_);
+                steal_storage(other);
+            } else if (allocator_ == other.allocator_) {
+                deallocate_storage();
+                steal_storage(other);
+            } else {
+                assign_range(std::make_move_iterator(other.data_), other.size_);
+            }
+            return *this;
+        }
+
+        vector &operator=(std::initializer_list<T> ilist) {
+            assign_range(ilist.begin(), static_cast<size_type>(ilist.size()));
+            return *this;
         }
 
         ~vector(){
-            for (size_type i = 0; i < size_; i++) {
-                std::allocator_traits<Allocator>::destroy(allocator_, data_ + i);
-            }
+            deallocate_storage();
         }
         reference at(size_type pos) {
             if (pos >= 0 && pos < size_) {
@@ -347,12 +486,19 @@ namespace pretty_vector {
             return at(size_ - 1);
         }
 
+        allocator_type get_allocator() const {
+            return allocator_;
+        }
+
+        // Tells the compiler the storage is aligned to `alignment`, so loops
+        // over data() can use aligned vector loads. Every block, including
+        // the ones reserve() and growth reallocate to, comes from allocator_.
         T *data() {
-            return data_;
+            return assume_aligned(data_);
         }
 
         const T *data() const {
-            return data_;
+            return assume_aligned(data_);
         }
 
         iterator begin() {
@@ -404,6 +550,126 @@ namespace pretty_vector {
             return const_iterator(data_, size_);
         }
 
+        // Linear searches over the contiguous storage. For arithmetic
+        // elements they run the SIMD kernels of simd_kernels.h; other types
+        // compare element by element.
+        iterator find(const T &value) {
+            return iterator(data_, find_index(value));
+        }
+
+        const_iterator find(const T &value) const {
+            return const_iterator(data_, find_index(value));
+        }
+
+        size_type count(const T &value) const {
+            if constexpr (std::is_arithmetic<T>::value && sizeof(T) <= 8) {
+                return static_cast<size_type>(simd::count(data(), size_, value));
+            }
+            size_type result = 0;
+            for (size_type i = 0; i < size_; ++i) {
+                result += data_[i] == value;
+            }
+            return result;
+        }
+
+        bool contains(const T &value) const {
+            return find_index(value) != size_;
+        }
+
+        // range_predicate (in_range, less_than, ...) is vectorized for
+        // arithmetic T
+        template<class Predicate>
+        iterator find_if(Predicate pred) {
+            return iterator(data_, find_if_index(pred));
+        }
+
+        template<class Predicate>
+        const_iterator find_if(Predicate pred) const {
+            return const_iterator(data_, find_if_index(pred));
+        }
+
+        // first position where this vector and `other` differ, within the
+        // shorter of the two
+        std::pair<const_iterator, const_iterator> mismatch(const vector &other) const {
+            size_type common = size_ < other.size_ ? size_ : other.size_;
+            size_type i = 0;
+            if constexpr (std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value) {
+                i = common == 0 ? 0 : static_cast<size_type>(simd::mismatch(data(), other.data(), common));
+            } else {
+                while (i < common && data_[i] == other.data_[i]) {
+                    ++i;
+                }
+            }
+            return std::make_pair(const_iterator(data_, i), const_iterator(other.data_, i));
+        }
+
+        // Removes the elements matching `pred` in one pass and returns how many
+        // went. Trivially copyable elements are masked a block at a time and
+        // left-packed by the SIMD compact kernel; range_predicate builds the
+        // masks with SIMD compares too. Other elements are moved forward one
+        // by one.
+        template<class Predicate>
+        size_type erase_if(Predicate pred) {
+            size_type kept = 0, i = 0;
+            try {
+                if constexpr (bitwise_relocatable && simd::has_kernel_width<T>::value) {
+                    std::uint64_t drop[mask_block / 64];
+                    for (; i < size_; i += mask_block) {
+                        size_type n = size_ - i < mask_block ? size_ - i : mask_block;
+                        mask_range(i, n, pred, drop);
+                        kept += static_cast<size_type>(simd::compact(data_ + kept, data_ + i, drop, n));
+                    }
+                } else {
+                    for (; i < size_; ++i) {
+                        if (!pred(data_[i])) {
+                            if (kept != i) {
+                                assign_element(kept, std::move(data_[i]));
+                            }
+                            ++kept;
+                        }
+                    }
+                }
+            } catch (...) {
+                // the unvisited elements close the gap left by the removed ones
+                erase(iterator(data_, kept), iterator(data_, i));
+                throw;
+            }
+            size_type removed = size_ - kept;
+            erase(iterator(data_, kept), end());
+            return removed;
+        }
+
+        // Bit i of the result (word i / 64) is set when pred(element i); the
+        // words can be combined and passed to erase_masked.
+        template<class Predicate>
+        vector<std::uint64_t> mask_if(Predicate pred) const {
+            vector<std::uint64_t> bits;
+            bits.resize((size_ + 63) / 64);
+            mask_range(0, size_, pred, bits.data());
+            return bits;
+        }
+
+        // removes element i when bit i of `mask` is set; mask holds at least
+        // (size() + 63) / 64 words
+        size_type erase_masked(const std::uint64_t *mask) {
+            size_type kept = 0;
+            if constexpr (bitwise_relocatable && simd::has_kernel_width<T>::value) {
+                kept = static_cast<size_type>(simd::compact(data_, data_, mask, size_));
+            } else {
+                for (size_type i = 0; i < size_; ++i) {
+                    if (!((mask[i / 64] >> (i % 64)) & 1)) {
+                        if (kept != i) {
+                            assign_element(kept, std::move(data_[i]));
+                        }
+                        ++kept;
+                    }
+                }
+            }
+            size_type removed = size_ - kept;
+            erase(iterator(data_, kept), end());
+            return removed;
+        }
+
         bool empty() const {
             return (size_ == 0);
         }
@@ -423,15 +689,7 @@ namespace pretty_vector {
             } else if (size > max_size()) {
                 throw std::length_error("Out of memory!");
             } else {
-                Allocator tallocator;
-                auto new_data = tallocator.allocate(size);
-                move_data_to_pointer(new_data);
-                if (capacity() > 0){
-                    allocator_.deallocate(data_, capacity_);
-                }
-                capacity_ = size;
-                data_ = new_data;
-                allocator_ = tallocator;
+                reallocate_storage(size);
             }
         }
 
@@ -440,13 +698,23 @@ namespace pretty_vector {
         }
 
         void shrink_to_fit() {
-            allocator_.deallocate(data_ + size_, capacity_);
-            capacity_ = size_;
+            if (size_ == capacity_) {
+                return;
+            }
+            if (size_ == 0) {
+                deallocate_storage();
+                return;
+            }
+            if (shrink_storage_in_place(allocator_, size_, 0)) {
+                capacity_ = size_;
+                return;
+            }
+            reallocate_storage(size_);
         }
 
         void clear() {
             for (size_type i = 0; i < size_; ++i) {
-                allocator_.destroy(data_ + i);
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + i);
             }
             size_ = 0;
         }
@@ -455,30 +723,58 @@ namespace pretty_vector {
 
         void reallocation(size_type new_size) {
             if (this->requires_reallocation(new_size)) {
-                size_type needed_capacity = capacity_ + new_size - size_;
-                size_type new_capacity = static_cast<size_type>(ceil(needed_capacity * resize_coefficient));
-                this->reserve(new_capacity);
+                this->reserve(grown_capacity(new_size));
             }
         }
 
         template<typename ...Args>
         void emplace_back(Args &&... args) {
-            this->reallocation(size_ + 1);
-            std::allocator_traits<Allocator>::construct(allocator_, data_ + size_, std::forward<Args>(args)...);
+            if (!this->requires_reallocation(size_ + 1)) {
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + size_, std::forward<Args>(args)...);
+                ++size_;
+                return;
+            }
+
+            // the new element is built before the old ones are relocated: args may
+            // refer into the current buffer, and a throw leaves *this untouched
+            size_type new_capacity = grown_capacity(size_ + 1);
+            pointer new_data = std::allocator_traits<Allocator>::allocate(allocator_, new_capacity);
+            try {
+                std::allocator_traits<Allocator>::construct(allocator_, new_data + size_, std::forward<Args>(args)...);
+            } catch (...) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, new_data, new_capacity);
+                throw;
+            }
+            try {
+                move_data_to_pointer(new_data);
+            } catch (...) {
+                std::allocator_traits<Allocator>::destroy(allocator_, new_data + size_);
+                std::allocator_traits<Allocator>::deallocate(allocator_, new_data, new_capacity);
+                throw;
+            }
+            adopt_storage(new_data, new_capacity);
             ++size_;
         }
 
         template<typename ...Args>
         iterator emplace(const_iterator position, Args &&... args) {
             difference_type index_position = std::distance(this->cbegin(), position);
-            reallocation(size_ + 1);
-
-            if (index_position <= size_ - 1) {
-                shift_right(1, iterator(data_ + index_position), end());
+            if (index_position == difference_type(size_)) {
+                emplace_back(std::forward<Args>(args)...);
+                return iterator(data_, index_position);
             }
 
-            std::allocator_traits<Allocator>::construct(allocator_, data_ + index_position,
-                                                        std::forward<Args>(args)...);
+            // as in emplace_back the element is built first: args may refer into
+            // the vector, and a throwing constructor must find *this untouched
+            T value(std::forward<Args>(args)...);
+            reallocation(size_ + 1);
+            shift_right(1, iterator(data_, index_position), end());
+            try {
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + index_position, std::move(value));
+            } catch (...) {
+                shift_left(1, iterator(data_, index_position + 1), iterator(data_, size_ + 1));
+                throw;
+            }
             ++size_;
 
             return iterator(data_, index_position);
@@ -489,60 +785,67 @@ namespace pretty_vector {
         }
 
         iterator insert(const_iterator pos, T &&value) {
-            return this->emplace(pos, std::forward<const T &>(value));
+            return this->emplace(pos, std::move(value));
         }
 
         iterator insert(const_iterator pos, size_type count, const T &value) {
-            shift_right(count, pos, end());
-            for (auto i = 0; i < count; ++i) {
-                std::allocator_traits<Allocator>::construct(allocator_, data_ + i, value);
+            size_type index = pos.index_;
+            if (count == 0) {
+                return iterator(data_, index);
+            }
+            T copy(value);
+            reallocation(size_ + count);
+            shift_right(count, iterator(data_, index), end());
+            for (size_type i = 0; i < count; ++i) {
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + index + i, copy);
             }
             size_ += count;
+            return iterator(data_, index);
         }
 
-        template<class InputIt>
-        iterator insert(iterator pos, InputIt first, InputIt last) {
+        template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+        iterator insert(const_iterator pos, InputIt first, InputIt last) {
+            size_type index = pos.index_;
             size_type size = last - first;
-            shift_right(size, pos, end());
-            int i = pos.current_index();
+            reallocation(size_ + size);
+            shift_right(size, iterator(data_, index), end());
+            size_type i = index;
             for (auto it = first; it != last; it++) {
                 std::allocator_traits<Allocator>::construct(allocator_, data_ + i, *it);
                 ++i;
             }
             size_ += size;
+            return iterator(data_, index);
         }
 
         iterator insert(const_iterator pos, std::initializer_list<T> ilist) {
-            size_type size = ilist.end() - ilist.begin();
-            shift_right(size, pos, end());
-            int i = pos.current_index();
-            for (auto it = ilist.begin(); it != ilist.end(); it++) {
-                std::allocator_traits<Allocator>::construct(allocator_, data_ + i, *it);
-                ++i;
-            }
-            size_ += size;
+            return insert(pos, ilist.begin(), ilist.end());
         }
 
         iterator erase(iterator pos) {
-            allocator_.destroy(data_ + pos.current_index());
-            shift_left(1,pos+1,end());
+            size_type index = pos.current_index();
+            std::allocator_traits<Allocator>::destroy(allocator_, data_ + index);
+            shift_left(1, pos + 1, end());
             size_--;
-            return ++pos;
+            return iterator(data_, index);
         }
 
         iterator erase(iterator first, iterator last) {
+            size_type count = static_cast<size_type>(last - first);
             for (iterator t = first; t != last; ++t) {
-                allocator_.destroy(data_ + t.current_index());
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + t.current_index());
             }
-            shift_left(static_cast<size_type>(last - first), last + 1, end());
-            size_ -= static_cast<size_type>(last - first);
-            return ++last;
+            shift_left(count, last, end());
+            size_ -= count;
+            return iterator(data_, first.current_index());
         }
 
         void push_back(const T &value) {
-            reallocation(size_ + 1);
-            iterator it = end();
-            insert(it, value);
+            emplace_back(value);
+        }
+
+        void push_back(T &&value) {
+            emplace_back(std::move(value));
         }
 
         void pop_back() {
@@ -553,27 +856,23 @@ namespace pretty_vector {
         }
 
         void assign( size_type count, const T& value ){
+            T copy(value);
+            if (count > capacity_) {
+                deallocate_storage();
+                reserve(count);
+            }
+            while (size_ > count) {
+                pop_back();
+            }
             for (size_type i = 0; i < size_; i++) {
-                allocator_.destroy(data_ + i);
+                assign_element(i, copy);
             }
-            reallocation(count);
-            fill_with_value(value);
-            size_ = count;
+            fill_with_value(count, copy);
         }
 
         template< class InputIt >
         void assign( InputIt first, InputIt last ){
-            for (size_type i = 0; i < size_; i++) {
-                allocator_.destroy(data_ + i);
-            }
-            auto count = last - first;
-            reallocation(count);
-            size_ = count;
-            size_type i = 0;
-            for (auto it = first; it != last; it++) {
-                allocator_.construct(data_ + i, *it);
-                i++;
-            }
+            assign_range(first, static_cast<size_type>(last - first));
         }
 
         void assign( std::initializer_list<T> ilist ){
@@ -581,43 +880,51 @@ namespace pretty_vector {
         }
 
         void resize(size_type count) {
-            if (count <= size_) {
-                for (int i = 0; i < abs(count - size_); ++i) {
-                    pop_back();
-                }
-            } else {
-                for (auto i = 0; i < abs(count - size_); ++i) {
-                    std::allocator_traits<Allocator>::construct(allocator_, data_ + size_ + i, T());
-                }
-                size_ += abs(count - size_);
+            while (size_ > count) {
+                pop_back();
+            }
+            reserve(count);
+            for (; size_ < count; ++size_) {
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + size_);
             }
         }
 
         void resize(size_type count, const value_type &value) {
-            if (count <= size_) {
-                for (int i = 0; i < abs(count - size_); ++i) {
-                    pop_back();
-                }
+            while (size_ > count) {
+                pop_back();
+            }
+            if (count > capacity_) {
+                T copy(value);
+                reserve(count);
+                fill_with_value(count, copy);
             } else {
-                for (auto i = 0; i < abs(count - size_); ++i) {
-                    std::allocator_traits<Allocator>::construct(allocator_, data_ + size_ + i, value);
-                }
-                size_ += abs(count - size_);
+                fill_with_value(count, value);
             }
         }
 
-        void swap(vector &other) {
-            std::swap(allocator_, other.allocator_);
+        void swap(vector &other) noexcept {
+            if (std::allocator_traits<Allocator>::propagate_on_container_swap::value) {
+                std::swap(allocator_, other.allocator_);
+            }
             std::swap(size_, other.size_);
             std::swap(capacity_, other.capacity_);
             std::swap(data_, other.data_);
         }
 
+        friend void swap(vector &lhs, vector &rhs) noexcept {
+            lhs.swap(rhs);
+        }
+
         friend bool operator==(const vector<T, Allocator>& lhs, const vector<T, Allocator>& rhs)
         {
             if (lhs.size_ != rhs.size_) {
                 return false;
             }
+            // equal values have equal bytes for these, so compare memory
+            if constexpr (std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value) {
+                return lhs.size_ == 0 ||
+                       simd::kernels().equal(lhs.data_, rhs.data_, static_cast<std::size_t>(lhs.size_) * sizeof(T));
+            }
 
             auto itL = lhs.begin();
             auto itR = rhs.begin();
@@ -662,17 +969,213 @@ namespace pretty_vector {
         Allocator allocator_;
         pointer data_;
 
-        void fill_with_value(const T &value) {
-            for (iterator it = begin(); it != end(); ++it) {
-                *it = value;
+        // constructs copies of `value` in [size_, count); capacity must already suffice
+        void fill_with_value(size_type count, const T &value) {
+            if constexpr (bitwise_relocatable && simd::has_kernel_width<T>::value) {
+                if (count > size_) {
+                    simd::fill(data_ + size_, value, count - size_);
+                    size_ = count;
+                }
+                return;
+            }
+            for (; size_ < count; ++size_) {
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + size_, value);
             }
-            size_ = capacity_;
         };
 
-        void move_data_to_pointer(pointer data) {
+        template<class U>
+        void assign_element(size_type i, U &&value) {
+            if constexpr (std::is_assignable<T &, U &&>::value) {
+                data_[i] = std::forward<U>(value);
+            } else {
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + i);
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + i, std::forward<U>(value));
+            }
+        }
+
+        // allocators may offer `bool shrink_in_place(pointer, size_type old_n, size_type new_n)`
+        // to give back the tail of a block without relocating its elements
+        template<class A>
+        auto shrink_storage_in_place(A &alloc, size_type new_capacity, int)
+        -> decltype(alloc.shrink_in_place(data_, capacity_, new_capacity)) {
+            return alloc.shrink_in_place(data_, capacity_, new_capacity);
+        }
+
+        template<class A>
+        bool shrink_storage_in_place(A &, size_type, long) {
+            return false;
+        }
+
+        void steal_storage(vector &other) noexcept {
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+            other.capacity_ = 0;
+        }
+
+        void deallocate_storage() noexcept {
             for (size_type i = 0; i < size_; i++) {
-                allocator_.construct(data + i, std::move(data_[i]));
-                allocator_.destroy(data_ + i);
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + i);
+            }
+            if (data_) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, data_, capacity_);
+            }
+            data_ = nullptr;
+            size_ = 0;
+            capacity_ = 0;
+        }
+
+        // replaces the contents with `count` elements read from `first`,
+        // assigning over live elements and reusing the buffer when it is big enough
+        template<class InputIt>
+        void assign_range(InputIt first, size_type count) {
+            if (count > capacity_) {
+                pointer new_data = std::allocator_traits<Allocator>::allocate(allocator_, count);
+                size_type i = 0;
+                try {
+                    for (; i < count; ++i, ++first) {
+                        std::allocator_traits<Allocator>::construct(allocator_, new_data + i, *first);
+                    }
+                } catch (...) {
+                    for (size_type j = 0; j < i; ++j) {
+                        std::allocator_traits<Allocator>::destroy(allocator_, new_data + j);
+                    }
+                    std::allocator_traits<Allocator>::deallocate(allocator_, new_data, count);
+                    throw;
+                }
+                deallocate_storage();
+                data_ = new_data;
+                size_ = count;
+                capacity_ = count;
+                return;
+            }
+
+            size_type common = count < size_ ? count : size_;
+            size_type i = 0;
+            for (; i < common; ++i, ++first) {
+                assign_element(i, *first);
+            }
+            for (; i < count; ++i, ++first) {
+                std::allocator_traits<Allocator>::construct(allocator_, data_ + i, *first);
+                ++size_;
+            }
+            for (i = count; i < size_; ++i) {
+                std::allocator_traits<Allocator>::destroy(allocator_, data_ + i);
+            }
+            size_ = count;
+        }
+
+        static constexpr bool bitwise_relocatable = is_bitwise_relocatable<T, Allocator>::value;
+
+        size_type find_index(const T &value) const {
+            if constexpr (std::is_arithmetic<T>::value && sizeof(T) <= 8) {
+                return static_cast<size_type>(simd::find(data(), size_, value));
+            }
+            size_type i = 0;
+            while (i < size_ && !(data_[i] == value)) {
+                ++i;
+            }
+            return i;
+        }
+
+        template<class Predicate>
+        size_type find_if_index(const Predicate &pred) const {
+            if constexpr (std::is_arithmetic<T>::value && sizeof(T) <= 8 &&
+                          std::is_same<Predicate, range_predicate<T>>::value) {
+                if (pred.hi < pred.lo) {
+                    return size_;
+                }
+                return static_cast<size_type>(simd::find_in_range(data(), size_, pred.lo, pred.hi));
+            }
+            size_type i = 0;
+            while (i < size_ && !pred(data_[i])) {
+                ++i;
+            }
+            return i;
+        }
+
+        // elements masked per step of erase_if
+        static constexpr size_type mask_block = 4096;
+
+        // bits for elements [first, first + n): (n + 63) / 64 words
+        template<class Predicate>
+        void mask_range(size_type first, size_type n, const Predicate &pred, std::uint64_t *bits) const {
+            if constexpr (std::is_arithmetic<T>::value && sizeof(T) <= 8 &&
+                          std::is_same<Predicate, range_predicate<T>>::value) {
+                simd::mask_in_range(data() + first, n, pred.lo, pred.hi, bits);
+                return;
+            }
+            for (size_type w = 0; w * 64 < n; ++w) {
+                size_type block = n - w * 64 < 64 ? n - w * 64 : 64;
+                std::uint64_t word = 0;
+                for (size_type j = 0; j < block; ++j) {
+                    word |= std::uint64_t(static_cast<bool>(pred(data_[first + w * 64 + j]))) << j;
+                }
+                bits[w] = word;
+            }
+        }
+
+        template<class U>
+        static U *assume_aligned(U *p) {
+#if defined(__GNUC__)
+            return static_cast<U *>(__builtin_assume_aligned(p, alignment));
+#else
+            return p;
+#endif
+        }
+
+        size_type grown_capacity(size_type new_size) const {
+            size_type needed_capacity = capacity_ + new_size - size_;
+            return static_cast<size_type>(ceil(needed_capacity * resize_coefficient));
+        }
+
+        void adopt_storage(pointer new_data, size_type new_capacity) noexcept {
+            if (data_) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, data_, capacity_);
+            }
+            data_ = new_data;
+            capacity_ = new_capacity;
+        }
+
+        void reallocate_storage(size_type new_capacity) {
+            pointer new_data = std::allocator_traits<Allocator>::allocate(allocator_, new_capacity);
+            try {
+                move_data_to_pointer(new_data);
+            } catch (...) {
+                std::allocator_traits<Allocator>::deallocate(allocator_, new_data, new_capacity);
+                throw;
+            }
+            adopt_storage(new_data, new_capacity);
+        }
+
+        // Relocates the elements into `data`, which must hold size_ elements. Elements
+        // whose move constructor may throw are copied instead (move_if_noexcept), so if
+        // a construction fails the partial copies are destroyed and data_ is untouched.
+        void move_data_to_pointer(pointer data) {
+            if constexpr (bitwise_relocatable) {
+                if (size_ > 0) {
+                    simd::kernels().relocate(static_cast<void *>(data), static_cast<const void *>(data_),
+                                             size_ * sizeof(T));
+                }
+                return;
+            } else {
+                size_type i = 0;
+                try {
+                    for (; i < size_; i++) {
+                        std::allocator_traits<Allocator>::construct(allocator_, data + i,
+                                                                    std::move_if_noexcept(data_[i]));
+                    }
+                } catch (...) {
+                    for (size_type j = 0; j < i; j++) {
+                        std::allocator_traits<Allocator>::destroy(allocator_, data + j);
+                    }
+                    throw;
+                }
+                for (i = 0; i < size_; i++) {
+                    std::allocator_traits<Allocator>::destroy(allocator_, data_ + i);
+                }
             }
         }
 
@@ -681,8 +1184,15 @@ namespace pretty_vector {
                 return;
             }
 
+            // relocates [from, after_last) by n; the gap left at [from, from + n) is raw storage
+            if constexpr (bitwise_relocatable) {
+                simd::kernels().relocate(static_cast<void *>(&*(from + n)), static_cast<const void *>(&*from),
+                                         static_cast<std::size_t>(after_last - from) * sizeof(T));
+                return;
+            }
             for (iterator it = after_last - 1; true; --it) {
-                allocator_.construct(&*(it + n), std::move(*it));
+                std::allocator_traits<Allocator>::construct(allocator_, &*(it + n), std::move(*it));
+                std::allocator_traits<Allocator>::destroy(allocator_, &*it);
                 if (it == from) { break; }
             }
         }
@@ -692,8 +1202,15 @@ namespace pretty_vector {
                 return;
             }
 
+            // [from - n, from) must be raw storage; [after_last - n, after_last) is raw afterwards
+            if constexpr (bitwise_relocatable) {
+                simd::kernels().relocate(static_cast<void *>(&*(from - n)), static_cast<const void *>(&*from),
+                                         static_cast<std::size_t>(after_last - from) * sizeof(T));
+                return;
+            }
             for (iterator it = from; it < after_last ; ++it) {
-                allocator_.construct(&*(it - n), std::move(*it));
+                std::allocator_traits<Allocator>::construct(allocator_, &*(it - n), std::move(*it));
+                std::allocator_traits<Allocator>::destroy(allocator_, &*it);
             }
         }
 
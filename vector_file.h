@@ -0,0 +1,756 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include "circular_vector.h"
+#include "simd_kernels.h"
+#include "vector.h"
+
+namespace pretty_vector {
+
+    struct vector_file_options {
+        // uncompressed bytes per block, rounded down to whole elements: the
+        // unit of compression and of seeking
+        unsigned int block_bytes = 1u << 20;
+        // compress byte j of every element together, which turns the high
+        // bytes of small numbers into long runs
+        bool shuffle = true;
+        // blocks queued between the caller and the background thread
+        unsigned int queue_blocks = 4;
+    };
+
+    namespace file_detail {
+        typedef vector<unsigned char> bytes;
+
+        // Layout (native byte order): a 32-byte header, the blocks, then one
+        // index entry per block. The header is written again with the index
+        // offset on close, so an offset of 0 marks an unfinished file.
+        constexpr unsigned char magic[4] = {'P', 'V', 'F', '1'};
+        constexpr std::uint32_t version = 1;
+        constexpr std::size_t header_bytes = 32;
+        constexpr std::size_t entry_bytes = 16;
+        constexpr unsigned int largest_block = 1u << 30;
+
+        struct header {
+            std::uint32_t element_size;
+            std::uint32_t block_elements;
+            std::uint64_t size;
+            std::uint64_t index_offset;
+        };
+
+        struct index_entry {
+            std::uint64_t offset;
+            std::uint32_t stored_bytes;
+            std::uint32_t raw_bytes;
+        };
+
+        // first byte of every stored block
+        enum method : unsigned char {
+            stored = 0, lz = 1, shuffled_lz = 2
+        };
+
+        template<class U>
+        void put(unsigned char *at, U value) {
+            std::memcpy(at, &value, sizeof(U));
+        }
+
+        template<class U>
+        U get(const unsigned char *at) {
+            U value;
+            std::memcpy(&value, at, sizeof(U));
+            return value;
+        }
+
+        inline void encode_header(const header &h, unsigned char *out) {
+            std::memcpy(out, magic, 4);
+            put(out + 4, version);
+            put(out + 8, h.element_size);
+            put(out + 12, h.block_elements);
+            put(out + 16, h.size);
+            put(out + 24, h.index_offset);
+        }
+
+        inline header decode_header(const unsigned char *in) {
+            if (std::memcmp(in, magic, 4) != 0 || get<std::uint32_t>(in + 4) != version) {
+                throw std::runtime_error("vector_file: not a vector file");
+            }
+            header h;
+            h.element_size = get<std::uint32_t>(in + 8);
+            h.block_elements = get<std::uint32_t>(in + 12);
+            h.size = get<std::uint64_t>(in + 16);
+            h.index_offset = get<std::uint64_t>(in + 24);
+            return h;
+        }
+
+        // LZ77 in LZ4's sequence layout: a token byte with the literal count in
+        // the high nibble and the match length - 4 in the low one (15 means
+        // more length bytes follow, each adding up to 255), the literals, the
+        // match offset in two bytes, then the rest of the match length. The
+        // last sequence has literals only. A match may overlap the bytes it
+        // produces, so a run of one byte is a match at offset 1.
+        constexpr std::size_t min_match = 4;
+        constexpr std::size_t max_offset = 65535;
+        constexpr unsigned int hash_bits = 14;
+
+        // most bytes lz_compress writes for n input bytes
+        inline std::size_t lz_bound(std::size_t n) {
+            return n + n / 255 + 16;
+        }
+
+        inline unsigned char *put_length(unsigned char *out, std::size_t extra) {
+            for (; extra >= 255; extra -= 255) {
+                *out++ = 255;
+            }
+            *out++ = static_cast<unsigned char>(extra);
+            return out;
+        }
+
+        inline unsigned char *put_sequence(unsigned char *out, const unsigned char *literals, std::size_t count,
+                                           std::size_t offset, std::size_t length) {
+            std::size_t extra = length ? length - min_match : 0;
+            *out++ = static_cast<unsigned char>(std::min<std::size_t>(count, 15) << 4 |
+                                                std::min<std::size_t>(extra, 15));
+            if (count >= 15) {
+                out = put_length(out, count - 15);
+            }
+            std::memcpy(out, literals, count);
+            out += count;
+            if (length) {
+                *out++ = static_cast<unsigned char>(offset);
+                *out++ = static_cast<unsigned char>(offset >> 8);
+                if (extra >= 15) {
+                    out = put_length(out, extra - 15);
+                }
+            }
+            return out;
+        }
+
+        // Greedy matching against the last position of each 4-byte hash;
+        // stretches without matches are skipped faster the longer they get.
+        // Writes at most lz_bound(n) bytes and returns how many.
+        inline std::size_t lz_compress(const unsigned char *in, std::size_t n, unsigned char *out) {
+            unsigned char *start = out;
+            vector<std::uint32_t> last(1u << hash_bits, 0u);
+            std::size_t anchor = 0, i = 0;
+            while (i + 8 <= n) {
+                std::uint32_t quad = get<std::uint32_t>(in + i);
+                std::uint32_t &slot = last.data()[(quad * 2654435761u) >> (32 - hash_bits)];
+                std::size_t candidate = slot;
+                slot = static_cast<std::uint32_t>(i);
+                if (candidate >= i || i - candidate > max_offset || get<std::uint32_t>(in + candidate) != quad) {
+                    i += 1 + ((i - anchor) >> 6);
+                    continue;
+                }
+                std::size_t length = min_match;
+                bool differs = false;
+                for (; i + length + 8 <= n; length += 8) {
+                    std::uint64_t diff = get<std::uint64_t>(in + i + length) ^
+                                         get<std::uint64_t>(in + candidate + length);
+                    if (diff) {
+                        length += static_cast<std::size_t>(__builtin_ctzll(diff)) / 8;
+                        differs = true;
+                        break;
+                    }
+                }
+                for (; !differs && i + length < n && in[i + length] == in[candidate + length]; ++length) {
+                }
+                out = put_sequence(out, in + anchor, i - anchor, i - candidate, length);
+                i += length;
+                anchor = i;
+            }
+            out = put_sequence(out, in + anchor, n - anchor, 0, 0);
+            return static_cast<std::size_t>(out - start);
+        }
+
+        inline bool get_length(const unsigned char *&in, const unsigned char *end, std::size_t &length) {
+            for (;;) {
+                if (in == end) {
+                    return false;
+                }
+                unsigned char more = *in++;
+                length += more;
+                if (more != 255) {
+                    return true;
+                }
+            }
+        }
+
+        // out[i] = out[i - offset] for i < length; copied in pieces that do not
+        // overlap their source, each a whole number of periods long
+        inline void copy_match(unsigned char *out, std::size_t offset, std::size_t length) {
+            std::size_t done = 0;
+            while (done < length) {
+                std::size_t period = (offset + done) / offset * offset;
+                std::size_t piece = std::min(period, length - done);
+                std::memcpy(out + done, out + done - period, piece);
+                done += piece;
+            }
+        }
+
+        // false unless `in` decodes to exactly n bytes
+        inline bool lz_decompress(const unsigned char *in, std::size_t size, unsigned char *out, std::size_t n) {
+            const unsigned char *end = in + size;
+            std::size_t at = 0;
+            while (in != end) {
+                unsigned int token = *in++;
+                std::size_t count = token >> 4;
+                if (count == 15 && !get_length(in, end, count)) {
+                    return false;
+                }
+                if (count > static_cast<std::size_t>(end - in) || count > n - at) {
+                    return false;
+                }
+                std::memcpy(out + at, in, count);
+                in += count;
+                at += count;
+                if (in == end) {
+                    break;
+                }
+                if (end - in < 2) {
+                    return false;
+                }
+                std::size_t offset = in[0] | std::size_t(in[1]) << 8;
+                in += 2;
+                std::size_t length = token & 15;
+                if (length == 15 && !get_length(in, end, length)) {
+                    return false;
+                }
+                length += min_match;
+                if (offset == 0 || offset > at || length > n - at) {
+                    return false;
+                }
+                copy_match(out + at, offset, length);
+                at += length;
+            }
+            return at == n;
+        }
+
+        // One block of n raw bytes of `width`-byte elements: the method byte,
+        // then the LZ stream, or the raw bytes when compressing does not pay.
+        inline void encode_block(const unsigned char *raw, std::size_t n, std::size_t width, bool shuffled,
+                                 bytes &scratch, bytes &out) {
+            out.resize(static_cast<unsigned int>(1 + lz_bound(n)));
+            const unsigned char *source = raw;
+            method how = lz;
+            if (shuffled && width > 1) {
+                scratch.resize(static_cast<unsigned int>(n));
+                simd::byte_shuffle(raw, n / width, width, scratch.data());
+                source = scratch.data();
+                how = shuffled_lz;
+            }
+            std::size_t written = lz_compress(source, n, out.data() + 1);
+            if (written >= n) {
+                how = stored;
+                std::memcpy(out.data() + 1, raw, n);
+                written = n;
+            }
+            out.data()[0] = how;
+            out.resize(static_cast<unsigned int>(1 + written));
+        }
+
+        inline void decode_block(const unsigned char *in, std::size_t size, std::size_t width, bytes &scratch,
+                                 unsigned char *out, std::size_t n) {
+            bool valid = size >= 1;
+            if (valid && in[0] == stored) {
+                valid = size - 1 == n;
+                if (valid) {
+                    std::memcpy(out, in + 1, n);
+                }
+            } else if (valid && in[0] == lz) {
+                valid = lz_decompress(in + 1, size - 1, out, n);
+            } else if (valid && in[0] == shuffled_lz) {
+                scratch.resize(static_cast<unsigned int>(n));
+                valid = n % width == 0 && lz_decompress(in + 1, size - 1, scratch.data(), n);
+                if (valid) {
+                    simd::byte_unshuffle(scratch.data(), n / width, width, out);
+                }
+            } else {
+                valid = false;
+            }
+            if (!valid) {
+                throw std::runtime_error("vector_file: corrupt block");
+            }
+        }
+
+        // Bounded FIFO of blocks between the caller and one background thread.
+        // close() wakes both sides: pushes fail and pops drain what is left.
+        // fail() also closes and keeps the exception for rethrow(). Buffers
+        // done with go back through recycle() and out again through reuse(),
+        // so a steady stream does not allocate and zero a block every time.
+        class block_channel {
+        public:
+            explicit block_channel(unsigned int capacity) :
+                    blocks_(std::max(capacity, 1u), circular_vector<bytes>::capacity_policy::fixed),
+                    closed_(false) {}
+
+            void recycle(bytes &block) {
+                std::lock_guard<std::mutex> lock(lock_);
+                if (spares_.size() <= blocks_.capacity()) {
+                    spares_.push_back(std::move(block));
+                }
+                block = bytes();
+            }
+
+            // hands block a recycled buffer if there is one
+            void reuse(bytes &block) {
+                std::lock_guard<std::mutex> lock(lock_);
+                if (!spares_.empty()) {
+                    block = std::move(spares_.back());
+                    spares_.pop_back();
+                }
+            }
+
+            bool push(bytes &block) {
+                std::unique_lock<std::mutex> lock(lock_);
+                not_full_.wait(lock, [&] { return closed_ || !blocks_.full(); });
+                if (closed_) {
+                    return false;
+                }
+                blocks_.push_back(std::move(block));
+                not_empty_.notify_one();
+                return true;
+            }
+
+            bool pop(bytes &block) {
+                std::unique_lock<std::mutex> lock(lock_);
+                not_empty_.wait(lock, [&] { return closed_ || !blocks_.empty(); });
+                if (blocks_.empty()) {
+                    return false;
+                }
+                block = std::move(blocks_.front());
+                blocks_.pop_front();
+                not_full_.notify_one();
+                return true;
+            }
+
+            void close() {
+                std::lock_guard<std::mutex> lock(lock_);
+                closed_ = true;
+                not_full_.notify_all();
+                not_empty_.notify_all();
+            }
+
+            void fail(std::exception_ptr error) {
+                std::lock_guard<std::mutex> lock(lock_);
+                error_ = error_ ? error_ : error;
+                closed_ = true;
+                not_full_.notify_all();
+                not_empty_.notify_all();
+            }
+
+            void rethrow() {
+                std::lock_guard<std::mutex> lock(lock_);
+                if (error_) {
+                    std::rethrow_exception(error_);
+                }
+            }
+
+            // empty and open again, for a new background thread
+            void reset() {
+                std::lock_guard<std::mutex> lock(lock_);
+                blocks_.clear();
+                closed_ = false;
+                error_ = nullptr;
+            }
+
+        private:
+            std::mutex lock_;
+            std::condition_variable not_full_;
+            std::condition_variable not_empty_;
+            circular_vector<bytes> blocks_;
+            vector<bytes> spares_;
+            bool closed_;
+            std::exception_ptr error_;
+        };
+
+        inline unsigned int block_elements(const vector_file_options &options, std::size_t width) {
+            std::size_t bytes = std::min(options.block_bytes, largest_block);
+            return static_cast<unsigned int>(std::max<std::size_t>(bytes / width, 1));
+        }
+    }
+
+    // Writes elements to a block-compressed vector file. Filled blocks are
+    // handed to a background thread that compresses and writes them while
+    // the caller fills the next ones. close() (or the destructor, which
+    // swallows errors) writes the last block and the block index; a file
+    // that was never closed cannot be read.
+    template<class T>
+    class vector_file_writer {
+        static_assert(std::is_trivially_copyable<T>::value, "vector files hold trivially copyable elements");
+
+    public:
+        using value_type = T;
+
+        explicit vector_file_writer(const std::string &path, vector_file_options options = vector_file_options()) :
+                file_(path, std::ios::binary | std::ios::trunc), options_(options),
+                block_elements_(file_detail::block_elements(options, sizeof(T))), filled_(0), size_(0),
+                end_(file_detail::header_bytes), channel_(options.queue_blocks), closed_(false) {
+            if (!file_) {
+                throw std::runtime_error("vector_file: cannot create " + path);
+            }
+            write_header(0);
+            raw_.resize(block_elements_ * static_cast<unsigned int>(sizeof(T)));
+            worker_ = std::thread([this] { run(); });
+        }
+
+        vector_file_writer(const vector_file_writer &) = delete;
+
+        vector_file_writer &operator=(const vector_file_writer &) = delete;
+
+        ~vector_file_writer() {
+            try {
+                close();
+            } catch (...) {
+            }
+        }
+
+        std::uint64_t size() const { return size_; }
+
+        void push_back(const T &value) { write(&value, 1); }
+
+        void write(const T *first, std::size_t count) {
+            while (count > 0) {
+                std::size_t take = std::min<std::size_t>(count, block_elements_ - filled_);
+                std::memcpy(raw_.data() + filled_ * sizeof(T), first, take * sizeof(T));
+                filled_ += static_cast<unsigned int>(take);
+                size_ += take;
+                first += take;
+                count -= take;
+                if (filled_ == block_elements_) {
+                    flush_block();
+                }
+            }
+        }
+
+        template<class Allocator>
+        void write(const vector<T, Allocator> &values) {
+            write(values.data(), values.size());
+        }
+
+        void close() {
+            if (closed_) {
+                return;
+            }
+            closed_ = true;
+            if (filled_ > 0) {
+                raw_.resize(filled_ * static_cast<unsigned int>(sizeof(T)));
+                channel_.push(raw_);
+            }
+            channel_.close();
+            worker_.join();
+            channel_.rethrow();
+            vector<unsigned char> index(static_cast<unsigned int>(index_.size() * file_detail::entry_bytes), 0);
+            for (unsigned int b = 0; b < index_.size(); ++b) {
+                unsigned char *at = index.data() + b * file_detail::entry_bytes;
+                file_detail::put(at, index_.data()[b].offset);
+                file_detail::put(at + 8, index_.data()[b].stored_bytes);
+                file_detail::put(at + 12, index_.data()[b].raw_bytes);
+            }
+            file_.write(reinterpret_cast<const char *>(index.data()), index.size());
+            write_header(end_);
+            file_.close();
+            if (!file_) {
+                throw std::runtime_error("vector_file: write failed");
+            }
+        }
+
+    private:
+        void write_header(std::uint64_t index_offset) {
+            unsigned char bytes[file_detail::header_bytes] = {};
+            file_detail::encode_header({static_cast<std::uint32_t>(sizeof(T)), block_elements_, size_, index_offset},
+                                       bytes);
+            file_.seekp(0);
+            file_.write(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+            file_.seekp(0, std::ios::end);
+        }
+
+        void flush_block() {
+            if (!channel_.push(raw_)) {
+                channel_.rethrow();
+            }
+            channel_.reuse(raw_);
+            raw_.resize(block_elements_ * static_cast<unsigned int>(sizeof(T)));
+            filled_ = 0;
+        }
+
+        // the background thread: owns file_ and index_ until it is joined
+        void run() {
+            try {
+                file_detail::bytes raw, scratch, encoded;
+                while (channel_.pop(raw)) {
+                    file_detail::encode_block(raw.data(), raw.size(), sizeof(T), options_.shuffle, scratch, encoded);
+                    file_.write(reinterpret_cast<const char *>(encoded.data()), encoded.size());
+                    if (!file_) {
+                        throw std::runtime_error("vector_file: write failed");
+                    }
+                    index_.push_back({end_, encoded.size(), raw.size()});
+                    end_ += encoded.size();
+                    channel_.recycle(raw);
+                }
+            } catch (...) {
+                channel_.fail(std::current_exception());
+            }
+        }
+
+        std::ofstream file_;
+        vector_file_options options_;
+        unsigned int block_elements_;
+        file_detail::bytes raw_;
+        unsigned int filled_;
+        std::uint64_t size_;
+        std::uint64_t end_;
+        vector<file_detail::index_entry> index_;
+        file_detail::block_channel channel_;
+        std::thread worker_;
+        bool closed_;
+    };
+
+    // Reads a vector file. read() streams from the current position while a
+    // background thread reads and decompresses the blocks ahead of it;
+    // seek() only moves the position; the thread is restarted from the block
+    // index when a read lands anywhere but the current or the next block.
+    // at() and read_block() decode a single block without disturbing the
+    // stream. Throws std::runtime_error for files that are unreadable,
+    // unfinished, corrupt or hold elements of another size.
+    template<class T>
+    class vector_file_reader {
+        static_assert(std::is_trivially_copyable<T>::value, "vector files hold trivially copyable elements");
+
+    public:
+        using value_type = T;
+
+        explicit vector_file_reader(const std::string &path, vector_file_options options = vector_file_options()) :
+                file_(path, std::ios::binary), channel_(options.queue_blocks), streaming_(false), next_block_(0),
+                position_(0), current_first_(0), current_count_(0), cached_block_(no_block) {
+            if (!file_) {
+                throw std::runtime_error("vector_file: cannot open " + path);
+            }
+            unsigned char bytes[file_detail::header_bytes];
+            read_at(0, bytes, sizeof(bytes));
+            header_ = file_detail::decode_header(bytes);
+            if (header_.element_size != sizeof(T)) {
+                throw std::runtime_error("vector_file: elements are " + std::to_string(header_.element_size) +
+                                         " bytes, not " + std::to_string(sizeof(T)));
+            }
+            if (header_.index_offset == 0) {
+                throw std::runtime_error("vector_file: the file was not closed");
+            }
+            if (header_.block_elements == 0) {
+                throw std::runtime_error("vector_file: not a vector file");
+            }
+            std::uint64_t blocks = (header_.size + header_.block_elements - 1) / header_.block_elements;
+            if (blocks > 0xffffffffu / file_detail::entry_bytes) {
+                throw std::runtime_error("vector_file: not a vector file");
+            }
+            file_detail::bytes index(static_cast<unsigned int>(blocks * file_detail::entry_bytes), 0);
+            read_at(header_.index_offset, index.data(), index.size());
+            for (unsigned int b = 0; b < blocks; ++b) {
+                const unsigned char *at = index.data() + b * file_detail::entry_bytes;
+                index_.push_back({file_detail::get<std::uint64_t>(at), file_detail::get<std::uint32_t>(at + 8),
+                                  file_detail::get<std::uint32_t>(at + 12)});
+                if (index_.data()[b].raw_bytes != elements_in_block(b) * sizeof(T)) {
+                    throw std::runtime_error("vector_file: corrupt index");
+                }
+            }
+        }
+
+        vector_file_reader(const vector_file_reader &) = delete;
+
+        vector_file_reader &operator=(const vector_file_reader &) = delete;
+
+        ~vector_file_reader() { stop(); }
+
+        std::uint64_t size() const { return header_.size; }
+
+        unsigned int block_count() const { return index_.size(); }
+
+        unsigned int block_elements() const { return header_.block_elements; }
+
+        // index of the element read() returns next
+        std::uint64_t tell() const { return position_; }
+
+        void seek(std::uint64_t pos) {
+            if (pos > header_.size) {
+                throw std::out_of_range("vector_file_reader::seek");
+            }
+            position_ = pos;
+        }
+
+        // Copies up to `count` elements from the current position to out and
+        // moves past them; returns how many, fewer only at the end.
+        std::size_t read(T *out, std::size_t count) {
+            count = static_cast<std::size_t>(std::min<std::uint64_t>(count, header_.size - position_));
+            for (std::size_t done = 0; done < count;) {
+                if (position_ < current_first_ || position_ >= current_first_ + current_count_) {
+                    next_block(static_cast<unsigned int>(position_ / header_.block_elements));
+                }
+                std::size_t offset = static_cast<std::size_t>(position_ - current_first_);
+                std::size_t take = std::min<std::size_t>(count - done, current_count_ - offset);
+                std::memcpy(out + done, current_.data() + offset * sizeof(T), take * sizeof(T));
+                done += take;
+                position_ += take;
+            }
+            return count;
+        }
+
+        template<class Allocator>
+        void read(vector<T, Allocator> &out, std::size_t count) {
+            out.resize(static_cast<unsigned int>(std::min<std::uint64_t>(count, header_.size - position_)));
+            read(out.data(), out.size());
+        }
+
+        T at(std::uint64_t pos) {
+            if (pos >= header_.size) {
+                throw std::out_of_range("vector_file_reader::at");
+            }
+            T value;
+            if (pos >= current_first_ && pos < current_first_ + current_count_) {
+                std::memcpy(&value, current_.data() + (pos - current_first_) * sizeof(T), sizeof(T));
+                return value;
+            }
+            unsigned int block = static_cast<unsigned int>(pos / header_.block_elements);
+            if (block != cached_block_) {
+                cached_.resize(index_.data()[block].raw_bytes);
+                cached_block_ = no_block;
+                load_block(block, cached_.data(), stored_, scratch_);
+                cached_block_ = block;
+            }
+            std::memcpy(&value, cached_.data() + (pos % header_.block_elements) * sizeof(T), sizeof(T));
+            return value;
+        }
+
+        // elements in block b; the last block may be short
+        unsigned int elements_in_block(unsigned int b) const {
+            std::uint64_t first = std::uint64_t(b) * header_.block_elements;
+            return static_cast<unsigned int>(std::min<std::uint64_t>(header_.block_elements, header_.size - first));
+        }
+
+        // decodes block b to out and returns its element count
+        unsigned int read_block(unsigned int b, T *out) {
+            if (b >= index_.size()) {
+                throw std::out_of_range("vector_file_reader::read_block");
+            }
+            load_block(b, reinterpret_cast<unsigned char *>(out), stored_, scratch_);
+            return elements_in_block(b);
+        }
+
+    private:
+        static constexpr unsigned int no_block = ~0u;
+
+        void read_at(std::uint64_t offset, unsigned char *out, std::size_t count) {
+            std::lock_guard<std::mutex> lock(file_lock_);
+            file_.seekg(static_cast<std::streamoff>(offset));
+            file_.read(reinterpret_cast<char *>(out), static_cast<std::streamsize>(count));
+            if (!file_ || static_cast<std::size_t>(file_.gcount()) != count) {
+                file_.clear();
+                throw std::runtime_error("vector_file: the file is truncated");
+            }
+        }
+
+        // reads block b from either thread; the file is locked only while
+        // its stored bytes are read
+        void load_block(unsigned int b, unsigned char *out, file_detail::bytes &stored, file_detail::bytes &scratch) {
+            const file_detail::index_entry &entry = index_.data()[b];
+            stored.resize(entry.stored_bytes);
+            read_at(entry.offset, stored.data(), stored.size());
+            file_detail::decode_block(stored.data(), stored.size(), sizeof(T), scratch, out, entry.raw_bytes);
+        }
+
+        // makes block b the current one, from the background thread's queue
+        // when it is the block that thread hands over next
+        void next_block(unsigned int b) {
+            if (!streaming_ || b != next_block_) {
+                stop();
+                next_block_ = b;
+                streaming_ = true;
+                worker_ = std::thread([this, b] { run(b); });
+            }
+            current_count_ = 0;
+            channel_.recycle(current_);
+            if (!channel_.pop(current_)) {
+                channel_.rethrow();
+                throw std::runtime_error("vector_file: the file is truncated");
+            }
+            current_first_ = std::uint64_t(next_block_) * header_.block_elements;
+            current_count_ = elements_in_block(next_block_);
+            ++next_block_;
+        }
+
+        void stop() {
+            if (worker_.joinable()) {
+                channel_.close();
+                worker_.join();
+                channel_.reset();
+            }
+            streaming_ = false;
+        }
+
+        // the background thread: decodes blocks from `first` on until the end
+        // or until the channel is closed
+        void run(unsigned int first) {
+            try {
+                file_detail::bytes stored, scratch;
+                for (unsigned int b = first; b < index_.size(); ++b) {
+                    file_detail::bytes block;
+                    channel_.reuse(block);
+                    block.resize(index_.data()[b].raw_bytes);
+                    load_block(b, block.data(), stored, scratch);
+                    if (!channel_.push(block)) {
+                        return;
+                    }
+                }
+                channel_.close();
+            } catch (...) {
+                channel_.fail(std::current_exception());
+            }
+        }
+
+        std::ifstream file_;
+        std::mutex file_lock_;
+        file_detail::header header_;
+        vector<file_detail::index_entry> index_;
+        file_detail::block_channel channel_;
+        std::thread worker_;
+        bool streaming_;
+        unsigned int next_block_;
+        std::uint64_t position_;
+        file_detail::bytes current_;
+        std::uint64_t current_first_;
+        std::size_t current_count_;
+        file_detail::bytes cached_;
+        unsigned int cached_block_;
+        file_detail::bytes stored_;
+        file_detail::bytes scratch_;
+    };
+
+    // writes values to a new vector file at path
+    template<class T, class Allocator>
+    void save_vector(const std::string &path, const vector<T, Allocator> &values,
+                     vector_file_options options = vector_file_options()) {
+        vector_file_writer<T> writer(path, options);
+        writer.write(values);
+        writer.close();
+    }
+
+    // the whole of a vector file; throws std::length_error past what a
+    // vector can hold
+    template<class T, class Allocator = std::allocator<T>>
+    vector<T, Allocator> load_vector(const std::string &path, const Allocator &alloc = Allocator()) {
+        vector_file_reader<T> reader(path);
+        if (reader.size() > 0xffffffffu) {
+            throw std::length_error("load_vector: the file holds too many elements");
+        }
+        vector<T, Allocator> out(alloc);
+        reader.read(out, static_cast<std::size_t>(reader.size()));
+        return out;
+    }
+}
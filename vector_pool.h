@@ -0,0 +1,165 @@
+#pragma once
+#include <cstddef>
+#include "vector.h"
+
+namespace pretty_vector {
+
+    struct pool_limits {
+        // most vectors kept at once
+        unsigned int max_vectors = 16;
+        // vectors with a larger capacity are deallocated instead of pooled
+        unsigned int max_capacity = 1u << 16;
+        // most element bytes kept across all pooled vectors
+        std::size_t max_retained_bytes = std::size_t(1) << 20;
+    };
+
+    struct pool_stats {
+        std::size_t acquires = 0;
+        std::size_t hits = 0;
+        std::size_t releases = 0;
+        // released vectors deallocated because they were over a limit
+        std::size_t dropped = 0;
+        std::size_t retained_bytes = 0;
+        unsigned int pooled = 0;
+
+        double hit_rate() const { return acquires ? static_cast<double>(hits) / acquires : 0.0; }
+    };
+
+    // Recycles pretty_vector::vector buffers: released vectors are cleared and
+    // kept with their capacity, and acquire() hands them out again instead of
+    // allocating. The limits bound how much memory sits idle in the pool.
+    //
+    // A pool is not synchronized; use local() for one pool per thread. A
+    // vector acquired on one thread may be released on another (it joins that
+    // thread's pool) as long as the allocators compare equal.
+    template<class T, class Allocator = std::allocator<T>>
+    class vector_pool {
+    public:
+        using size_type = unsigned int;
+        using vector_type = vector<T, Allocator>;
+
+        // returns its vector to the pool when it goes out of scope
+        class lease {
+        public:
+            lease(lease &&other) noexcept : pool_(other.pool_), items_(std::move(other.items_)) {
+                other.pool_ = nullptr;
+            }
+
+            lease(const lease &) = delete;
+
+            lease &operator=(const lease &) = delete;
+
+            ~lease() {
+                if (pool_) {
+                    pool_->release(std::move(items_));
+                }
+            }
+
+            vector_type &operator*() { return items_; }
+
+            vector_type *operator->() { return &items_; }
+
+            // keeps the vector; the pool forgets about it
+            vector_type detach() {
+                pool_ = nullptr;
+                return std::move(items_);
+            }
+
+        private:
+            friend class vector_pool;
+
+            lease(vector_pool *pool, vector_type items) : pool_(pool), items_(std::move(items)) {}
+
+            vector_pool *pool_;
+            vector_type items_;
+        };
+
+        explicit vector_pool(pool_limits limits = pool_limits(), const Allocator &alloc = Allocator()) :
+                allocator_(alloc), limits_(limits), free_() {}
+
+        vector_pool(const vector_pool &) = delete;
+
+        vector_pool &operator=(const vector_pool &) = delete;
+
+        // this thread's pool with the default limits
+        static vector_pool &local() {
+            static thread_local vector_pool pool;
+            return pool;
+        }
+
+        // An empty vector with room for at least `capacity` elements: the most
+        // recently released pooled vector that is big enough, which keeps a
+        // hot buffer hot, or else a newly allocated one. Only the first counts
+        // as a hit; pooled vectors that are too small stay in the pool.
+        vector_type acquire(size_type capacity = 0) {
+            ++stats_.acquires;
+            for (size_type i = free_.size(); i-- > 0;) {
+                if (free_.data()[i].capacity() >= capacity) {
+                    ++stats_.hits;
+                    vector_type items(std::move(free_.data()[i]));
+                    free_.erase(free_.begin() + i);
+                    stats_.retained_bytes -= bytes(items);
+                    return items;
+                }
+            }
+            vector_type items(allocator_);
+            items.reserve(capacity);
+            return items;
+        }
+
+        lease acquire_lease(size_type capacity = 0) { return lease(this, acquire(capacity)); }
+
+        // clears `items` and keeps its storage unless that breaks a limit
+        void release(vector_type &&items) {
+            ++stats_.releases;
+            items.clear();
+            std::size_t size = bytes(items);
+            if (size == 0) {
+                return;
+            }
+            if (items.capacity() > limits_.max_capacity || free_.size() >= limits_.max_vectors ||
+                stats_.retained_bytes + size > limits_.max_retained_bytes) {
+                // taken over so the storage goes now, whatever the caller does with items
+                vector_type dropped(std::move(items));
+                ++stats_.dropped;
+                return;
+            }
+            free_.push_back(std::move(items));
+            stats_.retained_bytes += size;
+        }
+
+        // deallocates every pooled vector
+        void trim() {
+            free_.clear();
+            free_.shrink_to_fit();
+            stats_.retained_bytes = 0;
+        }
+
+        const pool_limits &limits() const { return limits_; }
+
+        // applies to later releases; call trim() to drop what is already kept
+        void set_limits(pool_limits limits) { limits_ = limits; }
+
+        pool_stats stats() const {
+            pool_stats result = stats_;
+            result.pooled = free_.size();
+            return result;
+        }
+
+        void reset_stats() {
+            std::size_t retained = stats_.retained_bytes;
+            stats_ = pool_stats();
+            stats_.retained_bytes = retained;
+        }
+
+    private:
+        Allocator allocator_;
+        pool_limits limits_;
+        vector<vector_type> free_;
+        pool_stats stats_;
+
+        static std::size_t bytes(const vector_type &items) {
+            return static_cast<std::size_t>(items.capacity()) * sizeof(T);
+        }
+    };
+}